@@ -0,0 +1,250 @@
+#include "cache.hpp"
+
+namespace proto {
+
+static_assert(sizeof(cache_header_t) == CACHE_ALIGNMENT,
+              "Cache header must be CACHE_ALIGNMENT bytes");
+
+static size_t cache_align(const size_t n) {
+  return (n + CACHE_ALIGNMENT - 1) & ~((size_t) CACHE_ALIGNMENT - 1);
+}
+
+/**
+ * Get total size and newest modification time of the files at `paths`.
+ * @returns 0 for success or -1 for failure.
+ */
+static int cache_src_stat(const std::vector<std::string> &paths,
+                          uint64_t *size,
+                          int64_t *mtime) {
+  *size = 0;
+  *mtime = 0;
+  for (const auto &path : paths) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      return -1;
+    }
+
+    const int64_t ns =
+        (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    *size += st.st_size;
+    *mtime = std::max(*mtime, ns);
+  }
+
+  return 0;
+}
+
+cache_t::cache_t() {}
+
+cache_t::cache_t(const std::string &path_, const std::string &src_path)
+    : cache_t{path_, std::vector<std::string>{src_path}} {}
+
+cache_t::cache_t(const std::string &path_,
+                 const std::vector<std::string> &src_paths)
+    : path{path_} {
+  if (path.empty()) {
+    return;
+  }
+
+  // Check cache against source files
+  uint64_t src_size = 0;
+  int64_t src_mtime = 0;
+  if (cache_src_stat(src_paths, &src_size, &src_mtime) != 0) {
+    return;
+  }
+
+  // Map cache
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(cache_header_t)) {
+    close(fd);
+    return;
+  }
+  size = st.st_size;
+  data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    data = nullptr;
+    return;
+  }
+
+  // Validate header
+  const cache_header_t *header = (const cache_header_t *) data;
+  const size_t ts_size = cache_align(sizeof(timestamp_t) * header->nb_rows);
+  const size_t col_size = cache_align(sizeof(double) * header->nb_rows);
+  if (memcmp(header->magic, CACHE_MAGIC, 8) != 0 ||
+      header->version != CACHE_VERSION || header->src_size != src_size ||
+      header->src_mtime != src_mtime ||
+      size != sizeof(cache_header_t) + ts_size + header->nb_cols * col_size) {
+    return;
+  }
+
+  // Columns
+  const uint8_t *base = (const uint8_t *) data + sizeof(cache_header_t);
+  nb_rows = header->nb_rows;
+  nb_cols = header->nb_cols;
+  timestamps = (const timestamp_t *) base;
+  for (size_t j = 0; j < nb_cols; j++) {
+    cols.push_back((const double *) (base + ts_size + j * col_size));
+  }
+
+  ok = true;
+}
+
+cache_t::~cache_t() {
+  if (data) {
+    munmap(data, size);
+  }
+}
+
+/**
+ * Create directory `dir` if it does not exist.
+ * @returns 0 for success or -1 for failure.
+ */
+static int cache_mkdir(const std::string &dir) {
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Cache directory. This is `$PROTO_CACHE_DIR` if set, else
+ * `$XDG_CACHE_HOME/proto`, where `$XDG_CACHE_HOME` defaults to
+ * `$HOME/.cache`. The directory is created if it does not exist.
+ * @returns Cache directory, or empty to disable caching if it cannot be
+ * created.
+ */
+std::string cache_dir() {
+  const char *proto_dir = getenv("PROTO_CACHE_DIR");
+  const char *xdg_dir = getenv("XDG_CACHE_HOME");
+  const char *home_dir = getenv("HOME");
+
+  std::string dir;
+  if (proto_dir && strlen(proto_dir)) {
+    dir = proto_dir;
+  } else {
+    std::string base;
+    if (xdg_dir && strlen(xdg_dir)) {
+      base = xdg_dir;
+    } else if (home_dir && strlen(home_dir)) {
+      base = std::string{home_dir} + "/.cache";
+    } else {
+      return "";
+    }
+    if (cache_mkdir(base) != 0) {
+      return "";
+    }
+    dir = base + "/proto";
+  }
+
+  if (cache_mkdir(dir) != 0) {
+    return "";
+  }
+
+  return dir;
+}
+
+/**
+ * Cache path of text file at `src_path` in cache directory `dir`. The cache
+ * is named after the file and a hash of its absolute path, so files with the
+ * same name in different datasets do not collide.
+ * @returns Cache path, or empty if `dir` is empty or `src_path` is invalid.
+ */
+std::string cache_path(const std::string &src_path, const std::string &dir) {
+  if (dir.empty()) {
+    return "";
+  }
+
+  char abs_path[PATH_MAX];
+  if (realpath(src_path.c_str(), abs_path) == NULL) {
+    return "";
+  }
+
+  const std::string abs_str{abs_path};
+  const std::string name = abs_str.substr(abs_str.find_last_of('/') + 1);
+  char hash[17];
+  snprintf(hash,
+           sizeof(hash),
+           "%016zx",
+           (size_t) std::hash<std::string>{}(abs_str));
+
+  return dir + "/" + name + "." + hash + ".cache";
+}
+
+/**
+ * Save `timestamps` and the columns of `data` as a binary columnar cache of
+ * the text files at `src_paths`. The cache is written to a temporary file and
+ * renamed, so a cache is never observed partially written.
+ * @returns 0 for success or -1 for failure.
+ */
+int cache_save(const std::string &path,
+               const std::vector<std::string> &src_paths,
+               const timestamps_t &timestamps,
+               const matx_t &data) {
+  assert((size_t) data.rows() == timestamps.size());
+
+  // Setup header
+  cache_header_t header;
+  memset(&header, 0, sizeof(cache_header_t));
+  memcpy(header.magic, CACHE_MAGIC, 8);
+  header.version = CACHE_VERSION;
+  header.nb_cols = data.cols();
+  header.nb_rows = data.rows();
+  if (cache_src_stat(src_paths, &header.src_size, &header.src_mtime) != 0) {
+    LOG_ERROR("Failed to stat sources of cache [%s]!", path.c_str());
+    return -1;
+  }
+
+  // Write header, timestamps and columns
+  const std::string tmp_path = path + ".tmp";
+  FILE *fp = fopen(tmp_path.c_str(), "wb");
+  if (fp == NULL) {
+    LOG_ERROR("Failed to open [%s] for writing!", tmp_path.c_str());
+    return -1;
+  }
+
+  const size_t nb_rows = header.nb_rows;
+  const size_t ts_size = sizeof(timestamp_t) * nb_rows;
+  const size_t col_size = sizeof(double) * nb_rows;
+  const char padding[CACHE_ALIGNMENT] = {0};
+  std::vector<double> col(nb_rows);
+
+  bool ok = fwrite(&header, sizeof(cache_header_t), 1, fp) == 1;
+  ok = ok && fwrite(timestamps.data(), 1, ts_size, fp) == ts_size;
+  ok = ok && fwrite(padding, 1, cache_align(ts_size) - ts_size, fp) ==
+                 cache_align(ts_size) - ts_size;
+  for (long j = 0; j < data.cols() && ok; j++) {
+    for (size_t i = 0; i < nb_rows; i++) {
+      col[i] = data(i, j);
+    }
+    ok = ok && fwrite(col.data(), 1, col_size, fp) == col_size;
+    ok = ok && fwrite(padding, 1, cache_align(col_size) - col_size, fp) ==
+                   cache_align(col_size) - col_size;
+  }
+  ok = (fclose(fp) == 0) && ok;
+
+  if (ok == false || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOG_ERROR("Failed to write cache [%s]!", path.c_str());
+    remove(tmp_path.c_str());
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Save `timestamps` and the columns of `data` as a binary columnar cache of
+ * the text file at `src_path`.
+ * @returns 0 for success or -1 for failure.
+ */
+int cache_save(const std::string &path,
+               const std::string &src_path,
+               const timestamps_t &timestamps,
+               const matx_t &data) {
+  return cache_save(path, std::vector<std::string>{src_path}, timestamps, data);
+}
+
+} // namespace proto
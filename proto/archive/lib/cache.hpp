@@ -0,0 +1,82 @@
+#ifndef PROTO_CACHE_HPP
+#define PROTO_CACHE_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "core.hpp"
+
+namespace proto {
+
+#define CACHE_MAGIC "PROTOCSH"
+#define CACHE_VERSION 1
+#define CACHE_ALIGNMENT 64
+
+/**
+ * Binary columnar cache header. The header is followed by `nb_rows`
+ * timestamps and then `nb_cols` columns of `nb_rows` doubles, each section
+ * starting on a CACHE_ALIGNMENT byte boundary. The size and modification
+ * time of the text files the cache was built from, summed and the newest
+ * respectively, are kept to detect stale caches.
+ */
+struct cache_header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t nb_cols;
+  uint64_t nb_rows;
+  uint64_t src_size;
+  int64_t src_mtime;
+  uint8_t reserved[24];
+};
+
+/**
+ * Memory mapped binary columnar cache, `ok` is only set if the cache at
+ * `path` exists and is up to date with the text files at `src_paths`. An
+ * empty `path` means caching is disabled.
+ */
+struct cache_t {
+  bool ok = false;
+  std::string path;
+
+  void *data = nullptr;
+  size_t size = 0;
+  size_t nb_rows = 0;
+  size_t nb_cols = 0;
+  const timestamp_t *timestamps = nullptr;
+  std::vector<const double *> cols;
+
+  cache_t();
+  cache_t(const std::string &path_, const std::string &src_path);
+  cache_t(const std::string &path_, const std::vector<std::string> &src_paths);
+  cache_t(const cache_t &) = delete;
+  cache_t &operator=(const cache_t &) = delete;
+  ~cache_t();
+};
+
+std::string cache_dir();
+std::string cache_path(const std::string &src_path,
+                       const std::string &dir = cache_dir());
+int cache_save(const std::string &path,
+               const std::vector<std::string> &src_paths,
+               const timestamps_t &timestamps,
+               const matx_t &data);
+int cache_save(const std::string &path,
+               const std::string &src_path,
+               const timestamps_t &timestamps,
+               const matx_t &data);
+
+} // namespace proto
+#endif // PROTO_CACHE_HPP
@@ -6,6 +6,7 @@
 #include <inttypes.h>
 
 #include "core.hpp"
+#include "cache.hpp"
 #include "timeline.hpp"
 
 namespace proto {
@@ -43,6 +44,78 @@ struct euroc_imu_t {
     const std::string data_path = data_dir + "/data.csv";
     const std::string sensor_path = data_dir + "/sensor.yaml";
 
+    // Load binary cache, else parse the text file and cache it
+    if (load_cache(data_path) != 0) {
+      load_csv(data_path);
+      save_cache(data_path);
+    }
+
+    // Load calibration data
+    config_t config{sensor_path};
+    if (config.ok != true) {
+      FATAL("Failed to load sensor file [%s]!", sensor_path.c_str());
+    }
+    parse(config, "sensor_type", sensor_type);
+    parse(config, "comment", comment);
+    parse(config, "T_BS", T_BS);
+    parse(config, "rate_hz", rate_hz);
+    parse(config, "gyroscope_noise_density", gyro_noise_density);
+    parse(config, "gyroscope_random_walk", gyro_random_walk);
+    parse(config, "accelerometer_noise_density", accel_noise_density);
+    parse(config, "accelerometer_random_walk", accel_random_walk);
+
+    ok = true;
+  }
+
+  /**
+   * Load IMU data from the binary cache of `data_path`.
+   * @returns 0 for success or -1 if the cache is missing or stale.
+   */
+  int load_cache(const std::string &data_path) {
+    const cache_t cache{cache_path(data_path), data_path};
+    if (cache.ok == false || cache.nb_cols != 6) {
+      return -1;
+    }
+
+    timestamps.assign(cache.timestamps, cache.timestamps + cache.nb_rows);
+    w_B.resize(cache.nb_rows);
+    a_B.resize(cache.nb_rows);
+    for (size_t i = 0; i < cache.nb_rows; i++) {
+      w_B[i] = vec3_t{(real_t) cache.cols[0][i],
+                      (real_t) cache.cols[1][i],
+                      (real_t) cache.cols[2][i]};
+      a_B[i] = vec3_t{(real_t) cache.cols[3][i],
+                      (real_t) cache.cols[4][i],
+                      (real_t) cache.cols[5][i]};
+    }
+
+    return 0;
+  }
+
+  /**
+   * Save IMU data as a binary cache of `data_path` in the cache directory.
+   */
+  void save_cache(const std::string &data_path) {
+    // Caching is disabled if there is no cache directory
+    const std::string path = cache_path(data_path);
+    if (path.empty()) {
+      return;
+    }
+
+    matx_t data(timestamps.size(), 6);
+    for (size_t i = 0; i < timestamps.size(); i++) {
+      data.block(i, 0, 1, 3) = w_B[i].transpose();
+      data.block(i, 3, 1, 3) = a_B[i].transpose();
+    }
+    if (cache_save(path, data_path, timestamps, data) != 0) {
+      LOG_WARN("Failed to cache [%s]!", data_path.c_str());
+    }
+  }
+
+  /**
+   * Parse IMU data from the csv file at `data_path`.
+   */
+  void load_csv(const std::string &data_path) {
     // Open file for loading
     int nb_rows = 0;
     FILE *fp = file_open(data_path, "r", &nb_rows);
@@ -80,22 +153,6 @@ struct euroc_imu_t {
       a_B.emplace_back(a_x, a_y, a_z);
     }
     fclose(fp);
-
-    // Load calibration data
-    config_t config{sensor_path};
-    if (config.ok != true) {
-      FATAL("Failed to load sensor file [%s]!", sensor_path.c_str());
-    }
-    parse(config, "sensor_type", sensor_type);
-    parse(config, "comment", comment);
-    parse(config, "T_BS", T_BS);
-    parse(config, "rate_hz", rate_hz);
-    parse(config, "gyroscope_noise_density", gyro_noise_density);
-    parse(config, "gyroscope_random_walk", gyro_random_walk);
-    parse(config, "accelerometer_noise_density", accel_noise_density);
-    parse(config, "accelerometer_random_walk", accel_random_walk);
-
-    ok = true;
   }
 
   ~euroc_imu_t() {}
@@ -256,8 +313,68 @@ struct euroc_ground_truth_t {
 
   euroc_ground_truth_t(const std::string &data_dir_)
       : data_dir{data_dir_} {
-    // Open file for loading
+    // Load binary cache, else parse the text file and cache it
     const std::string data_path = data_dir + "/data.csv";
+    if (load_cache(data_path) != 0) {
+      load_csv(data_path);
+      save_cache(data_path);
+    }
+
+    ok = true;
+  }
+
+  /**
+   * Load ground truth from the binary cache of `data_path`.
+   * @returns 0 for success or -1 if the cache is missing or stale.
+   */
+  int load_cache(const std::string &data_path) {
+    const cache_t cache{cache_path(data_path), data_path};
+    if (cache.ok == false || cache.nb_cols != 16) {
+      return -1;
+    }
+
+    const auto &c = cache.cols;
+    timestamps.assign(cache.timestamps, cache.timestamps + cache.nb_rows);
+    for (size_t i = 0; i < cache.nb_rows; i++) {
+      p_RS_R.emplace_back(c[0][i], c[1][i], c[2][i]);
+      q_RS.emplace_back(c[3][i], c[4][i], c[5][i], c[6][i]);
+      v_RS_R.emplace_back(c[7][i], c[8][i], c[9][i]);
+      b_w_RS_S.emplace_back(c[10][i], c[11][i], c[12][i]);
+      b_a_RS_S.emplace_back(c[13][i], c[14][i], c[15][i]);
+    }
+
+    return 0;
+  }
+
+  /**
+   * Save ground truth as a binary cache of `data_path` in the cache
+   * directory.
+   */
+  void save_cache(const std::string &data_path) {
+    // Caching is disabled if there is no cache directory
+    const std::string path = cache_path(data_path);
+    if (path.empty()) {
+      return;
+    }
+
+    matx_t data(timestamps.size(), 16);
+    for (size_t i = 0; i < timestamps.size(); i++) {
+      data.block(i, 0, 1, 3) = p_RS_R[i].transpose();
+      data.block(i, 3, 1, 4) = q_RS[i].transpose();
+      data.block(i, 7, 1, 3) = v_RS_R[i].transpose();
+      data.block(i, 10, 1, 3) = b_w_RS_S[i].transpose();
+      data.block(i, 13, 1, 3) = b_a_RS_S[i].transpose();
+    }
+    if (cache_save(path, data_path, timestamps, data) != 0) {
+      LOG_WARN("Failed to cache [%s]!", data_path.c_str());
+    }
+  }
+
+  /**
+   * Parse ground truth from the csv file at `data_path`.
+   */
+  void load_csv(const std::string &data_path) {
+    // Open file for loading
     int nb_rows = 0;
     FILE *fp = file_open(data_path, "r", &nb_rows);
     if (fp == nullptr) {
@@ -318,8 +435,6 @@ struct euroc_ground_truth_t {
       b_a_RS_S.emplace_back(b_a_x, b_a_y, b_a_z);
     }
     fclose(fp);
-
-    ok = true;
   }
 
   ~euroc_ground_truth_t() {}
@@ -353,7 +468,7 @@ struct euroc_data_t {
 
   std::set<timestamp_t> timestamps;
   std::map<timestamp_t, double> time;
-  std::multimap<timestamp_t, timeline_event_t> timeline;
+  timeline_t timeline;
 
   euroc_data_t() {}
 
@@ -365,8 +480,7 @@ struct euroc_data_t {
       const timestamp_t ts = imu_data.timestamps[i];
       const vec3_t a_B = imu_data.a_B[i];
       const vec3_t w_B = imu_data.w_B[i];
-      const auto imu_event = timeline_event_t{ts, a_B, w_B};
-      timeline.insert({ts, imu_event});
+      timeline.add(timeline_event_t{ts, a_B, w_B});
     }
 
     // Load camera data
@@ -376,17 +490,15 @@ struct euroc_data_t {
     for (size_t i = 0; i < cam0_data.timestamps.size(); i++) {
       const timestamp_t ts = cam0_data.timestamps[i];
       const auto image_path = cam0_data.image_paths[i];
-      const auto cam0_event = timeline_event_t(ts, 0, image_path);
-      timeline.insert({ts, cam0_event});
+      timeline.add(timeline_event_t(ts, 0, image_path));
     }
     // -- Load cam1 data
     const auto cam1_path = data_path + "/mav0/cam1";
-    cam1_data = euroc_camera_t{cam0_path};
+    cam1_data = euroc_camera_t{cam1_path};
     for (size_t i = 0; i < cam1_data.timestamps.size(); i++) {
       const timestamp_t ts = cam1_data.timestamps[i];
       const auto image_path = cam1_data.image_paths[i];
-      const auto cam1_event = timeline_event_t(ts, 1, image_path);
-      timeline.insert({ts, cam1_event});
+      timeline.add(timeline_event_t(ts, 1, image_path));
     }
     // -- Set camera image size
     cv::Mat image = cv::imread(cam0_data.image_paths[0]);
@@ -401,18 +513,11 @@ struct euroc_data_t {
     ts_end = max_timestamp();
     ts_now = ts_start;
 
-    // Get timestamps and calculate relative time
-    auto it = timeline.begin();
-    auto it_end = timeline.end();
-    while (it != it_end) {
-      const timestamp_t ts = it->first;
-      timestamps.insert(ts);
-      time[ts] = ((double) ts - ts_start) * 1e-9;
-
-      // Advance to next non-duplicate entry.
-      do {
-        ++it;
-      } while (ts == it->first);
+    // Merge timeline, get timestamps and calculate relative time
+    timeline.merge();
+    for (const timestamp_t ts : timeline.timestamps) {
+      timestamps.insert(timestamps.end(), ts);
+      time.insert(time.end(), {ts, ((double) ts - ts_start) * 1e-9});
     }
 
     ok = true;
@@ -453,6 +558,192 @@ struct euroc_data_t {
   }
 };
 
+/*****************************************************************************
+ * euroc_stream_t
+ ****************************************************************************/
+
+/**
+ * Read the next data line of the EuRoC csv file `fp` into `line`, skipping
+ * the header and comment lines.
+ * @returns 0 for success or -1 at the end of the file.
+ */
+static int euroc_read_line(FILE *fp, char *line, const int line_size) {
+  while (fgets(line, line_size, fp) != NULL) {
+    if (line[0] != '#' && line[0] != '\n' && line[0] != '\r') {
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Parse `n` comma separated values after the timestamp at the start of
+ * `line`.
+ * @returns 0 for success or -1 for failure.
+ */
+static int euroc_parse_line(const char *line,
+                            timestamp_t *ts,
+                            double *values,
+                            const int n) {
+  char *end = nullptr;
+  *ts = strtoll(line, &end, 10);
+  for (int i = 0; i < n; i++) {
+    if (*end != ',') {
+      return -1;
+    }
+    values[i] = strtod(end + 1, &end);
+  }
+  return 0;
+}
+
+/**
+ * EuRoC IMU event source
+ */
+struct euroc_imu_source_t : timeline_source_t {
+  std::string data_path;
+  FILE *fp = nullptr;
+
+  euroc_imu_source_t(const std::string &data_dir)
+      : data_path{data_dir + "/data.csv"} {
+    fp = fopen(data_path.c_str(), "r");
+    if (fp == nullptr) {
+      FATAL("Failed to open [%s]!", data_path.c_str());
+    }
+  }
+
+  ~euroc_imu_source_t() { fclose(fp); }
+
+  int read(timeline_event_t &event) {
+    char line[1024] = {0};
+    if (euroc_read_line(fp, line, 1024) != 0) {
+      return -1;
+    }
+
+    timestamp_t ts = 0;
+    double v[6] = {0};
+    if (euroc_parse_line(line, &ts, v, 6) != 0) {
+      FATAL("Failed to parse line in [%s]", data_path.c_str());
+    }
+    const vec3_t w_B{v[0], v[1], v[2]};
+    const vec3_t a_B{v[3], v[4], v[5]};
+    event = timeline_event_t{ts, a_B, w_B};
+
+    return 0;
+  }
+};
+
+/**
+ * EuRoC camera event source
+ */
+struct euroc_camera_source_t : timeline_source_t {
+  std::string data_dir;
+  std::string data_path;
+  int camera_index = 0;
+  FILE *fp = nullptr;
+
+  euroc_camera_source_t(const std::string &data_dir_, const int camera_index_)
+      : data_dir{data_dir_}, data_path{data_dir + "/data.csv"},
+        camera_index{camera_index_} {
+    fp = fopen(data_path.c_str(), "r");
+    if (fp == nullptr) {
+      FATAL("Failed to open [%s]!", data_path.c_str());
+    }
+  }
+
+  ~euroc_camera_source_t() { fclose(fp); }
+
+  int read(timeline_event_t &event) {
+    char line[1024] = {0};
+    if (euroc_read_line(fp, line, 1024) != 0) {
+      return -1;
+    }
+
+    char *end = nullptr;
+    const timestamp_t ts = strtoll(line, &end, 10);
+    if (*end != ',') {
+      FATAL("Failed to parse line in [%s]", data_path.c_str());
+    }
+    const std::string image_file = strip_end(end + 1, "\r\n");
+    const auto image_path = data_dir + "/data/" + image_file;
+    event = timeline_event_t(ts, camera_index, image_path);
+
+    return 0;
+  }
+};
+
+/**
+ * EuRoC motion capture event source
+ */
+struct euroc_mocap_source_t : timeline_source_t {
+  std::string object_name;
+  std::string data_path;
+  FILE *fp = nullptr;
+
+  euroc_mocap_source_t(const std::string &data_dir,
+                       const std::string &object_name_)
+      : object_name{object_name_}, data_path{data_dir + "/data.csv"} {
+    fp = fopen(data_path.c_str(), "r");
+    if (fp == nullptr) {
+      FATAL("Failed to open [%s]!", data_path.c_str());
+    }
+  }
+
+  ~euroc_mocap_source_t() { fclose(fp); }
+
+  int read(timeline_event_t &event) {
+    char line[1024] = {0};
+    if (euroc_read_line(fp, line, 1024) != 0) {
+      return -1;
+    }
+
+    timestamp_t ts = 0;
+    double v[7] = {0};
+    if (euroc_parse_line(line, &ts, v, 7) != 0) {
+      FATAL("Failed to parse line in [%s]", data_path.c_str());
+    }
+    const vec3_t r_WM{v[0], v[1], v[2]};
+    const quat_t q_WM{v[3], v[4], v[5], v[6]};
+    event = timeline_event_t{ts, object_name, r_WM, q_WM};
+
+    return 0;
+  }
+};
+
+/**
+ * EuRoC data stream, yields the IMU, camera and motion capture events of a
+ * sequence in time order directly from the dataset files. Unlike
+ * `euroc_data_t` the sequence is never loaded as a whole, at most
+ * `window_size` events per sensor are held in memory so processing can
+ * start immediately and memory use does not grow with sequence length.
+ */
+struct euroc_stream_t {
+  bool ok = false;
+  std::string data_path;
+  timeline_stream_t stream;
+
+  euroc_stream_t(const std::string &data_path_,
+                 const size_t window_size = 100)
+      : data_path{strip_end(data_path_, "/")}, stream{window_size} {
+    const std::string mav_path = data_path + "/mav0";
+    stream.add(new euroc_imu_source_t{mav_path + "/imu0"});
+    stream.add(new euroc_camera_source_t{mav_path + "/cam0", 0});
+    stream.add(new euroc_camera_source_t{mav_path + "/cam1", 1});
+    if (file_exists(mav_path + "/vicon0/data.csv")) {
+      stream.add(new euroc_mocap_source_t{mav_path + "/vicon0", "vicon0"});
+    }
+
+    ok = true;
+  }
+
+  ~euroc_stream_t() {}
+
+  /**
+   * Get next event in time order.
+   * @returns 0 for success or -1 at the end of the sequence.
+   */
+  int next(timeline_event_t &event) { return stream.next(event); }
+};
+
 /*****************************************************************************
  * euroc_target_t
  ****************************************************************************/
@@ -579,7 +870,7 @@ struct euroc_calib_t {
     for (size_t i = 0; i < calib_data.cam1_data.timestamps.size(); i++) {
       const auto ts = calib_data.cam1_data.timestamps[i];
       const auto img_path = calib_data.cam1_data.image_paths[i];
-      const timeline_event_t event{ts, 0, img_path};
+      const timeline_event_t event{ts, 1, img_path};
       timeline.add(event);
     }
     // -- Add imu events
@@ -590,6 +881,7 @@ struct euroc_calib_t {
       const timeline_event_t event{ts, a_B, w_B};
       timeline.add(event);
     }
+    timeline.merge();
 
     return timeline;
   }
@@ -2,6 +2,7 @@
 #define PROTO_KITTI_HPP
 
 #include "core.hpp"
+#include "cache.hpp"
 
 namespace proto {
 
@@ -18,25 +19,21 @@ struct kitti {
   }
 
   static std::vector<real_t> parse_array(const std::string &line) {
-    // Setup
-    std::string s = parse_string(line);
-    std::string delimiter = " ";
-
-    // Extract tokens
-    size_t pos = 0;
-    std::string token;
+    // Parse space separated values after the ':'
+    const std::string s = parse_string(line);
+    const char *p = s.c_str();
+    char *end = nullptr;
     std::vector<real_t> values;
 
-    while ((pos = s.find(delimiter)) != std::string::npos) {
-      token = s.substr(0, pos);
-      values.push_back(std::stod(token));
-      s.erase(0, pos + delimiter.length());
+    while (true) {
+      const real_t value = strtod(p, &end);
+      if (end == p) {
+        break;
+      }
+      values.push_back(value);
+      p = end;
     }
 
-    // Extract last token
-    token = s.substr(0, pos);
-    values.push_back(std::stod(token));
-
     return values;
   }
 
@@ -316,6 +313,8 @@ struct calib_velo2cam_t {
 };
 
 /** OXTS entry **/
+#define OXTS_NB_FIELDS 25
+
 struct oxts_entry_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
   std::string file_path;
@@ -342,7 +341,15 @@ struct oxts_entry_t {
     // Load the data
     std::string line;
     std::getline(oxt_file, line);
-    const std::vector<real_t> array = kitti::parse_array(line);
+    parse(kitti::parse_array(line));
+  }
+
+  oxts_entry_t(const std::vector<real_t> &array) { parse(array); }
+
+  void parse(const std::vector<real_t> &array) {
+    if (array.size() < OXTS_NB_FIELDS) {
+      FATAL("Invalid OXTS entry [%s]!", file_path.c_str());
+    }
 
     // Store
     const real_t lat = array[0];
@@ -405,47 +412,74 @@ struct oxts_t {
 
   oxts_t() {}
   oxts_t(const std::string &oxts_dir_) : oxts_dir{oxts_dir_} {
-    // ----------------------- LOAD OXTS ENTRIES -----------------------------
     // Get list of oxts files
     const std::string oxts_data_dir = strip(oxts_dir) + "/data";
+    const std::string ts_path = strip(oxts_dir) + "/timestamps.txt";
     std::vector<std::string> oxts_files;
     if (list_dir(oxts_data_dir, oxts_files) != 0) {
       FATAL("Failed to list directory [%s]!", oxts_data_dir.c_str());
     }
     std::sort(oxts_files.begin(), oxts_files.end());
 
-    // Get first GPS point
-    oxts_entry_t first_entry{oxts_data_dir + "/" + oxts_files[0]};
-
-    // Store initial conditions
-    const vec3_t gps_ref = first_entry.gps;
-    gps.emplace_back(first_entry.gps);
-    rpy.emplace_back(first_entry.rpy);
-    p_G.emplace_back(0, 0, 0);
-    v_G.emplace_back(first_entry.v_G);
-    v_B.emplace_back(first_entry.v_B);
-    a_G.emplace_back(first_entry.a_G);
-    a_B.emplace_back(first_entry.a_B);
-    w_G.emplace_back(first_entry.w_G);
-    w_B.emplace_back(first_entry.w_B);
-    pos_accuracy.push_back(first_entry.pos_accuracy);
-    vel_accuracy.push_back(first_entry.vel_accuracy);
-
-    // Parse oxts files
-    for (size_t i = 1; i < oxts_files.size(); i++) {
-      // Parse single oxts file
-      oxts_entry_t entry{oxts_data_dir + "/" + oxts_files[i]};
+    // Load binary cache of the oxts entries, else parse the text files and
+    // cache them. The cache is checked against the timestamps file and every
+    // oxts file, so editing any of them invalidates it.
+    std::vector<std::string> src_paths{ts_path};
+    for (const auto &oxts_file : oxts_files) {
+      src_paths.push_back(oxts_data_dir + "/" + oxts_file);
+    }
+    const std::string oxts_cache = cache_path(oxts_dir);
+    const cache_t cache{oxts_cache, src_paths};
+    timestamps_t entry_ts;
+    matx_t entries;
+    if (cache.ok && cache.nb_cols == OXTS_NB_FIELDS &&
+        cache.nb_rows == oxts_files.size()) {
+      entry_ts.assign(cache.timestamps, cache.timestamps + cache.nb_rows);
+      entries.resize(cache.nb_rows, OXTS_NB_FIELDS);
+      for (size_t j = 0; j < OXTS_NB_FIELDS; j++) {
+        const Eigen::Map<const Eigen::VectorXd> col{cache.cols[j],
+                                                    (long) cache.nb_rows};
+        entries.col(j) = col.cast<real_t>();
+      }
+    } else {
+      entries = load_entries(oxts_data_dir, oxts_files);
+      entry_ts = load_timestamps(ts_path);
+      if (oxts_cache.empty()) {
+        // Caching disabled, no cache directory
+      } else if ((size_t) entries.rows() != entry_ts.size()) {
+        LOG_WARN("Not caching [%s], %ld entries but %zu timestamps!",
+                 oxts_dir.c_str(),
+                 entries.rows(),
+                 entry_ts.size());
+      } else if (cache_save(oxts_cache, src_paths, entry_ts, entries) != 0) {
+        LOG_WARN("Failed to cache [%s]!", oxts_dir.c_str());
+      }
+    }
+
+    // Store oxts entries, positions are relative to the first GPS point
+    vec3_t gps_ref;
+    std::vector<real_t> array(OXTS_NB_FIELDS);
+    for (long i = 0; i < entries.rows(); i++) {
+      for (long j = 0; j < OXTS_NB_FIELDS; j++) {
+        array[j] = entries(i, j);
+      }
+      const oxts_entry_t entry{array};
 
       // Calculate local position
       real_t dist_N = 0.0;
       real_t dist_E = 0.0;
-      real_t alt = entry.gps(2) - gps_ref(2);
-      latlon_diff(gps_ref(0),
-                  gps_ref(1),
-                  entry.gps(0),
-                  entry.gps(1),
-                  &dist_N,
-                  &dist_E);
+      real_t alt = 0.0;
+      if (i == 0) {
+        gps_ref = entry.gps;
+      } else {
+        alt = entry.gps(2) - gps_ref(2);
+        latlon_diff(gps_ref(0),
+                    gps_ref(1),
+                    entry.gps(0),
+                    entry.gps(1),
+                    &dist_N,
+                    &dist_E);
+      }
 
       // Store data
       gps.emplace_back(entry.gps);
@@ -461,10 +495,49 @@ struct oxts_t {
       vel_accuracy.push_back(entry.vel_accuracy);
     }
 
-    // ------------------------ LOAD TIMESTAMPS ------------------------------
-    const std::string file_path = strip(oxts_dir) + "/timestamps.txt";
+    // Store timestamps
+    for (const auto ts : entry_ts) {
+      timestamps.push_back(ts);
+      time.push_back((real_t) (ts - entry_ts[0]) * 1.0e-9);
+    }
+  }
+
+  /**
+   * Parse the oxts entries in `oxts_files` under `oxts_data_dir`, one row
+   * of OXTS_NB_FIELDS values per file.
+   */
+  static matx_t load_entries(const std::string &oxts_data_dir,
+                             const std::vector<std::string> &oxts_files) {
+    matx_t entries(oxts_files.size(), OXTS_NB_FIELDS);
+
+    for (size_t i = 0; i < oxts_files.size(); i++) {
+      const std::string file_path = oxts_data_dir + "/" + oxts_files[i];
+      std::ifstream oxt_file(file_path.c_str());
+      if (oxt_file.good() == false) {
+        FATAL("Failed to load file [%s]!", file_path.c_str());
+      }
+
+      std::string line;
+      std::getline(oxt_file, line);
+      const std::vector<real_t> array = kitti::parse_array(line);
+      if (array.size() < OXTS_NB_FIELDS) {
+        FATAL("Invalid OXTS entry [%s]!", file_path.c_str());
+      }
+      for (size_t j = 0; j < OXTS_NB_FIELDS; j++) {
+        entries(i, j) = array[j];
+      }
+    }
+
+    return entries;
+  }
+
+  /**
+   * Parse the KITTI date time strings in the timestamps file at `file_path`.
+   */
+  static timestamps_t load_timestamps(const std::string &file_path) {
     std::string line;
     std::ifstream timestamps_file(file_path.c_str());
+    timestamps_t timestamps;
 
     // Get first timestamp
     long ts_first = 0;
@@ -475,7 +548,6 @@ struct oxts_t {
       FATAL("Failed to parse timestamp -> [%s]", line.c_str());
     }
     timestamps.push_back(ts_first);
-    time.push_back(0.0);
     line = std::string();
 
     // Parse the rest of timestamps
@@ -496,9 +568,10 @@ struct oxts_t {
       }
 
       timestamps.push_back(ts);
-      time.push_back((real_t) (ts - ts_first) * 1.0e-9);
       line = std::string();
     }
+
+    return timestamps;
   }
 };
 
@@ -1,7 +1,12 @@
 #ifndef PROTO_SE_HPP
 #define PROTO_SE_HPP
 
+#include <initializer_list>
+#include <stdexcept>
+#include <unordered_map>
+
 #include "core.hpp"
+#include "cache.hpp"
 
 namespace proto {
 
@@ -9,12 +14,26 @@ namespace proto {
 
 typedef ssize_t id_t;
 
+/**
+ * Parameter type tags, `graph_t` orders its Jacobian columns by tag.
+ */
+enum param_type_t {
+  POSE_PARAM,
+  FIDUCIAL_POSE_PARAM,
+  EXTRINSIC_PARAM,
+  LANDMARK_PARAM,
+  CAMERA_PARAM,
+  SB_PARAM,
+  NB_PARAM_TYPES
+};
+
 struct param_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
   bool fixed = false;
   bool marginalize = false;
 
   std::string type;
+  param_type_t tag = POSE_PARAM;
   id_t id = -1;
   timestamp_t ts = 0;
   long local_size = 0;
@@ -23,9 +42,15 @@ struct param_t {
 
   std::vector<id_t> factor_ids;
 
+  // Graph bookkeeping
+  size_t nb_factors = 0;  // Number of graph factors using this param
+  long col = -1;          // Jacobian column offset within its param block
+  long pool = -1;         // Graph pool owning this param, -1 if heap allocated
+
   param_t() {}
 
   param_t(const std::string &type_,
+          const param_type_t tag_,
           const id_t id_,
           const timestamp_t &ts_,
           const long local_size_,
@@ -33,6 +58,7 @@ struct param_t {
           const bool fixed_=false)
     : fixed{fixed_},
       type{type_},
+      tag{tag_},
       id{id_},
       ts{ts_},
       local_size{local_size_},
@@ -40,11 +66,12 @@ struct param_t {
       param{zeros(global_size_, 1)} {}
 
   param_t(const std::string &type_,
+          const param_type_t tag_,
           const id_t id_,
           const long local_size_,
           const long global_size_,
           const bool fixed_=false)
-    : param_t{type_, id_, 0, local_size_, global_size_, fixed_} {}
+    : param_t{type_, tag_, id_, 0, local_size_, global_size_, fixed_} {}
 
   virtual ~param_t() {}
 
@@ -55,6 +82,9 @@ struct param_t {
 
   virtual void plus(const vecx_t &) = 0;
   virtual void perturb(const int i, const real_t step_size) = 0;
+
+  /** Local difference between `param` and `param0`, the inverse of `plus()` **/
+  virtual vecx_t minus(const vecx_t &param0) const { return param - param0; }
 };
 
 struct pose_t : param_t {
@@ -66,7 +96,7 @@ struct pose_t : param_t {
          const timestamp_t &ts_,
          const vec_t<7> &pose,
          const bool fixed_=false)
-      : param_t{"pose_t", id_, ts_, 6, 7, fixed_} {
+      : param_t{"pose_t", POSE_PARAM, id_, ts_, 6, 7, fixed_} {
     param = pose;
   }
 
@@ -74,7 +104,7 @@ struct pose_t : param_t {
          const timestamp_t &ts_,
          const mat4_t &T,
          const bool fixed_=false)
-      : param_t{"pose_t", id_, ts_, 6, 7, fixed_} {
+      : param_t{"pose_t", POSE_PARAM, id_, ts_, 6, 7, fixed_} {
     const quat_t q{tf_quat(T)};
     const vec3_t r{tf_trans(T)};
 
@@ -142,6 +172,20 @@ struct pose_t : param_t {
     param(6) += dx(5);
   }
 
+  vecx_t minus(const vecx_t &param0) const {
+    const quat_t q0{param0(0), param0(1), param0(2), param0(3)};
+    const vec3_t r0{param0(4), param0(5), param0(6)};
+
+    quat_t dq = rot() * q0.inverse();
+    if (dq.w() < 0.0) {
+      dq.coeffs() *= -1.0;
+    }
+
+    vecx_t dx{6};
+    dx << 2.0 * dq.vec(), trans() - r0;
+    return dx;
+  }
+
   void perturb(const int i, const real_t step_size) {
     if (i >= 0 && i < 3) {
       const auto T_WS_diff = tf_perturb_rot(this->tf(), step_size, i);
@@ -165,6 +209,7 @@ struct fiducial_pose_t : pose_t {
   fiducial_pose_t(const id_t id_, const mat4_t &T, const bool fixed_=false)
     : pose_t{id_, 0, T, fixed_} {
     this->type = "fiducial_pose_t";
+    this->tag = FIDUCIAL_POSE_PARAM;
   }
 };
 
@@ -176,6 +221,7 @@ struct extrinsic_t : pose_t {
   extrinsic_t(const id_t id_, const mat4_t &T, const bool fixed_=false)
     : pose_t{id_, 0, T, fixed_} {
     this->type = "extrinsic_t";
+    this->tag = EXTRINSIC_PARAM;
   }
 };
 
@@ -185,7 +231,7 @@ struct landmark_t : param_t {
   landmark_t() {}
 
   landmark_t(const id_t id_, const vec3_t &p_W_, const bool fixed_=false)
-    : param_t{"landmark_t", id_, 3, 3, fixed_} {
+    : param_t{"landmark_t", LANDMARK_PARAM, id_, 3, 3, fixed_} {
     param = p_W_;
   }
 
@@ -211,7 +257,8 @@ struct camera_params_t : param_t {
                   const vecx_t &proj_params_,
                   const vecx_t &dist_params_,
                   const bool fixed_=false)
-    : param_t{"camera_params_t", id_, proj_params_.size() + dist_params_.size(),
+    : param_t{"camera_params_t", CAMERA_PARAM, id_,
+              proj_params_.size() + dist_params_.size(),
               proj_params_.size() + dist_params_.size(),
               fixed_},
       cam_index{cam_index_},
@@ -240,7 +287,7 @@ struct sb_params_t : param_t {
              const vec3_t &ba_,
              const vec3_t &bg_,
              const bool fixed_=false)
-    : param_t{"sb_params_t", id_, ts_, 9, 9, fixed_} {
+    : param_t{"sb_params_t", SB_PARAM, id_, ts_, 9, 9, fixed_} {
     param << v_, ba_, bg_;
   }
 
@@ -258,39 +305,170 @@ void keypoints_print(const keypoints_t &keypoints);
 
 /******************************** FACTORS ************************************/
 
+/** Number of factor parameters stored inline, most factors need no more **/
+#define FACTOR_INLINE_PARAMS 4
+
+/**
+ * Vector that keeps up to `N` elements inline and only allocates once it
+ * grows beyond that.
+ */
+template <typename T, size_t N>
+struct inline_vector_t {
+  size_t nb_items = 0;
+  T items[N] = {};
+  std::vector<T> spill;
+
+  T *data() { return spill.empty() ? items : spill.data(); }
+  const T *data() const { return spill.empty() ? items : spill.data(); }
+
+  void push_back(const T &item) {
+    if (nb_items < N && spill.empty()) {
+      items[nb_items++] = item;
+      return;
+    }
+    if (spill.empty()) {
+      spill.assign(items, items + nb_items);
+    }
+    spill.push_back(item);
+    nb_items++;
+  }
+
+  void clear() {
+    nb_items = 0;
+    spill.clear();
+  }
+
+  size_t size() const { return nb_items; }
+  T &operator[](const size_t i) { return data()[i]; }
+  const T &operator[](const size_t i) const { return data()[i]; }
+  T *begin() { return data(); }
+  T *end() { return data() + nb_items; }
+  const T *begin() const { return data(); }
+  const T *end() const { return data() + nb_items; }
+};
+
+/**
+ * Parameters of a factor, stored inline so that creating a factor does not
+ * allocate.
+ */
+struct factor_params_t : inline_vector_t<param_t *, FACTOR_INLINE_PARAMS> {
+  factor_params_t() {}
+
+  factor_params_t(std::initializer_list<param_t *> params_) {
+    for (auto param : params_) {
+      push_back(param);
+    }
+  }
+
+  factor_params_t(const std::vector<param_t *> &params_) {
+    for (auto param : params_) {
+      push_back(param);
+    }
+  }
+};
+
+/**
+ * Jacobians of a factor w.r.t. each of its parameters, these are views onto
+ * the Jacobian storage of the concrete factor type (see `factor_storage_t`).
+ */
+struct factor_jacobians_t {
+  long rows = 0;
+  inline_vector_t<long, FACTOR_INLINE_PARAMS> cols;
+  inline_vector_t<real_t *, FACTOR_INLINE_PARAMS> data;
+
+  size_t size() const { return data.size(); }
+
+  map_mat_t<Eigen::Dynamic, Eigen::Dynamic> operator[](const size_t i) {
+    return map_mat_t<Eigen::Dynamic, Eigen::Dynamic>{data[i], rows, cols[i]};
+  }
+
+  Eigen::Map<const matx_t> operator[](const size_t i) const {
+    return Eigen::Map<const matx_t>{data[i], rows, cols[i]};
+  }
+};
+
+/** Total number of Jacobian columns of a factor with params of size `cols` **/
+constexpr int factor_cols() { return 0; }
+
+template <typename... COLS>
+constexpr int factor_cols(const int col, const COLS... cols) {
+  return (col == Eigen::Dynamic || factor_cols(cols...) == Eigen::Dynamic)
+             ? Eigen::Dynamic
+             : col + factor_cols(cols...);
+}
+
+/**
+ * Fixed-size residual, square-root information and Jacobian storage of a
+ * factor with `R` residuals and parameters of local size `COLS`. The
+ * Jacobians w.r.t. each parameter sit side by side in `jacobians`.
+ */
+template <int R, int... COLS>
+struct factor_storage_t {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  vec_t<R> residuals;
+  mat_t<R, R> sqrt_info;
+  mat_t<R, factor_cols(COLS...)> jacobians;
+};
+
 struct factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
   bool marginalize = false;
 
   std::string type = "factor_t";
   id_t id = 0;
+  long pool = -1;  // Graph pool owning this factor, -1 if heap allocated
 
-  matx_t covar;
-  matx_t info;
-  matx_t sqrt_info;
-
-  std::vector<param_t *> params;
-  vecx_t residuals;
-  matxs_t jacobians;
+  factor_params_t params;
+  map_vec_t<Eigen::Dynamic> residuals{nullptr, 0};
+  map_mat_t<Eigen::Dynamic, Eigen::Dynamic> sqrt_info{nullptr, 0, 0};
+  factor_jacobians_t jacobians;
 
   factor_t() {}
 
-  factor_t(const id_t id_,
-           const matx_t &covar_,
-           const std::vector<param_t *> &params_)
-    : id{id_}, covar{covar_}, info{covar_.inverse()}, params{params_} {
-    Eigen::LLT<matx_t> llt_info(info);
-    sqrt_info = llt_info.matrixL().transpose();
-  }
+  factor_t(const id_t id_, const factor_params_t &params_)
+    : id{id_}, params{params_} {}
 
-  factor_t(const id_t id_, const matx_t &covar_, param_t * &param_)
-    : id{id_}, covar{covar_}, info{covar_.inverse()}, params{param_} {
-    Eigen::LLT<matx_t> llt_info(info);
-    sqrt_info = llt_info.matrixL().transpose();
-  }
+  factor_t(const factor_t &) = delete;
+  factor_t &operator=(const factor_t &) = delete;
 
   virtual ~factor_t() {}
   virtual int eval(const bool jacs=true) = 0;
+
+  /**
+   * Point `residuals`, `sqrt_info` and `jacobians` at the `storage` of the
+   * concrete factor type and form the square-root information from `covar`.
+   */
+  template <typename STORAGE, typename COVAR>
+  void bind_storage(STORAGE &storage, const COVAR &covar) {
+    typedef decltype(storage.sqrt_info) sqrt_info_t;
+    const long rows = covar.rows();
+
+    long cols = 0;
+    for (const auto param : params) {
+      cols += param->local_size;
+    }
+    storage.residuals.setZero(rows);
+    storage.jacobians.setZero(rows, cols);
+
+    const sqrt_info_t covar_ = covar;
+    const sqrt_info_t info = covar_.inverse();
+    const Eigen::LLT<sqrt_info_t> llt_info(info);
+    storage.sqrt_info = llt_info.matrixL().transpose();
+
+    new (&residuals) map_vec_t<Eigen::Dynamic>(storage.residuals.data(), rows);
+    new (&sqrt_info) map_mat_t<Eigen::Dynamic, Eigen::Dynamic>(
+        storage.sqrt_info.data(), rows, rows);
+
+    long col = 0;
+    jacobians.rows = rows;
+    jacobians.cols.clear();
+    jacobians.data.clear();
+    for (const auto param : params) {
+      jacobians.cols.push_back(param->local_size);
+      jacobians.data.push_back(storage.jacobians.data() + col * rows);
+      col += param->local_size;
+    }
+  }
 };
 
 int check_jacobians(factor_t *factor,
@@ -301,15 +479,15 @@ int check_jacobians(factor_t *factor,
 
 struct pose_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  factor_storage_t<6, 6> storage;
   const mat4_t pose_meas;
 
   pose_factor_t(const id_t id_,
                 const mat_t<6, 6> &covar_,
                 param_t *param_)
-      : factor_t{id_, covar_, param_}, pose_meas{tf(param_->param)} {
+      : factor_t{id_, {param_}}, pose_meas{tf(param_->param)} {
     type = "pose_factor_t";
-    residuals = zeros(6, 1);
-    jacobians.push_back(zeros(6, 6));
+    bind_storage(storage, covar_);
   }
 
   int eval(const bool jacs=true) {
@@ -354,15 +532,15 @@ struct extrinsic_factor_t : pose_factor_t {
 
 struct speed_bias_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  factor_storage_t<9, 9> storage;
   const vec_t<9> sb_meas;
 
   speed_bias_factor_t(const id_t id_,
                       const mat_t<9, 9> &covar_,
                       param_t * param_)
-      : factor_t{id_, covar_, param_}, sb_meas{param_->param} {
+      : factor_t{id_, {param_}}, sb_meas{param_->param} {
     type = "speed_bias_factor_t";
-    residuals = zeros(9, 1);
-    jacobians.push_back(zeros(9, 9));
+    bind_storage(storage, covar_);
   }
 
   int eval(const bool jacs=true) {
@@ -384,15 +562,15 @@ struct speed_bias_factor_t : factor_t {
 
 struct camera_params_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  factor_storage_t<Eigen::Dynamic, Eigen::Dynamic> storage;
   const vecx_t meas;
 
   camera_params_factor_t(const id_t id_,
                          const matx_t &covar_,
                          param_t *param_)
-      : factor_t(id_, covar_, {param_}), meas{param_->param} {
+      : factor_t{id_, {param_}}, meas{param_->param} {
     type = "camera_params_factor_t";
-    residuals = zeros(9, 1);
-    jacobians.push_back(zeros(9, 9));
+    bind_storage(storage, covar_);
   }
 
   int eval(const bool jacs=true) {
@@ -414,15 +592,15 @@ struct camera_params_factor_t : factor_t {
 
 struct landmark_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
-  const vecx_t meas;
+  factor_storage_t<3, 3> storage;
+  const vec3_t meas;
 
   landmark_factor_t(const id_t id_,
-                    const matx_t &covar_,
+                    const mat3_t &covar_,
                     param_t *param_)
-      : factor_t(id_, covar_, {param_}), meas{param_->param} {
+      : factor_t{id_, {param_}}, meas{param_->param} {
     type = "landmark_factor_t";
-    residuals = zeros(3, 1);
-    jacobians.push_back(zeros(3, 3));
+    bind_storage(storage, covar_);
   }
 
   int eval(const bool jacs=true) {
@@ -445,6 +623,7 @@ struct landmark_factor_t : factor_t {
 template <typename CM>
 struct ba_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  factor_storage_t<2, 6, 3, CM::params_size> storage;
 
   int cam_index = 0;
   int resolution[2] = {0, 0};
@@ -456,13 +635,10 @@ struct ba_factor_t : factor_t {
               const timestamp_t &ts_,
               const vec2_t &z_,
               const mat2_t &covar_,
-              const std::vector<param_t *> &params_)
-      : factor_t{id_, covar_, params_}, ts{ts_}, z{z_} {
+              const factor_params_t &params_)
+      : factor_t{id_, params_}, ts{ts_}, z{z_} {
     type = "ba_factor_t";
-    residuals = zeros(2, 1);
-    jacobians.push_back(zeros(2, 6));  // T_WC
-    jacobians.push_back(zeros(2, 3));  // p_W
-    jacobians.push_back(zeros(2, CM::params_size));  // Camera params
+    bind_storage(storage, covar_);  // J: T_WC, p_W, camera params
 
     auto cam_params = static_cast<camera_params_t *>(params_[2]);
     cam_index = cam_params->cam_index;
@@ -523,6 +699,7 @@ struct ba_factor_t : factor_t {
 template <typename CM>
 struct calib_mono_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  factor_storage_t<2, 6, 6, CM::params_size> storage;
 
   int cam_index = 0;
   int resolution[2] = {0, 0};
@@ -540,14 +717,11 @@ struct calib_mono_factor_t : factor_t {
                       const vec3_t &r_FFi_,
                       const vec2_t &z_,
                       const mat2_t &covar_,
-                      const std::vector<param_t *> &params_)
-      : factor_t{id_, covar_, params_}, ts{ts_},
+                      const factor_params_t &params_)
+      : factor_t{id_, params_}, ts{ts_},
         tag_id{tag_id_}, tag_corner{tag_corner_}, r_FFi{r_FFi_}, z{z_} {
     type = "calib_mono_factor_t";
-    residuals = zeros(2, 1);
-    jacobians.push_back(zeros(2, 6));  // T_WC
-    jacobians.push_back(zeros(2, 6));  // T_WF
-    jacobians.push_back(zeros(2, CM::params_size));  // Camera params
+    bind_storage(storage, covar_);  // J: T_WC, T_WF, camera params
 
     auto cam_params = static_cast<camera_params_t *>(params_[2]);
     cam_index = cam_params->cam_index;
@@ -611,6 +785,7 @@ struct calib_mono_factor_t : factor_t {
 template <typename CM>
 struct cam_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  factor_storage_t<2, 6, 6, 3, CM::params_size> storage;
 
   int cam_index = 0;
   int resolution[2] = {0, 0};
@@ -622,14 +797,10 @@ struct cam_factor_t : factor_t {
                const timestamp_t &ts_,
                const vec2_t &z_,
                const mat2_t &covar_,
-               const std::vector<param_t *> &params_)
-      : factor_t{id_, covar_, params_}, ts{ts_}, z{z_} {
+               const factor_params_t &params_)
+      : factor_t{id_, params_}, ts{ts_}, z{z_} {
     type = "cam_factor_t";
-    residuals = zeros(2, 1);
-    jacobians.push_back(zeros(2, 6));  // T_WS
-    jacobians.push_back(zeros(2, 6));  // T_SC
-    jacobians.push_back(zeros(2, 3));  // p_W
-    jacobians.push_back(zeros(2, CM::params_size));  // Camera params
+    bind_storage(storage, covar_);  // J: T_WS, T_SC, p_W, camera params
 
     auto cam_params = static_cast<camera_params_t *>(params_[3]);
     cam_index = cam_params->cam_index;
@@ -700,6 +871,7 @@ struct cam_factor_t : factor_t {
 
 struct imu_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  factor_storage_t<15, 6, 9, 6, 9> storage;
 
   const int imu_index = -1;
   const timestamps_t imu_ts;
@@ -727,18 +899,15 @@ struct imu_factor_t : factor_t {
                const vec3s_t imu_accel_,
                const vec3s_t imu_gyro_ ,
                const mat_t<15, 15> &covar_,
-               const std::vector<param_t *> &params_)
-      : factor_t{id_, covar_, params_},
+               const factor_params_t &params_)
+      : factor_t{id_, params_},
         imu_index{imu_index_},
         imu_ts{imu_ts_},
         imu_accel{imu_accel_},
         imu_gyro{imu_gyro_} {
     type = "imu_factor_t";
-    residuals = zeros(15, 1);
-    jacobians.push_back(zeros(15, 6));  // T_WS at timestep i
-    jacobians.push_back(zeros(15, 9));  // Speed and bias at timestep i
-    jacobians.push_back(zeros(15, 6));  // T_WS at timestep j
-    jacobians.push_back(zeros(15, 9));  // Speed and bias at timestep j
+    // J: T_WS and speed and bias at timestep i, then at timestep j
+    bind_storage(storage, covar_);
 
     propagate(imu_ts_, imu_accel_, imu_gyro_);
   }
@@ -901,24 +1070,80 @@ void imu_propagate(const imu_data_t &imu_data,
                    vec_t<7> &pose_j,
                    vec_t<9> &sb_j);
 
+/**
+ * Marginalization prior. The factors that depend on the params to be
+ * marginalized are added with `add()`, `linearize()` then linearizes them at
+ * the current estimate and Schur-complements the marginalized params `m` out
+ * of
+ *
+ *   [H_mm H_mr] [dx_m] = [b_m]
+ *   [H_rm H_rr] [dx_r]   [b_r]
+ *
+ * where H = J^T J and b = J^T r. The prior on the remaining params `r`
+ *
+ *   H_prior = H_rr - H_rm H_mm^-1 H_mr
+ *   b_prior = b_r - H_rm H_mm^-1 b_m
+ *
+ * is kept in square-root form H_prior = J0^T J0, b_prior = J0^T r0 with
+ * linearization point x0, and evaluated as r = r0 + J0 (x - x0) with its
+ * Jacobians fixed at J0.
+ */
 struct marg_factor_t : factor_t {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+  factor_storage_t<Eigen::Dynamic, Eigen::Dynamic> storage;
+
+  std::vector<factor_t *> factors;    // Factors to marginalize (not owned)
+  std::vector<param_t *> marg_params;  // Params to marginalize
+
+  matx_t H_prior;
+  vecx_t b_prior;
+  vecxs_t x0;
+  vecx_t r0;
+  vecx_t dx;
 
   marg_factor_t() {
     type = "marg_factor_t";
   }
 
-  void add_param() {
-    // Add parameter to be marginalized
+  marg_factor_t(const id_t id_) : factor_t{id_, {}} {
+    type = "marg_factor_t";
+  }
+
+  /** Add `factor` to be marginalized **/
+  void add(factor_t *factor) {
+    factors.push_back(factor);
+
+    for (const auto param : factor->params) {
+      if (param->fixed) {
+        continue;
+      }
 
+      if (param->marginalize) {
+        if (std::count(marg_params.begin(), marg_params.end(), param) == 0) {
+          marg_params.push_back(param);
+        }
+      } else if (std::count(params.begin(), params.end(), param) == 0) {
+        params.push_back(param);
+      }
+    }
   }
 
-  int eval(const bool jacs=true) {
+  /**
+   * Linearize the added factors at the current estimate and form the prior.
+   * @returns 0 for success, -1 if there is nothing to marginalize or keep
+   */
+  int linearize();
 
-    // Calculate jacobians
-    if (jacs) {
+  int eval(const bool jacs=true) {
+    UNUSED(jacs);
 
+    long rs = 0;
+    for (size_t i = 0; i < params.size(); i++) {
+      dx.segment(rs, params[i]->local_size) = params[i]->minus(x0[i]);
+      rs += params[i]->local_size;
     }
+    residuals = r0;
+    residuals.noalias() += storage.jacobians * dx;
 
     return 0;
   }
@@ -926,32 +1151,209 @@ struct marg_factor_t : factor_t {
 
 /********************************* GRAPH ************************************/
 
-struct graph_t {
-  id_t next_param_id = 0;
-  id_t next_factor_id = 0;
+/**
+ * Pool of graph params or factors of one concrete type. Objects are
+ * constructed in place in chunks of `chunk_size`, so they never move and sit
+ * next to objects of the same type. Released slots are reused by the next
+ * `alloc()` before a new chunk is allocated.
+ */
+struct pool_base_t {
+  virtual ~pool_base_t() {}
+  virtual void release(void *slot) = 0;
+};
 
-  std::map<id_t, factor_t *> factors;
-  std::map<id_t, param_t *> params;
-  std::unordered_map<id_t, size_t> param_index; // id - column start
-  std::vector<std::string> param_order{"pose_t",
-                                       "camera_params_t",
-                                       "landmark_t"};
+template <typename T>
+struct pool_t : pool_base_t {
+  size_t chunk_size = 64;
+  std::vector<T *> chunks;
+  std::vector<T *> free_slots;
 
-  graph_t() {}
+  pool_t() {}
 
-  ~graph_t() {
-    for (const auto &kv : factors) {
-      delete kv.second;
+  ~pool_t() {
+    for (auto chunk : chunks) {
+      Eigen::aligned_allocator<T>().deallocate(chunk, chunk_size);
     }
-    factors.clear();
+  }
 
-    for (const auto &kv : params) {
-      delete kv.second;
+  template <typename... ARGS>
+  T *alloc(ARGS &&... args) {
+    if (free_slots.empty()) {
+      T *chunk = Eigen::aligned_allocator<T>().allocate(chunk_size);
+      chunks.push_back(chunk);
+      for (size_t i = chunk_size; i > 0; i--) {
+        free_slots.push_back(chunk + i - 1);
+      }
     }
-    params.clear();
+
+    T *slot = free_slots.back();
+    free_slots.pop_back();
+    return new (slot) T(std::forward<ARGS>(args)...);
+  }
+
+  void release(void *slot) {
+    static_cast<T *>(slot)->~T();
+    free_slots.push_back(static_cast<T *>(slot));
   }
 };
 
+/** Index of the pool of type `T` in `graph_t.pools` **/
+size_t pool_index_next();
+
+template <typename T>
+size_t pool_index() {
+  static const size_t index = pool_index_next();
+  return index;
+}
+
+/**
+ * Graph params or factors by id. Ids are handed out in increasing order and
+ * the sliding window removes the oldest first, so entries are kept in a dense
+ * array starting at the oldest live id instead of a tree.
+ */
+template <typename T>
+struct graph_table_t {
+  typedef std::pair<id_t, T *> entry_t;
+
+  template <typename ENTRY>
+  struct iterator_t {
+    ENTRY *it;
+    ENTRY *end;
+
+    iterator_t(ENTRY *it_, ENTRY *end_) : it{it_}, end{end_} { skip(); }
+    void skip() { while (it != end && it->second == nullptr) it++; }
+    ENTRY &operator*() const { return *it; }
+    ENTRY *operator->() const { return it; }
+    iterator_t &operator++() { it++; skip(); return *this; }
+    bool operator!=(const iterator_t &other) const { return it != other.it; }
+  };
+  typedef iterator_t<entry_t> iterator;
+  typedef iterator_t<const entry_t> const_iterator;
+
+  id_t first_id = 0;              // Id of `entries[0]`
+  size_t head = 0;                // Index of the first live entry
+  size_t nb_entries = 0;          // Number of live entries
+  std::vector<entry_t> entries;
+
+  size_t size() const { return nb_entries; }
+  bool empty() const { return nb_entries == 0; }
+
+  size_t count(const id_t id) const {
+    const id_t i = id - first_id;
+    return (i >= 0 && i < (id_t) entries.size() && entries[i].second) ? 1 : 0;
+  }
+
+  T *operator[](const id_t id) const {
+    return (count(id)) ? entries[id - first_id].second : nullptr;
+  }
+
+  T *at(const id_t id) const {
+    if (count(id) == 0) {
+      throw std::out_of_range("graph_table_t::at");
+    }
+    return entries[id - first_id].second;
+  }
+
+  void insert(const id_t id, T *value) {
+    if (entries.empty()) {
+      first_id = id;
+      head = 0;
+    }
+    assert(id >= first_id);
+    while ((id_t) entries.size() <= id - first_id) {
+      entries.emplace_back(first_id + entries.size(), nullptr);
+    }
+    assert(entries[id - first_id].second == nullptr);
+    entries[id - first_id].second = value;
+    head = std::min(head, (size_t) (id - first_id));
+    nb_entries++;
+  }
+
+  void erase(const id_t id) {
+    if (count(id) == 0) {
+      return;
+    }
+    entries[id - first_id].second = nullptr;
+    nb_entries--;
+
+    // Drop the dead prefix once it makes up half the table
+    while (head < entries.size() && entries[head].second == nullptr) {
+      head++;
+    }
+    if (head == entries.size()) {
+      clear();
+    } else if (head > entries.size() / 2) {
+      entries.erase(entries.begin(), entries.begin() + head);
+      first_id += head;
+      head = 0;
+    }
+  }
+
+  void clear() {
+    entries.clear();
+    head = 0;
+    nb_entries = 0;
+  }
+
+  iterator begin() {
+    return iterator{entries.data() + head, entries.data() + entries.size()};
+  }
+  iterator end() {
+    const auto end = entries.data() + entries.size();
+    return iterator{end, end};
+  }
+  const_iterator begin() const {
+    return const_iterator{entries.data() + head, entries.data() + entries.size()};
+  }
+  const_iterator end() const {
+    const auto end = entries.data() + entries.size();
+    return const_iterator{end, end};
+  }
+};
+
+struct graph_t {
+  id_t next_param_id = 0;
+  id_t next_factor_id = 0;
+
+  // Params and factors live in one pool per concrete type, `params` and
+  // `factors` index them by id.
+  std::vector<pool_base_t *> pools;
+  graph_table_t<factor_t> factors;
+  graph_table_t<param_t> params;
+
+  // Jacobian column ordering, kept up to date by graph_add_* / graph_rm_*
+  // so that evaluating the graph does not have to rebuild it. Parameters
+  // used by factors are grouped into blocks by tag, marginalized blocks
+  // first, then the remaining blocks in `param_order`.
+  std::vector<param_type_t> param_order{POSE_PARAM,
+                                        CAMERA_PARAM,
+                                        LANDMARK_PARAM};
+  std::vector<param_t *> param_blocks[2 * NB_PARAM_TYPES];
+  size_t block_size[2 * NB_PARAM_TYPES] = {0};
+
+  graph_t() {}
+  graph_t(const graph_t &) = delete;
+  graph_t &operator=(const graph_t &) = delete;
+  ~graph_t();
+};
+
+/** Construct a param or factor of type `T` in the graph pool of its type **/
+template <typename T, typename... ARGS>
+T *graph_new(graph_t &graph, ARGS &&... args) {
+  const size_t index = pool_index<T>();
+  if (index >= graph.pools.size()) {
+    graph.pools.resize(index + 1, nullptr);
+  }
+  if (graph.pools[index] == nullptr) {
+    graph.pools[index] = new pool_t<T>();
+  }
+
+  auto pool = static_cast<pool_t<T> *>(graph.pools[index]);
+  T *obj = pool->alloc(std::forward<ARGS>(args)...);
+  obj->pool = index;
+  return obj;
+}
+
 id_t graph_add_pose(graph_t &graph,
                     const timestamp_t &ts,
                     const vec_t<7> &pose,
@@ -993,6 +1395,14 @@ id_t graph_add_speed_bias(graph_t &graph,
 
 vecx_t graph_get_estimate(graph_t &graph, id_t id);
 
+/**
+ * Add `factor` to `graph`, parameters join the Jacobian column ordering when
+ * first used by a factor. The graph owns `factor`, which is either created by
+ * `graph_new()` or heap allocated with `new`.
+ * @returns Factor id
+ */
+id_t graph_add_factor(graph_t &graph, factor_t *factor);
+
 id_t graph_add_pose_factor(graph_t &graph,
                            const id_t pose_id,
                            const mat_t<6, 6> &covar = I(6));
@@ -1016,22 +1426,15 @@ id_t graph_add_ba_factor(graph_t &graph,
 
   // Create factor
   const id_t f_id = graph.next_factor_id++;
-  std::vector<param_t *> params{
+  const factor_params_t params{
     graph.params[cam_pose_id],
     graph.params[landmark_id],
     graph.params[cam_params_id],
   };
-  auto factor = new ba_factor_t<CM>{f_id, ts, z, covar, params};
+  auto factor = graph_new<ba_factor_t<CM>>(graph, f_id, ts, z, covar, params);
 
   // Add factor to graph
-  graph.factors[f_id] = factor;
-
-  // Point params to factor
-  for (auto *param : params) {
-    param->factor_ids.push_back(f_id);
-  }
-
-  return f_id;
+  return graph_add_factor(graph, factor);
 }
 
 template <typename CM>
@@ -1048,26 +1451,19 @@ id_t graph_add_calib_mono_factor(graph_t &graph,
 
   // Create factor
   const id_t f_id = graph.next_factor_id++;
-  std::vector<param_t *> params{
+  const factor_params_t params{
     graph.params[cam_pose_id],
     graph.params[fiducial_id],
     graph.params[cam_params_id],
   };
-  auto factor = new calib_mono_factor_t<CM>{
-    f_id, ts,
+  auto factor = graph_new<calib_mono_factor_t<CM>>(
+    graph, f_id, ts,
     tag_id, tag_corner, r_FFi,
     z, covar, params
-  };
+  );
 
   // Add factor to graph
-  graph.factors[f_id] = factor;
-
-  // Point params to factor
-  for (auto *param : params) {
-    param->factor_ids.push_back(f_id);
-  }
-
-  return f_id;
+  return graph_add_factor(graph, factor);
 }
 
 template <typename CM>
@@ -1081,23 +1477,16 @@ id_t graph_add_cam_factor(graph_t &graph,
                           const mat2_t &covar = I(2)) {
   // Create factor
   const id_t f_id = graph.next_factor_id++;
-  std::vector<param_t *> params{
+  const factor_params_t params{
     graph.params[sensor_pose_id],
     graph.params[imu_cam_pose_id],
     graph.params[landmark_id],
     graph.params[cam_params_id]
   };
-  auto factor = new cam_factor_t<CM>{f_id, ts, z, covar, params};
+  auto factor = graph_new<cam_factor_t<CM>>(graph, f_id, ts, z, covar, params);
 
   // Add factor to graph
-  graph.factors[f_id] = factor;
-
-  // Point params to factor
-  for (auto *param : params) {
-    param->factor_ids.push_back(f_id);
-  }
-
-  return f_id;
+  return graph_add_factor(graph, factor);
 }
 
 id_t graph_add_imu_factor(graph_t &graph,
@@ -1115,8 +1504,36 @@ id_t graph_add_imu_factor(graph_t &graph,
 void graph_mark_param(graph_t &graph, const id_t param_id);
 void graph_rm_param(graph_t &graph, const id_t param_id);
 void graph_rm_factor(graph_t &graph, const id_t factor_id);
+
+/**
+ * Marginalize the params `param_ids`, marked with `graph_mark_param()`, out
+ * of `graph`. The factors `factor_ids` that depend on them are replaced by a
+ * single `marg_factor_t` prior on the params they share with the rest of the
+ * graph, then the marginalized params are removed.
+ * @returns Id of the marginalization factor, -1 if no prior was formed
+ */
+id_t graph_marginalize(graph_t &graph,
+                       const std::vector<id_t> &factor_ids,
+                       const std::vector<id_t> &param_ids);
+long graph_param_index(const graph_t &graph, const id_t param_id);
+
+/**
+ * Evaluate the residuals `r` of `graph` without Jacobians, `r` is only
+ * reallocated when the number of residuals changes.
+ * @returns Cost 0.5 * r^T r
+ */
+real_t graph_cost(graph_t &graph, vecx_t &r);
+
 vecx_t graph_residuals(graph_t &graph);
 matx_t graph_jacobians(graph_t &graph, size_t *marg_size, size_t *remain_size);
+
+/**
+ * Evaluate every factor of `graph` once, forming the residuals `r` and the
+ * L.H.S and R.H.S of H dx = g together.
+ * @returns Cost 0.5 * r^T r
+ */
+real_t graph_eval(graph_t &graph, matx_t &H, vecx_t &g, vecx_t &r,
+                  size_t *marg_size, size_t *remain_size);
 void graph_eval(graph_t &graph, matx_t &H, vecx_t &g,
                 size_t *marg_size, size_t *remain_size);
 vecx_t graph_get_state(const graph_t &graph);
@@ -1124,6 +1541,46 @@ void graph_set_state(graph_t &graph, const vecx_t &x);
 void graph_print_params(const graph_t &graph);
 void graph_update(graph_t &graph, const vecx_t &dx, const size_t offset=0);
 
+/**
+ * Square-root form of the linearized graph, for solving without forming
+ * H = J^T J. Each landmark only observed by single landmark factors is
+ * eliminated on its own with a Householder QR of the rows that observe it
+ * (square-root bundle adjustment), the remaining columns form a reduced
+ * system over the rest of the rows.
+ */
+struct graph_qr_t {
+  /** Rows observing a landmark, QR factorized on the landmark columns **/
+  struct landmark_block_t {
+    long col = 0;                // Landmark column in dx
+    vec3_t D;                    // Column norms of the landmark Jacobian
+    std::vector<long> cols;      // Reduced column of each other param
+    std::vector<long> sizes;     // Local size of each other param
+    matx_t QJ;                   // Q^T [J_landmark J_params r]
+  };
+
+  size_t params_size = 0;        // Number of columns in dx
+  std::vector<long> reduced;     // Column in dx of each reduced column
+  std::vector<landmark_block_t> landmarks;
+  matx_t J;                      // Rows not observing an eliminated landmark
+  vecx_t r;
+  vecx_t D;                      // Column norms of the reduced columns
+};
+
+/**
+ * Evaluate every factor of `graph` once, forming the residuals `r` and the
+ * square-root system `qr`.
+ * @returns Cost 0.5 * r^T r
+ */
+real_t graph_eval_qr(graph_t &graph, graph_qr_t &qr, vecx_t &r);
+
+/**
+ * Solve min ||J dx + r||^2 + lambda ||D dx||^2 with D^2 = diag(J^T J) by QR,
+ * the square-root equivalent of (H + lambda diag(H)) dx = g. Landmark
+ * damping is folded in with Givens rotations, so the landmark QR from
+ * `graph_eval_qr()` is reused for every lambda.
+ */
+void graph_solve_qr(const graph_qr_t &qr, const real_t lambda, vecx_t &dx);
+
 /*****************************************************************************
  *                               TINY SOLVER
  ****************************************************************************/
@@ -1136,14 +1593,17 @@ struct tiny_solver_t {
   real_t cost_change_threshold = 1e-1;
   real_t time_limit = 0.01;
   real_t update_factor = 10.0;
+  std::string solver_type = "cholesky";  // "cholesky" or "qr"
 
   // Optimization data
   int iter = 0;
   real_t cost = 0.0;
   real_t solve_time = 0.0;
   matx_t H;
+  vecx_t H_diag;
   vecx_t g;
   vecx_t e;
+  graph_qr_t qr;
 
   vecx_t x;
   vecx_t dx;
@@ -1162,12 +1622,26 @@ struct tiny_solver_t {
     parse(config, key + "max_iter", max_iter);
     parse(config, key + "time_limit", time_limit);
     parse(config, key + "lambda", lambda);
+    parse(config, key + "solver_type", solver_type, true);
   }
 
   real_t eval(graph_t &graph) {
-    graph_eval(graph, H, g, &marg_size, &remain_size);
-    e = graph_residuals(graph);
-    return 0.5 * e.transpose() * e;
+    if (solver_type == "qr") {
+      return graph_eval_qr(graph, qr, e);
+    }
+    return graph_eval(graph, H, g, e, &marg_size, &remain_size);
+  }
+
+  /** Solve the damped linearized system for `dx` **/
+  void solve_step(const real_t lambda_k) {
+    if (solver_type == "cholesky") {
+      H.diagonal() = (1.0 + lambda_k) * H_diag;
+      dx = H.ldlt().solve(g);
+    } else if (solver_type == "qr") {
+      graph_solve_qr(qr, lambda_k, dx);
+    } else {
+      FATAL("solver_type [%s] not implemented!\n", solver_type.c_str());
+    }
   }
 
   void update(graph_t &graph, const real_t lambda_k) {
@@ -1198,32 +1672,24 @@ struct tiny_solver_t {
   int solve(graph_t &graph)  {
     struct timespec solve_tic = tic();
     real_t lambda_k = lambda;
+    bool linearize = true;
 
     // Solve
     for (iter = 0; iter < max_iter; iter++) {
-      // Cost k
-      x = graph_get_state(graph);
-      graph_eval(graph, H, g, &marg_size, &remain_size);
-      const matx_t H_diag = (H.diagonal().asDiagonal());
-      H = H + lambda_k * H_diag;
-      dx = H.ldlt().solve(g);
-      e = graph_residuals(graph);
-      cost = 0.5 * e.transpose() * e;
+      // Cost k, H and g only change after an accepted update
+      if (linearize) {
+        x = graph_get_state(graph);
+        cost = eval(graph);
+        H_diag = H.diagonal();
+        linearize = false;
+      }
+
+      // Damp the linearized system and solve for dx
+      solve_step(lambda_k);
 
-      // Cost k+1
+      // Cost k+1, residuals only
       graph_update(graph, dx);
-      // graph_eval(graph, H, g, &marg_size, &remain_size);
-      // const matx_t H_diag_kp1 = (H.diagonal().asDiagonal());
-      // H = H + lambda_k * H_diag_kp1;
-      // dx = H.ldlt().solve(g);
-      e = graph_residuals(graph);
-      const real_t cost_k = 0.5 * e.transpose() * e;
-
-      // cost = eval(graph);
-      // x = graph_get_state(graph);
-      //
-      // update(graph, lambda);
-      // const real_t cost_k = eval(graph);
+      const real_t cost_k = graph_cost(graph, e);
 
       const real_t cost_delta = cost_k - cost;
       const real_t solve_time = toc(&solve_tic);
@@ -1255,6 +1721,7 @@ struct tiny_solver_t {
         // printf("improvement!\n");
         lambda_k /= update_factor;
         cost = cost_k;
+        linearize = true;
       } else {
         // Reject update
         // printf("no improvement!\n");
@@ -1309,6 +1776,8 @@ struct swf_t {
 
   ordered_set_t<id_t> marg_param_ids;
   ordered_set_t<id_t> marg_factor_ids;
+  id_t marg_factor_id = -1;
+  poses_t marg_poses;
 
   real_t imu_rate = 0.0;
   vec3_t g{0.0, 0.0, -9.81};
@@ -1532,56 +2001,85 @@ struct swf_t {
     return factor_id;
   }
 
+  /** Mark param `param_id` and the factors that depend on it **/
+  void mark_param(const id_t param_id) {
+    const auto param = graph.params[param_id];
+    graph_mark_param(graph, param_id);
+    marg_param_ids.insert(param_id);
+    for (const auto &factor_id : param->factor_ids) {
+      marg_factor_ids.insert(factor_id);
+    }
+  }
+
   void pre_marginalize() {
-    // Mark oldest pose or speed bias for marginalization
-    {
-      auto &state = window.front();
-      if (state.pose_id != -1) {
-        const auto &param = graph.params[state.pose_id];
-        param->mark_marginalize();
-        marg_param_ids.insert(param->id);
-
-        auto factor_ids = param->factor_ids;
-        for (const auto &factor_id : factor_ids) {
-          if (graph.factors.count(factor_id)) {
-            const auto &factor = graph.factors[factor_id];
-            factor->marginalize = true;
-            marg_factor_ids.insert(factor->id);
-
-            auto &ids = param->factor_ids;
-            auto erase_idx = std::remove(ids.begin(), ids.end(), factor_id);
-            ids.erase(erase_idx, ids.end());
-          }
+    // Mark oldest pose and speed bias for marginalization
+    const auto &state = window.front();
+    if (state.pose_id != -1) {
+      mark_param(state.pose_id);
+    }
+    if (state.sb_id != -1) {
+      mark_param(state.sb_id);
+    }
+
+    // The previous prior is folded into the next one, so there is only ever
+    // one marginalization factor in the graph
+    if (marg_factor_id != -1) {
+      marg_factor_ids.insert(marg_factor_id);
+    }
+
+    // Landmarks the rest of the window no longer observes go with them
+    std::vector<param_t *> landmarks;
+    for (const auto &factor_id : marg_factor_ids) {
+      for (const auto param : graph.factors[factor_id]->params) {
+        if (param->tag == LANDMARK_PARAM && param->fixed == false) {
+          landmarks.push_back(param);
         }
       }
-      if (state.sb_id != -1) {
-        const auto &param = graph.params[state.sb_id];
-        param->mark_marginalize();
-        marg_param_ids.insert(param->id);
-
-        for (const auto &factor_id : param->factor_ids) {
-          if (graph.factors.count(factor_id)) {
-            const auto &factor = graph.factors[factor_id];
-            factor->marginalize = true;
-            marg_factor_ids.insert(factor->id);
-
-            auto &ids = param->factor_ids;
-            auto erase_idx = std::remove(ids.begin(), ids.end(), factor_id);
-            ids.erase(erase_idx, ids.end());
-          }
-        }
+    }
+    for (const auto landmark : landmarks) {
+      bool observed = false;
+      for (const auto &factor_id : landmark->factor_ids) {
+        observed |= (marg_factor_ids.count(factor_id) == 0);
+      }
+      if (observed == false && landmark->marginalize == false) {
+        mark_param(landmark->id);
       }
     }
   }
 
   void marginalize() {
-    // for (const auto &param_id : marg_param_ids) {
-    //   // printf("remove param[%ld]\n", param_id);
-    //   graph_rm_param(graph, param_id);
-    // }
-    for (const auto &factor_id : marg_factor_ids) {
-      // printf("remove factor[%ld]\n", factor_id);
-      graph_rm_factor(graph, factor_id);
+    // Keep the estimates of the poses and landmarks leaving the graph
+    for (const auto &param_id : marg_param_ids) {
+      const auto param = graph.params[param_id];
+      if (param->tag == POSE_PARAM) {
+        marg_poses.emplace_back(param_id, param->ts, vec_t<7>{param->param});
+        pose_ids.erase(std::find(pose_ids.begin(), pose_ids.end(), param_id));
+      } else if (param->tag == SB_PARAM) {
+        sb_ids.erase(std::find(sb_ids.begin(), sb_ids.end(), param_id));
+      }
+    }
+    std::vector<std::pair<size_t, vec3_t>> landmarks;
+    for (const auto &param_id : marg_param_ids) {
+      const auto param = graph.params[param_id];
+      auto it = std::find(feature_ids.begin(), feature_ids.end(), param_id);
+      if (param->tag == LANDMARK_PARAM && it != feature_ids.end()) {
+        landmarks.emplace_back(it - feature_ids.begin(), param->param);
+      }
+    }
+
+    // Replace the marginalized factors with a prior
+    if (marg_param_ids.empty() == false) {
+      const std::vector<id_t> factor_ids{marg_factor_ids.begin(),
+                                         marg_factor_ids.end()};
+      const std::vector<id_t> param_ids{marg_param_ids.begin(),
+                                        marg_param_ids.end()};
+      marg_factor_id = graph_marginalize(graph, factor_ids, param_ids);
+    }
+
+    // Marginalized landmarks re-enter the graph without their history, in
+    // case they are observed again
+    for (const auto &landmark : landmarks) {
+      feature_ids[landmark.first] = graph_add_landmark(graph, landmark.second);
     }
 
     marg_param_ids.clear();
@@ -1607,11 +2105,11 @@ struct swf_t {
 
     // Add imu
     if (yaml_has_key(config, "imu0")) {
-      graph.param_order = {"pose_t",
-                           "sb_params_t",
-                           "camera_params_t",
-                           "extrinsic_t",
-                           "landmark_t"};
+      graph.param_order = {POSE_PARAM,
+                           SB_PARAM,
+                           CAMERA_PARAM,
+                           EXTRINSIC_PARAM,
+                           LANDMARK_PARAM};
       add_imu(config);
     }
 
@@ -1646,6 +2144,9 @@ struct swf_t {
       return -1;
     }
 
+    for (const auto &pose : marg_poses) {
+      save_pose(est_csv, pose.ts, pose.param);
+    }
     for (const auto &id : pose_ids) {
       const auto ts = graph.params[id]->ts;
       const auto pose = graph.params[id]->param;
@@ -1700,18 +2201,51 @@ struct ba_data_t {
   }
 
   static poses_t load_poses(const std::string &csv_path) {
+    // Load binary cache, else parse the text file and cache it
+    timestamps_t pose_ids;
+    matx_t data;
+    const std::string path = cache_path(csv_path);
+    const cache_t cache{path, csv_path};
+    if (cache.ok && cache.nb_cols == 7) {
+      data.resize(cache.nb_rows, 7);
+      for (size_t j = 0; j < 7; j++) {
+        const Eigen::Map<const Eigen::VectorXd> col{cache.cols[j],
+                                                    (long) cache.nb_rows};
+        data.col(j) = col.cast<real_t>();
+      }
+    } else {
+      data = load_poses_csv(csv_path);
+      for (long i = 0; i < data.rows(); i++) {
+        pose_ids.push_back(i);
+      }
+      if (path.size() && cache_save(path, csv_path, pose_ids, data) != 0) {
+        LOG_WARN("Failed to cache [%s]!", csv_path.c_str());
+      }
+    }
+
+    // Form poses
+    poses_t poses;
+    for (long i = 0; i < data.rows(); i++) {
+      quat_t q{data(i, 0), data(i, 1), data(i, 2), data(i, 3)};
+      vec3_t r{data(i, 4), data(i, 5), data(i, 6)};
+      poses.emplace_back(i, i, tf(q, r));
+    }
+
+    return poses;
+  }
+
+  static matx_t load_poses_csv(const std::string &csv_path) {
     FILE *csv_file = fopen(csv_path.c_str(), "r");
     char line[1024] = {0};
-    poses_t poses;
+    std::vector<vecx_t> rows;
 
-    size_t pose_index = 0;
     while (fgets(line, 1024, csv_file) != NULL) {
       if (line[0] == '#') {
         continue;
       }
 
       char entry[1024] = {0};
-      real_t data[7] = {0};
+      vecx_t data = zeros(7, 1);
       int index = 0;
       for (size_t i = 0; i < strlen(line); i++) {
         char c = line[i];
@@ -1720,22 +2254,23 @@ struct ba_data_t {
         }
 
         if (c == ',' || c == '\n') {
-          data[index] = strtod(entry, NULL);
+          data(index) = strtod(entry, NULL);
           memset(entry, '\0', sizeof(char) * 100);
           index++;
         } else {
           entry[strlen(entry)] = c;
         }
       }
-
-      quat_t q{data[0], data[1], data[2], data[3]};
-      vec3_t r{data[4], data[5], data[6]};
-      poses.emplace_back(pose_index, pose_index, tf(q, r));
-      pose_index++;
+      rows.push_back(data);
     }
     fclose(csv_file);
 
-    return poses;
+    matx_t data(rows.size(), 7);
+    for (size_t i = 0; i < rows.size(); i++) {
+      data.row(i) = rows[i].transpose();
+    }
+
+    return data;
   }
 
   static keypoints_t parse_keypoints_line(const char *line) {
@@ -1,6 +1,12 @@
 #ifndef PROTO_TIMELINE_HPP
 #define PROTO_TIMELINE_HPP
 
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
 #include "core.hpp"
 
 namespace proto {
@@ -57,17 +63,292 @@ struct timeline_event_t {
   ~timeline_event_t() {}
 };
 
+/**
+ * Compact timeline event. Unlike `timeline_event_t` the record is POD, image
+ * paths and object names are interned into the owning `timeline_t` and
+ * referenced by `str_id`.
+ *
+ * - IMU: `data` holds a_m (0-2) and w_m (3-5)
+ * - Camera: `sensor_id` is the camera index, `str_id` the image path
+ * - MOCAP: `str_id` is the object name, `data` holds r_WM (0-2) and q_WM
+ *   (3-6) in w, x, y, z order
+ */
+struct timeline_record_t {
+  int type = NOT_SET;
+  int sensor_id = -1;
+  int str_id = -1;
+  timestamp_t ts = 0;
+  double data[7] = {0};
+};
+
+/**
+ * Time-ordered sensor stream of a timeline
+ */
+struct timeline_sensor_t {
+  int type = NOT_SET;
+  int sensor_id = -1;
+  bool sorted = true;
+  std::vector<timeline_record_t> records;
+};
+
+/**
+ * Timeline of sensor events. Events are appended to a contiguous array per
+ * sensor, `merge()` then k-way merges the sensor arrays into `data` in
+ * O(N log k) for N events and k sensors. Events with the same timestamp are
+ * ordered by the order their sensors were first added.
+ */
 struct timeline_t {
-  std::multimap<timestamp_t, timeline_event_t> data;
-  std::set<timestamp_t> timestamps;
+  std::vector<std::string> strings;
+  std::map<std::string, int> string_ids;
+  std::vector<timeline_sensor_t> sensors;
+
+  std::vector<timeline_record_t> data;
+  timestamps_t timestamps;
 
   timeline_t() {}
   ~timeline_t() {}
 
+  /**
+   * Intern `str` and return its index in `strings`.
+   */
+  int intern(const std::string &str) {
+    const auto it = string_ids.find(str);
+    if (it != string_ids.end()) {
+      return it->second;
+    }
+
+    const int str_id = strings.size();
+    strings.push_back(str);
+    string_ids.insert({str, str_id});
+    return str_id;
+  }
+
+  /**
+   * Get the sensor stream of `type` and `sensor_id`, adding it if it does
+   * not exist yet.
+   */
+  timeline_sensor_t &sensor(const int type, const int sensor_id) {
+    for (auto &sensor : sensors) {
+      if (sensor.type == type && sensor.sensor_id == sensor_id) {
+        return sensor;
+      }
+    }
+
+    sensors.emplace_back();
+    sensors.back().type = type;
+    sensors.back().sensor_id = sensor_id;
+    return sensors.back();
+  }
+
+  /**
+   * Append `record` to its sensor stream. Streams are expected to be added
+   * in time order, out of order streams are sorted by `merge()`.
+   */
+  void add(const timeline_record_t &record) {
+    auto &sensor = this->sensor(record.type, record.sensor_id);
+    auto &records = sensor.records;
+    if (records.size() && record.ts < records.back().ts) {
+      sensor.sorted = false;
+    }
+    records.push_back(record);
+  }
+
   void add(const timeline_event_t &event) {
-    const auto &ts = event.ts;
-    data.insert({ts, event});
-    timestamps.insert(ts);
+    timeline_record_t record;
+    record.type = event.type;
+    record.ts = event.ts;
+
+    switch (event.type) {
+      case IMU_EVENT:
+        for (int i = 0; i < 3; i++) {
+          record.data[i] = event.a_m(i);
+          record.data[i + 3] = event.w_m(i);
+        }
+        break;
+      case CAMERA_EVENT:
+        record.sensor_id = event.camera_index;
+        record.str_id = intern(event.image_path);
+        break;
+      case VICON_EVENT:
+        record.str_id = intern(event.object_name);
+        record.sensor_id = record.str_id;
+        for (int i = 0; i < 3; i++) {
+          record.data[i] = event.r_WM(i);
+        }
+        record.data[3] = event.q_WM.w();
+        record.data[4] = event.q_WM.x();
+        record.data[5] = event.q_WM.y();
+        record.data[6] = event.q_WM.z();
+        break;
+    }
+
+    add(record);
+  }
+
+  /**
+   * Merge the sensor streams into `data` and the unique timestamps into
+   * `timestamps`.
+   */
+  void merge() {
+    // Sort out of order sensor streams
+    size_t nb_records = 0;
+    for (auto &sensor : sensors) {
+      if (sensor.sorted == false) {
+        std::stable_sort(sensor.records.begin(),
+                         sensor.records.end(),
+                         [](const timeline_record_t &a,
+                            const timeline_record_t &b) { return a.ts < b.ts; });
+        sensor.sorted = true;
+      }
+      nb_records += sensor.records.size();
+    }
+
+    // Min-heap of (timestamp, sensor index) over the stream fronts
+    typedef std::pair<timestamp_t, size_t> heap_entry_t;
+    const auto cmp = [](const heap_entry_t &a, const heap_entry_t &b) {
+      return a > b;
+    };
+    std::vector<heap_entry_t> heap;
+    std::vector<size_t> cursors(sensors.size(), 0);
+    for (size_t k = 0; k < sensors.size(); k++) {
+      if (sensors[k].records.size()) {
+        heap.emplace_back(sensors[k].records[0].ts, k);
+      }
+    }
+    std::make_heap(heap.begin(), heap.end(), cmp);
+
+    // K-way merge
+    data.clear();
+    timestamps.clear();
+    data.reserve(nb_records);
+    while (heap.size()) {
+      std::pop_heap(heap.begin(), heap.end(), cmp);
+      const size_t k = heap.back().second;
+      const auto &records = sensors[k].records;
+      const auto &record = records[cursors[k]++];
+
+      data.push_back(record);
+      if (timestamps.empty() || timestamps.back() != record.ts) {
+        timestamps.push_back(record.ts);
+      }
+
+      if (cursors[k] < records.size()) {
+        heap.back() = {records[cursors[k]].ts, k};
+        std::push_heap(heap.begin(), heap.end(), cmp);
+      } else {
+        heap.pop_back();
+      }
+    }
+  }
+
+  /**
+   * Convert merged record `i` back to a timeline event.
+   */
+  timeline_event_t event(const size_t i) const {
+    const auto &record = data[i];
+    const double *v = record.data;
+
+    switch (record.type) {
+      case IMU_EVENT:
+        return timeline_event_t{record.ts,
+                                vec3_t{v[0], v[1], v[2]},
+                                vec3_t{v[3], v[4], v[5]}};
+      case CAMERA_EVENT:
+        return timeline_event_t{record.ts,
+                                record.sensor_id,
+                                strings[record.str_id]};
+      case VICON_EVENT:
+        return timeline_event_t{record.ts,
+                                strings[record.str_id],
+                                vec3_t{v[0], v[1], v[2]},
+                                quat_t{v[3], v[4], v[5], v[6]}};
+    }
+
+    return timeline_event_t{};
+  }
+};
+
+/**
+ * Time-ordered source of timeline events, read lazily from the underlying
+ * sensor file one event at a time.
+ */
+struct timeline_source_t {
+  virtual ~timeline_source_t() {}
+
+  /**
+   * Read the next event, events must be in non-decreasing time order.
+   * @returns 0 for success or -1 at the end of the source.
+   */
+  virtual int read(timeline_event_t &event) = 0;
+};
+
+/**
+ * Streaming timeline, merges the events of several time-ordered sources in
+ * time order while only keeping a look-ahead window of at most
+ * `window_size` events per source in memory. Events with the same
+ * timestamp are returned in the order the sources were added.
+ */
+struct timeline_stream_t {
+  typedef std::deque<timeline_event_t,
+                     Eigen::aligned_allocator<timeline_event_t>>
+      window_t;
+
+  size_t window_size = 100;
+  std::vector<std::unique_ptr<timeline_source_t>> sources;
+  std::vector<window_t> windows;
+  std::vector<bool> exhausted;
+
+  timeline_stream_t() {}
+  timeline_stream_t(const size_t window_size_) : window_size{window_size_} {}
+  ~timeline_stream_t() {}
+
+  /**
+   * Add `source` to the stream, the stream takes ownership of `source`.
+   */
+  void add(timeline_source_t *source) {
+    sources.emplace_back(source);
+    windows.emplace_back();
+    exhausted.push_back(false);
+  }
+
+  /**
+   * Refill the look-ahead window of source `k` once it is empty.
+   */
+  void fill(const size_t k) {
+    timeline_event_t event;
+    while (exhausted[k] == false && windows[k].size() < window_size) {
+      if (sources[k]->read(event) != 0) {
+        exhausted[k] = true;
+        break;
+      }
+      windows[k].push_back(event);
+    }
+  }
+
+  /**
+   * Get next event in time order.
+   * @returns 0 for success or -1 at the end of the stream.
+   */
+  int next(timeline_event_t &event) {
+    int k_min = -1;
+    for (size_t k = 0; k < sources.size(); k++) {
+      if (windows[k].empty()) {
+        fill(k);
+      }
+      if (windows[k].empty()) {
+        continue;
+      }
+      if (k_min == -1 || windows[k].front().ts < windows[k_min].front().ts) {
+        k_min = k;
+      }
+    }
+    if (k_min == -1) {
+      return -1;
+    }
+
+    event = windows[k_min].front();
+    windows[k_min].pop_front();
+    return 0;
   }
 };
 
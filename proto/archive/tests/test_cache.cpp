@@ -0,0 +1,146 @@
+#include "munit.hpp"
+#include "cache.hpp"
+
+namespace proto {
+
+#define TEST_CACHE_SRC "/tmp/test_cache.csv"
+#define TEST_CACHE_PATH "/tmp/test_cache.csv.cache"
+
+static void write_test_src(const std::string &text) {
+  FILE *fp = fopen(TEST_CACHE_SRC, "w");
+  fprintf(fp, "%s", text.c_str());
+  fclose(fp);
+}
+
+int test_cache_path() {
+  write_test_src("#ts,x\n1,0.1\n");
+
+  // Caching disabled without a cache directory
+  MU_CHECK(cache_path(TEST_CACHE_SRC, "") == "");
+  MU_CHECK(cache_path("/tmp/no_such_file.csv", "/tmp") == "");
+
+  // Cache is named after the source file in the cache directory
+  const std::string path = cache_path(TEST_CACHE_SRC, "/tmp/cache");
+  MU_CHECK(path.find("/tmp/cache/test_cache.csv.") == 0);
+  MU_CHECK(path.substr(path.size() - 6) == ".cache");
+  MU_CHECK(path == cache_path(TEST_CACHE_SRC, "/tmp/cache"));
+
+  // Empty cache path is never loaded
+  const cache_t cache{"", TEST_CACHE_SRC};
+  MU_CHECK(cache.ok == false);
+
+  return 0;
+}
+
+int test_cache_dir() {
+  const std::string home = "/tmp/test_cache_home";
+  remove((home + "/.cache/proto").c_str());
+  remove((home + "/.cache").c_str());
+  mkdir(home.c_str(), 0755);
+
+  // Defaults to $HOME/.cache/proto
+  unsetenv("PROTO_CACHE_DIR");
+  unsetenv("XDG_CACHE_HOME");
+  setenv("HOME", home.c_str(), 1);
+  MU_CHECK(cache_dir() == home + "/.cache/proto");
+  MU_CHECK(access((home + "/.cache/proto").c_str(), F_OK) == 0);
+
+  // $XDG_CACHE_HOME and $PROTO_CACHE_DIR take precedence
+  setenv("XDG_CACHE_HOME", "/tmp", 1);
+  MU_CHECK(cache_dir() == "/tmp/proto");
+  setenv("PROTO_CACHE_DIR", "/tmp", 1);
+  MU_CHECK(cache_dir() == "/tmp");
+
+  // Caching disabled if the directory cannot be created
+  setenv("PROTO_CACHE_DIR", "/proc/no_such_dir/proto", 1);
+  MU_CHECK(cache_dir() == "");
+  unsetenv("PROTO_CACHE_DIR");
+  unsetenv("XDG_CACHE_HOME");
+
+  return 0;
+}
+
+int test_cache_save_load() {
+  write_test_src("#ts,x,y\n1,0.1,0.2\n2,0.3,0.4\n3,0.5,0.6\n");
+  remove(TEST_CACHE_PATH);
+
+  // Cache does not exist yet
+  {
+    const cache_t cache{TEST_CACHE_PATH, TEST_CACHE_SRC};
+    MU_CHECK(cache.ok == false);
+  }
+
+  // Save and load cache
+  const timestamps_t timestamps{1, 2, 3};
+  matx_t data(3, 2);
+  data << 0.1, 0.2, 0.3, 0.4, 0.5, 0.6;
+  MU_CHECK(cache_save(TEST_CACHE_PATH, TEST_CACHE_SRC, timestamps, data) == 0);
+
+  const cache_t cache{TEST_CACHE_PATH, TEST_CACHE_SRC};
+  MU_CHECK(cache.ok);
+  MU_CHECK(cache.nb_rows == 3);
+  MU_CHECK(cache.nb_cols == 2);
+  for (size_t i = 0; i < 3; i++) {
+    MU_CHECK(cache.timestamps[i] == timestamps[i]);
+    MU_CHECK(((uintptr_t) cache.cols[0]) % CACHE_ALIGNMENT == 0);
+    MU_CHECK(((uintptr_t) cache.cols[1]) % CACHE_ALIGNMENT == 0);
+    MU_CHECK_FLOAT(data(i, 0), cache.cols[0][i]);
+    MU_CHECK_FLOAT(data(i, 1), cache.cols[1][i]);
+  }
+
+  return 0;
+}
+
+int test_cache_stale() {
+  write_test_src("#ts,x\n1,0.1\n");
+  const timestamps_t timestamps{1};
+  matx_t data(1, 1);
+  data << 0.1;
+  MU_CHECK(cache_save(TEST_CACHE_PATH, TEST_CACHE_SRC, timestamps, data) == 0);
+
+  // Source file changed after the cache was written
+  write_test_src("#ts,x\n1,0.1\n2,0.2\n");
+  const cache_t cache{TEST_CACHE_PATH, TEST_CACHE_SRC};
+  MU_CHECK(cache.ok == false);
+
+  return 0;
+}
+
+int test_cache_stale_sources() {
+  // Cache of two source files
+  write_test_src("#ts,x\n1,0.1\n");
+  FILE *fp = fopen("/tmp/test_cache_2.csv", "w");
+  fprintf(fp, "#ts,x\n1,0.2\n");
+  fclose(fp);
+  const std::vector<std::string> src_paths{TEST_CACHE_SRC,
+                                           "/tmp/test_cache_2.csv"};
+  const timestamps_t timestamps{1};
+  matx_t data(1, 1);
+  data << 0.1;
+  MU_CHECK(cache_save(TEST_CACHE_PATH, src_paths, timestamps, data) == 0);
+  {
+    const cache_t cache{TEST_CACHE_PATH, src_paths};
+    MU_CHECK(cache.ok);
+  }
+
+  // Second source file changed after the cache was written
+  fp = fopen("/tmp/test_cache_2.csv", "w");
+  fprintf(fp, "#ts,x\n1,0.25\n");
+  fclose(fp);
+  const cache_t cache{TEST_CACHE_PATH, src_paths};
+  MU_CHECK(cache.ok == false);
+
+  return 0;
+}
+
+void test_suite() {
+  MU_ADD_TEST(test_cache_path);
+  MU_ADD_TEST(test_cache_dir);
+  MU_ADD_TEST(test_cache_save_load);
+  MU_ADD_TEST(test_cache_stale);
+  MU_ADD_TEST(test_cache_stale_sources);
+}
+
+} // namespace proto
+
+MU_RUN_TESTS(proto::test_suite);
@@ -149,6 +149,40 @@ int test_euroc_data_load() {
   return 0;
 }
 
+int test_euroc_stream() {
+  euroc_stream_t stream{TEST_DATA, 4};
+  MU_CHECK(stream.ok);
+
+  // Stream events in time order with a small look-ahead window
+  size_t nb_imu = 0;
+  size_t nb_cam0 = 0;
+  size_t nb_cam1 = 0;
+  timestamp_t ts_prev = 0;
+  timeline_event_t event;
+  while (stream.next(event) == 0) {
+    MU_CHECK(event.ts >= ts_prev);
+    ts_prev = event.ts;
+
+    if (event.type == IMU_EVENT) {
+      nb_imu++;
+    } else if (event.type == CAMERA_EVENT && event.camera_index == 0) {
+      MU_CHECK(file_exists(event.image_path));
+      nb_cam0++;
+    } else if (event.type == CAMERA_EVENT && event.camera_index == 1) {
+      nb_cam1++;
+    }
+  }
+
+  // Compare against loading the whole sequence
+  euroc_imu_t imu_data{TEST_IMU_DATA};
+  euroc_camera_t cam0_data{TEST_CAM0_DATA};
+  MU_CHECK(nb_imu == imu_data.timestamps.size());
+  MU_CHECK(nb_cam0 == cam0_data.timestamps.size());
+  MU_CHECK(nb_cam1 > 0);
+
+  return 0;
+}
+
 int test_euroc_calib_load() {
   {
     euroc_calib_t data;
@@ -225,6 +259,7 @@ void test_suite() {
   MU_ADD_TEST(test_euroc_ground_truth_load);
 
   MU_ADD_TEST(test_euroc_data_load);
+  MU_ADD_TEST(test_euroc_stream);
 
   MU_ADD_TEST(test_euroc_calib_load);
 
@@ -626,23 +626,40 @@ int test_marg_factor() {
   landmarks[0].marginalize = true;
   landmarks[0].type = "marg_landmark_t";
 
-  // marg_factor_t marg;
-  // for (size_t i = 0; i < factors.size(); i++) {
-  //   marg.add(factors[i]);
-  // }
-  // MU_CHECK(marg.marg_params.size() == 1);
-  // MU_CHECK(marg.remain_params.size() == 2);
+  landmarks[2].param(1) += 0.05;  // Non-zero residuals
+  marg_factor_t marg;
+  for (size_t i = 0; i < factors.size(); i++) {
+    marg.add(factors[i]);
+  }
+  MU_CHECK(marg.marg_params.size() == 2);
+  MU_CHECK(marg.params.size() == 9);
+  MU_CHECK(marg.linearize() == 0);
+  MU_CHECK(marg.factors.size() == 0);
+
+  // Prior in square-root form
+  const long r = 4 * 6 + 4 * 3 + 8;
+  const matx_t J0 = marg.storage.jacobians;
+  MU_CHECK(marg.H_prior.rows() == r);
+  MU_CHECK(J0.rows() == r && J0.cols() == r);
+  MU_CHECK((J0.transpose() * J0 - marg.H_prior).norm() < 1e-6 * marg.H_prior.norm());
+  MU_CHECK(marg.b_prior.norm() > 0.0);
+  MU_CHECK((J0.transpose() * marg.r0 - marg.b_prior).norm() < 1e-6 * marg.b_prior.norm());
+
+  // Residuals at the linearization point are r0, and move with J0
+  marg.eval();
+  MU_CHECK((marg.residuals - marg.r0).norm() < 1e-12);
+  landmarks[1].param(0) += 0.01;
+  marg.eval();
+  const vecx_t dr = marg.residuals - marg.r0;
+  long col = 0;
+  for (size_t i = 0; marg.params[i] != &landmarks[1]; i++) {
+    col += marg.params[i]->local_size;
+  }
+  MU_CHECK((dr - 0.01 * J0.col(col)).norm() < 1e-9);
 
-  // marg.eval();
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/J.csv");
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/H.csv");
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/b.csv");
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/Hmm.csv");
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/Hmr.csv");
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/Hrm.csv");
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/Hrr.csv");
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/H_marg.csv");
-  // OCTAVE_SCRIPT("scripts/estimation/plot_matrix.m /tmp/b_marg.csv");
+  for (auto factor : factors) {
+    delete factor;
+  }
 
   return 0;
 }
@@ -994,6 +1011,129 @@ int test_graph_rm_factor() {
   return 0;
 }
 
+int test_graph_pool() {
+  graph_t graph;
+
+  // Params of the same type are packed into one pool
+  const mat4_t T_WS = I(4);
+  const auto pose0_id = graph_add_pose(graph, 0, T_WS);
+  const auto pose1_id = graph_add_pose(graph, 1, T_WS);
+  const auto landmark_id = graph_add_landmark(graph, vec3_t{1.0, 2.0, 3.0});
+  const param_t *pose0 = graph.params[pose0_id];
+  const param_t *pose1 = graph.params[pose1_id];
+  MU_CHECK(pose0->pool != -1);
+  MU_CHECK(pose0->pool == pose1->pool);
+  MU_CHECK(pose0->pool != graph.params[landmark_id]->pool);
+  MU_CHECK((static_cast<const pose_t *>(pose0) + 1) == pose1);
+
+  // Removed slots are reused
+  graph_rm_param(graph, pose0_id);
+  const auto pose2_id = graph_add_pose(graph, 2, T_WS);
+  MU_CHECK(graph.params[pose2_id] == pose0);
+  MU_CHECK(graph.params[pose2_id]->ts == 2);
+
+  // Factors keep their Jacobians in fixed-size storage
+  const auto factor_id = graph_add_pose_factor(graph, pose1_id);
+  auto factor = static_cast<pose_factor_t *>(graph.factors[factor_id]);
+  MU_CHECK(factor->jacobians.size() == 1);
+  MU_CHECK(factor->jacobians[0].data() == factor->storage.jacobians.data());
+  MU_CHECK(factor->residuals.data() == factor->storage.residuals.data());
+
+  return 0;
+}
+
+int test_graph_table() {
+  graph_table_t<param_t> table;
+  landmark_t landmarks[10];
+
+  for (id_t id = 0; id < 10; id++) {
+    table.insert(id, &landmarks[id]);
+  }
+  MU_CHECK(table.size() == 10);
+  MU_CHECK(table.count(10) == 0);
+  MU_CHECK(table[3] == &landmarks[3]);
+
+  // Erasing the oldest ids drops them from the table
+  for (id_t id = 0; id < 6; id++) {
+    table.erase(id);
+  }
+  MU_CHECK(table.size() == 4);
+  MU_CHECK(table.entries.size() == 4);
+  MU_CHECK(table.first_id == 6);
+  MU_CHECK(table.count(5) == 0);
+  MU_CHECK(table[5] == nullptr);
+  MU_CHECK(table.at(6) == &landmarks[6]);
+
+  // Iteration skips erased ids
+  table.erase(8);
+  std::vector<id_t> ids;
+  for (const auto &kv : table) {
+    ids.push_back(kv.first);
+  }
+  MU_CHECK(ids.size() == 3);
+  MU_CHECK(ids[0] == 6);
+  MU_CHECK(ids[1] == 7);
+  MU_CHECK(ids[2] == 9);
+
+  return 0;
+}
+
+int test_graph_param_index() {
+  graph_t graph;
+
+  // Camera, poses and landmarks
+  const int resolution[2] = {640, 480};
+  const vec4_t proj_params{320.0, 240.0, 320.0, 240.0};
+  const vec4_t dist_params{0.0, 0.0, 0.0, 0.0};
+  const auto cam_id = graph_add_camera(graph, 0, resolution,
+                                       proj_params, dist_params);
+  const mat4_t T_WC = tf(I(3), zeros(3, 1));
+  const auto pose0_id = graph_add_pose(graph, 0, T_WC);
+  const auto pose1_id = graph_add_pose(graph, 1, T_WC);
+  const auto p0_id = graph_add_landmark(graph, vec3_t{0.0, 0.0, 1.0});
+  const auto p1_id = graph_add_landmark(graph, vec3_t{0.1, 0.0, 1.0});
+  MU_CHECK(graph_param_index(graph, pose0_id) == -1);
+
+  // Params join the column ordering when first used by a factor
+  const vec2_t z{320.0, 240.0};
+  graph_add_ba_factor<pinhole_radtan4_t>(graph, 0, pose0_id, p0_id, cam_id, z);
+  const auto factor_id = graph_add_ba_factor<pinhole_radtan4_t>(
+      graph, 1, pose1_id, p1_id, cam_id, z);
+  MU_CHECK(graph_param_index(graph, pose0_id) == 0);
+  MU_CHECK(graph_param_index(graph, pose1_id) == 6);
+  MU_CHECK(graph_param_index(graph, cam_id) == 12);
+  MU_CHECK(graph_param_index(graph, p0_id) == 20);
+  MU_CHECK(graph_param_index(graph, p1_id) == 23);
+
+  // Marginalized params are ordered first
+  graph_mark_param(graph, pose1_id);
+  MU_CHECK(graph_param_index(graph, pose1_id) == 0);
+  MU_CHECK(graph_param_index(graph, pose0_id) == 6);
+  MU_CHECK(graph_param_index(graph, cam_id) == 12);
+
+  // Params leave the column ordering once no factor uses them
+  graph_rm_factor(graph, factor_id);
+  MU_CHECK(graph_param_index(graph, pose1_id) == -1);
+  MU_CHECK(graph_param_index(graph, p1_id) == -1);
+  MU_CHECK(graph_param_index(graph, pose0_id) == 0);
+  MU_CHECK(graph_param_index(graph, cam_id) == 6);
+  MU_CHECK(graph_param_index(graph, p0_id) == 14);
+  MU_CHECK(graph.params[pose1_id]->factor_ids.size() == 0);
+
+  // Evaluate graph
+  matx_t H;
+  vecx_t g;
+  size_t marg_size = 0;
+  size_t remain_size = 0;
+  graph_eval(graph, H, g, &marg_size, &remain_size);
+  MU_CHECK(marg_size == 0);
+  MU_CHECK(remain_size == 17);
+  MU_CHECK(H.rows() == 17);
+  MU_CHECK(g.rows() == 17);
+
+  return 0;
+}
+
 int test_graph_get_state() {
   graph_t graph;
 
@@ -1189,6 +1329,101 @@ int test_graph_eval() {
   return 0;
 }
 
+int test_graph_cost() {
+  graph_t graph;
+
+  // Camera, pose, landmarks and ba factors
+  const int resolution[2] = {640, 480};
+  const vec4_t proj_params{320.0, 240.0, 320.0, 240.0};
+  const vec4_t dist_params{0.0, 0.0, 0.0, 0.0};
+  const auto cam_id = graph_add_camera(graph, 0, resolution,
+                                       proj_params, dist_params);
+  const auto pose_id = graph_add_pose(graph, 0, tf(I(3), zeros(3, 1)));
+  graph_add_pose_factor(graph, pose_id, I(6));
+  for (int i = 0; i < 10; i++) {
+    const auto p_id = graph_add_landmark(graph, vec3_t{0.1 * i, 0.0, 2.0});
+    const vec2_t z{330.0 + 16.0 * i, 235.0};
+    graph_add_ba_factor<pinhole_radtan4_t>(graph, 0, pose_id, p_id, cam_id, z);
+  }
+
+  // Single pass evaluation and cost only evaluation agree
+  matx_t H;
+  vecx_t g;
+  vecx_t r;
+  size_t marg_size = 0;
+  size_t remain_size = 0;
+  const real_t cost = graph_eval(graph, H, g, r, &marg_size, &remain_size);
+  MU_CHECK(r.size() == 6 + 10 * 2);
+  MU_CHECK(cost > 0.0);
+
+  vecx_t e;
+  MU_CHECK(fabs(graph_cost(graph, e) - cost) < 1e-12);
+  MU_CHECK((e - r).norm() < 1e-12);
+  MU_CHECK((graph_residuals(graph) - r).norm() < 1e-12);
+
+  return 0;
+}
+
+int test_graph_solve_qr() {
+  graph_t graph;
+
+  // Camera, poses, landmarks and ba factors, landmark 0 is only observed by
+  // the first pose
+  const int resolution[2] = {640, 480};
+  const vec4_t proj_params{320.0, 240.0, 320.0, 240.0};
+  const vec4_t dist_params{0.01, 0.001, 0.0001, 0.0001};
+  const auto cam_id = graph_add_camera(graph, 0, resolution,
+                                       proj_params, dist_params);
+  std::vector<id_t> pose_ids;
+  for (int k = 0; k < 3; k++) {
+    const vec3_t r_WC{0.1 * k, 0.0, 0.0};
+    pose_ids.push_back(graph_add_pose(graph, k, tf(I(3), r_WC)));
+  }
+  graph_add_pose_factor(graph, pose_ids[0], I(6));
+  for (int i = 0; i < 10; i++) {
+    const vec3_t p_W{0.1 * i - 0.5, 0.05 * i, 2.0 + 0.1 * i};
+    const auto p_id = graph_add_landmark(graph, p_W);
+    for (int k = 0; k < ((i == 0) ? 1 : 3); k++) {
+      const vec2_t z{300.0 + 16.0 * i - 15.0 * k, 240.0 + 5.0 * i};
+      graph_add_ba_factor<pinhole_radtan4_t>(graph, k, pose_ids[k], p_id,
+                                             cam_id, z);
+    }
+  }
+
+  // Cholesky and QR steps agree
+  matx_t H;
+  vecx_t g;
+  vecx_t r;
+  size_t marg_size = 0;
+  size_t remain_size = 0;
+  const real_t cost = graph_eval(graph, H, g, r, &marg_size, &remain_size);
+
+  graph_qr_t qr;
+  vecx_t r_qr;
+  MU_CHECK(fabs(graph_eval_qr(graph, qr, r_qr) - cost) < 1e-12);
+  MU_CHECK((r_qr - r).norm() < 1e-12);
+  MU_CHECK(qr.landmarks.size() == 10);
+  MU_CHECK(qr.reduced.size() == 8 + 3 * 6);
+
+  const real_t lambda = 1e-2;
+  H.diagonal() *= (1.0 + lambda);
+  const vecx_t dx = H.ldlt().solve(g);
+  vecx_t dx_qr;
+  graph_solve_qr(qr, lambda, dx_qr);
+  MU_CHECK(dx_qr.size() == dx.size());
+  MU_CHECK((dx_qr - dx).norm() < 1e-6 * dx.norm());
+
+  // Solve with the QR solver
+  tiny_solver_t solver;
+  solver.solver_type = "qr";
+  solver.max_iter = 5;
+  solver.time_limit = 10.0;
+  solver.solve(graph);
+  MU_CHECK(solver.cost < cost);
+
+  return 0;
+}
+
 int test_graph_solve_ba() {
   ba_data_t data{TEST_BA_DATA};
 
@@ -1889,9 +2124,14 @@ void test_suite() {
   MU_ADD_TEST(test_graph_add_imu_factor);
   MU_ADD_TEST(test_graph_rm_param);
   MU_ADD_TEST(test_graph_rm_factor);
+  MU_ADD_TEST(test_graph_pool);
+  MU_ADD_TEST(test_graph_table);
+  MU_ADD_TEST(test_graph_param_index);
   MU_ADD_TEST(test_graph_get_state);
   MU_ADD_TEST(test_graph_set_state);
   MU_ADD_TEST(test_graph_eval);
+  MU_ADD_TEST(test_graph_cost);
+  MU_ADD_TEST(test_graph_solve_qr);
   MU_ADD_TEST(test_graph_solve_ba);
 
   MU_ADD_TEST(test_swf_add_imu);
@@ -0,0 +1,99 @@
+#include "munit.hpp"
+#include "timeline.hpp"
+
+namespace proto {
+
+int test_timeline_add() {
+  timeline_t timeline;
+  timeline.add(timeline_event_t{0, vec3_t{1.0, 2.0, 3.0}, zeros(3, 1)});
+  timeline.add(timeline_event_t{0, 0, "cam0/0.png"});
+  timeline.add(timeline_event_t{0, 1, "cam1/0.png"});
+  timeline.add(timeline_event_t{1, 0, "cam0/1.png"});
+  timeline.add(timeline_event_t{1, 0, "cam0/1.png"});
+
+  MU_CHECK(timeline.sensors.size() == 3);
+  MU_CHECK(timeline.sensors[0].type == IMU_EVENT);
+  MU_CHECK(timeline.sensors[1].records.size() == 3);
+  MU_CHECK(timeline.sensors[2].records.size() == 1);
+  MU_CHECK(timeline.strings.size() == 3);
+  MU_CHECK(timeline.sensors[1].records[1].str_id ==
+           timeline.sensors[1].records[2].str_id);
+
+  return 0;
+}
+
+int test_timeline_merge() {
+  timeline_t timeline;
+  for (timestamp_t ts = 0; ts < 100; ts++) {
+    timeline.add(timeline_event_t{ts, zeros(3, 1), zeros(3, 1)});
+  }
+  for (timestamp_t ts = 0; ts < 100; ts += 10) {
+    timeline.add(timeline_event_t{ts, 0, std::to_string(ts) + ".png"});
+  }
+  // -- Out of order stream
+  for (timestamp_t ts = 95; ts >= 5; ts -= 10) {
+    const quat_t q{1.0, 0.0, 0.0, 0.0};
+    timeline.add(timeline_event_t{ts, "body", vec3_t{1.0, 2.0, 3.0}, q});
+  }
+  timeline.merge();
+
+  MU_CHECK(timeline.data.size() == 120);
+  MU_CHECK(timeline.timestamps.size() == 100);
+  for (size_t i = 1; i < timeline.data.size(); i++) {
+    const auto &prev = timeline.data[i - 1];
+    const auto &curr = timeline.data[i];
+    MU_CHECK(prev.ts <= curr.ts);
+    if (prev.ts == curr.ts) {
+      // Ties are ordered by the order sensors were added
+      MU_CHECK(prev.type == IMU_EVENT);
+    }
+  }
+  for (size_t i = 1; i < timeline.timestamps.size(); i++) {
+    MU_CHECK(timeline.timestamps[i - 1] < timeline.timestamps[i]);
+  }
+
+  return 0;
+}
+
+int test_timeline_event() {
+  timeline_t timeline;
+  const vec3_t a_m{1.0, 2.0, 3.0};
+  const vec3_t w_m{4.0, 5.0, 6.0};
+  const vec3_t r_WM{7.0, 8.0, 9.0};
+  const quat_t q_WM{0.5, 0.5, 0.5, 0.5};
+  timeline.add(timeline_event_t{2, "body", r_WM, q_WM});
+  timeline.add(timeline_event_t{1, 1, "cam1/1.png"});
+  timeline.add(timeline_event_t{0, a_m, w_m});
+  timeline.merge();
+
+  const auto imu_event = timeline.event(0);
+  MU_CHECK(imu_event.type == IMU_EVENT);
+  MU_CHECK(imu_event.ts == 0);
+  MU_CHECK((imu_event.a_m - a_m).norm() < 1e-12);
+  MU_CHECK((imu_event.w_m - w_m).norm() < 1e-12);
+
+  const auto cam_event = timeline.event(1);
+  MU_CHECK(cam_event.type == CAMERA_EVENT);
+  MU_CHECK(cam_event.ts == 1);
+  MU_CHECK(cam_event.camera_index == 1);
+  MU_CHECK(cam_event.image_path == "cam1/1.png");
+
+  const auto mocap_event = timeline.event(2);
+  MU_CHECK(mocap_event.type == VICON_EVENT);
+  MU_CHECK(mocap_event.ts == 2);
+  MU_CHECK(mocap_event.object_name == "body");
+  MU_CHECK((mocap_event.r_WM - r_WM).norm() < 1e-12);
+  MU_CHECK(mocap_event.q_WM.isApprox(q_WM));
+
+  return 0;
+}
+
+void test_suite() {
+  MU_ADD_TEST(test_timeline_add);
+  MU_ADD_TEST(test_timeline_merge);
+  MU_ADD_TEST(test_timeline_event);
+}
+
+} // namespace proto
+
+MU_RUN_TESTS(proto::test_suite);
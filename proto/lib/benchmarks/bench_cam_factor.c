@@ -0,0 +1,94 @@
+#include "../proto.h"
+
+#define NB_POSES 100
+#define NB_FEATURES 2000
+#define NB_OBS 20000
+#define NB_ITERS 50
+
+int main() {
+  /* Parameters */
+  pose_t *poses = malloc(sizeof(pose_t) * NB_POSES);
+  for (int i = 0; i < NB_POSES; i++) {
+    real_t data[7] = {1.0,
+                      randf(-0.05, 0.05),
+                      randf(-0.05, 0.05),
+                      randf(-0.05, 0.05),
+                      randf(-0.5, 0.5),
+                      randf(-0.5, 0.5),
+                      randf(-0.5, 0.5)};
+    vec_normalize(data, 4);
+    pose_setup(&poses[i], i, data);
+  }
+
+  extrinsics_t extrinsics;
+  const real_t exts_data[7] = {1.0, 0.0, 0.0, 0.0, 0.01, 0.02, 0.03};
+  extrinsics_setup(&extrinsics, exts_data);
+
+  camera_params_t cam;
+  const int cam_res[2] = {752, 480};
+  const real_t cam_data[8] = {458.0, 457.0, 367.0, 248.0,
+                              -0.28, 0.07, 0.0002, 0.00002};
+  camera_params_setup(&cam, 0, cam_res, "pinhole", "radtan4", cam_data);
+
+  feature_t *features = malloc(sizeof(feature_t) * NB_FEATURES);
+  for (int i = 0; i < NB_FEATURES; i++) {
+    const real_t data[3] = {randf(-2.0, 2.0),
+                            randf(-2.0, 2.0),
+                            randf(4.0, 6.0)};
+    feature_setup(&features[i], data);
+  }
+
+  /* Observations */
+  cam_factor_t *factors = malloc(sizeof(cam_factor_t) * NB_OBS);
+  cam_factor_batch_t batch;
+  cam_factor_batch_setup(&batch, NB_OBS);
+  for (int i = 0; i < NB_OBS; i++) {
+    const int pose_idx = i % NB_POSES;
+    const int feature_idx = i % NB_FEATURES;
+    const real_t var[2] = {1.0, 1.0};
+    const real_t z[2] = {randf(0.0, 752.0), randf(0.0, 480.0)};
+    cam_factor_setup(&factors[i],
+                     &poses[pose_idx],
+                     &extrinsics,
+                     &features[feature_idx],
+                     &cam,
+                     var);
+    factors[i].z[0] = z[0];
+    factors[i].z[1] = z[1];
+    cam_factor_batch_add(&batch, pose_idx, 0, 0, feature_idx, z, var);
+  }
+
+  /* Scalar */
+  struct timespec t = tic();
+  for (int k = 0; k < NB_ITERS; k++) {
+    for (int i = 0; i < NB_OBS; i++) {
+      cam_factor_eval(&factors[i]);
+    }
+  }
+  const real_t scalar_secs = toc(&t) / NB_ITERS;
+
+  /* Batch */
+  t = tic();
+  for (int k = 0; k < NB_ITERS; k++) {
+    cam_factor_batch_eval(&batch,
+                          poses,
+                          NB_POSES,
+                          &extrinsics,
+                          1,
+                          &cam,
+                          features);
+  }
+  const real_t batch_secs = toc(&t) / NB_ITERS;
+
+  printf("observations: %d\n", NB_OBS);
+  printf("cam_factor_eval:       %8.3fms\n", scalar_secs * 1e3);
+  printf("cam_factor_batch_eval: %8.3fms\n", batch_secs * 1e3);
+  printf("speed up:              %8.2fx\n", scalar_secs / batch_secs);
+
+  cam_factor_batch_free(&batch);
+  free(factors);
+  free(features);
+  free(poses);
+
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include "../proto.h"
+
+/**
+ * Unblocked textbook Cholesky-Crout factorization, the previous chol().
+ */
+static void chol_textbook(const real_t *A, const size_t m, real_t *L) {
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < (i + 1); j++) {
+      real_t s = 0.0;
+      for (size_t k = 0; k < j; k++) {
+        s += L[i * m + k] * L[j * m + k];
+      }
+      if (i == j) {
+        L[i * m + j] = sqrt(A[i * m + i] - s);
+      } else {
+        L[i * m + j] = (1.0 / L[j * m + j] * (A[i * m + j] - s));
+      }
+    }
+  }
+}
+
+/**
+ * Random `n x n` symmetric positive definite matrix.
+ */
+static real_t *random_spd_matrix(const size_t n) {
+  real_t *B = mat_malloc(n, n);
+  real_t *A = mat_malloc(n, n);
+  for (size_t i = 0; i < n * n; i++) {
+    B[i] = randf(-1.0, 1.0);
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j <= i; j++) {
+      real_t sum = 0.0;
+      for (size_t k = 0; k < n; k++) {
+        sum += B[i * n + k] * B[j * n + k];
+      }
+      A[i * n + j] = sum;
+      A[j * n + i] = sum;
+    }
+    A[i * n + i] += n;
+  }
+  free(B);
+  return A;
+}
+
+/**
+ * Time `nb_iters` factorizations plus solves of a `n x n` system with each
+ * Cholesky implementation.
+ */
+static void bench_chol(const size_t n, const int nb_iters) {
+  real_t *A = random_spd_matrix(n);
+  real_t *L = mat_malloc(n, n);
+  real_t *b = vec_malloc(n);
+  real_t *x = vec_malloc(n);
+  real_t *work = vec_malloc(chol_work_size(n));
+  for (size_t i = 0; i < n; i++) {
+    b[i] = randf(-1.0, 1.0);
+  }
+  printf("%5zux%-5zu", n, n);
+
+  /* Textbook */
+  struct timespec t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    zeros(L, n, n);
+    chol_textbook(A, n, L);
+    chol_factor_solve(L, n, b, x);
+  }
+  printf("  textbook: %10.3fus", toc(&t) / nb_iters * 1e6);
+
+  /* Blocked LLT */
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    mat_copy(A, n, n, L);
+    chol_factor(L, n, work);
+    chol_factor_solve(L, n, b, x);
+  }
+  printf("  chol_factor: %10.3fus", toc(&t) / nb_iters * 1e6);
+
+  /* Blocked LDLT */
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    mat_copy(A, n, n, L);
+    ldlt_factor(L, n, work);
+    ldlt_factor_solve(L, n, b, x);
+  }
+  printf("  ldlt_factor: %10.3fus", toc(&t) / nb_iters * 1e6);
+
+#ifdef USE_LAPACK
+  /* LAPACK */
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    lapack_chol_solve(A, b, x, n);
+  }
+  printf("  lapack: %10.3fus", toc(&t) / nb_iters * 1e6);
+#endif
+  printf("\n");
+
+  free(A);
+  free(L);
+  free(b);
+  free(x);
+  free(work);
+}
+
+int main() {
+  /* Reduced camera systems of small to large sliding windows */
+  for (size_t n = 16; n <= 1024; n *= 2) {
+    const int nb_iters = (n <= 128) ? 1000 : 10;
+    bench_chol(n, nb_iters);
+  }
+  bench_chol(2048, 3);
+
+  return 0;
+}
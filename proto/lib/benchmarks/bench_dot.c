@@ -0,0 +1,67 @@
+#include "../proto.h"
+
+static const char *backend_names[4] = {"auto", "naive", "builtin", "cblas"};
+
+static real_t *random_matrix(const size_t m, const size_t n) {
+  real_t *A = mat_malloc(m, n);
+  for (size_t i = 0; i < m * n; i++) {
+    A[i] = randf(-1.0, 1.0);
+  }
+  return A;
+}
+
+/**
+ * Time `nb_iters` products of an `m x k` and `k x n` matrix with each dot()
+ * backend.
+ */
+static void bench_dot(const size_t m,
+                      const size_t k,
+                      const size_t n,
+                      const int nb_iters) {
+  real_t *A = random_matrix(m, k);
+  real_t *B = random_matrix(k, n);
+  real_t *C = mat_malloc(m, n);
+
+  printf("%4zux%-4zu * %4zux%-4zu", m, k, k, n);
+  for (int b = 0; b < 4; b++) {
+    if (dot_set_backend(b) != 0) {
+      continue;
+    } else if (b == DOT_NAIVE && m * n * k > 512 * 512 * 512) {
+      continue;
+    }
+
+    struct timespec t = tic();
+    for (int i = 0; i < nb_iters; i++) {
+      zeros(C, m, n);
+      dot(A, m, k, B, k, n, C);
+    }
+    const real_t secs = toc(&t) / nb_iters;
+    const real_t gflops = (2.0 * m * n * k) / secs * 1e-9;
+    printf("  %s: %9.3fus ", backend_names[b], secs * 1e6);
+    printf("[%6.2f GFLOPS]", gflops);
+  }
+  printf("\n");
+  dot_set_backend(DOT_AUTO);
+
+  free(A);
+  free(B);
+  free(C);
+}
+
+int main() {
+  /* Tiny matrices that dominate the factor code */
+  bench_dot(2, 3, 3, 1000000);
+  bench_dot(3, 3, 3, 1000000);
+  bench_dot(3, 3, 1, 1000000);
+  bench_dot(4, 4, 4, 1000000);
+  bench_dot(4, 4, 1, 1000000);
+  bench_dot(6, 6, 6, 1000000);
+
+  /* Square matrices */
+  for (size_t m = 16; m <= 1024; m *= 2) {
+    const int nb_iters = (m <= 128) ? 1000 : 5;
+    bench_dot(m, m, m, nb_iters);
+  }
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include "../proto.h"
+
+#define BENCH_DSV_PATH "/tmp/bench_dsv.csv"
+
+/**
+ * Write `nb_rows` of EuRoC style ground truth, a nanosecond timestamp
+ * followed by 16 reals.
+ */
+static size_t write_euroc_csv(const char *fp, const int nb_rows) {
+  FILE *csv = fopen(fp, "w");
+  fprintf(csv, "#timestamp, p_x, p_y, p_z, q_w, q_x, q_y, q_z, ...\n");
+  for (int i = 0; i < nb_rows; i++) {
+    fprintf(csv, "%ld", 1403636579758555392 + (long) i * 5000000);
+    for (int j = 0; j < 16; j++) {
+      fprintf(csv, ",%.15f", randf(-10.0, 10.0));
+    }
+    fprintf(csv, "\n");
+  }
+  const size_t size = ftell(csv);
+  fclose(csv);
+  return size;
+}
+
+/**
+ * Previous loader, a line at a time with fgets() and strtod() into per-row
+ * arrays.
+ */
+static real_t **fgets_strtod_data(const char *fp, int *nb_rows, int *nb_cols) {
+  *nb_rows = dsv_rows(fp);
+  *nb_cols = dsv_cols(fp, ',');
+  real_t **data = malloc(sizeof(real_t *) * *nb_rows);
+
+  FILE *infile = fopen(fp, "r");
+  char line[MAX_LINE_LENGTH] = {0};
+  int row_idx = 0;
+  while (fgets(line, MAX_LINE_LENGTH, infile) != NULL) {
+    if (line[0] == '#') {
+      continue;
+    }
+    data[row_idx] = malloc(sizeof(real_t) * *nb_cols);
+    char *s = line;
+    for (int j = 0; j < *nb_cols; j++) {
+      data[row_idx][j] = strtod(s, &s);
+      s++;
+    }
+    row_idx++;
+  }
+  fclose(infile);
+
+  return data;
+}
+
+int main() {
+  const size_t size = write_euroc_csv(BENCH_DSV_PATH, 1000000);
+  const real_t size_mb = size / (1024.0 * 1024.0);
+  printf("file: %.1fMB\n", size_mb);
+
+  /* fgets + strtod */
+  int nb_rows = 0;
+  int nb_cols = 0;
+  struct timespec t = tic();
+  real_t **rows = fgets_strtod_data(BENCH_DSV_PATH, &nb_rows, &nb_cols);
+  real_t secs = toc(&t);
+  printf("fgets + strtod: %8.3fs [%7.1f MB/s]\n", secs, size_mb / secs);
+  for (int i = 0; i < nb_rows; i++) {
+    free(rows[i]);
+  }
+  free(rows);
+
+  /* dsv_data */
+  t = tic();
+  real_t *data = dsv_data(BENCH_DSV_PATH, ',', &nb_rows, &nb_cols);
+  secs = toc(&t);
+  printf("dsv_data:       %8.3fs [%7.1f MB/s]\n", secs, size_mb / secs);
+  dsv_free(data);
+
+  remove(BENCH_DSV_PATH);
+  return 0;
+}
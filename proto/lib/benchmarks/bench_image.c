@@ -0,0 +1,218 @@
+#include "../proto.h"
+
+/**
+ * Direct 2D convolution of `img` with the `k x k` integer kernel `K`, the
+ * unseparated reference for the separable kernels.
+ */
+static void conv2d(const image_t *img,
+                   const int *K,
+                   const int k,
+                   const int shift,
+                   uint8_t *out) {
+  const int w = img->width;
+  const int h = img->height;
+  const int r = k / 2;
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      int sum = 0;
+      for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) {
+          const int sy = MIN(MAX(y + i - r, 0), h - 1);
+          const int sx = MIN(MAX(x + j - r, 0), w - 1);
+          sum += K[i * k + j] * img->data[sy * img->stride + sx];
+        }
+      }
+      out[y * w + x] = sum >> shift;
+    }
+  }
+}
+
+/**
+ * Time `nb_iters` runs of each image kernel on a `w x h` image.
+ */
+static void bench_image(const int w, const int h, const int nb_iters) {
+  image_t img;
+  image_setup(&img, w, h, malloc(w * h));
+  for (int i = 0; i < w * h; i++) {
+    img.data[i] = rand() % 256;
+  }
+  image_t out;
+  image_setup(&out, w, h, malloc(w * h));
+  imagef_t gx;
+  imagef_t gy;
+  imagef_t imgf;
+  imagef_t outf;
+  imagef_malloc(&gx, w, h);
+  imagef_malloc(&gy, w, h);
+  imagef_malloc(&imgf, w, h);
+  imagef_malloc(&outf, w, h);
+  for (int i = 0; i < w * h; i++) {
+    imgf.data[i] = img.data[i];
+  }
+  printf("%dx%d\n", w, h);
+
+  /* Pyramid */
+  const int gauss[25] = {1,  4,  6,  4,  1,
+                         4,  16, 24, 16, 4,
+                         6,  24, 36, 24, 6,
+                         4,  16, 24, 16, 4,
+                         1,  4,  6,  4,  1};
+  struct timespec t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    conv2d(&img, gauss, 5, 8, out.data);
+  }
+  printf("  conv2d 5x5:         %10.3fus\n", toc(&t) / nb_iters * 1e6);
+
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    image_pyramid_t pyr;
+    image_pyramid_setup(&pyr, &img, 4);
+    image_pyramid_free(&pyr);
+  }
+  printf("  image_pyramid (4):  %10.3fus\n", toc(&t) / nb_iters * 1e6);
+
+  /* Gradients */
+  const int scharr[9] = {-3, 0, 3, -10, 0, 10, -3, 0, 3};
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    conv2d(&img, scharr, 3, 0, out.data);
+  }
+  printf("  conv2d 3x3:         %10.3fus\n", toc(&t) / nb_iters * 1e6);
+
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    image_scharr(&img, &gx, &gy);
+  }
+  printf("  image_scharr:       %10.3fus\n", toc(&t) / nb_iters * 1e6);
+
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    image_sobel(&img, &gx, &gy);
+  }
+  printf("  image_sobel:        %10.3fus\n", toc(&t) / nb_iters * 1e6);
+
+  /* Box filters */
+  int box[81];
+  for (int i = 0; i < 81; i++) {
+    box[i] = 1;
+  }
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    conv2d(&img, box, 9, 6, out.data);
+  }
+  printf("  conv2d 9x9:         %10.3fus\n", toc(&t) / nb_iters * 1e6);
+
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    image_box_filter(&img, 4, &out);
+  }
+  printf("  image_box_filter:   %10.3fus\n", toc(&t) / nb_iters * 1e6);
+
+  t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    imagef_box_filter(&imgf, 4, &outf);
+  }
+  printf("  imagef_box_filter:  %10.3fus\n", toc(&t) / nb_iters * 1e6);
+
+  free(img.data);
+  free(out.data);
+  imagef_free(&gx);
+  imagef_free(&gy);
+  imagef_free(&imgf);
+  imagef_free(&outf);
+}
+
+/**
+ * Time FAST corner detection on the image at `path`.
+ */
+static void bench_fast(const char *path, const int nb_iters) {
+  image_t *rgb = image_load(path);
+  image_t img;
+  image_setup(&img, rgb->width, rgb->height, malloc(rgb->width * rgb->height));
+  image_gray(rgb, &img);
+  image_free(rgb);
+  printf("%dx%d [%s]\n", img.width, img.height, path);
+
+  keypoint_t kps[1000];
+  for (int nb_threads = 1; nb_threads <= 4; nb_threads *= 2) {
+    int nb_kps = 0;
+    struct timespec t = tic();
+    for (int i = 0; i < nb_iters; i++) {
+      nb_kps = fast_grid_detect(&img, 20, 4, 5, 1000, nb_threads, kps);
+    }
+    printf("  fast_grid_detect (%d threads): %10.3fus  [%d corners]\n",
+           nb_threads,
+           toc(&t) / nb_iters * 1e6,
+           nb_kps);
+  }
+
+  free(img.data);
+}
+
+/**
+ * Time `nb_iters` KLT pyramid builds and batched tracks of FAST corners
+ * between two views of the image at `path` offset by (3, 2) pixels.
+ */
+static void bench_klt(const char *path, const int nb_iters) {
+  image_t *rgb = image_load(path);
+  image_t img;
+  image_setup(&img, rgb->width, rgb->height, malloc(rgb->width * rgb->height));
+  image_gray(rgb, &img);
+  image_free(rgb);
+
+  image_t img0;
+  image_t img1;
+  image_view(&img, 0, 0, img.width - 3, img.height - 2, &img0);
+  image_view(&img, 3, 2, img.width - 3, img.height - 2, &img1);
+
+  klt_t klt;
+  klt_setup(&klt);
+  klt_pyramid_t pyr0;
+  klt_pyramid_t pyr1;
+  struct timespec t = tic();
+  for (int i = 0; i < nb_iters; i++) {
+    klt_pyramid_setup(&pyr0, &img0, klt.max_level + 1);
+    klt_pyramid_free(&pyr0);
+  }
+  printf("  klt_pyramid_setup: %10.3fus\n", toc(&t) / nb_iters * 1e6);
+  klt_pyramid_setup(&pyr0, &img0, klt.max_level + 1);
+  klt_pyramid_setup(&pyr1, &img1, klt.max_level + 1);
+
+  keypoint_t kps0[200];
+  keypoint_t kps1[200];
+  uint8_t status[200];
+  real_t err[200];
+  const int nb_kps = fast_grid_detect(&img0, 20, 4, 5, 200, 1, kps0);
+  for (int nb_threads = 1; nb_threads <= 4; nb_threads *= 2) {
+    klt.nb_threads = nb_threads;
+    int nb_tracked = 0;
+    struct timespec t = tic();
+    for (int i = 0; i < nb_iters; i++) {
+      memcpy(kps1, kps0, sizeof(keypoint_t) * nb_kps);
+      nb_tracked =
+          klt_track(&klt, &pyr0, &pyr1, nb_kps, kps0, kps1, status, err);
+    }
+    printf("  klt_track (%d threads): %10.3fus  [%d / %d tracked]\n",
+           nb_threads,
+           toc(&t) / nb_iters * 1e6,
+           nb_tracked,
+           nb_kps);
+  }
+
+  klt_pyramid_free(&pyr0);
+  klt_pyramid_free(&pyr1);
+  free(img.data);
+}
+
+int main(int argc, char *argv[]) {
+  bench_image(752, 480, 20);
+  bench_image(1280, 720, 10);
+
+  /* EuRoC cam0 frame by default */
+  const char *image_path =
+      "../../archive/tests/test_data/calib/stereo/cam0_1403709395937837056.png";
+  bench_fast((argc > 1) ? argv[1] : image_path, 100);
+  bench_klt((argc > 1) ? argv[1] : image_path, 100);
+
+  return 0;
+}
@@ -407,70 +407,254 @@ char **dsv_fields(const char *fp, const char delim, int *nb_fields) {
 }
 
 /**
- * Load delimited separated value data as a matrix.
+ * Parse a real number from `[*p, end)` into `value` and advance `*p` past
+ * it. Plain decimal numbers with an optional exponent are parsed in place,
+ * anything else (nan, inf, hex, numbers beyond the exact fast path in double
+ * precision) is copied out up to the next `delim` or end of line and handed
+ * to strtod().
+ * @returns 0 for success or -1 if the field is empty or not a number
+ */
+static int dsv_parse_real(const char **p,
+                          const char *end,
+                          const char delim,
+                          real_t *value) {
+  static const double pow10[23] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                   1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                   1e18, 1e19, 1e20, 1e21, 1e22};
+  const char *s = *p;
+
+  /* Sign */
+  int negative = 0;
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = (*s == '-');
+    s++;
+  }
+
+  /* Mantissa, keeping the 19 most significant digits */
+  uint64_t mantissa = 0;
+  int nb_digits = 0;
+  int nb_read = 0;
+  int exponent = 0;
+  for (; s < end && (unsigned) (*s - '0') < 10; s++, nb_read++) {
+    if (nb_digits < 19) {
+      mantissa = mantissa * 10 + (*s - '0');
+      nb_digits += (mantissa != 0);
+    } else {
+      exponent++;
+    }
+  }
+  if (s < end && *s == '.') {
+    for (s++; s < end && (unsigned) (*s - '0') < 10; s++, nb_read++) {
+      if (nb_digits < 19) {
+        mantissa = mantissa * 10 + (*s - '0');
+        nb_digits += (mantissa != 0);
+        exponent--;
+      }
+    }
+  }
+
+  /* Exponent */
+  if (nb_read && s < end && (*s == 'e' || *s == 'E')) {
+    const char *e = s + 1;
+    int exp_negative = 0;
+    if (e < end && (*e == '-' || *e == '+')) {
+      exp_negative = (*e == '-');
+      e++;
+    }
+    int exp_value = 0;
+    const char *exp_start = e;
+    for (; e < end && (unsigned) (*e - '0') < 10; e++) {
+      exp_value = (exp_value < 10000) ? exp_value * 10 + (*e - '0') : exp_value;
+    }
+    if (e != exp_start) {
+      exponent += (exp_negative) ? -exp_value : exp_value;
+      s = e;
+    }
+  }
+
+  /* Fast path */
+  const int terminated = (s == end || *s == delim || *s == '\n' || *s == '\r'
+                          || *s == ' ');
+#if PRECISION == 2
+  const int exact = (mantissa <= (1ull << 53) && abs(exponent) <= 22);
+#else
+  const int exact = 1;
+#endif
+  if (nb_read && terminated && exact) {
+    double x = (double) mantissa;
+    if (exponent < -22) {
+      x *= pow(10.0, exponent);
+    } else if (exponent < 0) {
+      x /= pow10[-exponent];
+    } else if (exponent > 22) {
+      x *= pow(10.0, exponent);
+    } else if (exponent > 0) {
+      x *= pow10[exponent];
+    }
+    *p = s;
+    *value = (negative) ? -x : x;
+    return 0;
+  }
+
+  /* Slow path */
+  char token[64] = {0};
+  size_t len = 0;
+  s = *p;
+  while (s < end && *s != delim && *s != '\n' && *s != '\r') {
+    if (len < sizeof(token) - 1) {
+      token[len++] = *s;
+    }
+    s++;
+  }
+  *p = s;
+
+  char *token_end = NULL;
+  *value = strtod(token, &token_end);
+  while (*token_end == ' ') {
+    token_end++;
+  }
+  if (token_end == token || *token_end != '\0') {
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Load delimited separated value data at `fp` as a row-major matrix, where
+ * `delim` is the value separator. Lines starting with '#', empty and
+ * whitespace only lines are skipped, while an empty field fails the load. The file is memory mapped and parsed in a single pass, on
+ * success `nb_rows` and `nb_cols` will be set respectively.
  * @returns
- * - Matrix of DSV data
+ * - Contiguous `nb_rows x nb_cols` matrix of DSV data, free with dsv_free()
  * - NULL for failure
  */
-real_t **
-dsv_data(const char *fp, const char delim, int *nb_rows, int *nb_cols) {
+real_t *dsv_data(const char *fp,
+                 const char delim,
+                 int *nb_rows,
+                 int *nb_cols) {
   assert(fp != NULL);
-
-  /* Obtain number of rows and columns in dsv data */
-  *nb_rows = dsv_rows(fp);
-  *nb_cols = dsv_cols(fp, delim);
-  if (*nb_rows == -1 || *nb_cols == -1) {
+  assert(nb_rows != NULL);
+  assert(nb_cols != NULL);
+  *nb_rows = 0;
+  *nb_cols = 0;
+
+  /* Map file */
+  const int fd = open(fp, O_RDONLY);
+  if (fd == -1) {
+    LOG_ERROR("Failed to open [%s]!", fp);
     return NULL;
   }
-
-  /* Initialize memory for dsv data */
-  real_t **data = malloc(sizeof(real_t *) * *nb_rows);
-  for (int i = 0; i < *nb_rows; i++) {
-    data[i] = malloc(sizeof(real_t) * *nb_cols);
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    LOG_ERROR("Failed to stat [%s] or file is empty!", fp);
+    close(fd);
+    return NULL;
   }
-
-  /* Load file */
-  FILE *infile = fopen(fp, "r");
-  if (infile == NULL) {
-    fclose(infile);
+  const size_t size = st.st_size;
+  char *buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (buf == MAP_FAILED) {
+    LOG_ERROR("Failed to mmap [%s]!", fp);
     return NULL;
   }
+  madvise(buf, size, MADV_SEQUENTIAL);
+
+  /* Parse rows */
+  const char *p = buf;
+  const char *end = buf + size;
+  size_t capacity = 1024;
+  size_t nb_values = 0;
+  real_t *data = malloc(sizeof(real_t) * capacity);
+  int rows = 0;
+  int cols = 0;
+  int retval = 0;
 
-  /* Loop through data */
-  char line[MAX_LINE_LENGTH] = {0};
-  int row_idx = 0;
-  int col_idx = 0;
-
-  /* Loop through data line by line */
-  while (fgets(line, MAX_LINE_LENGTH, infile) != NULL) {
-    /* Ignore if comment line */
-    if (line[0] == '#') {
+  while (p < end) {
+    /* -- Skip comment, empty and whitespace only lines */
+    const char *q = p;
+    while (q < end && (*q == ' ' || *q == '\t')) {
+      q++;
+    }
+    if (*p == '#' || q == end || *q == '\n' || *q == '\r') {
+      const char *eol = memchr(p, '\n', end - p);
+      p = (eol) ? eol + 1 : end;
       continue;
     }
 
-    /* Iterate through values in line separated by commas */
-    char entry[100] = {0};
-    for (size_t i = 0; i < strlen(line); i++) {
-      char c = line[i];
-      if (c == ' ') {
-        continue;
+    /* -- Parse values in row */
+    const char *row_start = p;
+    int col = 0;
+    while (1) {
+      while (p < end && *p == ' ' && delim != ' ') {
+        p++;
+      }
+      if (nb_values == capacity) {
+        capacity *= 2;
+        data = realloc(data, sizeof(real_t) * capacity);
       }
+      if (dsv_parse_real(&p, end, delim, &data[nb_values]) != 0) {
+        LOG_ERROR("Failed to parse row %d of [%s]!", rows, fp);
+        retval = -1;
+        break;
+      }
+      nb_values++;
+      col++;
 
-      if (c == ',' || c == '\n') {
-        data[row_idx][col_idx] = strtod(entry, NULL);
-        memset(entry, '\0', sizeof(char) * 100);
-        col_idx++;
-      } else {
-        entry[strlen(entry)] = c;
+      while (p < end && *p == ' ' && delim != ' ') {
+        p++;
+      }
+      if (p < end && *p == delim) {
+        p++;
+        continue;
       }
+      break;
+    }
+    if (retval != 0) {
+      break;
     }
 
-    col_idx = 0;
-    row_idx++;
+    /* -- End of row */
+    if (p < end && *p == '\r') {
+      p++;
+    }
+    if (p < end && *p != '\n') {
+      LOG_ERROR("Failed to parse row %d of [%s]!", rows, fp);
+      retval = -1;
+      break;
+    }
+    p = (p < end) ? p + 1 : end;
+
+    /* -- Check columns, reserve memory for all rows after the first */
+    if (rows == 0) {
+      cols = col;
+      const size_t row_size = p - row_start;
+      const size_t nb_rows_est = size / row_size + 1;
+      if (nb_rows_est * cols > capacity) {
+        capacity = nb_rows_est * cols;
+        data = realloc(data, sizeof(real_t) * capacity);
+      }
+    } else if (col != cols) {
+      LOG_ERROR("Row %d of [%s] has %d columns, expected %d!",
+                rows,
+                fp,
+                col,
+                cols);
+      retval = -1;
+      break;
+    }
+    rows++;
   }
 
   /* Clean up */
-  fclose(infile);
+  munmap(buf, size);
+  if (retval != 0 || rows == 0) {
+    free(data);
+    return NULL;
+  }
+  *nb_rows = rows;
+  *nb_cols = cols;
 
   return data;
 }
@@ -478,10 +662,7 @@ dsv_data(const char *fp, const char delim, int *nb_rows, int *nb_cols) {
 /**
  * Free DSV data.
  */
-void dsv_free(real_t **data, const int nb_rows) {
-  for (int i = 0; i < nb_rows; i++) {
-    free(data[i]);
-  }
+void dsv_free(real_t *data) {
   free(data);
 }
 
@@ -489,23 +670,181 @@ void dsv_free(real_t **data, const int nb_rows) {
  * Load comma separated data as a matrix, where `fp` is the csv file path, on
  * success `nb_rows` and `nb_cols` will be filled.
  * @returns
- * - Matrix of CSV data
+ * - Contiguous `nb_rows x nb_cols` matrix of CSV data
  * - NULL for failure
  */
-real_t **csv_data(const char *fp, int *nb_rows, int *nb_cols) {
+real_t *csv_data(const char *fp, int *nb_rows, int *nb_cols) {
   return dsv_data(fp, ',', nb_rows, nb_cols);
 }
 
 /**
  * Free CSV data.
  */
-void csv_free(real_t **data, const int nb_rows) {
-  for (int i = 0; i < nb_rows; i++) {
-    free(data[i]);
-  }
+void csv_free(real_t *data) {
   free(data);
 }
 
+/******************************************************************************
+ * ARENA
+ ******************************************************************************/
+
+/**
+ * Round `size` up to a multiple of ARENA_ALIGNMENT.
+ */
+static size_t arena_align(const size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+}
+
+/**
+ * Setup `arena`, new blocks are allocated `block_size` bytes or larger.
+ * No memory is allocated until the first `arena_alloc()`.
+ */
+void arena_setup(arena_t *arena, const size_t block_size) {
+  assert(arena != NULL);
+  assert(block_size > 0);
+
+  arena->head = NULL;
+  arena->curr = NULL;
+  arena->block_size = arena_align(block_size);
+}
+
+/**
+ * Free all memory blocks owned by `arena`.
+ */
+void arena_free(arena_t *arena) {
+  assert(arena != NULL);
+
+  arena_block_t *block = arena->head;
+  while (block) {
+    arena_block_t *next = block->next;
+    free(block->data);
+    free(block);
+    block = next;
+  }
+  arena->head = NULL;
+  arena->curr = NULL;
+}
+
+/**
+ * Release every allocation made from `arena` at once. The memory blocks are
+ * kept for reuse rather than freed.
+ */
+void arena_reset(arena_t *arena) {
+  assert(arena != NULL);
+
+  for (arena_block_t *block = arena->head; block; block = block->next) {
+    block->used = 0;
+  }
+  arena->curr = arena->head;
+}
+
+/**
+ * Allocate `size` bytes aligned to ARENA_ALIGNMENT from `arena`.
+ * @returns Pointer to uninitialized memory owned by the arena
+ */
+void *arena_alloc(arena_t *arena, const size_t size) {
+  assert(arena != NULL);
+  const size_t nb_bytes = arena_align((size) ? size : 1);
+
+  /* Find a block with enough room, starting from the current one */
+  arena_block_t *prev = NULL;
+  arena_block_t *block = (arena->curr) ? arena->curr : arena->head;
+  while (block && block->used + nb_bytes > block->size) {
+    prev = block;
+    block = block->next;
+  }
+
+  /* Out of blocks, append a new one */
+  if (block == NULL) {
+    block = malloc(sizeof(arena_block_t));
+    block->next = NULL;
+    block->size = (nb_bytes > arena->block_size) ? nb_bytes : arena->block_size;
+    block->used = 0;
+    block->data = aligned_alloc(ARENA_ALIGNMENT, block->size);
+    if (prev) {
+      prev->next = block;
+    } else {
+      arena->head = block;
+    }
+  }
+
+  void *ptr = block->data + block->used;
+  block->used += nb_bytes;
+  arena->curr = block;
+  return ptr;
+}
+
+/**
+ * Allocate zero-initialized memory for `nmemb` elements of `size` bytes
+ * from `arena`.
+ */
+void *arena_calloc(arena_t *arena, const size_t nmemb, const size_t size) {
+  void *ptr = arena_alloc(arena, nmemb * size);
+  memset(ptr, 0, nmemb * size);
+  return ptr;
+}
+
+/**
+ * Grow the allocation `ptr` of `old_size` bytes to `new_size` bytes. The
+ * allocation is extended in place if it is the last one made from `arena`
+ * and the block has room, else the data is copied to a new allocation and
+ * the old memory is only reclaimed when the arena is reset.
+ *
+ * @returns Pointer to the grown allocation
+ */
+void *arena_grow(arena_t *arena,
+                 void *ptr,
+                 const size_t old_size,
+                 const size_t new_size) {
+  assert(arena != NULL);
+  assert(new_size >= old_size);
+  if (ptr == NULL) {
+    return arena_alloc(arena, new_size);
+  }
+
+  arena_block_t *block = arena->curr;
+  const size_t old_bytes = arena_align((old_size) ? old_size : 1);
+  const size_t new_bytes = arena_align(new_size);
+  if (block && (char *) ptr + old_bytes == block->data + block->used
+      && block->used - old_bytes + new_bytes <= block->size) {
+    block->used = block->used - old_bytes + new_bytes;
+    return ptr;
+  }
+
+  void *data = arena_alloc(arena, new_size);
+  memcpy(data, ptr, old_size);
+  return data;
+}
+
+/**
+ * @returns Current position of `arena` to later rewind to.
+ */
+arena_mark_t arena_mark(const arena_t *arena) {
+  assert(arena != NULL);
+
+  arena_mark_t mark;
+  mark.block = arena->curr;
+  mark.used = (arena->curr) ? arena->curr->used : 0;
+  return mark;
+}
+
+/**
+ * Release every allocation made from `arena` since `mark`.
+ */
+void arena_rewind(arena_t *arena, const arena_mark_t mark) {
+  assert(arena != NULL);
+  if (mark.block == NULL) {
+    arena_reset(arena);
+    return;
+  }
+
+  mark.block->used = mark.used;
+  for (arena_block_t *block = mark.block->next; block; block = block->next) {
+    block->used = 0;
+  }
+  arena->curr = mark.block;
+}
+
 /******************************************************************************
  * TIME
  ******************************************************************************/
@@ -557,6 +896,11 @@ timestamp_t time_now() {
   return (uint64_t) sec * BILLION + (uint64_t) ns;
 }
 
+/**
+ * Convert timestamp `ts` in nano-seconds to seconds.
+ */
+real_t ts2sec(const timestamp_t ts) { return ts * 1e-9; }
+
 /******************************************************************************
  * NETWORK
  ******************************************************************************/
@@ -1087,63 +1431,7 @@ int mat_save(const char *save_path, const real_t *A, const int m, const int n) {
  * @returns Loaded matrix matrix
  */
 real_t *mat_load(const char *mat_path, int *nb_rows, int *nb_cols) {
-  /* Obtain number of rows and columns in csv data */
-  *nb_rows = dsv_rows(mat_path);
-  *nb_cols = dsv_cols(mat_path, ',');
-  if (*nb_rows == -1 || *nb_cols == -1) {
-    return NULL;
-  }
-
-  /* Initialize memory for csv data */
-  real_t *A = malloc(sizeof(real_t) * *nb_rows * *nb_cols);
-
-  /* Load file */
-  FILE *infile = fopen(mat_path, "r");
-  if (infile == NULL) {
-    fclose(infile);
-    return NULL;
-  }
-
-  /* Loop through data */
-  char line[MAX_LINE_LENGTH] = {0};
-  int row_idx = 0;
-  int col_idx = 0;
-  int idx = 0;
-
-  /* Loop through data line by line */
-  while (fgets(line, MAX_LINE_LENGTH, infile) != NULL) {
-    /* Ignore if comment line */
-    if (line[0] == '#') {
-      continue;
-    }
-
-    /* Iterate through values in line separated by commas */
-    char entry[100] = {0};
-    for (size_t i = 0; i < strlen(line); i++) {
-      char c = line[i];
-      if (c == ' ') {
-        continue;
-      }
-
-      if (c == ',' || c == '\n') {
-        A[idx] = strtod(entry, NULL);
-        idx++;
-
-        memset(entry, '\0', sizeof(char) * 100);
-        col_idx++;
-      } else {
-        entry[strlen(entry)] = c;
-      }
-    }
-
-    col_idx = 0;
-    row_idx++;
-  }
-
-  /* Clean up */
-  fclose(infile);
-
-  return A;
+  return dsv_data(mat_path, ',', nb_rows, nb_cols);
 }
 
 /**
@@ -1448,95 +1736,436 @@ void vec_normalize(real_t *x, const size_t n) {
 }
 
 /**
- * Dot product of two matrices or vectors `A` and `B` of size `A_m x A_n` and
- * `B_m x B_n`. Results are written to `C`.
+ * Backend used by `dot()`, see `dot_set_backend()`.
  */
-void dot(const real_t *A,
-         const size_t A_m,
-         const size_t A_n,
-         const real_t *B,
-         const size_t B_m,
-         const size_t B_n,
-         real_t *C) {
-  assert(A != NULL && B != NULL && A != C && B != C);
-  assert(A_m > 0 && A_n > 0 && B_m > 0 && B_n > 0);
-  assert(A_n == B_m);
+static int dot_backend = DOT_AUTO;
+
+/**
+ * Set the backend used by `dot()` to one of:
+ *
+ * - DOT_AUTO: Tiny-matrix fast path, naive loops or blocked GEMM depending
+ *   on the matrix sizes
+ * - DOT_NAIVE: Naive triple loop
+ * - DOT_BUILTIN: Cache-blocked, register-tiled GEMM
+ * - DOT_CBLAS: CBLAS GEMM
+ *
+ * @returns 0 for success or -1 if the backend is not available
+ */
+int dot_set_backend(const int backend) {
+  switch (backend) {
+    case DOT_AUTO:
+    case DOT_NAIVE:
+    case DOT_BUILTIN:
+      dot_backend = backend;
+      return 0;
+    case DOT_CBLAS:
+#ifdef USE_CBLAS
+      dot_backend = backend;
+      return 0;
+#else
+      LOG_ERROR("Not compiled with USE_CBLAS!");
+      return -1;
+#endif
+    default:
+      LOG_ERROR("Invalid dot backend [%d]!", backend);
+      return -1;
+  }
+}
 
-  size_t m = A_m;
-  size_t n = B_n;
+/**
+ * @returns Backend currently used by `dot()`.
+ */
+int dot_get_backend() {
+  return dot_backend;
+}
 
+/**
+ * Naive matrix multiply `C += A * B`, where `A` is `m x k` and `B` is `k x n`.
+ */
+static void dot_naive(const real_t *A,
+                      const size_t m,
+                      const size_t k,
+                      const real_t *B,
+                      const size_t n,
+                      real_t *C) {
   for (size_t i = 0; i < m; i++) {
     for (size_t j = 0; j < n; j++) {
-      for (size_t k = 0; k < A_n; k++) {
-        C[(i * n) + j] += A[(i * A_n) + k] * B[(k * B_n) + j];
+      for (size_t p = 0; p < k; p++) {
+        C[(i * n) + j] += A[(i * k) + p] * B[(p * n) + j];
       }
     }
   }
 }
 
 /**
- * Create skew-symmetric matrix `A` from a 3x1 vector `x`.
+ * Tiny matrix multiply `C += A * B` for a compile-time inner dimension `k`,
+ * once inlined with a constant `k` the inner loop is fully unrolled.
  */
-void skew(const real_t x[3], real_t A[3 * 3]) {
-  /* First row */
-  A[0] = 0.0;
-  A[1] = -x[2];
-  A[2] = x[1];
+static inline void dot_tiny(const real_t *restrict A,
+                            const size_t m,
+                            const size_t k,
+                            const real_t *restrict B,
+                            const size_t n,
+                            real_t *restrict C) {
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < n; j++) {
+      real_t sum = 0.0;
+      for (size_t p = 0; p < k; p++) {
+        sum += A[i * k + p] * B[p * n + j];
+      }
+      C[i * n + j] += sum;
+    }
+  }
+}
 
-  /* Second row */
-  A[3] = x[2];
-  A[4] = 0.0;
-  A[5] = -x[0];
+/**
+ * Tiny-matrix fast path for the 2x3, 3x3, 4x4 and 6x6 products that dominate
+ * the transform and factor code.
+ *
+ * @returns 0 if the product was computed, else -1 if the sizes are not
+ * handled by the fast path.
+ */
+static int dot_tiny_dispatch(const real_t *A,
+                             const size_t m,
+                             const size_t k,
+                             const real_t *B,
+                             const size_t n,
+                             real_t *C) {
+  if (m > DOT_TINY_MAX || n > DOT_TINY_MAX) {
+    return -1;
+  }
 
-  /* Third row */
-  A[6] = -x[1];
-  A[7] = x[0];
-  A[8] = 0.0;
+  switch (k) {
+    case 3:
+      dot_tiny(A, m, 3, B, n, C);
+      return 0;
+    case 4:
+      dot_tiny(A, m, 4, B, n, C);
+      return 0;
+    case 6:
+      dot_tiny(A, m, 6, B, n, C);
+      return 0;
+    default:
+      return -1;
+  }
 }
 
+/** Row of a DOT_MR x DOT_NR GEMM micro-kernel tile */
+typedef real_t dot_row_t __attribute__((vector_size(sizeof(real_t) * DOT_NR)));
+
 /**
- * Perform forward substitution with a lower triangular matrix `L`, column
- * vector `b` and solve for vector `y` of size `n`.
+ * GEMM micro-kernel, `C += A * B` for a `DOT_MR x DOT_NR` tile of `C` with
+ * leading dimension `ldc`, where `A` and `B` are packed panels of depth `kc`.
+ * The tile is accumulated in registers one row vector at a time, and only
+ * the top-left `mr x nr` of the tile is written back for edge tiles.
  */
-void fwdsubs(const real_t *L, const real_t *b, real_t *y, const size_t n) {
-  for (size_t i = 0; i < n; i++) {
-    real_t alpha = b[i];
-    for (size_t j = 0; j < i; j++) {
-      alpha -= L[i * n + j] * y[j];
+static void dot_kernel(const size_t kc,
+                       const real_t *restrict A,
+                       const real_t *restrict B,
+                       real_t *restrict C,
+                       const size_t ldc,
+                       const size_t mr,
+                       const size_t nr) {
+  dot_row_t c[DOT_MR] = {0};
+  for (size_t p = 0; p < kc; p++) {
+    dot_row_t b;
+    memcpy(&b, &B[p * DOT_NR], sizeof(dot_row_t));
+    for (size_t i = 0; i < DOT_MR; i++) {
+      c[i] += A[p * DOT_MR + i] * b;
+    }
+  }
+
+  for (size_t i = 0; i < mr; i++) {
+    for (size_t j = 0; j < nr; j++) {
+      C[i * ldc + j] += c[i][j];
     }
-    y[i] = alpha / L[i * n + i];
   }
 }
 
 /**
- * Perform backward substitution with a upper triangular matrix `U`, column
- * vector `y` and solve for vector `x` of size `n`.
+ * Pack the `mc x kc` block of `A` with leading dimension `lda` into panels
+ * of DOT_MR rows stored depth first, zero padding the last panel.
  */
-void bwdsubs(const real_t *U, const real_t *y, real_t *x, const size_t n) {
-  for (int i = n - 1; i >= 0; i--) {
-    real_t alpha = y[i];
-    for (int j = i; j < (int) n; j++) {
-      alpha -= U[i * n + j] * x[j];
+static void dot_pack_A(const real_t *A,
+                       const size_t lda,
+                       const size_t mc,
+                       const size_t kc,
+                       real_t *A_packed) {
+  for (size_t ir = 0; ir < mc; ir += DOT_MR) {
+    const size_t mr = (mc - ir < DOT_MR) ? mc - ir : DOT_MR;
+    for (size_t p = 0; p < kc; p++) {
+      for (size_t i = 0; i < DOT_MR; i++) {
+        *A_packed++ = (i < mr) ? A[(ir + i) * lda + p] : 0.0;
+      }
     }
-    x[i] = alpha / U[i * n + i];
   }
 }
 
 /**
- * Check analytical jacobian `jac` with name `jac_name` and compare it with a
- * numerically differentiated jacobian `fdiff` (finite diff). Where both
- * matrices are of size `m x n`, `tol` denotes the tolerance to consider both
- * `jac` and `fdiff` to be close enough. For debugging purposes use `verbose`
- * to show the matrices and differences.
- *
- * @returns
- * - 0 for success
- * - -1 for failure
+ * Pack the `kc x nc` block of `B` with leading dimension `ldb` into panels
+ * of DOT_NR columns stored depth first, zero padding the last panel.
  */
-int check_jacobian(const char *jac_name,
-                   const real_t *fdiff,
-                   const real_t *jac,
-                   const size_t m,
+static void dot_pack_B(const real_t *B,
+                       const size_t ldb,
+                       const size_t kc,
+                       const size_t nc,
+                       real_t *B_packed) {
+  for (size_t jr = 0; jr < nc; jr += DOT_NR) {
+    const size_t nr = (nc - jr < DOT_NR) ? nc - jr : DOT_NR;
+    for (size_t p = 0; p < kc; p++) {
+      const real_t *b = &B[p * ldb + jr];
+      for (size_t j = 0; j < DOT_NR; j++) {
+        *B_packed++ = (j < nr) ? b[j] : 0.0;
+      }
+    }
+  }
+}
+
+/** Sizes of the GEMM pack buffers, whole DOT_MR and DOT_NR panels */
+#define DOT_A_PACK_SIZE (((DOT_MC + DOT_MR - 1) / DOT_MR) * DOT_MR * DOT_KC)
+#define DOT_B_PACK_SIZE (((DOT_NC + DOT_NR - 1) / DOT_NR) * DOT_NR * DOT_KC)
+
+/**
+ * GEMM pack buffers of the calling thread, allocated on first use and freed
+ * when the thread exits.
+ */
+typedef struct dot_pack_t {
+  real_t *A;
+  real_t *B;
+} dot_pack_t;
+
+static pthread_key_t dot_pack_key;
+static pthread_once_t dot_pack_once = PTHREAD_ONCE_INIT;
+
+static void dot_pack_free(void *arg) {
+  dot_pack_t *pack = (dot_pack_t *) arg;
+  free(pack->A);
+  free(pack->B);
+  free(pack);
+}
+
+static void dot_pack_key_setup(void) {
+  pthread_key_create(&dot_pack_key, dot_pack_free);
+}
+
+/**
+ * @returns GEMM pack buffers of the calling thread, of `DOT_A_PACK_SIZE` and
+ * `DOT_B_PACK_SIZE` elements aligned to 64 bytes.
+ */
+static dot_pack_t *dot_pack_get(void) {
+  pthread_once(&dot_pack_once, dot_pack_key_setup);
+  dot_pack_t *pack = pthread_getspecific(dot_pack_key);
+  if (pack == NULL) {
+    const size_t A_bytes = (sizeof(real_t) * DOT_A_PACK_SIZE + 63) & ~63UL;
+    const size_t B_bytes = (sizeof(real_t) * DOT_B_PACK_SIZE + 63) & ~63UL;
+    pack = malloc(sizeof(dot_pack_t));
+    pack->A = aligned_alloc(64, A_bytes);
+    pack->B = aligned_alloc(64, B_bytes);
+    pthread_setspecific(dot_pack_key, pack);
+  }
+  return pack;
+}
+
+/**
+ * Cache-blocked GEMM `C += A * B`, where `A` is `m x k` and `B` is `k x n`.
+ *
+ * `B` is packed in `DOT_KC x DOT_NC` blocks that stay in the L3 cache and `A`
+ * in `DOT_MC x DOT_KC` blocks that stay in the L2 cache, the micro-kernel then
+ * streams DOT_MR x DOT_NR tiles of `C` through registers. The pack buffers
+ * are per thread and reused across calls.
+ */
+static void dot_gemm(const real_t *A,
+                     const size_t m,
+                     const size_t k,
+                     const real_t *B,
+                     const size_t n,
+                     real_t *C) {
+  dot_pack_t *pack = dot_pack_get();
+  real_t *A_packed = pack->A;
+  real_t *B_packed = pack->B;
+
+  for (size_t jc = 0; jc < n; jc += DOT_NC) {
+    const size_t nc = (n - jc < DOT_NC) ? n - jc : DOT_NC;
+
+    for (size_t pc = 0; pc < k; pc += DOT_KC) {
+      const size_t kc = (k - pc < DOT_KC) ? k - pc : DOT_KC;
+      dot_pack_B(&B[pc * n + jc], n, kc, nc, B_packed);
+
+      for (size_t ic = 0; ic < m; ic += DOT_MC) {
+        const size_t mc = (m - ic < DOT_MC) ? m - ic : DOT_MC;
+        dot_pack_A(&A[ic * k + pc], k, mc, kc, A_packed);
+
+        for (size_t jr = 0; jr < nc; jr += DOT_NR) {
+          const size_t nr = (nc - jr < DOT_NR) ? nc - jr : DOT_NR;
+          const real_t *B_panel = &B_packed[jr * kc];
+
+          for (size_t ir = 0; ir < mc; ir += DOT_MR) {
+            const size_t mr = (mc - ir < DOT_MR) ? mc - ir : DOT_MR;
+            const real_t *A_panel = &A_packed[ir * kc];
+            real_t *C_tile = &C[(ic + ir) * n + (jc + jr)];
+            dot_kernel(kc, A_panel, B_panel, C_tile, n, mr, nr);
+          }
+        }
+      }
+    }
+  }
+}
+
+#ifdef USE_CBLAS
+/**
+ * CBLAS matrix multiply `C += A * B`, where `A` is `m x k` and `B` is `k x n`.
+ */
+static void dot_cblas(const real_t *A,
+                      const size_t m,
+                      const size_t k,
+                      const real_t *B,
+                      const size_t n,
+                      real_t *C) {
+#if PRECISION == 1
+  cblas_sgemm(CblasRowMajor,
+              CblasNoTrans,
+              CblasNoTrans,
+              m,
+              n,
+              k,
+              1.0,
+              A,
+              k,
+              B,
+              n,
+              1.0,
+              C,
+              n);
+#elif PRECISION == 2
+  cblas_dgemm(CblasRowMajor,
+              CblasNoTrans,
+              CblasNoTrans,
+              m,
+              n,
+              k,
+              1.0,
+              A,
+              k,
+              B,
+              n,
+              1.0,
+              C,
+              n);
+#endif
+}
+#endif
+
+/**
+ * Dot product of two matrices or vectors `A` and `B` of size `A_m x A_n` and
+ * `B_m x B_n`. Results are accumulated into `C`, see `dot_set_backend()` for
+ * how the product is computed.
+ */
+void dot(const real_t *A,
+         const size_t A_m,
+         const size_t A_n,
+         const real_t *B,
+         const size_t B_m,
+         const size_t B_n,
+         real_t *C) {
+  assert(A != NULL && B != NULL && A != C && B != C);
+  assert(A_m > 0 && A_n > 0 && B_m > 0 && B_n > 0);
+  assert(A_n == B_m);
+
+  const size_t m = A_m;
+  const size_t k = A_n;
+  const size_t n = B_n;
+
+  switch (dot_backend) {
+    case DOT_NAIVE:
+      dot_naive(A, m, k, B, n, C);
+      return;
+    case DOT_BUILTIN:
+      dot_gemm(A, m, k, B, n, C);
+      return;
+#ifdef USE_CBLAS
+    case DOT_CBLAS:
+      dot_cblas(A, m, k, B, n, C);
+      return;
+#endif
+    default:
+      break;
+  }
+
+  /* DOT_AUTO */
+  if (dot_tiny_dispatch(A, m, k, B, n, C) == 0) {
+    return;
+  }
+
+  if (m * n * k < DOT_GEMM_MIN_FLOPS) {
+    dot_naive(A, m, k, B, n, C);
+  } else {
+    dot_gemm(A, m, k, B, n, C);
+  }
+}
+
+/**
+ * Create skew-symmetric matrix `A` from a 3x1 vector `x`.
+ */
+void skew(const real_t x[3], real_t A[3 * 3]) {
+  /* First row */
+  A[0] = 0.0;
+  A[1] = -x[2];
+  A[2] = x[1];
+
+  /* Second row */
+  A[3] = x[2];
+  A[4] = 0.0;
+  A[5] = -x[0];
+
+  /* Third row */
+  A[6] = -x[1];
+  A[7] = x[0];
+  A[8] = 0.0;
+}
+
+/**
+ * Perform forward substitution with a lower triangular matrix `L`, column
+ * vector `b` and solve for vector `y` of size `n`.
+ */
+void fwdsubs(const real_t *L, const real_t *b, real_t *y, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    real_t alpha = b[i];
+    for (size_t j = 0; j < i; j++) {
+      alpha -= L[i * n + j] * y[j];
+    }
+    y[i] = alpha / L[i * n + i];
+  }
+}
+
+/**
+ * Perform backward substitution with a upper triangular matrix `U`, column
+ * vector `y` and solve for vector `x` of size `n`.
+ */
+void bwdsubs(const real_t *U, const real_t *y, real_t *x, const size_t n) {
+  for (int i = n - 1; i >= 0; i--) {
+    real_t alpha = y[i];
+    for (int j = i; j < (int) n; j++) {
+      alpha -= U[i * n + j] * x[j];
+    }
+    x[i] = alpha / U[i * n + i];
+  }
+}
+
+/**
+ * Check analytical jacobian `jac` with name `jac_name` and compare it with a
+ * numerically differentiated jacobian `fdiff` (finite diff). Where both
+ * matrices are of size `m x n`, `tol` denotes the tolerance to consider both
+ * `jac` and `fdiff` to be close enough. For debugging purposes use `verbose`
+ * to show the matrices and differences.
+ *
+ * @returns
+ * - 0 for success
+ * - -1 for failure
+ */
+int check_jacobian(const char *jac_name,
+                   const real_t *fdiff,
+                   const real_t *jac,
+                   const size_t m,
                    const size_t n,
                    const real_t tol,
                    const int verbose) {
@@ -1569,6 +2198,7 @@ int check_jacobian(const char *jac_name,
     }
     retval = 0;
   }
+  free(delta);
 
   return retval;
 }
@@ -1905,87 +2535,319 @@ int svd(real_t *A, const int m, const int n, real_t *w, real_t *V) {
  ******************************************************************************/
 
 /**
- * Cholesky decomposition. Takes a `m x m` matrix `A` and decomposes it into a
- * lower and upper triangular matrix `L` and `U` with Cholesky decomposition.
- * This function only returns the `L` triangular matrix.
+ * Factor the `m x n` panel `A` with leading dimension `lda` in place, where
+ * the top `n x n` block is the diagonal block. The diagonal block is
+ * overwritten with its Cholesky factor L (or with unit L and D on the
+ * diagonal if `ldlt` is set), and the rows below it are solved against it.
+ *
+ * @returns 0 for success or -1 if the diagonal block is not positive
+ * definite (or singular for LDLT)
  */
-void chol(const real_t *A, const size_t m, real_t *L) {
-  assert(A != NULL);
-  assert(m > 0);
-  /* real_t *L = calloc(m * m, sizeof(real_t)); */
+static int chol_panel(real_t *A,
+                      const size_t lda,
+                      const size_t m,
+                      const size_t n,
+                      const int ldlt) {
+  real_t v[CHOL_NB] = {0};
+
+  for (size_t j = 0; j < n; j++) {
+    real_t *A_j = &A[j * lda];
+
+    /* -- Diagonal */
+    real_t d = A_j[j];
+    for (size_t p = 0; p < j; p++) {
+      v[p] = (ldlt) ? A_j[p] * A[p * lda + p] : A_j[p];
+      d -= A_j[p] * v[p];
+    }
+    if (ldlt) {
+      if (fabs(d) < 1e-30) {
+        return -1;
+      }
+      A_j[j] = d;
+    } else {
+      if (d <= 0.0 || isnan(d)) {
+        return -1;
+      }
+      d = sqrt(d);
+      A_j[j] = d;
+    }
 
-  for (size_t i = 0; i < m; i++) {
-    for (size_t j = 0; j < (i + 1); j++) {
+    /* -- Column below the diagonal */
+    const real_t d_inv = 1.0 / d;
+    for (size_t i = j + 1; i < m; i++) {
+      real_t *A_i = &A[i * lda];
+      real_t s = A_i[j];
+      for (size_t p = 0; p < j; p++) {
+        s -= A_i[p] * v[p];
+      }
+      A_i[j] = s * d_inv;
+    }
+  }
 
-      if (i == j) {
-        real_t s = 0.0;
-        for (size_t k = 0; k < j; k++) {
-          s += L[j * m + k] * L[j * m + k];
-        }
-        L[i * m + j] = sqrt(A[i * m + i] - s);
+  return 0;
+}
 
-      } else {
-        real_t s = 0.0;
-        for (size_t k = 0; k < j; k++) {
-          s += L[i * m + k] * L[j * m + k];
+/**
+ * Symmetric rank-k update `C -= P * D * P(0:n)'` of the lower trapezoid of
+ * the `m x n` matrix `C` with leading dimension `ldc`, where `P` is `m x k`
+ * with leading dimension `ldp` and `D` is the diagonal of the `k x k` matrix
+ * `LD` with leading dimension `ldd`, or identity if `LD` is NULL. Tiles
+ * crossing the diagonal also write to the strict upper triangle of `C`.
+ *
+ * `P` is packed CHOL_NB columns at a time into `work`, which must hold
+ * `2 * (m + DOT_NR) * CHOL_NB` elements, and then multiplied with the GEMM
+ * micro-kernel.
+ */
+static void chol_update(const real_t *P,
+                        const size_t ldp,
+                        const size_t m,
+                        const size_t n,
+                        const size_t k,
+                        const real_t *LD,
+                        const size_t ldd,
+                        real_t *C,
+                        const size_t ldc,
+                        real_t *work) {
+  real_t *A_packed = work;
+  real_t *B_packed = &work[(m + DOT_NR) * CHOL_NB];
+
+  for (size_t pc = 0; pc < k; pc += CHOL_NB) {
+    const size_t kc = (k - pc < CHOL_NB) ? k - pc : CHOL_NB;
+
+    /* -- Pack -P * D in DOT_MR row panels and P' in DOT_NR column panels */
+    real_t *a = A_packed;
+    for (size_t ir = 0; ir < m; ir += DOT_MR) {
+      for (size_t p = 0; p < kc; p++) {
+        const real_t d = (LD) ? LD[(pc + p) * ldd + (pc + p)] : 1.0;
+        for (size_t i = 0; i < DOT_MR; i++) {
+          *a++ = (ir + i < m) ? -P[(ir + i) * ldp + pc + p] * d : 0.0;
+        }
+      }
+    }
+    real_t *b = B_packed;
+    for (size_t jr = 0; jr < n; jr += DOT_NR) {
+      for (size_t p = 0; p < kc; p++) {
+        for (size_t j = 0; j < DOT_NR; j++) {
+          *b++ = (jr + j < n) ? P[(jr + j) * ldp + pc + p] : 0.0;
         }
-        L[i * m + j] = (1.0 / L[j * m + j] * (A[i * m + j] - s));
+      }
+    }
+
+    /* -- Lower trapezoid tiles of C */
+    for (size_t ir = 0; ir < m; ir += DOT_MR) {
+      const size_t mr = (m - ir < DOT_MR) ? m - ir : DOT_MR;
+      const size_t je = (ir + mr < n) ? ir + mr : n;
+      for (size_t jr = 0; jr < je; jr += DOT_NR) {
+        const size_t nr = (n - jr < DOT_NR) ? n - jr : DOT_NR;
+        dot_kernel(kc,
+                   &A_packed[ir * kc],
+                   &B_packed[jr * kc],
+                   &C[ir * ldc + jr],
+                   ldc,
+                   mr,
+                   nr);
       }
     }
   }
 }
 
 /**
- * Solve `Ax = b` using Cholesky decomposition, where `A` is a square matrix,
- * `b` is a vector and `x` is the solution vector of size `n`.
+ * Blocked right-looking Cholesky or LDLT factorization of the `m x n` panel
+ * `A` with leading dimension `lda` in place, where `m >= n`. The top `n x n`
+ * block is factored and the rows below it are solved against the factor.
  */
-void chol_solve(const real_t *A, const real_t *b, real_t *x, const size_t n) {
-  /* Allocate memory */
-  real_t *L = calloc(n * n, sizeof(real_t));
-  real_t *Lt = calloc(n * n, sizeof(real_t));
-  real_t *y = calloc(n, sizeof(real_t));
-
-  /* Cholesky decomposition */
-  chol(A, n, L);
-  mat_transpose(L, n, n, Lt);
-
-  /* Forward substitution */
-  /* Ax = b -> LLt x = b. */
-  /* Let y = Lt x, L y = b (Solve for y) */
-  for (int i = 0; i < (int) n; i++) {
-    real_t alpha = b[i];
+static int chol_blocked(real_t *A,
+                        const size_t lda,
+                        const size_t m,
+                        const size_t n,
+                        real_t *work,
+                        const int ldlt) {
+  for (size_t k = 0; k < n; k += CHOL_NB) {
+    const size_t nb = (n - k < CHOL_NB) ? n - k : CHOL_NB;
+    real_t *A_kk = &A[k * lda + k];
+
+    /* Factor the panel, then update the trailing matrix */
+    if (chol_panel(A_kk, lda, m - k, nb, ldlt) != 0) {
+      return -1;
+    }
+    if (k + nb < n) {
+      real_t *P = &A[(k + nb) * lda + k];
+      real_t *A_22 = &A[(k + nb) * lda + (k + nb)];
+      chol_update(P,
+                  lda,
+                  m - k - nb,
+                  n - k - nb,
+                  nb,
+                  (ldlt) ? A_kk : NULL,
+                  lda,
+                  A_22,
+                  lda,
+                  work);
+    }
+  }
+
+  /* Zero the strict upper triangle */
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = i + 1; j < n; j++) {
+      A[i * lda + j] = 0.0;
+    }
+  }
 
-    if (fltcmp(L[i * n + i], 0.0) == 0) {
-      y[i] = 0.0;
+  return 0;
+}
 
-    } else {
-      for (int j = 0; j < i; j++) {
-        alpha -= L[i * n + j] * y[j];
-      }
-      y[i] = alpha / L[i * n + i];
+/**
+ * @returns Number of elements of workspace needed by `chol_factor()` and
+ * `ldlt_factor()` for a `n x n` matrix.
+ */
+size_t chol_work_size(const size_t n) {
+  return 2 * (n + DOT_NR) * CHOL_NB;
+}
+
+/**
+ * Cholesky factorization of the `n x n` symmetric positive definite matrix
+ * `A` in place, only the lower triangle of `A` is read and on return `A`
+ * holds the lower triangular `L` where `A = L * L'`. The factorization is
+ * blocked, with the trailing matrix updated by the GEMM micro-kernel using
+ * `work` of `chol_work_size(n)` elements.
+ *
+ * @returns 0 for success or -1 if `A` is not positive definite
+ */
+int chol_factor(real_t *A, const size_t n, real_t *work) {
+  assert(A != NULL);
+  assert(n > 0);
+  assert(work != NULL || n <= CHOL_NB);
+  return chol_blocked(A, n, n, n, work, 0);
+}
+
+/**
+ * LDLT factorization of the `n x n` symmetric matrix `A` in place, only the
+ * lower triangle of `A` is read and on return the strict lower triangle of
+ * `A` holds the unit lower triangular `L` and the diagonal holds `D`, where
+ * `A = L * D * L'`. See `chol_factor()` for `work`.
+ *
+ * @returns 0 for success or -1 if `A` is singular
+ */
+int ldlt_factor(real_t *A, const size_t n, real_t *work) {
+  assert(A != NULL);
+  assert(n > 0);
+  assert(work != NULL || n <= CHOL_NB);
+  return chol_blocked(A, n, n, n, work, 1);
+}
+
+/**
+ * Solve `L * L' x = b` for `x`, where `L` is the `n x n` Cholesky factor
+ * from `chol_factor()`. `x` and `b` may be the same vector.
+ */
+void chol_factor_solve(const real_t *L,
+                       const size_t n,
+                       const real_t *b,
+                       real_t *x) {
+  assert(L != NULL && b != NULL && x != NULL);
+
+  /* Forward substitution L y = b */
+  for (size_t i = 0; i < n; i++) {
+    const real_t *L_i = &L[i * n];
+    real_t s = b[i];
+    for (size_t j = 0; j < i; j++) {
+      s -= L_i[j] * x[j];
     }
+    x[i] = s / L_i[i];
   }
 
-  /* Backward substitution */
-  /* Now we have y, we can go back to (Lt x = y) and solve for x */
-  for (int i = n - 1; i >= 0; i--) {
-    real_t alpha = y[i];
+  /* Backward substitution L' x = y, a row of L at a time */
+  for (size_t i = n; i-- > 0;) {
+    const real_t *L_i = &L[i * n];
+    x[i] /= L_i[i];
+    for (size_t j = 0; j < i; j++) {
+      x[j] -= L_i[j] * x[i];
+    }
+  }
+}
 
-    if (fltcmp(Lt[i * n + i], 0.0) == 0) {
-      x[i] = 0.0;
+/**
+ * Solve `L * D * L' x = b` for `x`, where `L` and `D` are the `n x n` LDLT
+ * factors from `ldlt_factor()`. `x` and `b` may be the same vector.
+ */
+void ldlt_factor_solve(const real_t *LD,
+                       const size_t n,
+                       const real_t *b,
+                       real_t *x) {
+  assert(LD != NULL && b != NULL && x != NULL);
 
-    } else {
-      for (int j = i; j < (int) n; j++) {
-        alpha -= Lt[i * n + j] * x[j];
-      }
-      x[i] = alpha / Lt[i * n + i];
+  /* Forward substitution L z = b */
+  for (size_t i = 0; i < n; i++) {
+    const real_t *L_i = &LD[i * n];
+    real_t s = b[i];
+    for (size_t j = 0; j < i; j++) {
+      s -= L_i[j] * x[j];
+    }
+    x[i] = s;
+  }
+
+  /* D y = z */
+  for (size_t i = 0; i < n; i++) {
+    x[i] /= LD[i * n + i];
+  }
+
+  /* Backward substitution L' x = y, a row of L at a time */
+  for (size_t i = n; i-- > 0;) {
+    const real_t *L_i = &LD[i * n];
+    for (size_t j = 0; j < i; j++) {
+      x[j] -= L_i[j] * x[i];
+    }
+  }
+}
+
+/**
+ * Cholesky decomposition. Takes a `m x m` matrix `A` and decomposes it into a
+ * lower and upper triangular matrix `L` and `U` with Cholesky decomposition.
+ * This function only returns the `L` triangular matrix. If `A` is not
+ * positive definite `L` is set to NaN.
+ *
+ * @returns 0 for success or -1 if `A` is not positive definite
+ */
+int chol(const real_t *A, const size_t m, real_t *L) {
+  assert(A != NULL);
+  assert(m > 0);
+
+  real_t *work = NULL;
+  if (m > CHOL_NB) {
+    work = malloc(sizeof(real_t) * chol_work_size(m));
+  }
+  mat_copy(A, m, m, L);
+  const int retval = chol_factor(L, m, work);
+  if (retval != 0) {
+    for (size_t i = 0; i < m * m; i++) {
+      L[i] = NAN;
+    }
+  }
+  free(work);
+
+  return retval;
+}
+
+/**
+ * Solve `Ax = b` using Cholesky decomposition, where `A` is a square matrix,
+ * `b` is a vector and `x` is the solution vector of size `n`. If `A` is not
+ * positive definite `x` is set to NaN.
+ */
+void chol_solve(const real_t *A, const real_t *b, real_t *x, const size_t n) {
+  /* Allocate memory */
+  real_t *L = malloc(sizeof(real_t) * (n * n + chol_work_size(n)));
+  mat_copy(A, n, n, L);
+
+  /* Cholesky decomposition, then forward and backward substitution */
+  if (chol_factor(L, n, &L[n * n]) == 0) {
+    chol_factor_solve(L, n, b, x);
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      x[i] = NAN;
     }
   }
 
   /* Clean up */
-  free(y);
   free(L);
-  free(Lt);
 }
 
 #ifdef USE_LAPACK
@@ -2224,7 +3086,7 @@ void tf_inv(const real_t T[4 * 4], real_t T_inv[4 * 4]) {
   /* Set translation component */
   real_t r_inv[3] = {0};
   mat_scale(C_inv, 3, 3, -1.0);
-  dot(C_inv, 3, 3, r, 3, 1, r_inv);
+  dot_3x3_3x1(C_inv, r, r_inv);
   tf_trans_set(T_inv, r_inv);
 
   /* Make sure the last element is 1 */
@@ -2243,7 +3105,7 @@ void tf_point(const real_t T[4 * 4], const real_t p[3], real_t retval[3]) {
 
   const real_t hp_a[4] = {p[0], p[1], p[2], 1.0};
   real_t hp_b[4] = {0.0, 0.0, 0.0, 0.0};
-  dot(T, 4, 4, hp_a, 4, 1, hp_b);
+  dot_4x4_4x1(T, hp_a, hp_b);
 
   retval[0] = hp_b[0];
   retval[1] = hp_b[1];
@@ -2257,7 +3119,7 @@ void tf_point(const real_t T[4 * 4], const real_t p[3], real_t retval[3]) {
 void tf_hpoint(const real_t T[4 * 4], const real_t hp[4], real_t retval[4]) {
   assert(T != NULL);
   assert(hp != retval);
-  dot(T, 4, 4, hp, 4, 1, retval);
+  dot_4x4_4x1(T, hp, retval);
 }
 
 /**
@@ -2280,7 +3142,7 @@ void tf_perturb_rot(real_t T[4 * 4], const real_t step_size, const int i) {
   real_t C_rvec[3 * 3] = {0};
   real_t C_diff[3 * 3] = {0};
   rvec2rot(drvec, 1e-8, C_rvec);
-  dot(C_rvec, 3, 3, C, 3, 3, C_diff);
+  dot_3x3_3x3(C_rvec, C, C_diff);
   tf_rot_set(T, C_diff);
 }
 
@@ -2529,7 +3391,7 @@ void quat_lmul(const real_t p[4], const real_t q[4], real_t r[4]) {
   };
   /* clang-format on */
 
-  cblas_dot(lprod, 4, 4, q, 4, 1, r);
+  dot_4x4_4x1(lprod, q, r);
 }
 
 /**
@@ -2553,7 +3415,7 @@ void quat_rmul(const real_t p[4], const real_t q[4], real_t r[4]) {
   };
   /* clang-format on */
 
-  dot(rprod, 4, 4, p, 4, 1, r);
+  dot_4x4_4x1(rprod, p, r);
 }
 
 /**
@@ -2585,7 +3447,7 @@ void quat_delta(const real_t dalpha[3], real_t dq[4]) {
  *****************************************************************************/
 
 /**
- * Setup image `img` with `width`, `height` and `data`.
+ * Setup single channel image `img` with `width`, `height` and `data`.
  */
 void image_setup(image_t *img,
                  const int width,
@@ -2594,7 +3456,10 @@ void image_setup(image_t *img,
   assert(img != NULL);
   img->width = width;
   img->height = height;
+  img->channels = 1;
+  img->stride = width;
   img->data = data;
+  img->buf = NULL;
 }
 
 /**
@@ -2617,7 +3482,9 @@ image_t *image_load(const char *file_path) {
   img->width = img_w;
   img->height = img_h;
   img->channels = img_c;
+  img->stride = img_w * img_c;
   img->data = data;
+  img->buf = NULL;
   return img;
 }
 
@@ -2635,1329 +3502,6286 @@ void image_print_properties(const image_t *img) {
  * Free image.
  */
 void image_free(image_t *img) {
-  free(img->data);
+  if (img->buf) {
+    image_release(img);
+  } else {
+    free(img->data);
+  }
   free(img);
 }
 
-/* RADTAN --------------------------------------------------------------------*/
+/**
+ * Setup image buffer pool.
+ */
+void image_pool_setup(image_pool_t *pool) {
+  assert(pool != NULL);
+  pthread_mutex_init(&pool->lock, NULL);
+  pool->free_list = NULL;
+  pool->nb_bufs = 0;
+  pool->nb_free = 0;
+}
 
 /**
- * Distort 2x1 point `p` using Radial-Tangential distortion, where the
- * distortion params are stored in `params` (k1, k2, p1, p2), results are
- * written to 2x1 vector `p_d`.
+ * Free image buffer pool, all pooled images must have been released.
  */
-void radtan4_distort(const real_t params[4], const real_t p[2], real_t p_d[2]) {
-  assert(params != NULL);
-  assert(p != NULL);
-  assert(p_d != NULL);
-
-  /* Distortion parameters */
-  const real_t k1 = params[0];
-  const real_t k2 = params[1];
-  const real_t p1 = params[2];
-  const real_t p2 = params[3];
-
-  /* Point */
-  const real_t x = p[0];
-  const real_t y = p[1];
+void image_pool_free(image_pool_t *pool) {
+  assert(pool != NULL);
+  if (pool->nb_free != pool->nb_bufs) {
+    LOG_ERROR("Freeing image pool with %d buffers in use!",
+              pool->nb_bufs - pool->nb_free);
+  }
 
-  /* Apply radial distortion */
-  const real_t x2 = x * x;
-  const real_t y2 = y * y;
-  const real_t r2 = x2 + y2;
-  const real_t r4 = r2 * r2;
-  const real_t radial_factor = 1.0 + (k1 * r2) + (k2 * r4);
-  const real_t x_dash = x * radial_factor;
-  const real_t y_dash = y * radial_factor;
+  image_buf_t *buf = pool->free_list;
+  while (buf) {
+    image_buf_t *next = buf->next;
+    free(buf);
+    buf = next;
+  }
+  pool->free_list = NULL;
+  pool->nb_bufs = 0;
+  pool->nb_free = 0;
+  pthread_mutex_destroy(&pool->lock);
+}
 
-  /* Apply tangential distortion */
-  const real_t xy = x * y;
-  const real_t x_ddash = x_dash + (2.0 * p1 * xy + p2 * (r2 + 2.0 * x2));
-  const real_t y_ddash = y_dash + (p1 * (r2 + 2.0 * y2) + 2.0 * p2 * xy);
+/* Pixels follow the buffer header in the same allocation, 16 byte aligned */
+#define IMAGE_BUF_OFFSET ((sizeof(image_buf_t) + 15) & ~(size_t) 15)
 
-  /* Distorted point */
-  p_d[0] = x_ddash;
-  p_d[1] = y_ddash;
+/**
+ * Image buffer header of pooled pixel buffer `data`.
+ */
+static image_buf_t *image_buf_header(void *data) {
+  return (image_buf_t *) ((uint8_t *) data - IMAGE_BUF_OFFSET);
 }
 
 /**
- * Form Radial-Tangential point jacobian, using distortion `params` (k1, k2,
- * p1, p2), 2x1 image point `p`, the jacobian is written to 2x2 `J_point`.
+ * Get a buffer of at least `size` bytes from `pool`. The smallest free
+ * buffer large enough is reused, otherwise a new buffer is allocated.
+ * @returns Buffer or NULL for failure
  */
-void radtan4_point_jacobian(const real_t params[4],
-                            const real_t p[2],
-                            real_t J_point[2 * 2]) {
-  assert(params != NULL);
-  assert(p != NULL);
-  assert(J_point != NULL);
-
-  /* Distortion parameters */
-  const real_t k1 = params[0];
-  const real_t k2 = params[1];
-  const real_t p1 = params[2];
-  const real_t p2 = params[3];
-
-  /* Point */
-  const real_t x = p[0];
-  const real_t y = p[1];
+static image_buf_t *image_buf_get(image_pool_t *pool, const size_t size) {
+  /* -- Reuse free buffer */
+  pthread_mutex_lock(&pool->lock);
+  image_buf_t **best = NULL;
+  for (image_buf_t **link = &pool->free_list; *link; link = &(*link)->next) {
+    const size_t buf_size = (*link)->size;
+    if (buf_size >= size && (best == NULL || buf_size < (*best)->size)) {
+      best = link;
+    }
+  }
+  image_buf_t *buf = NULL;
+  if (best) {
+    buf = *best;
+    *best = buf->next;
+    pool->nb_free--;
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  /* -- Allocate new buffer */
+  if (buf == NULL) {
+    buf = malloc(IMAGE_BUF_OFFSET + size);
+    if (buf == NULL) {
+      LOG_ERROR("Failed to allocate %zu byte image buffer!", size);
+      return NULL;
+    }
+    buf->data = (uint8_t *) buf + IMAGE_BUF_OFFSET;
+    buf->size = size;
+    buf->pool = pool;
 
-  /* Apply radial distortion */
-  const real_t x2 = x * x;
-  const real_t y2 = y * y;
-  const real_t r2 = x2 + y2;
-  const real_t r4 = r2 * r2;
+    pthread_mutex_lock(&pool->lock);
+    pool->nb_bufs++;
+    pthread_mutex_unlock(&pool->lock);
+  }
+  buf->ref_count = 1;
+  buf->next = NULL;
 
-  /* Point Jacobian is 2x2 */
-  J_point[0] = k1 * r2 + k2 * r4 + 2 * p1 * y + 6 * p2 * x;
-  J_point[0] += x * (2 * k1 * x + 4 * k2 * x * r2) + 1;
-  J_point[1] = 2 * p1 * x + 2 * p2 * y + y * (2 * k1 * x + 4 * k2 * x * r2);
-  J_point[2] = J_point[1];
-  J_point[3] = k1 * r2 + k2 * r4 + 6 * p1 * y + 2 * p2 * x;
-  J_point[3] += y * (2 * k1 * y + 4 * k2 * y * r2) + 1;
+  return buf;
 }
 
 /**
- * Form Radial-Tangential parameter jacobian, using distortion `params` (k1,
- * k2, p1, p2), 2x1 image point `p`, the jacobian is written to 2x4 `J_param`.
+ * Return buffer `buf` to its pool.
  */
-void radtan4_params_jacobian(const real_t params[4],
-                             const real_t p[2],
-                             real_t J_param[2 * 4]) {
-  assert(params != NULL);
-  assert(p != NULL);
-  assert(J_param != NULL);
-  UNUSED(params);
-
-  /* Point */
-  const real_t x = p[0];
-  const real_t y = p[1];
+static void image_buf_put(image_buf_t *buf) {
+  image_pool_t *pool = buf->pool;
+  pthread_mutex_lock(&pool->lock);
+  buf->next = pool->free_list;
+  pool->free_list = buf;
+  pool->nb_free++;
+  pthread_mutex_unlock(&pool->lock);
+}
 
-  /* Setup */
-  const real_t x2 = x * x;
-  const real_t y2 = y * y;
-  const real_t xy = x * y;
-  const real_t r2 = x2 + y2;
-  const real_t r4 = r2 * r2;
+/**
+ * Allocate a `width` x `height` image with `channels` from `pool`.
+ * @returns 0 for success or -1 for failure
+ */
+int image_pool_alloc(image_pool_t *pool,
+                     const int width,
+                     const int height,
+                     const int channels,
+                     image_t *img) {
+  assert(pool != NULL);
+  assert(img != NULL);
 
-  /* Param Jacobian is 2x4 */
-  J_param[0] = x * r2;
-  J_param[1] = x * r4;
-  J_param[2] = 2 * xy;
-  J_param[3] = 3 * x2 + y2;
+  const size_t size = (size_t) width * height * channels;
+  image_buf_t *buf = image_buf_get(pool, size);
+  if (buf == NULL) {
+    return -1;
+  }
 
-  J_param[4] = y * r2;
-  J_param[5] = y * r4;
-  J_param[6] = x2 + 3 * y2;
-  J_param[7] = 2 * xy;
+  img->width = width;
+  img->height = height;
+  img->channels = channels;
+  img->stride = width * channels;
+  img->data = buf->data;
+  img->buf = buf;
+  return 0;
 }
 
-/* EQUI ----------------------------------------------------------------------*/
+/* Pool stb_image allocations are routed to, only set during a pooled load */
+static __thread image_pool_t *image_stbi_pool = NULL;
 
 /**
- * Distort 2x1 point `p` using Equi-Distant distortion, where the
- * distortion params are stored in `params` (k1, k2, k3, k4), results are
- * written to 2x1 vector `p_d`.
+ * stb_image malloc hook, allocates from the pool of the pooled load in
+ * progress on this thread, else from the heap.
  */
-void equi4_distort(const real_t params[4], const real_t p[2], real_t p_d[2]) {
-  assert(params != NULL);
-  assert(p != NULL);
-  assert(p_d != NULL);
-
-  const real_t k1 = params[0];
-  const real_t k2 = params[1];
-  const real_t k3 = params[2];
-  const real_t k4 = params[3];
-
-  const real_t x = p[0];
-  const real_t y = p[1];
-  const real_t r = sqrt(x * x + y * y);
-
-  const real_t th = atan(r);
-  const real_t th2 = th * th;
-  const real_t th4 = th2 * th2;
-  const real_t th6 = th4 * th2;
-  const real_t th8 = th4 * th4;
-  const real_t thd = th * (1.0 + k1 * th2 + k2 * th4 + k3 * th6 + k4 * th8);
-  const real_t s = thd / r;
+void *image_stbi_malloc(const size_t size) {
+  if (image_stbi_pool == NULL) {
+    return malloc(size);
+  }
 
-  p_d[0] = s * x;
-  p_d[1] = s * y;
+  image_buf_t *buf = image_buf_get(image_stbi_pool, size);
+  return (buf) ? buf->data : NULL;
 }
 
 /**
- * Form Equi-Distant point jacobian, using distortion `params` (k1, k2, k3,
- * k4), 2x1 image point `p`, the jacobian is written to 2x2 `J_point`.
+ * stb_image realloc hook, see `image_stbi_malloc()`.
  */
-void equi4_point_jacobian(const real_t params[4],
-                          const real_t p[2],
-                          real_t J_point[2 * 2]) {
-  assert(params != NULL);
-  assert(p != NULL);
-  assert(J_point != NULL);
-
-  const real_t k1 = params[0];
-  const real_t k2 = params[1];
-  const real_t k3 = params[2];
-  const real_t k4 = params[3];
-
-  const real_t x = p[0];
-  const real_t y = p[1];
-  const real_t r = sqrt(x * x + y * y);
-
-  const real_t th = atan(r);
-  const real_t th2 = th * th;
-  const real_t th4 = th2 * th2;
-  const real_t th6 = th4 * th2;
-  const real_t th8 = th4 * th4;
-  const real_t thd = th * (1.0 + k1 * th2 + k2 * th4 + k3 * th6 + k4 * th8);
+void *image_stbi_realloc(void *ptr, const size_t size) {
+  if (image_stbi_pool == NULL) {
+    return realloc(ptr, size);
+  }
+  if (ptr == NULL) {
+    return image_stbi_malloc(size);
+  }
 
-  const real_t th_r = 1.0 / (r * r + 1.0);
-  const real_t thd_th =
-      1.0 + 3.0 * k1 * th2 + 5.0 * k2 * th4 + 7.0 * k3 * th6 + 9.0 * k4 * th8;
-  const real_t s = thd / r;
-  const real_t s_r = thd_th * th_r / r - thd / (r * r);
-  const real_t r_x = 1.0 / r * x;
-  const real_t r_y = 1.0 / r * y;
+  image_buf_t *buf = image_buf_header(ptr);
+  if (buf->size >= size) {
+    return ptr;
+  }
+  void *data = image_stbi_malloc(size);
+  if (data == NULL) {
+    return NULL;
+  }
+  memcpy(data, ptr, buf->size);
+  image_buf_put(buf);
 
-  /* Point Jacobian is 2x2 */
-  J_point[0] = s + x * s_r * r_x;
-  J_point[1] = x * s_r * r_y;
-  J_point[2] = y * s_r * r_x;
-  J_point[3] = s + y * s_r * r_y;
+  return data;
 }
 
 /**
- * Form Equi-Distant parameter jacobian, using distortion `params` (k1, k2, k3,
- * k4), 2x1 image point `p`, the jacobian is written to 2x4 `J_param`.
+ * stb_image free hook, see `image_stbi_malloc()`.
  */
-void equi4_params_jacobian(const real_t params[4],
-                           const real_t p[2],
-                           real_t J_param[2 * 4]) {
-  assert(params != NULL);
-  assert(p != NULL);
-  assert(J_param != NULL);
-  UNUSED(params);
-
-  const real_t x = p[0];
-  const real_t y = p[1];
-  const real_t r = sqrt(x * x + y * y);
+void image_stbi_free(void *ptr) {
+  if (image_stbi_pool == NULL) {
+    free(ptr);
+    return;
+  }
+  if (ptr) {
+    image_buf_put(image_buf_header(ptr));
+  }
+}
 
-  const real_t th = atan(r);
-  const real_t th2 = th * th;
-  const real_t th3 = th2 * th;
-  const real_t th5 = th3 * th2;
-  const real_t th7 = th5 * th2;
-  const real_t th9 = th7 * th2;
+/**
+ * Load image at `file_path` into a buffer from `pool`. The image is decoded
+ * straight into the pooled buffer, and stb_image's scratch buffers also come
+ * from `pool`, so a steady stream of frames stops allocating once warmed up.
+ * @returns 0 for success or -1 for failure
+ */
+int image_pool_load(image_pool_t *pool, const char *file_path, image_t *img) {
+  assert(pool != NULL);
+  assert(file_path != NULL);
+  assert(img != NULL);
 
-  /* Param Jacobian is 2x4 */
-  J_param[0] = x * th3 / r;
-  J_param[1] = x * th5 / r;
-  J_param[2] = x * th7 / r;
-  J_param[3] = x * th9 / r;
+  int img_w = 0;
+  int img_h = 0;
+  int img_c = 0;
+  stbi_set_flip_vertically_on_load_thread(1);
+  image_stbi_pool = pool;
+  uint8_t *data = stbi_load(file_path, &img_w, &img_h, &img_c, 0);
+  image_stbi_pool = NULL;
+  if (data == NULL) {
+    LOG_ERROR("Failed to load image file: [%s]", file_path);
+    return -1;
+  }
 
-  J_param[4] = y * th3 / r;
-  J_param[5] = y * th5 / r;
-  J_param[6] = y * th7 / r;
-  J_param[7] = y * th9 / r;
+  img->width = img_w;
+  img->height = img_h;
+  img->channels = img_c;
+  img->stride = img_w * img_c;
+  img->data = data;
+  img->buf = image_buf_header(data);
+  return 0;
 }
 
-/* PINHOLE -------------------------------------------------------------------*/
-
 /**
- * Estimate pinhole focal length. The focal length is estimated using
- * `image_width` [pixels], and `fov` (Field of view of the camera) [rad].
+ * Add a reference to the pixel buffer of pooled image `img`.
  */
-real_t pinhole_focal(const int image_width, const real_t fov) {
-  return ((image_width / 2.0) / tan(deg2rad(fov) / 2.0));
+void image_retain(const image_t *img) {
+  assert(img != NULL && img->buf != NULL);
+  __atomic_add_fetch(&img->buf->ref_count, 1, __ATOMIC_RELAXED);
 }
 
 /**
- * Project 3D point `p_C` observed from the camera to the image plane `x` using
- * pinhole parameters `params` (fx, fy, cx, cy).
+ * Release the reference of `img` to its pixel buffer, the buffer is returned
+ * to its pool once the last reference is released.
  */
-void pinhole_project(const real_t params[4], const real_t p_C[3], real_t x[2]) {
-  assert(params != NULL);
-  assert(p_C != NULL);
-  assert(x != NULL);
+void image_release(image_t *img) {
+  assert(img != NULL);
+  image_buf_t *buf = img->buf;
+  img->data = NULL;
+  img->buf = NULL;
+  if (buf == NULL) {
+    return;
+  }
+  if (__atomic_sub_fetch(&buf->ref_count, 1, __ATOMIC_ACQ_REL) > 0) {
+    return;
+  }
+  image_buf_put(buf);
+}
 
-  const real_t fx = params[0];
-  const real_t fy = params[1];
-  const real_t cx = params[2];
-  const real_t cy = params[3];
+/**
+ * Create a `width` x `height` view of `src` with its top left corner at
+ * (`x`, `y`). No pixels are copied, the view shares and references the
+ * pixel buffer of `src` if it has one.
+ * @returns 0 for success or -1 if the view is out of bounds
+ */
+int image_view(const image_t *src,
+               const int x,
+               const int y,
+               const int width,
+               const int height,
+               image_t *view) {
+  assert(src != NULL);
+  assert(view != NULL);
+  if (x < 0 || y < 0 || width < 0 || height < 0 ||
+      x + width > src->width || y + height > src->height) {
+    LOG_ERROR("Image view out of bounds!");
+    return -1;
+  }
 
-  const real_t px = p_C[0] / p_C[2];
-  const real_t py = p_C[1] / p_C[2];
+  view->width = width;
+  view->height = height;
+  view->channels = src->channels;
+  view->stride = src->stride;
+  view->data = src->data + y * src->stride + x * src->channels;
+  view->buf = src->buf;
+  if (view->buf) {
+    image_retain(view);
+  }
 
-  x[0] = px * fx + cx;
-  x[1] = py * fy + cy;
+  return 0;
 }
 
 /**
- * Form Pinhole point jacobian `J` using pinhole parameters `params`.
+ * Image prefetch worker, claims the next frame whose slot is free, decodes it
+ * into a pooled buffer outside the lock and marks the slot ready.
  */
-void pinhole_point_jacobian(const real_t params[4], real_t J[2 * 3]) {
-  J[0] = params[0];
-  J[1] = 0.0;
-  J[2] = 0.0;
-  J[3] = params[1];
+static void *image_prefetch_worker(void *arg) {
+  image_prefetch_t *pf = (image_prefetch_t *) arg;
+
+  pthread_mutex_lock(&pf->lock);
+  while (1) {
+    /* -- Wait for a frame to load and a free slot to load it into */
+    const int k = pf->next_load;
+    const int slot = k % pf->nb_slots;
+    if (pf->stop || k >= pf->nb_paths) {
+      break;
+    }
+    if (pf->slot_state[slot] != PREFETCH_FREE) {
+      pthread_cond_wait(&pf->released, &pf->lock);
+      continue;
+    }
+    pf->slot_state[slot] = PREFETCH_LOADING;
+    pf->next_load++;
+    pthread_mutex_unlock(&pf->lock);
+
+    /* -- Decode image */
+    image_t img;
+    const int retval = image_pool_load(&pf->pool, pf->paths[k], &img);
+
+    /* -- Fill slot */
+    pthread_mutex_lock(&pf->lock);
+    if (retval == 0) {
+      pf->slots[slot] = img;
+      pf->slot_state[slot] = PREFETCH_READY;
+    } else {
+      pf->slot_state[slot] = PREFETCH_FAILED;
+    }
+    pthread_cond_broadcast(&pf->loaded);
+  }
+  pthread_mutex_unlock(&pf->lock);
+
+  return NULL;
 }
 
 /**
- * Form Pinhole parameter jacobian `J` using pinhole parameters `params` and
- * 2x1 image point `x`.
+ * Setup image prefetcher `pf` to load the `nb_paths` images at `paths` in
+ * order, with up to `nb_ahead` images decoded ahead of the consumer by
+ * `nb_threads` worker threads. `paths` must outlive the prefetcher.
+ * @returns 0 for success or -1 for failure
  */
-void pinhole_params_jacobian(const real_t params[4],
-                             const real_t x[2],
-                             real_t J[2 * 4]) {
-  assert(params != NULL);
-  assert(x != NULL);
-  assert(J != NULL);
-  UNUSED(params);
-
-  J[0] = x[0];
-  J[1] = 0.0;
-  J[2] = 1.0;
-  J[3] = 0.0;
+int image_prefetch_setup(image_prefetch_t *pf,
+                         const char **paths,
+                         const int nb_paths,
+                         const int nb_ahead,
+                         const int nb_threads) {
+  assert(pf != NULL);
+  assert(paths != NULL);
+  assert(nb_ahead > 0);
+  assert(nb_threads > 0);
+
+  pf->paths = paths;
+  pf->nb_paths = nb_paths;
+  image_pool_setup(&pf->pool);
+  pf->nb_slots = nb_ahead;
+  pf->slots = calloc(pf->nb_slots, sizeof(image_t));
+  pf->slot_state = calloc(pf->nb_slots, sizeof(int));
+  pf->next_load = 0;
+  pf->next_read = 0;
+  pf->stop = 0;
+  pthread_mutex_init(&pf->lock, NULL);
+  pthread_cond_init(&pf->loaded, NULL);
+  pthread_cond_init(&pf->released, NULL);
+
+  pf->threads = calloc(nb_threads, sizeof(pthread_t));
+  pf->nb_threads = 0;
+  for (int i = 0; i < nb_threads; i++) {
+    if (pthread_create(&pf->threads[i], NULL, image_prefetch_worker, pf)) {
+      LOG_ERROR("Failed to create image prefetch thread!");
+      image_prefetch_free(pf);
+      return -1;
+    }
+    pf->nb_threads++;
+  }
 
-  J[4] = 0.0;
-  J[5] = x[1];
-  J[6] = 0.0;
-  J[7] = 1.0;
+  return 0;
 }
 
-/* PINHOLE-RADTAN4 -----------------------------------------------------------*/
+/**
+ * Stop the worker threads and free image prefetcher `pf`. All images handed
+ * out by `image_prefetch_next()` must have been released.
+ */
+void image_prefetch_free(image_prefetch_t *pf) {
+  assert(pf != NULL);
+
+  pthread_mutex_lock(&pf->lock);
+  pf->stop = 1;
+  pthread_cond_broadcast(&pf->released);
+  pthread_mutex_unlock(&pf->lock);
+  for (int i = 0; i < pf->nb_threads; i++) {
+    pthread_join(pf->threads[i], NULL);
+  }
+
+  for (int i = 0; i < pf->nb_slots; i++) {
+    if (pf->slot_state[i] == PREFETCH_READY) {
+      image_release(&pf->slots[i]);
+    }
+  }
+  image_pool_free(&pf->pool);
+  free(pf->slots);
+  free(pf->slot_state);
+  free(pf->threads);
+  pthread_mutex_destroy(&pf->lock);
+  pthread_cond_destroy(&pf->loaded);
+  pthread_cond_destroy(&pf->released);
+}
 
 /**
- * Projection of 3D point to image plane using Pinhole + Radial-Tangential.
+ * Get the next image from prefetcher `pf`, blocking until it is decoded. The
+ * caller holds a reference to the pooled image `img` and releases it with
+ * `image_release()`, so a frame can be kept past the next call. Its buffer
+ * is recycled for a later frame once released.
  *
- * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, p1, p2)
- * @param[in] p_C 3x1 Point vector observed in camera frame
- * @param[out] x 2x1 Projected image point
+ * @returns
+ * - PREFETCH_OK with `img` set to the next image
+ * - PREFETCH_END at the end of the images
+ * - PREFETCH_ERROR if the image failed to load, the next call moves on to
+ *   the following image
  */
-void pinhole_radtan4_project(const real_t params[8],
-                             const real_t p_C[3],
-                             real_t x[2]) {
-  assert(params != NULL);
-  assert(p_C != NULL);
-  assert(x != NULL);
+int image_prefetch_next(image_prefetch_t *pf, image_t *img) {
+  assert(pf != NULL);
+  assert(img != NULL);
+  memset(img, 0, sizeof(image_t));
 
-  /* Project */
-  const real_t p[2] = {p_C[0] / p_C[2], p_C[1] / p_C[2]};
+  pthread_mutex_lock(&pf->lock);
+  if (pf->next_read >= pf->nb_paths) {
+    pthread_mutex_unlock(&pf->lock);
+    return PREFETCH_END;
+  }
 
-  /* Distort */
-  const real_t d[4] = {params[4], params[5], params[6], params[7]};
-  real_t p_d[2] = {0};
-  radtan4_distort(d, p, p_d);
+  /* -- Wait for the next frame */
+  const int k = pf->next_read++;
+  const int slot = k % pf->nb_slots;
+  while (pf->slot_state[slot] == PREFETCH_FREE ||
+         pf->slot_state[slot] == PREFETCH_LOADING) {
+    pthread_cond_wait(&pf->loaded, &pf->lock);
+  }
 
-  /* Scale and center */
-  const real_t fx = params[0];
-  const real_t fy = params[1];
-  const real_t cx = params[2];
-  const real_t cy = params[3];
+  /* -- Hand the slot's reference to the caller and free the slot */
+  const int state = pf->slot_state[slot];
+  if (state == PREFETCH_READY) {
+    *img = pf->slots[slot];
+  }
+  memset(&pf->slots[slot], 0, sizeof(image_t));
+  pf->slot_state[slot] = PREFETCH_FREE;
+  pthread_cond_broadcast(&pf->released);
+  pthread_mutex_unlock(&pf->lock);
 
-  x[0] = p[0] * fx + cx;
-  x[1] = p[1] * fy + cy;
+  return (state == PREFETCH_READY) ? PREFETCH_OK : PREFETCH_ERROR;
 }
 
+/* IMAGE PROCESSING ----------------------------------------------------------*/
+
 /**
- * Projection Jacobian of Pinhole + Radial-Tangential.
- *
- * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, p1, p2)
- * @param[in] p_C 3x1 Point vector observed in camera frame
- * @param[out] J 2x3 Projection Jacobian
+ * Map index `i` into `[0, n)` by reflecting about the borders without
+ * repeating the border pixel, i.e. `gfedcb|abcdefgh|gfedcba`.
  */
-void pinhole_radtan4_project_jacobian(const real_t params[8],
-                                      const real_t p_C[3],
-                                      real_t J[2 * 3]) {
-  assert(params != NULL);
-  assert(p_C != NULL);
-  assert(J != NULL);
-
-  /* Project */
-  const real_t x = p_C[0];
-  const real_t y = p_C[0];
-  const real_t z = p_C[0];
-  const real_t p[2] = {x / z, y / z};
+static inline int border_reflect101(int i, const int n) {
+  if (n == 1) {
+    return 0;
+  }
+  while (i < 0 || i >= n) {
+    i = (i < 0) ? -i : 2 * n - 2 - i;
+  }
+  return i;
+}
 
-  /* Projection Jacobian */
-  real_t J_proj[2 * 3] = {0};
-  J_proj[0] = 1.0 / z;
-  J_proj[1] = 0.0;
-  J_proj[2] = -x / (z * z);
-  J_proj[3] = 0.0;
-  J_proj[4] = 1.0 / z;
-  J_proj[5] = -y / (z * z);
+/**
+ * Row `y` of `img` with reflect-101 borders.
+ */
+static inline const uint8_t *image_row(const image_t *img, const int y) {
+  return img->data + border_reflect101(y, img->height) * img->stride;
+}
 
-  /* Distortion Point Jacobian */
-  const real_t k1 = params[4];
-  const real_t k2 = params[5];
-  const real_t p1 = params[6];
-  const real_t p2 = params[7];
-  const real_t d[4] = {k1, k2, p1, p2};
-  real_t J_dist_point[2 * 2] = {0};
-  radtan4_point_jacobian(d, p, J_dist_point);
+/**
+ * Row `y` of `img` with reflect-101 borders.
+ */
+static inline const float *imagef_row(const imagef_t *img, const int y) {
+  return img->data + border_reflect101(y, img->height) * img->stride;
+}
 
-  /* Project Point Jacobian */
-  real_t J_proj_point[2 * 3] = {0};
-  pinhole_point_jacobian(params, J_proj_point);
+/**
+ * Allocate a `width` x `height` float image.
+ * @returns 0 for success or -1 for failure
+ */
+int imagef_malloc(imagef_t *img, const int width, const int height) {
+  assert(img != NULL);
+  img->width = width;
+  img->height = height;
+  img->stride = width;
+  img->data = malloc(sizeof(float) * width * height);
+  if (img->data == NULL) {
+    LOG_ERROR("Failed to allocate %dx%d float image!", width, height);
+    return -1;
+  }
+  return 0;
+}
 
-  /* J = J_proj * J_dist_point * J_proj_point; */
-  real_t J_dist_proj[2 * 3] = {0};
-  dot(J_dist_point, 2, 2, J_proj, 2, 3, J_dist_proj);
-  dot(J_proj, 2, 2, J_dist_proj, 2, 3, J);
+/**
+ * Free float image data.
+ */
+void imagef_free(imagef_t *img) {
+  assert(img != NULL);
+  free(img->data);
+  img->data = NULL;
 }
 
 /**
- * Parameter Jacobian of Pinhole + Radial-Tangential.
- *
- * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, p1, p2)
- * @param[in] p_C 3x1 Point vector observed in camera frame
- * @param[out] J 2x8 Parameter Jacobian
+ * Convert `src` to the single channel image `dst` of the same size. Color
+ * images are converted with the BT.601 luma weights.
  */
-void pinhole_radtan4_params_jacobian(const real_t params[8],
-                                     const real_t p_C[3],
-                                     real_t J[2 * 8]) {
-  assert(params != NULL);
-  assert(p_C != NULL);
-  assert(J != NULL);
+void image_gray(const image_t *src, image_t *dst) {
+  assert(src != NULL && dst != NULL);
+  assert(src->width == dst->width && src->height == dst->height);
+  assert(dst->channels == 1);
+  const int w = src->width;
+  const int c = src->channels;
+
+  for (int y = 0; y < src->height; y++) {
+    const uint8_t *restrict s = src->data + y * src->stride;
+    uint8_t *restrict d = dst->data + y * dst->stride;
+
+    if (c == 1 || c == 2) {
+      for (int x = 0; x < w; x++) {
+        d[x] = s[x * c];
+      }
+    } else {
+#pragma GCC ivdep
+      for (int x = 0; x < w; x++) {
+        const int r = s[x * c + 0];
+        const int g = s[x * c + 1];
+        const int b = s[x * c + 2];
+        d[x] = (77 * r + 150 * g + 29 * b + 128) >> 8;
+      }
+    }
+  }
+}
 
-  const real_t fx = params[0];
-  const real_t fy = params[1];
-  const real_t cx = params[2];
-  const real_t cy = params[3];
-  const real_t k[4] = {fx, fy, cx, cy};
+/**
+ * Blur single channel image `src` with a 5x5 Gaussian kernel and downsample
+ * it into `dst`, which must be `(width + 1) / 2` x `(height + 1) / 2`. The
+ * kernel is applied separably as `[1 4 6 4 1] / 16` with reflect-101
+ * borders.
+ */
+void image_pyrdown(const image_t *src, image_t *dst) {
+  assert(src != NULL && dst != NULL);
+  assert(src->channels == 1 && dst->channels == 1);
+  assert(dst->width == (src->width + 1) / 2);
+  assert(dst->height == (src->height + 1) / 2);
+  const int w = src->width;
+
+  /* Vertically filtered row padded by 2 pixels each side */
+  uint16_t *buf = malloc(sizeof(uint16_t) * (w + 4));
+  uint16_t *restrict row = buf + 2;
+
+  for (int y = 0; y < dst->height; y++) {
+    /* -- Vertical pass */
+    const uint8_t *restrict r0 = image_row(src, 2 * y - 2);
+    const uint8_t *restrict r1 = image_row(src, 2 * y - 1);
+    const uint8_t *restrict r2 = image_row(src, 2 * y + 0);
+    const uint8_t *restrict r3 = image_row(src, 2 * y + 1);
+    const uint8_t *restrict r4 = image_row(src, 2 * y + 2);
+#pragma GCC ivdep
+    for (int x = 0; x < w; x++) {
+      row[x] = r0[x] + 4 * (r1[x] + r3[x]) + 6 * r2[x] + r4[x];
+    }
+    for (int x = 1; x <= 2; x++) {
+      row[-x] = row[border_reflect101(-x, w)];
+      row[w - 1 + x] = row[border_reflect101(w - 1 + x, w)];
+    }
 
-  const real_t k1 = params[4];
-  const real_t k2 = params[5];
-  const real_t p1 = params[6];
-  const real_t p2 = params[7];
-  const real_t d[4] = {k1, k2, p1, p2};
+    /* -- Horizontal pass and downsample */
+    uint8_t *restrict d = dst->data + y * dst->stride;
+#pragma GCC ivdep
+    for (int x = 0; x < dst->width; x++) {
+      const uint16_t *restrict p = row + 2 * x;
+      const int sum = p[-2] + 4 * (p[-1] + p[1]) + 6 * p[0] + p[2];
+      d[x] = (sum + 128) >> 8;
+    }
+  }
 
-  /* Project */
-  const real_t x = p_C[0];
-  const real_t y = p_C[0];
-  const real_t z = p_C[0];
-  const real_t p[2] = {x / z, y / z};
+  free(buf);
+}
 
-  /* Distort */
-  real_t p_d[2] = {0};
-  radtan4_distort(d, p, p_d);
+/**
+ * Build a `nb_levels` Gaussian pyramid of single channel image `img`. Level 0
+ * is a view of `img`, so `img` must outlive the pyramid.
+ * @returns 0 for success or -1 for failure
+ */
+int image_pyramid_setup(image_pyramid_t *pyr,
+                        const image_t *img,
+                        const int nb_levels) {
+  assert(pyr != NULL && img != NULL);
+  assert(img->channels == 1);
+  if (nb_levels < 1 || nb_levels > IMAGE_PYRAMID_MAX_LEVELS) {
+    LOG_ERROR("Invalid number of pyramid levels [%d]!", nb_levels);
+    return -1;
+  }
 
-  /* Project params Jacobian: J_proj_params */
-  real_t J_proj_params[2 * 4] = {0};
-  pinhole_params_jacobian(k, p_d, J_proj_params);
+  pyr->nb_levels = 1;
+  image_view(img, 0, 0, img->width, img->height, &pyr->levels[0]);
+  for (int i = 1; i < nb_levels; i++) {
+    const image_t *prev = &pyr->levels[i - 1];
+    const int w = (prev->width + 1) / 2;
+    const int h = (prev->height + 1) / 2;
+
+    image_t *level = &pyr->levels[i];
+    image_setup(level, w, h, malloc(w * h));
+    image_pyrdown(prev, level);
+    pyr->nb_levels++;
+  }
 
-  /* Project point Jacobian: J_proj_point */
-  real_t J_proj_point[2 * 3] = {0};
-  pinhole_point_jacobian(k, J_proj_point);
+  return 0;
+}
 
-  /* Distortion point Jacobian: J_dist_params */
-  real_t J_dist_params[2 * 2] = {0};
-  radtan4_params_jacobian(d, p, J_dist_params);
+/**
+ * Free image pyramid.
+ */
+void image_pyramid_free(image_pyramid_t *pyr) {
+  assert(pyr != NULL);
+  image_release(&pyr->levels[0]);
+  for (int i = 1; i < pyr->nb_levels; i++) {
+    free(pyr->levels[i].data);
+  }
+  pyr->nb_levels = 0;
+}
 
-  /* J = [J_proj_params, J_proj_point * J_dist_params] */
-  J[0] = J_proj_params[0];
-  J[1] = J_proj_params[1];
-  J[2] = J_proj_params[2];
-  J[3] = J_proj_params[3];
+/**
+ * 3x3 separable gradient of single channel image `src` with smoothing
+ * kernel `[a b a]` and derivative kernel `[-1 0 1]`, reflect-101 borders.
+ */
+static void image_gradient(const image_t *src,
+                           const int a,
+                           const int b,
+                           imagef_t *gx,
+                           imagef_t *gy) {
+  assert(src != NULL && gx != NULL && gy != NULL);
+  assert(src->channels == 1);
+  assert(gx->width == src->width && gx->height == src->height);
+  assert(gy->width == src->width && gy->height == src->height);
+  const int w = src->width;
+  const int h = src->height;
+
+  /* Vertically smoothed and differentiated rows, padded by 1 each side */
+  int *buf = malloc(sizeof(int) * 2 * (w + 2));
+  int *restrict vs = buf + 1;
+  int *restrict vd = buf + (w + 2) + 1;
+
+  for (int y = 0; y < h; y++) {
+    const uint8_t *restrict r0 = image_row(src, y - 1);
+    const uint8_t *restrict r1 = src->data + y * src->stride;
+    const uint8_t *restrict r2 = image_row(src, y + 1);
+
+    /* -- Vertical pass */
+#pragma GCC ivdep
+    for (int x = 0; x < w; x++) {
+      vs[x] = a * (r0[x] + r2[x]) + b * r1[x];
+      vd[x] = r2[x] - r0[x];
+    }
+    vs[-1] = vs[border_reflect101(-1, w)];
+    vs[w] = vs[border_reflect101(w, w)];
+    vd[-1] = vd[border_reflect101(-1, w)];
+    vd[w] = vd[border_reflect101(w, w)];
+
+    /* -- Horizontal pass */
+    float *restrict dx = gx->data + y * gx->stride;
+    float *restrict dy = gy->data + y * gy->stride;
+#pragma GCC ivdep
+    for (int x = 0; x < w; x++) {
+      dx[x] = vs[x + 1] - vs[x - 1];
+      dy[x] = a * (vd[x - 1] + vd[x + 1]) + b * vd[x];
+    }
+  }
 
-  J[8] = J_proj_params[4];
-  J[9] = J_proj_params[5];
-  J[10] = J_proj_params[6];
-  J[11] = J_proj_params[7];
+  free(buf);
 }
 
-/* PINHOLE-EQUI4 -------------------------------------------------------------*/
+/**
+ * Scharr image gradients `gx` and `gy` of single channel image `src`.
+ */
+void image_scharr(const image_t *src, imagef_t *gx, imagef_t *gy) {
+  image_gradient(src, 3, 10, gx, gy);
+}
 
 /**
- * Projection of 3D point to image plane using Pinhole + Equi-Distant.
- *
- * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, k3, k4)
- * @param[in] p_C 3x1 Point vector observed in camera frame
- * @param[out] x 2x1 Projected image point
+ * Sobel image gradients `gx` and `gy` of single channel image `src`.
  */
-void pinhole_equi4_project(const real_t params[8],
-                           const real_t p_C[3],
-                           real_t x[2]) {
-  assert(params != NULL);
-  assert(p_C != NULL);
-  assert(x != NULL);
+void image_sobel(const image_t *src, imagef_t *gx, imagef_t *gy) {
+  image_gradient(src, 1, 2, gx, gy);
+}
 
-  /* Project */
-  const real_t p[2] = {p_C[0] / p_C[2], p_C[1] / p_C[2]};
+/**
+ * Filter single channel image `src` with a normalized `(2 * radius + 1)`
+ * square box filter into `dst`, reflect-101 borders. Column sums are
+ * updated incrementally so the cost per pixel does not depend on `radius`.
+ */
+void image_box_filter(const image_t *src, const int radius, image_t *dst) {
+  assert(src != NULL && dst != NULL);
+  assert(src->channels == 1 && dst->channels == 1);
+  assert(src->width == dst->width && src->height == dst->height);
+  const int w = src->width;
+  const int h = src->height;
+  const int r = radius;
+  const uint32_t area = (2 * r + 1) * (2 * r + 1);
+
+  /* Division by `area` as a fixed point multiply, exact while the window sum
+   * times the reciprocal fits in 64 bits with 32 fractional bits */
+  const uint64_t recip = ((uint64_t) 1 << 32) / area + 1;
+  const int use_recip = area < 4096;
+
+  uint32_t *restrict sums = calloc(w, sizeof(uint32_t));
+  uint32_t *restrict row = malloc(sizeof(uint32_t) * (w + 2 * r));
+
+  /* -- Column sums of the first window */
+  for (int i = -r; i <= r; i++) {
+    const uint8_t *restrict s = image_row(src, i);
+    for (int x = 0; x < w; x++) {
+      sums[x] += s[x];
+    }
+  }
 
-  /* Distort */
-  const real_t d[4] = {params[4], params[5], params[6], params[7]};
-  real_t p_d[2] = {0};
-  equi4_distort(d, p, p_d);
+  for (int y = 0; y < h; y++) {
+    /* -- Horizontal running sum */
+    memcpy(row + r, sums, sizeof(uint32_t) * w);
+    for (int x = 1; x <= r; x++) {
+      row[r - x] = sums[border_reflect101(-x, w)];
+      row[r + w - 1 + x] = sums[border_reflect101(w - 1 + x, w)];
+    }
+    uint32_t sum = 0;
+    for (int x = 0; x < 2 * r; x++) {
+      sum += row[x];
+    }
+    uint8_t *restrict d = dst->data + y * dst->stride;
+    for (int x = 0; x < w; x++) {
+      sum += row[x + 2 * r];
+      const uint32_t n = sum + area / 2;
+      d[x] = (use_recip) ? (n * recip) >> 32 : n / area;
+      sum -= row[x];
+    }
 
-  /* Scale and center */
-  const real_t fx = params[0];
-  const real_t fy = params[1];
-  const real_t cx = params[2];
-  const real_t cy = params[3];
+    /* -- Slide column sums down one row */
+    if (y + 1 < h) {
+      const uint8_t *restrict add = image_row(src, y + r + 1);
+      const uint8_t *restrict sub = image_row(src, y - r);
+#pragma GCC ivdep
+      for (int x = 0; x < w; x++) {
+        sums[x] += add[x] - sub[x];
+      }
+    }
+  }
 
-  x[0] = p[0] * fx + cx;
-  x[1] = p[1] * fy + cy;
+  free(sums);
+  free(row);
 }
 
 /**
- * Projection Jacobian of Pinhole + Equi-Distant.
- *
- * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, k3, k4)
- * @param[in] p_C 3x1 Point vector observed in camera frame
- * @param[out] J 2x3 Projection Jacobian
+ * Float version of `image_box_filter()`.
  */
-void pinhole_equi4_project_jacobian(const real_t params[8],
-                                    const real_t p_C[3],
-                                    real_t J[2 * 3]) {
-  assert(params != NULL);
-  assert(p_C != NULL);
-  assert(J != NULL);
+void imagef_box_filter(const imagef_t *src, const int radius, imagef_t *dst) {
+  assert(src != NULL && dst != NULL);
+  assert(src->width == dst->width && src->height == dst->height);
+  const int w = src->width;
+  const int h = src->height;
+  const int r = radius;
+  const float scale = 1.0f / ((2 * r + 1) * (2 * r + 1));
+
+  float *restrict sums = calloc(w, sizeof(float));
+  float *restrict row = malloc(sizeof(float) * (w + 2 * r));
+
+  /* -- Column sums of the first window */
+  for (int i = -r; i <= r; i++) {
+    const float *restrict s = imagef_row(src, i);
+    for (int x = 0; x < w; x++) {
+      sums[x] += s[x];
+    }
+  }
 
-  /* Project */
-  const real_t x = p_C[0];
-  const real_t y = p_C[0];
-  const real_t z = p_C[0];
-  const real_t p[2] = {x / z, y / z};
+  for (int y = 0; y < h; y++) {
+    /* -- Horizontal running sum */
+    memcpy(row + r, sums, sizeof(float) * w);
+    for (int x = 1; x <= r; x++) {
+      row[r - x] = sums[border_reflect101(-x, w)];
+      row[r + w - 1 + x] = sums[border_reflect101(w - 1 + x, w)];
+    }
+    double sum = 0.0;
+    for (int x = 0; x < 2 * r; x++) {
+      sum += row[x];
+    }
+    float *restrict d = dst->data + y * dst->stride;
+    for (int x = 0; x < w; x++) {
+      sum += row[x + 2 * r];
+      d[x] = sum * scale;
+      sum -= row[x];
+    }
 
-  /* Projection Jacobian */
-  real_t J_proj[2 * 3] = {0};
-  J_proj[0] = 1.0 / z;
-  J_proj[1] = 0.0;
-  J_proj[2] = -x / (z * z);
-  J_proj[3] = 0.0;
-  J_proj[4] = 1.0 / z;
-  J_proj[5] = -y / (z * z);
+    /* -- Slide column sums down one row */
+    if (y + 1 < h) {
+      const float *restrict add = imagef_row(src, y + r + 1);
+      const float *restrict sub = imagef_row(src, y - r);
+#pragma GCC ivdep
+      for (int x = 0; x < w; x++) {
+        sums[x] += add[x] - sub[x];
+      }
+    }
+  }
 
-  /* Distortion Point Jacobian */
-  const real_t k1 = params[4];
-  const real_t k2 = params[5];
-  const real_t p1 = params[6];
-  const real_t p2 = params[7];
-  const real_t d[4] = {k1, k2, p1, p2};
-  real_t J_dist_point[2 * 2] = {0};
-  equi4_point_jacobian(d, p, J_dist_point);
+  free(sums);
+  free(row);
+}
+
+/* FAST ----------------------------------------------------------------------*/
+
+/* Bresenham circle of radius 3 around the center pixel, as (dx, dy) */
+static const int fast_circle[16][2] = {{0, -3},
+                                       {1, -3},
+                                       {2, -2},
+                                       {3, -1},
+                                       {3, 0},
+                                       {3, 1},
+                                       {2, 2},
+                                       {1, 3},
+                                       {0, 3},
+                                       {-1, 3},
+                                       {-2, 2},
+                                       {-3, 1},
+                                       {-3, 0},
+                                       {-3, -1},
+                                       {-2, -2},
+                                       {-1, -3}};
 
-  /* Project Point Jacobian */
-  real_t J_proj_point[2 * 3] = {0};
-  pinhole_point_jacobian(params, J_proj_point);
+/**
+ * Rotate 16-bit mask `m` right by `s` bits.
+ */
+static inline uint16_t fast_rot16(const uint16_t m, const int s) {
+  return (uint16_t) ((m >> s) | (m << (16 - s)));
+}
 
-  /* J = J_proj * J_dist_point * J_proj_point; */
-  real_t J_dist_proj[2 * 3] = {0};
-  dot(J_dist_point, 2, 2, J_proj, 2, 3, J_dist_proj);
-  dot(J_proj, 2, 2, J_dist_proj, 2, 3, J);
+/**
+ * Check if circle mask `m` has 9 contiguous bits set, with wrap around.
+ */
+static inline int fast_arc9(const uint16_t m) {
+  uint16_t a = m & fast_rot16(m, 1);
+  a &= fast_rot16(a, 2);
+  a &= fast_rot16(a, 4);
+  a &= fast_rot16(m, 8);
+  return a != 0;
 }
 
-/******************************************************************************
- * SENSOR FUSION
- ******************************************************************************/
+/**
+ * FAST-9 scores of the `n` pixels starting at (`x0`, `y`) of `img`, where 0
+ * means not a corner. The segment test of each pixel is unrolled over the
+ * circle into branch-free 8-bit compares and 16-bit mask operations so the
+ * loop over pixels vectorizes. The corners are then gathered into `idx`
+ * without branching and only they are scored, the score being the larger of
+ * the summed absolute brighter and darker differences beyond the threshold.
+ */
+static void fast_scores(const image_t *img,
+                        const int x0,
+                        const int y,
+                        const int n,
+                        const int threshold,
+                        uint8_t *restrict flags,
+                        int *restrict idx,
+                        int *restrict scores) {
+  const int t = threshold;
+  const uint8_t *restrict c = img->data + y * img->stride + x0;
+  int offsets[16];
+  for (int k = 0; k < 16; k++) {
+    offsets[k] = fast_circle[k][1] * img->stride + fast_circle[k][0];
+  }
 
-/* POSE --------------------------------------------------------------------- */
+  /* -- Segment test */
+#pragma GCC ivdep
+  for (int x = 0; x < n; x++) {
+    const uint8_t hi = MIN(c[x] + t, 255);
+    const uint8_t lo = MAX(c[x] - t, 0);
+    uint16_t bright = 0;
+    uint16_t dark = 0;
+#pragma GCC unroll 16
+    for (int k = 0; k < 16; k++) {
+      const uint8_t p = c[x + offsets[k]];
+      bright |= (uint16_t) ((p > hi) << k);
+      dark |= (uint16_t) ((p < lo) << k);
+    }
+    flags[x] = fast_arc9(bright) | fast_arc9(dark);
+  }
 
-void pose_setup(pose_t *pose, const timestamp_t ts, const real_t *data) {
-  assert(pose != NULL);
-  assert(data != NULL);
+  /* -- Gather corners */
+  int nb_corners = 0;
+  for (int x = 0; x < n; x++) {
+    idx[nb_corners] = x;
+    nb_corners += flags[x];
+    scores[x] = 0;
+  }
 
-  /* Timestamp */
-  pose->ts = ts;
+  /* -- Corner scores */
+  for (int i = 0; i < nb_corners; i++) {
+    const int x = idx[i];
+    int sum_bright = 0;
+    int sum_dark = 0;
+#pragma GCC unroll 16
+    for (int k = 0; k < 16; k++) {
+      const int d = c[x + offsets[k]] - c[x];
+      sum_bright += MAX(d - t, 0);
+      sum_dark += MAX(-d - t, 0);
+    }
+    scores[x] = MAX(sum_bright, sum_dark);
+  }
+}
 
-  /* Quaternion */
-  pose->data[0] = data[0];
-  pose->data[1] = data[1];
-  pose->data[2] = data[2];
-  pose->data[3] = data[3];
+/**
+ * Check if keypoint `a` is weaker than `b`, ties go to the later keypoint in
+ * raster order.
+ */
+static inline int keypoint_weaker(const keypoint_t *a, const keypoint_t *b) {
+  if (a->score != b->score) {
+    return a->score < b->score;
+  }
+  return (a->y != b->y) ? a->y > b->y : a->x > b->x;
+}
 
-  /* Translation */
-  pose->data[4] = data[4];
-  pose->data[5] = data[5];
-  pose->data[6] = data[6];
+/**
+ * Sort keypoints by descending score.
+ */
+static int keypoint_cmp(const void *a, const void *b) {
+  const keypoint_t *ka = (const keypoint_t *) a;
+  const keypoint_t *kb = (const keypoint_t *) b;
+  return keypoint_weaker(ka, kb) - keypoint_weaker(kb, ka);
 }
 
-/* SPEED AND BIASES --------------------------------------------------------- */
+/**
+ * Restore the min-heap property of the `n` keypoints in `heap` from `i`
+ * down, the weakest keypoint is at the root.
+ */
+static void keypoint_heap_down(keypoint_t *heap, const int n, int i) {
+  while (1) {
+    const int l = 2 * i + 1;
+    const int r = l + 1;
+    int min = i;
+    if (l < n && keypoint_weaker(&heap[l], &heap[min])) {
+      min = l;
+    }
+    if (r < n && keypoint_weaker(&heap[r], &heap[min])) {
+      min = r;
+    }
+    if (min == i) {
+      return;
+    }
+    const keypoint_t tmp = heap[i];
+    heap[i] = heap[min];
+    heap[min] = tmp;
+    i = min;
+  }
+}
 
-void speed_biases_setup(speed_biases_t *sb,
-                        const timestamp_t ts,
-                        const real_t *data) {
-  assert(sb != NULL);
-  assert(data != NULL);
+/**
+ * Keep the `max_kps` strongest keypoints in min-heap `heap` of size
+ * `nb_kps`, the caller ensures `heap` has room for `max_kps` keypoints.
+ * @returns Heap size
+ */
+static int keypoint_heap_push(keypoint_t *heap,
+                              int nb_kps,
+                              const int max_kps,
+                              const keypoint_t *kp) {
+  if (nb_kps < max_kps) {
+    /* -- Sift up */
+    int i = nb_kps++;
+    heap[i] = *kp;
+    while (i > 0 && keypoint_weaker(&heap[i], &heap[(i - 1) / 2])) {
+      const keypoint_t tmp = heap[i];
+      heap[i] = heap[(i - 1) / 2];
+      heap[(i - 1) / 2] = tmp;
+      i = (i - 1) / 2;
+    }
+  } else if (keypoint_weaker(&heap[0], kp)) {
+    /* -- Replace weakest */
+    heap[0] = *kp;
+    keypoint_heap_down(heap, nb_kps, 0);
+  }
+  return nb_kps;
+}
 
-  /* Timestamp */
-  sb->ts = ts;
+/**
+ * Detect the `max_kps` strongest non-max suppressed FAST-9 corners of `img`
+ * in the window `[x0, x1) x [y0, y1)`, which must lie at least 3 pixels
+ * inside the image. Scores are also computed one pixel around the window so
+ * suppression across neighbouring windows is consistent.
+ * @returns Number of corners written to `kps`
+ */
+static int fast_window(const image_t *img,
+                       const int threshold,
+                       const int x0,
+                       const int y0,
+                       const int x1,
+                       const int y1,
+                       const int max_kps,
+                       keypoint_t *kps) {
+  if (x1 <= x0 || y1 <= y0 || max_kps <= 0) {
+    return 0;
+  }
 
-  /* Velocity */
-  sb->data[0] = data[0];
-  sb->data[1] = data[1];
-  sb->data[2] = data[2];
+  /* Score window padded by one pixel where inside the detectable area */
+  const int sx0 = MAX(x0 - 1, 3);
+  const int sx1 = MIN(x1 + 1, img->width - 3);
+  const int sy0 = MAX(y0 - 1, 3);
+  const int sy1 = MIN(y1 + 1, img->height - 3);
+  const int sw = sx1 - sx0;
+  const int sh = sy1 - sy0;
+
+  /* Score map with a zero border so every window pixel has 8 neighbours */
+  const int mw = sw + 2;
+  int *map = calloc(mw * (sh + 2), sizeof(int));
+  uint8_t *flags = malloc(sizeof(uint8_t) * sw);
+  int *idx = malloc(sizeof(int) * sw);
+  for (int y = sy0; y < sy1; y++) {
+    int *row = map + (y - sy0 + 1) * mw + 1;
+    fast_scores(img, sx0, y, sw, threshold, flags, idx, row);
+  }
 
-  /* Accel biases */
-  sb->data[3] = data[3];
-  sb->data[4] = data[4];
-  sb->data[5] = data[5];
+  /* Non-max suppression, ties go to the first pixel in raster order. The
+   * local maxima of a row are flagged without branching, then the strongest
+   * are kept in a min-heap of size `max_kps` in `kps`. */
+  const int ww = x1 - x0;
+  int nb_kps = 0;
+  for (int y = y0; y < y1; y++) {
+    const int *restrict p = map + (y - sy0 + 1) * mw + (x0 - sx0 + 1);
+#pragma GCC ivdep
+    for (int x = 0; x < ww; x++) {
+      const int s = p[x];
+      flags[x] = (s > 0) & (s > p[x - mw - 1]) & (s > p[x - mw]) &
+                 (s > p[x - mw + 1]) & (s > p[x - 1]) & (s >= p[x + 1]) &
+                 (s >= p[x + mw - 1]) & (s >= p[x + mw]) & (s >= p[x + mw + 1]);
+    }
 
-  /* Gyro biases */
-  sb->data[6] = data[6];
-  sb->data[7] = data[7];
-  sb->data[8] = data[8];
-}
+    int nb_maxima = 0;
+    for (int x = 0; x < ww; x++) {
+      idx[nb_maxima] = x;
+      nb_maxima += flags[x];
+    }
+    for (int i = 0; i < nb_maxima; i++) {
+      const int x = idx[i];
+      const keypoint_t kp = {x0 + x, y, p[x]};
+      nb_kps = keypoint_heap_push(kps, nb_kps, max_kps, &kp);
+    }
+  }
+  qsort(kps, nb_kps, sizeof(keypoint_t), keypoint_cmp);
 
-/* FEATURE ------------------------------------------------------------------ */
+  free(map);
+  free(flags);
+  free(idx);
 
-void feature_setup(feature_t *p, const real_t *data) {
-  assert(p != NULL);
-  assert(data != NULL);
+  return nb_kps;
+}
 
-  p->data[0] = data[0];
-  p->data[1] = data[1];
-  p->data[2] = data[2];
+/**
+ * Detect the FAST corners in grid cell `i`.
+ */
+static int fast_grid_cell(const fast_worker_t *worker, const int i) {
+  const image_t *img = worker->img;
+  const int w = img->width;
+  const int h = img->height;
+  const int rows = worker->grid_rows;
+  const int cols = worker->grid_cols;
+  const int r = i / cols;
+  const int c = i % cols;
+  const int x0 = MAX((w * c) / cols, 3);
+  const int x1 = MIN((w * (c + 1)) / cols, w - 3);
+  const int y0 = MAX((h * r) / rows, 3);
+  const int y1 = MIN((h * (r + 1)) / rows, h - 3);
+
+  keypoint_t *kps = worker->kps + i * worker->max_per_cell;
+  return fast_window(img,
+                     worker->threshold,
+                     x0,
+                     y0,
+                     x1,
+                     y1,
+                     worker->max_per_cell,
+                     kps);
+}
+
+static void *fast_worker_detect(void *arg) {
+  fast_worker_t *worker = (fast_worker_t *) arg;
+  for (int i = worker->start; i < worker->end; i++) {
+    worker->nb_kps[i] = fast_grid_cell(worker, i);
+  }
+  return NULL;
 }
 
-/* EXTRINSICS --------------------------------------------------------------- */
+/**
+ * Detect up to `max_corners` of the strongest non-max suppressed FAST-9
+ * corners in single channel image `img` with intensity `threshold`.
+ * @returns Number of corners written to `kps`
+ */
+int fast_detect(const image_t *img,
+                const int threshold,
+                const int max_corners,
+                keypoint_t *kps) {
+  return fast_grid_detect(img, threshold, 1, 1, max_corners, 1, kps);
+}
 
-void extrinsics_setup(extrinsics_t *extrinsics, const real_t *data) {
-  assert(extrinsics != NULL);
-  assert(data != NULL);
+/**
+ * Detect FAST-9 corners in single channel image `img` bucketed in a
+ * `grid_rows` x `grid_cols` grid. Each cell keeps its strongest
+ * `max_corners / (grid_rows * grid_cols)` non-max suppressed corners, so
+ * corners are spread over the image. Cells are split between `nb_threads`
+ * worker threads, the result does not depend on the number of threads.
+ * @returns Number of corners written to `kps`, in grid cell order
+ */
+int fast_grid_detect(const image_t *img,
+                     const int threshold,
+                     const int grid_rows,
+                     const int grid_cols,
+                     const int max_corners,
+                     const int nb_threads,
+                     keypoint_t *kps) {
+  assert(img != NULL && kps != NULL);
+  assert(img->channels == 1);
+  assert(grid_rows > 0 && grid_cols > 0);
+  const int nb_cells = grid_rows * grid_cols;
+  const int max_per_cell = max_corners / nb_cells;
+  if (max_per_cell <= 0 || img->width < 7 || img->height < 7) {
+    return 0;
+  }
 
-  /* Quaternion */
-  extrinsics->data[0] = data[0];
-  extrinsics->data[1] = data[1];
-  extrinsics->data[2] = data[2];
-  extrinsics->data[3] = data[3];
+  /* Detect per cell, cell i writes to kps[i * max_per_cell] */
+  int *nb_kps = calloc(nb_cells, sizeof(int));
+  const int nb_workers = MAX(MIN(nb_threads, nb_cells), 1);
+  fast_worker_t *workers = calloc(nb_workers, sizeof(fast_worker_t));
+  int nb_started = 0;
+  for (int i = 0; i < nb_workers; i++) {
+    fast_worker_t *worker = &workers[i];
+    worker->img = img;
+    worker->threshold = threshold;
+    worker->grid_rows = grid_rows;
+    worker->grid_cols = grid_cols;
+    worker->max_per_cell = max_per_cell;
+    worker->start = (nb_cells * i) / nb_workers;
+    worker->end = (nb_cells * (i + 1)) / nb_workers;
+    worker->kps = kps;
+    worker->nb_kps = nb_kps;
+    if (nb_workers == 1) {
+      break;
+    }
+    if (pthread_create(&worker->thread, NULL, fast_worker_detect, worker)) {
+      LOG_ERROR("Failed to create FAST worker thread!");
+      break;
+    }
+    nb_started++;
+  }
+  for (int i = 0; i < nb_started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
 
-  /* Translation */
-  extrinsics->data[4] = data[4];
-  extrinsics->data[5] = data[5];
-  extrinsics->data[6] = data[6];
-}
+  /* Detect the cells of workers that did not run in a thread */
+  for (int i = nb_started; i < nb_workers; i++) {
+    workers[i] = workers[0];
+    workers[i].start = (nb_cells * i) / nb_workers;
+    workers[i].end = (nb_cells * (i + 1)) / nb_workers;
+    fast_worker_detect(&workers[i]);
+  }
 
-/* CAMERA PARAMS ------------------------------------------------------------ */
+  /* Compact cells */
+  int nb_corners = 0;
+  for (int i = 0; i < nb_cells; i++) {
+    memmove(kps + nb_corners,
+            kps + i * max_per_cell,
+            sizeof(keypoint_t) * nb_kps[i]);
+    nb_corners += nb_kps[i];
+  }
 
-void camera_params_setup(camera_params_t *camera,
-                         const int cam_idx,
-                         const int cam_res[2],
-                         const char *proj_model,
-                         const char *dist_model,
-                         const real_t data[8]) {
-  assert(camera != NULL);
-  assert(cam_res != NULL);
-  assert(proj_model != NULL);
-  assert(dist_model != NULL);
-  assert(data != NULL);
+  free(nb_kps);
+  free(workers);
 
-  camera->cam_idx = cam_idx;
-  camera->resolution[0] = cam_res[0];
-  camera->resolution[1] = cam_res[1];
+  return nb_corners;
+}
 
-  strcpy(camera->proj_model, proj_model);
-  strcpy(camera->dist_model, dist_model);
+/* KLT -----------------------------------------------------------------------*/
 
-  camera->data[0] = data[0];
-  camera->data[1] = data[1];
-  camera->data[2] = data[2];
-  camera->data[3] = data[3];
-  camera->data[4] = data[4];
-  camera->data[5] = data[5];
-  camera->data[6] = data[6];
-  camera->data[7] = data[7];
+/**
+ * Setup KLT tracker with the default settings, a 10x10 patch tracked over 4
+ * pyramid levels with at most 30 iterations per level.
+ */
+void klt_setup(klt_t *klt) {
+  assert(klt != NULL);
+  klt->patch_size = 10;
+  klt->max_level = 3;
+  klt->max_iter = 30;
+  klt->epsilon = 0.01;
+  klt->min_eigen = 0.1;
+  klt->nb_threads = 1;
 }
 
-void camera_params_print(const camera_params_t *camera) {
-  assert(camera);
+/**
+ * Build the `nb_levels` KLT pyramid of single channel image `img`. Level 0
+ * is a view of `img`, so `img` must outlive the pyramid.
+ * @returns 0 for success or -1 for failure
+ */
+int klt_pyramid_setup(klt_pyramid_t *pyr,
+                      const image_t *img,
+                      const int nb_levels) {
+  assert(pyr != NULL && img != NULL);
+  memset(pyr->gx, 0, sizeof(imagef_t) * IMAGE_PYRAMID_MAX_LEVELS);
+  memset(pyr->gy, 0, sizeof(imagef_t) * IMAGE_PYRAMID_MAX_LEVELS);
+  if (image_pyramid_setup(&pyr->pyr, img, nb_levels) != 0) {
+    return -1;
+  }
 
-  printf("cam_idx: %d\n", camera->cam_idx);
-  printf("cam_res: [%d, %d]\n", camera->resolution[0], camera->resolution[1]);
-  printf("proj_model: %s\n", camera->proj_model);
-  printf("dist_model: %s\n", camera->dist_model);
-  printf("data: [");
-  for (int i = 0; i < 8; i++) {
-    if ((i + 1) < 8) {
-      printf("%f, ", camera->data[i]);
-    } else {
-      printf("%f", camera->data[i]);
+  for (int i = 0; i < pyr->pyr.nb_levels; i++) {
+    const image_t *level = &pyr->pyr.levels[i];
+    if (imagef_malloc(&pyr->gx[i], level->width, level->height) != 0 ||
+        imagef_malloc(&pyr->gy[i], level->width, level->height) != 0) {
+      klt_pyramid_free(pyr);
+      return -1;
     }
+    image_scharr(level, &pyr->gx[i], &pyr->gy[i]);
   }
-  printf("]\n");
-}
-
-/* POSE FACTOR -------------------------------------------------------------- */
 
-void pose_factor_setup(pose_factor_t *factor,
-                       pose_t *pose,
-                       const real_t var[6]) {
-  assert(factor != NULL);
-  assert(pose != NULL);
-  assert(var != NULL);
+  return 0;
+}
 
-  zeros(factor->pose_meas, 7, 1);
-  factor->pose_est = pose;
+/**
+ * Free KLT pyramid.
+ */
+void klt_pyramid_free(klt_pyramid_t *pyr) {
+  assert(pyr != NULL);
+  for (int i = 0; i < pyr->pyr.nb_levels; i++) {
+    imagef_free(&pyr->gx[i]);
+    imagef_free(&pyr->gy[i]);
+  }
+  image_pyramid_free(&pyr->pyr);
+}
 
-  zeros(factor->covar, 6, 6);
-  factor->covar[0] = 1.0 / (var[0] * var[0]);
-  factor->covar[7] = 1.0 / (var[1] * var[1]);
-  factor->covar[14] = 1.0 / (var[2] * var[2]);
-  factor->covar[21] = 1.0 / (var[3] * var[3]);
-  factor->covar[28] = 1.0 / (var[4] * var[4]);
-  factor->covar[35] = 1.0 / (var[5] * var[5]);
+/**
+ * Check the `n` x `n` patch with top left corner (`x`, `y`) and the extra
+ * column and row needed for bilinear interpolation is inside `img`.
+ */
+static int klt_inside(const image_t *img,
+                      const float x,
+                      const float y,
+                      const int n) {
+  return x >= 0.0f && y >= 0.0f && x < img->width - n &&
+         y < img->height - n;
+}
 
-  zeros(factor->r, 6, 1);
-  factor->r_size = 6;
+/**
+ * Bilinear interpolation weights `w` and integer top left corner (`ix`,
+ * `iy`) of the patch with top left corner (`x`, `y`).
+ */
+static void klt_bilinear(const float x,
+                         const float y,
+                         int *ix,
+                         int *iy,
+                         float w[4]) {
+  const float fx = floorf(x);
+  const float fy = floorf(y);
+  const float a = x - fx;
+  const float b = y - fy;
+  *ix = fx;
+  *iy = fy;
+  w[0] = (1.0f - a) * (1.0f - b);
+  w[1] = a * (1.0f - b);
+  w[2] = (1.0f - a) * b;
+  w[3] = a * b;
+}
 
-  zeros(factor->J0, 6, 6);
-  factor->jacs[0] = factor->J0;
-  factor->nb_params = 1;
+/**
+ * Sample the `n` x `n` patch of `img` at (`ix`, `iy`) with bilinear weights
+ * `w` into `patch`.
+ */
+static void klt_sample(const image_t *img,
+                       const int ix,
+                       const int iy,
+                       const float w[4],
+                       const int n,
+                       float *restrict patch) {
+  const float w0 = w[0], w1 = w[1], w2 = w[2], w3 = w[3];
+  for (int r = 0; r < n; r++) {
+    const uint8_t *restrict s0 = img->data + (iy + r) * img->stride + ix;
+    const uint8_t *restrict s1 = s0 + img->stride;
+    float *restrict p = patch + r * n;
+#pragma GCC ivdep
+    for (int c = 0; c < n; c++) {
+      p[c] = w0 * s0[c] + w1 * s0[c + 1] + w2 * s1[c] + w3 * s1[c + 1];
+    }
+  }
 }
 
-void pose_factor_reset(pose_factor_t *factor) {
-  zeros(factor->r, 6, 1);
-  zeros(factor->J0, 6, 6);
+/**
+ * Float image version of `klt_sample()`.
+ */
+static void klt_samplef(const imagef_t *img,
+                        const int ix,
+                        const int iy,
+                        const float w[4],
+                        const int n,
+                        float *restrict patch) {
+  const float w0 = w[0], w1 = w[1], w2 = w[2], w3 = w[3];
+  for (int r = 0; r < n; r++) {
+    const float *restrict s0 = img->data + (iy + r) * img->stride + ix;
+    const float *restrict s1 = s0 + img->stride;
+    float *restrict p = patch + r * n;
+#pragma GCC ivdep
+    for (int c = 0; c < n; c++) {
+      p[c] = w0 * s0[c] + w1 * s0[c + 1] + w2 * s1[c] + w3 * s1[c + 1];
+    }
+  }
 }
 
-int pose_factor_eval(pose_factor_t *factor) {
-  assert(factor != NULL);
+/**
+ * Sum of the `n` column sums `v`.
+ */
+static float klt_sum(const float *v, const int n) {
+  float sum = 0.0f;
+  for (int c = 0; c < n; c++) {
+    sum += v[c];
+  }
+  return sum;
+}
 
-  /* Map params */
-  real_t pose_est[4 * 4] = {0};
+/**
+ * Refine the flow `d` of the patch centred at `p0` on pyramid level `l` with
+ * inverse compositional Gauss-Newton iterations. The template, its gradients
+ * and the inverse Hessian are computed once, each iteration only warps the
+ * patch `W` of the second frame. If `err` is not NULL it is set to the mean
+ * absolute intensity difference of the tracked patch. `buf` holds the SoA
+ * patch buffers and column sums, `4 * n * n + 3 * n` floats for patch size
+ * `n`. Reductions are accumulated per patch column, so they vectorize along
+ * the patch rows.
+ * @returns 0 for success or -1 if the patch is textureless or left the image
+ */
+static int klt_track_level(const klt_t *klt,
+                           const klt_pyramid_t *pyr0,
+                           const klt_pyramid_t *pyr1,
+                           const int l,
+                           const float p0[2],
+                           float d[2],
+                           float *err,
+                           float *buf) {
+  const image_t *img0 = &pyr0->pyr.levels[l];
+  const image_t *img1 = &pyr1->pyr.levels[l];
+  const int n = klt->patch_size;
+  const int N = n * n;
+  float *restrict T = buf;
+  float *restrict Tx = T + N;
+  float *restrict Ty = Tx + N;
+  float *restrict W = Ty + N;
+  float *restrict sx = W + N;
+  float *restrict sy = sx + n;
+  float *restrict sc = sy + n;
+
+  /* Template and its gradients, Scharr gradients are scaled by 32 */
+  const float x0 = p0[0] - (n - 1) * 0.5f;
+  const float y0 = p0[1] - (n - 1) * 0.5f;
+  if (klt_inside(img0, x0, y0, n) == 0) {
+    return -1;
+  }
+  int ix = 0;
+  int iy = 0;
+  float w[4] = {0};
+  klt_bilinear(x0, y0, &ix, &iy, w);
+  klt_sample(img0, ix, iy, w, n, T);
+  const float wg[4] = {w[0] / 32, w[1] / 32, w[2] / 32, w[3] / 32};
+  klt_samplef(&pyr0->gx[l], ix, iy, wg, n, Tx);
+  klt_samplef(&pyr0->gy[l], ix, iy, wg, n, Ty);
+
+  /* Hessian of the template, reject textureless patches */
+  memset(sx, 0, sizeof(float) * 3 * n);
+  for (int k = 0; k < N; k += n) {
+#pragma GCC ivdep
+    for (int c = 0; c < n; c++) {
+      sx[c] += Tx[k + c] * Tx[k + c];
+      sy[c] += Tx[k + c] * Ty[k + c];
+      sc[c] += Ty[k + c] * Ty[k + c];
+    }
+  }
+  const float Hxx = klt_sum(sx, n);
+  const float Hxy = klt_sum(sy, n);
+  const float Hyy = klt_sum(sc, n);
+  const float det = Hxx * Hyy - Hxy * Hxy;
+  const float tr = Hxx + Hyy;
+  const float disc = sqrtf((Hxx - Hyy) * (Hxx - Hyy) + 4.0f * Hxy * Hxy);
+  const float min_eigen = (tr - disc) / (2.0f * N);
+  if (min_eigen < klt->min_eigen || det < FLT_EPSILON) {
+    return -1;
+  }
+  const float Ixx = Hyy / det;
+  const float Ixy = -Hxy / det;
+  const float Iyy = Hxx / det;
+
+  /* Gauss-Newton iterations */
+  const float eps = klt->epsilon;
+  float cost_best = FLT_MAX;
+  float d_best[2] = {d[0], d[1]};
+  int converged = 0;
+  for (int iter = 0; iter < klt->max_iter && converged == 0; iter++) {
+    const float x1 = x0 + d[0];
+    const float y1 = y0 + d[1];
+    if (klt_inside(img1, x1, y1, n) == 0) {
+      return -1;
+    }
+    klt_bilinear(x1, y1, &ix, &iy, w);
+    klt_sample(img1, ix, iy, w, n, W);
+
+    /* -- Cost and steepest descent images times the residual */
+    memset(sx, 0, sizeof(float) * 3 * n);
+    for (int k = 0; k < N; k += n) {
+#pragma GCC ivdep
+      for (int c = 0; c < n; c++) {
+        const float e = W[k + c] - T[k + c];
+        sx[c] += Tx[k + c] * e;
+        sy[c] += Ty[k + c] * e;
+        sc[c] += e * e;
+      }
+    }
+    const float gx = klt_sum(sx, n);
+    const float gy = klt_sum(sy, n);
+    const float cost = klt_sum(sc, n);
+
+    /* -- Backtrack halfway to the best flow if the step increased the cost,
+     * the template Hessian can underestimate the curvature of the warped
+     * patch and make the steps overshoot */
+    if (cost >= cost_best) {
+      d[0] = 0.5f * (d[0] + d_best[0]);
+      d[1] = 0.5f * (d[1] + d_best[1]);
+      const float hx = d[0] - d_best[0];
+      const float hy = d[1] - d_best[1];
+      converged = (hx * hx + hy * hy < eps * eps);
+      continue;
+    }
+    cost_best = cost;
+    d_best[0] = d[0];
+    d_best[1] = d[1];
+
+    /* -- Inverse compositional update */
+    const float dx = Ixx * gx + Ixy * gy;
+    const float dy = Ixy * gx + Iyy * gy;
+    d[0] -= dx;
+    d[1] -= dy;
+    converged = (dx * dx + dy * dy < eps * eps);
+  }
+  if (converged == 0) {
+    d[0] = d_best[0];
+    d[1] = d_best[1];
+  }
+
+  /* Tracking error */
+  if (err) {
+    const float x1 = x0 + d[0];
+    const float y1 = y0 + d[1];
+    if (klt_inside(img1, x1, y1, n) == 0) {
+      return -1;
+    }
+    klt_bilinear(x1, y1, &ix, &iy, w);
+    klt_sample(img1, ix, iy, w, n, W);
+
+    memset(sc, 0, sizeof(float) * n);
+    for (int k = 0; k < N; k += n) {
+#pragma GCC ivdep
+      for (int c = 0; c < n; c++) {
+        sc[c] += fabsf(W[k + c] - T[k + c]);
+      }
+    }
+    *err = klt_sum(sc, n) / N;
+  }
+
+  return 0;
+}
+
+/**
+ * Track features `[start, end)` of `worker` coarse to fine. All features are
+ * tracked on a pyramid level before moving on to the next finer level, so
+ * the level's images and gradients stay in cache.
+ */
+static void *klt_worker_track(void *arg) {
+  klt_worker_t *worker = (klt_worker_t *) arg;
+  const klt_t *klt = worker->klt;
+  const klt_pyramid_t *pyr0 = worker->pyr0;
+  const klt_pyramid_t *pyr1 = worker->pyr1;
+  const int n = klt->patch_size;
+  const int nb_kps = worker->end - worker->start;
+  const keypoint_t *kps0 = worker->kps0 + worker->start;
+  keypoint_t *kps1 = worker->kps1 + worker->start;
+  uint8_t *status = worker->status + worker->start;
+  real_t *err = worker->err + worker->start;
+  int nb_levels = MIN(pyr0->pyr.nb_levels, pyr1->pyr.nb_levels);
+  nb_levels = MIN(nb_levels, klt->max_level + 1);
+
+  /* Patch buffers and flow of every feature at the current level */
+  float *buf = malloc(sizeof(float) * (4 * n * n + 3 * n));
+  float *flow = malloc(sizeof(float) * 2 * nb_kps);
+  const float top_scale = 1.0f / (1 << (nb_levels - 1));
+  for (int i = 0; i < nb_kps; i++) {
+    status[i] = 1;
+    err[i] = 0.0;
+    flow[i * 2 + 0] = (kps1[i].x - kps0[i].x) * top_scale;
+    flow[i * 2 + 1] = (kps1[i].y - kps0[i].y) * top_scale;
+  }
+
+  /* Track coarse to fine */
+  for (int l = nb_levels - 1; l >= 0; l--) {
+    const float scale = 1.0f / (1 << l);
+    for (int i = 0; i < nb_kps; i++) {
+      if (status[i] == 0) {
+        continue;
+      }
+
+      /* -- Track, features lost on a coarse level retry on the next one */
+      const float p0[2] = {kps0[i].x * scale, kps0[i].y * scale};
+      float *d = flow + i * 2;
+      const float d_init[2] = {d[0], d[1]};
+      float e = 0.0f;
+      if (klt_track_level(klt, pyr0, pyr1, l, p0, d, l ? NULL : &e, buf)) {
+        d[0] = d_init[0];
+        d[1] = d_init[1];
+        status[i] = (l > 0);
+      }
+      err[i] = e;
+
+      /* -- Propagate flow to the next finer level */
+      if (l > 0) {
+        d[0] *= 2.0f;
+        d[1] *= 2.0f;
+      }
+    }
+  }
+
+  /* Tracked keypoints */
+  for (int i = 0; i < nb_kps; i++) {
+    kps1[i].x = kps0[i].x + flow[i * 2 + 0];
+    kps1[i].y = kps0[i].y + flow[i * 2 + 1];
+    kps1[i].score = kps0[i].score;
+  }
+
+  free(buf);
+  free(flow);
+
+  return NULL;
+}
+
+/**
+ * Track `nb_kps` keypoints `kps0` from the frame of `pyr0` to the frame of
+ * `pyr1` with pyramidal inverse compositional KLT. `kps1` holds the initial
+ * guess of the tracked keypoints on input, e.g. a copy of `kps0`, and the
+ * tracked keypoints on output. `status[i]` is set to 1 if keypoint `i` was
+ * tracked and 0 if it was lost, `err[i]` to the mean absolute intensity
+ * difference of its patch. Keypoints are split between `klt->nb_threads`
+ * worker threads, the result does not depend on the number of threads.
+ * @returns Number of keypoints tracked
+ */
+int klt_track(const klt_t *klt,
+              const klt_pyramid_t *pyr0,
+              const klt_pyramid_t *pyr1,
+              const int nb_kps,
+              const keypoint_t *kps0,
+              keypoint_t *kps1,
+              uint8_t *status,
+              real_t *err) {
+  assert(klt != NULL && pyr0 != NULL && pyr1 != NULL);
+  assert(kps0 != NULL && kps1 != NULL && status != NULL && err != NULL);
+  assert(klt->patch_size > 0);
+  if (nb_kps <= 0) {
+    return 0;
+  }
+
+  /* Track, worker i tracks keypoints [start, end) */
+  const int nb_workers = MAX(MIN(klt->nb_threads, nb_kps), 1);
+  klt_worker_t *workers = calloc(nb_workers, sizeof(klt_worker_t));
+  int nb_started = 0;
+  for (int i = 0; i < nb_workers; i++) {
+    klt_worker_t *worker = &workers[i];
+    worker->klt = klt;
+    worker->pyr0 = pyr0;
+    worker->pyr1 = pyr1;
+    worker->start = (nb_kps * i) / nb_workers;
+    worker->end = (nb_kps * (i + 1)) / nb_workers;
+    worker->kps0 = kps0;
+    worker->kps1 = kps1;
+    worker->status = status;
+    worker->err = err;
+    if (nb_workers == 1) {
+      break;
+    }
+    if (pthread_create(&worker->thread, NULL, klt_worker_track, worker)) {
+      LOG_ERROR("Failed to create KLT worker thread!");
+      break;
+    }
+    nb_started++;
+  }
+  for (int i = 0; i < nb_started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  /* Track the keypoints of workers that did not run in a thread */
+  for (int i = nb_started; i < nb_workers; i++) {
+    workers[i] = workers[0];
+    workers[i].start = (nb_kps * i) / nb_workers;
+    workers[i].end = (nb_kps * (i + 1)) / nb_workers;
+    klt_worker_track(&workers[i]);
+  }
+  free(workers);
+
+  int nb_tracked = 0;
+  for (int i = 0; i < nb_kps; i++) {
+    nb_tracked += status[i];
+  }
+
+  return nb_tracked;
+}
+
+/* RANSAC --------------------------------------------------------------------*/
+
+/* Number of correspondences of a fundamental matrix sample */
+#define FUNDAMENTAL_SAMPLE_SIZE 8
+
+/* Max number of least squares refits of a RANSAC model */
+#define RANSAC_MAX_REFITS 4
+
+/**
+ * Setup RANSAC with the default settings, a 1 pixel threshold and 99%
+ * confidence.
+ */
+void ransac_setup(ransac_t *ransac) {
+  assert(ransac != NULL);
+  ransac->threshold = 1.0;
+  ransac->confidence = 0.99;
+  ransac->max_iter = 1000;
+  ransac->seed = 1;
+}
+
+/**
+ * Xorshift random number generator, advances `state` and returns a random
+ * integer in `[0, n)`.
+ */
+static int ransac_rand(uint32_t *state, const int n) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x % n;
+}
+
+/**
+ * Index of the smallest of the `n` singular values `w`, `svd()` does not
+ * sort them.
+ */
+static int svd_min_index(const real_t *w, const int n) {
+  int k_min = 0;
+  for (int k = 1; k < n; k++) {
+    k_min = (w[k] < w[k_min]) ? k : k_min;
+  }
+  return k_min;
+}
+
+/**
+ * Hartley normalization of the keypoints `kps[idx[i]]`, or the first `n` if
+ * `idx` is NULL. Keypoint `x` normalizes to `s * (x - c)`, which have zero
+ * mean and a mean distance of sqrt(2) to the origin.
+ * @returns 0 for success or -1 if all keypoints coincide
+ */
+static int fundamental_normalize(const keypoint_t *kps,
+                                 const int *idx,
+                                 const int n,
+                                 real_t c[2],
+                                 real_t *s) {
+  c[0] = 0.0;
+  c[1] = 0.0;
+  for (int i = 0; i < n; i++) {
+    const keypoint_t *kp = &kps[(idx) ? idx[i] : i];
+    c[0] += kp->x;
+    c[1] += kp->y;
+  }
+  c[0] /= n;
+  c[1] /= n;
+
+  real_t dist = 0.0;
+  for (int i = 0; i < n; i++) {
+    const keypoint_t *kp = &kps[(idx) ? idx[i] : i];
+    const real_t dx = kp->x - c[0];
+    const real_t dy = kp->y - c[1];
+    dist += sqrt(dx * dx + dy * dy);
+  }
+  if (dist < 1e-6) {
+    return -1;
+  }
+  *s = sqrt(2.0) * n / dist;
+
+  return 0;
+}
+
+/**
+ * Estimate the fundamental matrix `F`, with `x1^T F x0 = 0`, of the `n >= 8`
+ * correspondences `kps0[idx[i]]` and `kps1[idx[i]]`, or the first `n` if
+ * `idx` is NULL, with the normalized 8-point algorithm. `F` is rank 2 with
+ * unit Frobenius norm, for more than 8 correspondences it is the linear
+ * least squares fit.
+ * @returns 0 for success or -1 for failure
+ */
+int fundamental_8pt(const keypoint_t *kps0,
+                    const keypoint_t *kps1,
+                    const int *idx,
+                    const int n,
+                    real_t F[3 * 3]) {
+  assert(kps0 != NULL && kps1 != NULL && F != NULL);
+  if (n < FUNDAMENTAL_SAMPLE_SIZE) {
+    return -1;
+  }
+
+  /* Normalize */
+  real_t c0[2] = {0};
+  real_t c1[2] = {0};
+  real_t s0 = 0.0;
+  real_t s1 = 0.0;
+  if (fundamental_normalize(kps0, idx, n, c0, &s0) != 0 ||
+      fundamental_normalize(kps1, idx, n, c1, &s1) != 0) {
+    return -1;
+  }
+
+  /* Solve A f = 0, A is padded with zero rows to be at least 9 x 9 */
+  const int m = MAX(n, 9);
+  real_t *A = calloc(m * 9, sizeof(real_t));
+  for (int i = 0; i < n; i++) {
+    const int k = (idx) ? idx[i] : i;
+    const real_t x0 = (kps0[k].x - c0[0]) * s0;
+    const real_t y0 = (kps0[k].y - c0[1]) * s0;
+    const real_t x1 = (kps1[k].x - c1[0]) * s1;
+    const real_t y1 = (kps1[k].y - c1[1]) * s1;
+    real_t *a = A + i * 9;
+    a[0] = x1 * x0;
+    a[1] = x1 * y0;
+    a[2] = x1;
+    a[3] = y1 * x0;
+    a[4] = y1 * y0;
+    a[5] = y1;
+    a[6] = x0;
+    a[7] = y0;
+    a[8] = 1.0;
+  }
+
+  real_t w[9] = {0};
+  real_t V[9 * 9] = {0};
+  const int retval = svd(A, m, 9, w, V);
+  free(A);
+  if (retval != 0) {
+    return -1;
+  }
+  const int k_min = svd_min_index(w, 9);
+
+  /* Enforce rank 2 */
+  real_t U[3 * 3] = {0};
+  for (int i = 0; i < 9; i++) {
+    U[i] = V[i * 9 + k_min];
+  }
+  real_t w3[3] = {0};
+  real_t V3[3 * 3] = {0};
+  if (svd(U, 3, 3, w3, V3) != 0) {
+    return -1;
+  }
+  w3[svd_min_index(w3, 3)] = 0.0;
+
+  real_t Fn[3 * 3] = {0};
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      for (int k = 0; k < 3; k++) {
+        Fn[i * 3 + j] += U[i * 3 + k] * w3[k] * V3[j * 3 + k];
+      }
+    }
+  }
+
+  /* Denormalize, F = T1^T Fn T0 */
+  const real_t T0[3 * 3] = {s0, 0.0, -s0 * c0[0],
+                            0.0, s0, -s0 * c0[1],
+                            0.0, 0.0, 1.0};
+  const real_t T1_t[3 * 3] = {s1, 0.0, 0.0,
+                              0.0, s1, 0.0,
+                              -s1 * c1[0], -s1 * c1[1], 1.0};
+  real_t FnT0[3 * 3] = {0};
+  dot_3x3_3x3(Fn, T0, FnT0);
+  dot_3x3_3x3(T1_t, FnT0, F);
+
+  real_t norm = 0.0;
+  for (int i = 0; i < 9; i++) {
+    norm += F[i] * F[i];
+  }
+  norm = sqrt(norm);
+  for (int i = 0; i < 9; i++) {
+    F[i] /= norm;
+  }
+
+  return 0;
+}
+
+/**
+ * Mark the correspondences `(x0[i], y0[i])` and `(x1[i], y1[i])` with a
+ * Sampson distance to `F` below `threshold` in `inliers`. The points are
+ * stored SoA and the test is branch free, so the loop vectorizes.
+ * @returns Number of inliers
+ */
+static int fundamental_inliers(const real_t F[3 * 3],
+                               const real_t *restrict x0,
+                               const real_t *restrict y0,
+                               const real_t *restrict x1,
+                               const real_t *restrict y1,
+                               const int n,
+                               const real_t threshold,
+                               uint8_t *restrict inliers) {
+  const real_t f0 = F[0], f1 = F[1], f2 = F[2];
+  const real_t f3 = F[3], f4 = F[4], f5 = F[5];
+  const real_t f6 = F[6], f7 = F[7], f8 = F[8];
+  const real_t t_sq = threshold * threshold;
+
+  int nb_inliers = 0;
+#pragma GCC ivdep
+  for (int i = 0; i < n; i++) {
+    /* -- F x0 and F^T x1 */
+    const real_t a = f0 * x0[i] + f1 * y0[i] + f2;
+    const real_t b = f3 * x0[i] + f4 * y0[i] + f5;
+    const real_t c = f6 * x0[i] + f7 * y0[i] + f8;
+    const real_t d = f0 * x1[i] + f3 * y1[i] + f6;
+    const real_t e = f1 * x1[i] + f4 * y1[i] + f7;
+
+    /* -- Sampson distance r^2 / (a^2 + b^2 + d^2 + e^2) below threshold */
+    const real_t r = x1[i] * a + y1[i] * b + c;
+    const int inlier = r * r < t_sq * (a * a + b * b + d * d + e * e);
+    inliers[i] = inlier;
+    nb_inliers += inlier;
+  }
+
+  return nb_inliers;
+}
+
+/**
+ * Correspondence index and its quality, for sorting.
+ */
+typedef struct ransac_rank_t {
+  real_t quality;
+  int index;
+} ransac_rank_t;
+
+static int ransac_rank_cmp(const void *a, const void *b) {
+  const ransac_rank_t *ra = (const ransac_rank_t *) a;
+  const ransac_rank_t *rb = (const ransac_rank_t *) b;
+  if (ra->quality != rb->quality) {
+    return (ra->quality > rb->quality) ? -1 : 1;
+  }
+  return ra->index - rb->index;
+}
+
+/**
+ * Draw the next sample of `ransac_fundamental()`. Samples are drawn from the
+ * `n_top` correspondences of `order` with the highest quality. While
+ * `prosac` is set the sample always contains the lowest ranked of them, the
+ * newest member of the PROSAC sampling set.
+ */
+static void ransac_sample(const int *order,
+                          const int n_top,
+                          const int prosac,
+                          uint32_t *state,
+                          int sample[FUNDAMENTAL_SAMPLE_SIZE]) {
+  int nb_sample = 0;
+  int pool = n_top;
+  if (prosac) {
+    sample[nb_sample++] = order[n_top - 1];
+    pool = n_top - 1;
+  }
+
+  while (nb_sample < FUNDAMENTAL_SAMPLE_SIZE) {
+    const int k = order[ransac_rand(state, pool)];
+    int duplicate = 0;
+    for (int j = 0; j < nb_sample; j++) {
+      duplicate |= (sample[j] == k);
+    }
+    if (duplicate == 0) {
+      sample[nb_sample++] = k;
+    }
+  }
+}
+
+/**
+ * Locally optimize a RANSAC model, refit `F` to its `nb_inliers` `inliers`
+ * while the number of inliers grows. `pts` holds the correspondences SoA as
+ * for `fundamental_inliers()`, `idx` and `mask` are scratch buffers of `n`
+ * elements.
+ * @returns Number of inliers of the optimized model
+ */
+static int ransac_refit(const keypoint_t *kps0,
+                        const keypoint_t *kps1,
+                        const real_t *pts,
+                        const int n,
+                        const real_t threshold,
+                        real_t F[3 * 3],
+                        uint8_t *inliers,
+                        int nb_inliers,
+                        int *idx,
+                        uint8_t *mask) {
+  const real_t *x0 = pts;
+  const real_t *y0 = pts + n;
+  const real_t *x1 = pts + 2 * n;
+  const real_t *y1 = pts + 3 * n;
+
+  for (int iter = 0; iter < RANSAC_MAX_REFITS; iter++) {
+    int nb_idx = 0;
+    for (int i = 0; i < n; i++) {
+      if (inliers[i]) {
+        idx[nb_idx++] = i;
+      }
+    }
+
+    real_t F_refit[3 * 3] = {0};
+    if (fundamental_8pt(kps0, kps1, idx, nb_idx, F_refit) != 0) {
+      break;
+    }
+    const int nb_refit =
+        fundamental_inliers(F_refit, x0, y0, x1, y1, n, threshold, mask);
+    if (nb_refit <= nb_inliers) {
+      break;
+    }
+    nb_inliers = nb_refit;
+    memcpy(F, F_refit, sizeof(real_t) * 9);
+    memcpy(inliers, mask, sizeof(uint8_t) * n);
+  }
+
+  return nb_inliers;
+}
+
+/**
+ * Estimate the fundamental matrix `F` of the `n` correspondences `kps0` and
+ * `kps1` with RANSAC and the normalized 8-point algorithm, `inliers[i]` is
+ * set to 1 if correspondence `i` is an inlier and 0 otherwise. Each sample
+ * model with more inliers than any before is locally optimized by refitting
+ * it to all of its inliers, since minimal sample models are noisy.
+ *
+ * The number of iterations adapts to the inlier ratio of the best model so
+ * far, up to `ransac->max_iter`. If `quality` is not NULL, e.g. the track
+ * age of each correspondence, samples are drawn PROSAC style from a set of
+ * the highest quality correspondences that progressively grows to all
+ * correspondences. This finds a good model in fewer iterations when quality
+ * correlates with being an inlier, and falls back to RANSAC when not.
+ * @returns Number of inliers, or -1 if no model was found
+ */
+int ransac_fundamental(const ransac_t *ransac,
+                       const keypoint_t *kps0,
+                       const keypoint_t *kps1,
+                       const real_t *quality,
+                       const int n,
+                       real_t F[3 * 3],
+                       uint8_t *inliers) {
+  assert(ransac != NULL && kps0 != NULL && kps1 != NULL);
+  assert(F != NULL && inliers != NULL);
+  const int m = FUNDAMENTAL_SAMPLE_SIZE;
+  memset(inliers, 0, sizeof(uint8_t) * MAX(n, 0));
+  if (n < m) {
+    return -1;
+  }
+
+  /* SoA points for scoring */
+  real_t *pts = malloc(sizeof(real_t) * 4 * n);
+  real_t *x0 = pts;
+  real_t *y0 = pts + n;
+  real_t *x1 = pts + 2 * n;
+  real_t *y1 = pts + 3 * n;
+  for (int i = 0; i < n; i++) {
+    x0[i] = kps0[i].x;
+    y0[i] = kps0[i].y;
+    x1[i] = kps1[i].x;
+    y1[i] = kps1[i].y;
+  }
+
+  /* Correspondences by decreasing quality */
+  int *order = malloc(sizeof(int) * n);
+  if (quality) {
+    ransac_rank_t *ranks = malloc(sizeof(ransac_rank_t) * n);
+    for (int i = 0; i < n; i++) {
+      ranks[i].quality = quality[i];
+      ranks[i].index = i;
+    }
+    qsort(ranks, n, sizeof(ransac_rank_t), ransac_rank_cmp);
+    for (int i = 0; i < n; i++) {
+      order[i] = ranks[i].index;
+    }
+    free(ranks);
+  } else {
+    for (int i = 0; i < n; i++) {
+      order[i] = i;
+    }
+  }
+
+  /* PROSAC growth function, `T_n` is the expected number of the `max_iter`
+   * samples drawn only from the top `n_top` correspondences */
+  int n_top = (quality) ? m : n;
+  double T_n = ransac->max_iter;
+  for (int i = 0; i < m; i++) {
+    T_n *= (double) (m - i) / (n - i);
+  }
+  double T_n_prime = 1.0;
+
+  /* Hypothesize and verify */
+  const real_t th = ransac->threshold;
+  uint8_t *mask = malloc(sizeof(uint8_t) * n);
+  uint8_t *scratch = malloc(sizeof(uint8_t) * n);
+  int *idx = malloc(sizeof(int) * n);
+  real_t F_best[3 * 3] = {0};
+  int best = -1;
+  int best_sample = -1;
+  int nb_iter = ransac->max_iter;
+  uint32_t state = (ransac->seed) ? ransac->seed : 1;
+  for (int t = 1; t <= nb_iter; t++) {
+    /* -- Grow the PROSAC sampling set */
+    if (n_top < n && t > T_n_prime) {
+      const double T_next = T_n * (n_top + 1) / (n_top + 1 - m);
+      T_n_prime += ceil(T_next - T_n);
+      T_n = T_next;
+      n_top++;
+    }
+
+    /* -- Hypothesis */
+    int sample[FUNDAMENTAL_SAMPLE_SIZE];
+    ransac_sample(order, n_top, n_top < n && t <= T_n_prime, &state, sample);
+    real_t F_k[3 * 3] = {0};
+    if (fundamental_8pt(kps0, kps1, sample, m, F_k) != 0) {
+      continue;
+    }
+
+    /* -- Verify, locally optimize the best sample models */
+    int nb_inliers = fundamental_inliers(F_k, x0, y0, x1, y1, n, th, mask);
+    if (nb_inliers <= best_sample) {
+      continue;
+    }
+    best_sample = nb_inliers;
+    nb_inliers = ransac_refit(kps0, kps1, pts, n, th, F_k, mask, nb_inliers,
+                              idx, scratch);
+    if (nb_inliers <= best) {
+      continue;
+    }
+    best = nb_inliers;
+    memcpy(F_best, F_k, sizeof(real_t) * 9);
+    memcpy(inliers, mask, sizeof(uint8_t) * n);
+
+    /* -- Iterations needed for an outlier free sample with `confidence` */
+    const double p_good = pow((double) best / n, m);
+    if (p_good >= 1.0) {
+      break;
+    } else if (p_good > DBL_EPSILON) {
+      const double k = log(1.0 - ransac->confidence) / log(1.0 - p_good);
+      nb_iter = MIN(ransac->max_iter, ceil(k));
+    }
+  }
+  memcpy(F, F_best, sizeof(real_t) * 9);
+
+  free(pts);
+  free(order);
+  free(mask);
+  free(scratch);
+  free(idx);
+
+  return (best >= m) ? best : -1;
+}
+
+/* RADTAN --------------------------------------------------------------------*/
+
+/**
+ * Distort 2x1 point `p` using Radial-Tangential distortion, where the
+ * distortion params are stored in `params` (k1, k2, p1, p2), results are
+ * written to 2x1 vector `p_d`.
+ */
+void radtan4_distort(const real_t params[4], const real_t p[2], real_t p_d[2]) {
+  assert(params != NULL);
+  assert(p != NULL);
+  assert(p_d != NULL);
+
+  /* Distortion parameters */
+  const real_t k1 = params[0];
+  const real_t k2 = params[1];
+  const real_t p1 = params[2];
+  const real_t p2 = params[3];
+
+  /* Point */
+  const real_t x = p[0];
+  const real_t y = p[1];
+
+  /* Apply radial distortion */
+  const real_t x2 = x * x;
+  const real_t y2 = y * y;
+  const real_t r2 = x2 + y2;
+  const real_t r4 = r2 * r2;
+  const real_t radial_factor = 1.0 + (k1 * r2) + (k2 * r4);
+  const real_t x_dash = x * radial_factor;
+  const real_t y_dash = y * radial_factor;
+
+  /* Apply tangential distortion */
+  const real_t xy = x * y;
+  const real_t x_ddash = x_dash + (2.0 * p1 * xy + p2 * (r2 + 2.0 * x2));
+  const real_t y_ddash = y_dash + (p1 * (r2 + 2.0 * y2) + 2.0 * p2 * xy);
+
+  /* Distorted point */
+  p_d[0] = x_ddash;
+  p_d[1] = y_ddash;
+}
+
+/**
+ * Form Radial-Tangential point jacobian, using distortion `params` (k1, k2,
+ * p1, p2), 2x1 image point `p`, the jacobian is written to 2x2 `J_point`.
+ */
+void radtan4_point_jacobian(const real_t params[4],
+                            const real_t p[2],
+                            real_t J_point[2 * 2]) {
+  assert(params != NULL);
+  assert(p != NULL);
+  assert(J_point != NULL);
+
+  /* Distortion parameters */
+  const real_t k1 = params[0];
+  const real_t k2 = params[1];
+  const real_t p1 = params[2];
+  const real_t p2 = params[3];
+
+  /* Point */
+  const real_t x = p[0];
+  const real_t y = p[1];
+
+  /* Apply radial distortion */
+  const real_t x2 = x * x;
+  const real_t y2 = y * y;
+  const real_t r2 = x2 + y2;
+  const real_t r4 = r2 * r2;
+
+  /* Point Jacobian is 2x2 */
+  J_point[0] = k1 * r2 + k2 * r4 + 2 * p1 * y + 6 * p2 * x;
+  J_point[0] += x * (2 * k1 * x + 4 * k2 * x * r2) + 1;
+  J_point[1] = 2 * p1 * x + 2 * p2 * y + y * (2 * k1 * x + 4 * k2 * x * r2);
+  J_point[2] = J_point[1];
+  J_point[3] = k1 * r2 + k2 * r4 + 6 * p1 * y + 2 * p2 * x;
+  J_point[3] += y * (2 * k1 * y + 4 * k2 * y * r2) + 1;
+}
+
+/**
+ * Form Radial-Tangential parameter jacobian, using distortion `params` (k1,
+ * k2, p1, p2), 2x1 image point `p`, the jacobian is written to 2x4 `J_param`.
+ */
+void radtan4_params_jacobian(const real_t params[4],
+                             const real_t p[2],
+                             real_t J_param[2 * 4]) {
+  assert(params != NULL);
+  assert(p != NULL);
+  assert(J_param != NULL);
+  UNUSED(params);
+
+  /* Point */
+  const real_t x = p[0];
+  const real_t y = p[1];
+
+  /* Setup */
+  const real_t x2 = x * x;
+  const real_t y2 = y * y;
+  const real_t xy = x * y;
+  const real_t r2 = x2 + y2;
+  const real_t r4 = r2 * r2;
+
+  /* Param Jacobian is 2x4 */
+  J_param[0] = x * r2;
+  J_param[1] = x * r4;
+  J_param[2] = 2 * xy;
+  J_param[3] = 3 * x2 + y2;
+
+  J_param[4] = y * r2;
+  J_param[5] = y * r4;
+  J_param[6] = x2 + 3 * y2;
+  J_param[7] = 2 * xy;
+}
+
+/* EQUI ----------------------------------------------------------------------*/
+
+/**
+ * Distort 2x1 point `p` using Equi-Distant distortion, where the
+ * distortion params are stored in `params` (k1, k2, k3, k4), results are
+ * written to 2x1 vector `p_d`.
+ */
+void equi4_distort(const real_t params[4], const real_t p[2], real_t p_d[2]) {
+  assert(params != NULL);
+  assert(p != NULL);
+  assert(p_d != NULL);
+
+  const real_t k1 = params[0];
+  const real_t k2 = params[1];
+  const real_t k3 = params[2];
+  const real_t k4 = params[3];
+
+  const real_t x = p[0];
+  const real_t y = p[1];
+  const real_t r = sqrt(x * x + y * y);
+
+  const real_t th = atan(r);
+  const real_t th2 = th * th;
+  const real_t th4 = th2 * th2;
+  const real_t th6 = th4 * th2;
+  const real_t th8 = th4 * th4;
+  const real_t thd = th * (1.0 + k1 * th2 + k2 * th4 + k3 * th6 + k4 * th8);
+  const real_t s = thd / r;
+
+  p_d[0] = s * x;
+  p_d[1] = s * y;
+}
+
+/**
+ * Form Equi-Distant point jacobian, using distortion `params` (k1, k2, k3,
+ * k4), 2x1 image point `p`, the jacobian is written to 2x2 `J_point`.
+ */
+void equi4_point_jacobian(const real_t params[4],
+                          const real_t p[2],
+                          real_t J_point[2 * 2]) {
+  assert(params != NULL);
+  assert(p != NULL);
+  assert(J_point != NULL);
+
+  const real_t k1 = params[0];
+  const real_t k2 = params[1];
+  const real_t k3 = params[2];
+  const real_t k4 = params[3];
+
+  const real_t x = p[0];
+  const real_t y = p[1];
+  const real_t r = sqrt(x * x + y * y);
+
+  const real_t th = atan(r);
+  const real_t th2 = th * th;
+  const real_t th4 = th2 * th2;
+  const real_t th6 = th4 * th2;
+  const real_t th8 = th4 * th4;
+  const real_t thd = th * (1.0 + k1 * th2 + k2 * th4 + k3 * th6 + k4 * th8);
+
+  const real_t th_r = 1.0 / (r * r + 1.0);
+  const real_t thd_th =
+      1.0 + 3.0 * k1 * th2 + 5.0 * k2 * th4 + 7.0 * k3 * th6 + 9.0 * k4 * th8;
+  const real_t s = thd / r;
+  const real_t s_r = thd_th * th_r / r - thd / (r * r);
+  const real_t r_x = 1.0 / r * x;
+  const real_t r_y = 1.0 / r * y;
+
+  /* Point Jacobian is 2x2 */
+  J_point[0] = s + x * s_r * r_x;
+  J_point[1] = x * s_r * r_y;
+  J_point[2] = y * s_r * r_x;
+  J_point[3] = s + y * s_r * r_y;
+}
+
+/**
+ * Form Equi-Distant parameter jacobian, using distortion `params` (k1, k2, k3,
+ * k4), 2x1 image point `p`, the jacobian is written to 2x4 `J_param`.
+ */
+void equi4_params_jacobian(const real_t params[4],
+                           const real_t p[2],
+                           real_t J_param[2 * 4]) {
+  assert(params != NULL);
+  assert(p != NULL);
+  assert(J_param != NULL);
+  UNUSED(params);
+
+  const real_t x = p[0];
+  const real_t y = p[1];
+  const real_t r = sqrt(x * x + y * y);
+
+  const real_t th = atan(r);
+  const real_t th2 = th * th;
+  const real_t th3 = th2 * th;
+  const real_t th5 = th3 * th2;
+  const real_t th7 = th5 * th2;
+  const real_t th9 = th7 * th2;
+
+  /* Param Jacobian is 2x4 */
+  J_param[0] = x * th3 / r;
+  J_param[1] = x * th5 / r;
+  J_param[2] = x * th7 / r;
+  J_param[3] = x * th9 / r;
+
+  J_param[4] = y * th3 / r;
+  J_param[5] = y * th5 / r;
+  J_param[6] = y * th7 / r;
+  J_param[7] = y * th9 / r;
+}
+
+/* PINHOLE -------------------------------------------------------------------*/
+
+/**
+ * Estimate pinhole focal length. The focal length is estimated using
+ * `image_width` [pixels], and `fov` (Field of view of the camera) [rad].
+ */
+real_t pinhole_focal(const int image_width, const real_t fov) {
+  return ((image_width / 2.0) / tan(deg2rad(fov) / 2.0));
+}
+
+/**
+ * Project 3D point `p_C` observed from the camera to the image plane `x` using
+ * pinhole parameters `params` (fx, fy, cx, cy).
+ */
+void pinhole_project(const real_t params[4], const real_t p_C[3], real_t x[2]) {
+  assert(params != NULL);
+  assert(p_C != NULL);
+  assert(x != NULL);
+
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+
+  const real_t px = p_C[0] / p_C[2];
+  const real_t py = p_C[1] / p_C[2];
+
+  x[0] = px * fx + cx;
+  x[1] = py * fy + cy;
+}
+
+/**
+ * Form Pinhole point jacobian `J` using pinhole parameters `params`.
+ */
+void pinhole_point_jacobian(const real_t params[4], real_t J[2 * 2]) {
+  J[0] = params[0];
+  J[1] = 0.0;
+  J[2] = 0.0;
+  J[3] = params[1];
+}
+
+/**
+ * Form Pinhole parameter jacobian `J` using pinhole parameters `params` and
+ * 2x1 image point `x`.
+ */
+void pinhole_params_jacobian(const real_t params[4],
+                             const real_t x[2],
+                             real_t J[2 * 4]) {
+  assert(params != NULL);
+  assert(x != NULL);
+  assert(J != NULL);
+  UNUSED(params);
+
+  J[0] = x[0];
+  J[1] = 0.0;
+  J[2] = 1.0;
+  J[3] = 0.0;
+
+  J[4] = 0.0;
+  J[5] = x[1];
+  J[6] = 0.0;
+  J[7] = 1.0;
+}
+
+/* PINHOLE-RADTAN4 -----------------------------------------------------------*/
+
+/**
+ * Projection of 3D point to image plane using Pinhole + Radial-Tangential.
+ *
+ * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, p1, p2)
+ * @param[in] p_C 3x1 Point vector observed in camera frame
+ * @param[out] x 2x1 Projected image point
+ */
+void pinhole_radtan4_project(const real_t params[8],
+                             const real_t p_C[3],
+                             real_t x[2]) {
+  assert(params != NULL);
+  assert(p_C != NULL);
+  assert(x != NULL);
+
+  /* Project */
+  const real_t p[2] = {p_C[0] / p_C[2], p_C[1] / p_C[2]};
+
+  /* Distort */
+  const real_t d[4] = {params[4], params[5], params[6], params[7]};
+  real_t p_d[2] = {0};
+  radtan4_distort(d, p, p_d);
+
+  /* Scale and center */
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+
+  x[0] = p_d[0] * fx + cx;
+  x[1] = p_d[1] * fy + cy;
+}
+
+/**
+ * Projection Jacobian of Pinhole + Radial-Tangential.
+ *
+ * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, p1, p2)
+ * @param[in] p_C 3x1 Point vector observed in camera frame
+ * @param[out] J 2x3 Projection Jacobian
+ */
+void pinhole_radtan4_project_jacobian(const real_t params[8],
+                                      const real_t p_C[3],
+                                      real_t J[2 * 3]) {
+  assert(params != NULL);
+  assert(p_C != NULL);
+  assert(J != NULL);
+
+  /* Project */
+  const real_t x = p_C[0];
+  const real_t y = p_C[1];
+  const real_t z = p_C[2];
+  const real_t p[2] = {x / z, y / z};
+
+  /* Projection Jacobian */
+  real_t J_proj[2 * 3] = {0};
+  J_proj[0] = 1.0 / z;
+  J_proj[1] = 0.0;
+  J_proj[2] = -x / (z * z);
+  J_proj[3] = 0.0;
+  J_proj[4] = 1.0 / z;
+  J_proj[5] = -y / (z * z);
+
+  /* Distortion Point Jacobian */
+  const real_t k1 = params[4];
+  const real_t k2 = params[5];
+  const real_t p1 = params[6];
+  const real_t p2 = params[7];
+  const real_t d[4] = {k1, k2, p1, p2};
+  real_t J_dist_point[2 * 2] = {0};
+  radtan4_point_jacobian(d, p, J_dist_point);
+
+  /* Project Point Jacobian */
+  real_t J_proj_point[2 * 2] = {0};
+  pinhole_point_jacobian(params, J_proj_point);
+
+  /* J = J_proj_point * J_dist_point * J_proj; */
+  real_t J_dist_proj[2 * 3] = {0};
+  dot_2x2_2x3(J_dist_point, J_proj, J_dist_proj);
+  dot_2x2_2x3(J_proj_point, J_dist_proj, J);
+}
+
+/**
+ * Parameter Jacobian of Pinhole + Radial-Tangential.
+ *
+ * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, p1, p2)
+ * @param[in] p_C 3x1 Point vector observed in camera frame
+ * @param[out] J 2x8 Parameter Jacobian
+ */
+void pinhole_radtan4_params_jacobian(const real_t params[8],
+                                     const real_t p_C[3],
+                                     real_t J[2 * 8]) {
+  assert(params != NULL);
+  assert(p_C != NULL);
+  assert(J != NULL);
+
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+  const real_t k[4] = {fx, fy, cx, cy};
+
+  const real_t k1 = params[4];
+  const real_t k2 = params[5];
+  const real_t p1 = params[6];
+  const real_t p2 = params[7];
+  const real_t d[4] = {k1, k2, p1, p2};
+
+  /* Project */
+  const real_t x = p_C[0];
+  const real_t y = p_C[1];
+  const real_t z = p_C[2];
+  const real_t p[2] = {x / z, y / z};
+
+  /* Distort */
+  real_t p_d[2] = {0};
+  radtan4_distort(d, p, p_d);
+
+  /* Project params Jacobian: J_proj_params */
+  real_t J_proj_params[2 * 4] = {0};
+  pinhole_params_jacobian(k, p_d, J_proj_params);
+
+  /* Project point Jacobian: J_proj_point */
+  real_t J_proj_point[2 * 2] = {0};
+  pinhole_point_jacobian(k, J_proj_point);
+
+  /* Distortion point Jacobian: J_dist_params */
+  real_t J_dist_params[2 * 4] = {0};
+  radtan4_params_jacobian(d, p, J_dist_params);
+
+  /* J_dist = J_proj_point * J_dist_params */
+  real_t J_dist[2 * 4] = {0};
+  dot_2x2_2x4(J_proj_point, J_dist_params, J_dist);
+
+  /* J = [J_proj_params, J_proj_point * J_dist_params] */
+  J[0] = J_proj_params[0];
+  J[1] = J_proj_params[1];
+  J[2] = J_proj_params[2];
+  J[3] = J_proj_params[3];
+  J[4] = J_dist[0];
+  J[5] = J_dist[1];
+  J[6] = J_dist[2];
+  J[7] = J_dist[3];
+
+  J[8] = J_proj_params[4];
+  J[9] = J_proj_params[5];
+  J[10] = J_proj_params[6];
+  J[11] = J_proj_params[7];
+  J[12] = J_dist[4];
+  J[13] = J_dist[5];
+  J[14] = J_dist[6];
+  J[15] = J_dist[7];
+}
+
+/* PINHOLE-EQUI4 -------------------------------------------------------------*/
+
+/**
+ * Projection of 3D point to image plane using Pinhole + Equi-Distant.
+ *
+ * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, k3, k4)
+ * @param[in] p_C 3x1 Point vector observed in camera frame
+ * @param[out] x 2x1 Projected image point
+ */
+void pinhole_equi4_project(const real_t params[8],
+                           const real_t p_C[3],
+                           real_t x[2]) {
+  assert(params != NULL);
+  assert(p_C != NULL);
+  assert(x != NULL);
+
+  /* Project */
+  const real_t p[2] = {p_C[0] / p_C[2], p_C[1] / p_C[2]};
+
+  /* Distort */
+  const real_t d[4] = {params[4], params[5], params[6], params[7]};
+  real_t p_d[2] = {0};
+  equi4_distort(d, p, p_d);
+
+  /* Scale and center */
+  const real_t fx = params[0];
+  const real_t fy = params[1];
+  const real_t cx = params[2];
+  const real_t cy = params[3];
+
+  x[0] = p[0] * fx + cx;
+  x[1] = p[1] * fy + cy;
+}
+
+/**
+ * Projection Jacobian of Pinhole + Equi-Distant.
+ *
+ * @param[in] params Intrinsics parameters (fx, fy, cx, cy, k1, k2, k3, k4)
+ * @param[in] p_C 3x1 Point vector observed in camera frame
+ * @param[out] J 2x3 Projection Jacobian
+ */
+void pinhole_equi4_project_jacobian(const real_t params[8],
+                                    const real_t p_C[3],
+                                    real_t J[2 * 3]) {
+  assert(params != NULL);
+  assert(p_C != NULL);
+  assert(J != NULL);
+
+  /* Project */
+  const real_t x = p_C[0];
+  const real_t y = p_C[0];
+  const real_t z = p_C[0];
+  const real_t p[2] = {x / z, y / z};
+
+  /* Projection Jacobian */
+  real_t J_proj[2 * 3] = {0};
+  J_proj[0] = 1.0 / z;
+  J_proj[1] = 0.0;
+  J_proj[2] = -x / (z * z);
+  J_proj[3] = 0.0;
+  J_proj[4] = 1.0 / z;
+  J_proj[5] = -y / (z * z);
+
+  /* Distortion Point Jacobian */
+  const real_t k1 = params[4];
+  const real_t k2 = params[5];
+  const real_t p1 = params[6];
+  const real_t p2 = params[7];
+  const real_t d[4] = {k1, k2, p1, p2};
+  real_t J_dist_point[2 * 2] = {0};
+  equi4_point_jacobian(d, p, J_dist_point);
+
+  /* Project Point Jacobian */
+  real_t J_proj_point[2 * 3] = {0};
+  pinhole_point_jacobian(params, J_proj_point);
+
+  /* J = J_proj * J_dist_point * J_proj_point; */
+  real_t J_dist_proj[2 * 3] = {0};
+  dot_2x2_2x3(J_dist_point, J_proj, J_dist_proj);
+  dot_2x2_2x3(J_proj, J_dist_proj, J);
+}
+
+/******************************************************************************
+ * SENSOR FUSION
+ ******************************************************************************/
+
+/* POSE --------------------------------------------------------------------- */
+
+void pose_setup(pose_t *pose, const timestamp_t ts, const real_t *data) {
+  assert(pose != NULL);
+  assert(data != NULL);
+
+  /* Timestamp */
+  pose->ts = ts;
+
+  /* Quaternion */
+  pose->data[0] = data[0];
+  pose->data[1] = data[1];
+  pose->data[2] = data[2];
+  pose->data[3] = data[3];
+
+  /* Translation */
+  pose->data[4] = data[4];
+  pose->data[5] = data[5];
+  pose->data[6] = data[6];
+}
+
+/* SPEED AND BIASES --------------------------------------------------------- */
+
+void speed_biases_setup(speed_biases_t *sb,
+                        const timestamp_t ts,
+                        const real_t *data) {
+  assert(sb != NULL);
+  assert(data != NULL);
+
+  /* Timestamp */
+  sb->ts = ts;
+
+  /* Velocity */
+  sb->data[0] = data[0];
+  sb->data[1] = data[1];
+  sb->data[2] = data[2];
+
+  /* Accel biases */
+  sb->data[3] = data[3];
+  sb->data[4] = data[4];
+  sb->data[5] = data[5];
+
+  /* Gyro biases */
+  sb->data[6] = data[6];
+  sb->data[7] = data[7];
+  sb->data[8] = data[8];
+}
+
+/* FEATURE ------------------------------------------------------------------ */
+
+void feature_setup(feature_t *p, const real_t *data) {
+  assert(p != NULL);
+  assert(data != NULL);
+
+  p->data[0] = data[0];
+  p->data[1] = data[1];
+  p->data[2] = data[2];
+}
+
+/* EXTRINSICS --------------------------------------------------------------- */
+
+void extrinsics_setup(extrinsics_t *extrinsics, const real_t *data) {
+  assert(extrinsics != NULL);
+  assert(data != NULL);
+
+  /* Quaternion */
+  extrinsics->data[0] = data[0];
+  extrinsics->data[1] = data[1];
+  extrinsics->data[2] = data[2];
+  extrinsics->data[3] = data[3];
+
+  /* Translation */
+  extrinsics->data[4] = data[4];
+  extrinsics->data[5] = data[5];
+  extrinsics->data[6] = data[6];
+}
+
+/* CAMERA PARAMS ------------------------------------------------------------ */
+
+void camera_params_setup(camera_params_t *camera,
+                         const int cam_idx,
+                         const int cam_res[2],
+                         const char *proj_model,
+                         const char *dist_model,
+                         const real_t data[8]) {
+  assert(camera != NULL);
+  assert(cam_res != NULL);
+  assert(proj_model != NULL);
+  assert(dist_model != NULL);
+  assert(data != NULL);
+
+  camera->cam_idx = cam_idx;
+  camera->resolution[0] = cam_res[0];
+  camera->resolution[1] = cam_res[1];
+
+  strcpy(camera->proj_model, proj_model);
+  strcpy(camera->dist_model, dist_model);
+
+  camera->data[0] = data[0];
+  camera->data[1] = data[1];
+  camera->data[2] = data[2];
+  camera->data[3] = data[3];
+  camera->data[4] = data[4];
+  camera->data[5] = data[5];
+  camera->data[6] = data[6];
+  camera->data[7] = data[7];
+}
+
+void camera_params_print(const camera_params_t *camera) {
+  assert(camera);
+
+  printf("cam_idx: %d\n", camera->cam_idx);
+  printf("cam_res: [%d, %d]\n", camera->resolution[0], camera->resolution[1]);
+  printf("proj_model: %s\n", camera->proj_model);
+  printf("dist_model: %s\n", camera->dist_model);
+  printf("data: [");
+  for (int i = 0; i < 8; i++) {
+    if ((i + 1) < 8) {
+      printf("%f, ", camera->data[i]);
+    } else {
+      printf("%f", camera->data[i]);
+    }
+  }
+  printf("]\n");
+}
+
+/* POSE FACTOR -------------------------------------------------------------- */
+
+void pose_factor_setup(pose_factor_t *factor,
+                       pose_t *pose,
+                       const real_t var[6]) {
+  assert(factor != NULL);
+  assert(pose != NULL);
+  assert(var != NULL);
+
+  zeros(factor->pose_meas, 7, 1);
+  factor->pose_est = pose;
+
+  zeros(factor->covar, 6, 6);
+  factor->covar[0] = 1.0 / (var[0] * var[0]);
+  factor->covar[7] = 1.0 / (var[1] * var[1]);
+  factor->covar[14] = 1.0 / (var[2] * var[2]);
+  factor->covar[21] = 1.0 / (var[3] * var[3]);
+  factor->covar[28] = 1.0 / (var[4] * var[4]);
+  factor->covar[35] = 1.0 / (var[5] * var[5]);
+
+  zeros(factor->r, 6, 1);
+  factor->r_size = 6;
+
+  zeros(factor->J0, 6, 6);
+  factor->jacs[0] = factor->J0;
+  factor->nb_params = 1;
+}
+
+void pose_factor_reset(pose_factor_t *factor) {
+  zeros(factor->r, 6, 1);
+  zeros(factor->J0, 6, 6);
+}
+
+int pose_factor_eval(pose_factor_t *factor) {
+  assert(factor != NULL);
+
+  /* Map params */
+  real_t pose_est[4 * 4] = {0};
   real_t pose_meas[4 * 4] = {0};
   tf(factor->pose_est->data, pose_est);
   tf(factor->pose_meas, pose_meas);
 
-  /* Invert estimated pose */
-  real_t pose_est_inv[4 * 4] = {0};
-  tf_inv(pose_est, pose_est_inv);
+  /* Invert estimated pose */
+  real_t pose_est_inv[4 * 4] = {0};
+  tf_inv(pose_est, pose_est_inv);
+
+  /* Calculate delta pose */
+  real_t dpose[4 * 4] = {0};
+  dot_4x4_4x4(pose_est, pose_meas, dpose);
+
+  /* Calculate pose error */
+  real_t *r = factor->r;
+  const real_t dqw = dpose[0];
+  const real_t dqx = dpose[1];
+  const real_t dqy = dpose[2];
+  const real_t dqz = dpose[3];
+  const real_t drx = dpose[4];
+  const real_t dry = dpose[5];
+  const real_t drz = dpose[6];
+  /* -- dtheta */
+  r[0] = 2.0 * dqx;
+  r[1] = 2.0 * dqy;
+  r[2] = 2.0 * dqz;
+  /* -- dr */
+  r[3] = drx;
+  r[4] = dry;
+  r[5] = drz;
+
+  /* Calculate Jacobians */
+  /* clang-format off */
+  real_t *J = factor->J0;
+  J[0]  = -dqw; J[1]  =  dqz; J[2]  = -dqy; J[3]  =  0.0; J[4]  =  0.0; J[5]  =  0.0;
+  J[6]  = -dqz; J[7]  = -dqw; J[8]  =  dqx; J[9]  =  0.0; J[10] =  0.0; J[11] =  0.0;
+  J[12] =  dqy; J[13] = -dqx; J[14] = -dqw; J[15] =  0.0; J[16] =  0.0; J[17] =  0.0;
+  J[18] =  0.0; J[19] =  0.0; J[20] =  0.0; J[21] = -1.0; J[22] =  0.0; J[23] =  0.0;
+  J[24] =  0.0; J[25] =  0.0; J[26] =  0.0; J[27] =  0.0; J[28] = -1.0; J[29] =  0.0;
+  J[30] =  0.0; J[31] =  0.0; J[32] =  0.0; J[33] =  0.0; J[34] =  0.0; J[35] = -1.0;
+  factor->jacs[0] = J;
+  /* clang-format on */
+
+  return 0;
+}
+
+/* BA FACTOR ---------------------------------------------------------------- */
+
+void ba_factor_setup(ba_factor_t *factor,
+                     pose_t *pose,
+                     feature_t *feature,
+                     camera_params_t *camera,
+                     const real_t var[2]) {
+  factor->pose = pose;
+  factor->feature = feature;
+  factor->camera = camera;
+
+  factor->covar[0] = 1.0 / (var[0] * var[0]);
+  factor->covar[1] = 0.0;
+  factor->covar[2] = 0.0;
+  factor->covar[3] = 1.0 / (var[1] * var[1]);
+
+  zeros(factor->r, 2, 1);
+  factor->r_size = 2;
+
+  zeros(factor->J0, 2, 6);
+  zeros(factor->J1, 2, 3);
+  factor->jacs[0] = factor->J0;
+  factor->jacs[1] = factor->J1;
+  factor->nb_params = 4;
+}
+
+int ba_factor_eval(ba_factor_t *factor) {
+  assert(factor != NULL);
+  assert(factor->pose);
+  assert(factor->feature);
+  assert(factor->camera);
+
+  /* Map params */
+  /* -- Camera pose */
+  real_t T_WC[4 * 4] = {0};
+  tf(factor->pose->data, T_WC);
+  /* -- Feature */
+  real_t *p_W = factor->feature->data;
+  /* -- Camera params */
+  real_t *cam_params = factor->camera->data;
+
+  /* Calculate residuals */
+  /* -- Project point from world to image plane */
+  real_t T_CW[4 * 4] = {0};
+  real_t p_C[3] = {0};
+  real_t z_hat[2];
+  tf_inv(T_WC, T_CW);
+  tf_point(T_CW, p_W, p_C);
+  pinhole_radtan4_project(cam_params, p_C, z_hat);
+  /* -- Residual */
+  real_t err[2] = {0};
+  err[0] = factor->z[0] - z_hat[0];
+  err[1] = factor->z[1] - z_hat[1];
+  /* -- Weighted residual */
+  real_t sqrt_info[2 * 2] = {0};
+  sqrt_info[0] = sqrt(factor->covar[0]);
+  sqrt_info[1] = 0.0;
+  sqrt_info[2] = 0.0;
+  sqrt_info[3] = sqrt(factor->covar[3]);
+  dot_2x2_2x1(sqrt_info, err, factor->r);
+
+  /* Calculate jacobians */
+  /* -- Form: -1 * sqrt_info */
+  real_t neg_sqrt_info[2 * 2] = {0};
+  mat_copy(sqrt_info, 2, 2, neg_sqrt_info);
+  mat_scale(neg_sqrt_info, 2, 2, -1.0);
+  /* -- Form: Jh_weighted = -1 * sqrt_info * J_h */
+  real_t J_h[2 * 3] = {0};
+  real_t Jh_weighted[2 * 3] = {0};
+  pinhole_radtan4_project_jacobian(cam_params, p_C, J_h);
+  dot_2x2_2x3(neg_sqrt_info, J_h, Jh_weighted);
+  /* -- Fill jacobians */
+
+  return 0;
+}
+
+/* CAMERA FACTOR ------------------------------------------------------------ */
+
+void cam_factor_setup(cam_factor_t *factor,
+                      pose_t *pose,
+                      extrinsics_t *extrinsics,
+                      feature_t *feature,
+                      camera_params_t *camera,
+                      const real_t var[2]) {
+  factor->pose = pose;
+  factor->extrinsics = extrinsics;
+  factor->feature = feature;
+  factor->camera = camera;
+
+  factor->covar[0] = 1.0 / (var[0] * var[0]);
+  factor->covar[1] = 0.0;
+  factor->covar[2] = 0.0;
+  factor->covar[3] = 1.0 / (var[1] * var[1]);
+
+  zeros(factor->r, 2, 1);
+  factor->r_size = 2;
+
+  zeros(factor->J0, 2, 6);
+  zeros(factor->J1, 2, 6);
+  zeros(factor->J2, 2, 8);
+  zeros(factor->J3, 2, 3);
+  factor->jacs[0] = factor->J0;
+  factor->jacs[1] = factor->J1;
+  factor->jacs[2] = factor->J2;
+  factor->jacs[3] = factor->J3;
+  factor->nb_params = 4;
+}
+
+void cam_factor_reset(cam_factor_t *factor) {
+  zeros(factor->r, 2, 1);
+  zeros(factor->J0, 2, 6);
+  zeros(factor->J1, 2, 6);
+  zeros(factor->J2, 2, 8);
+  zeros(factor->J3, 2, 3);
+}
+
+static void cam_factor_sensor_pose_jacobian(const real_t Jh_weighted[2 * 3],
+                                            const real_t T_SC[3 * 3],
+                                            const real_t T_WS[3 * 3],
+                                            const real_t p_W[3],
+                                            real_t J[2 * 6]) {
+  /* J[0:2, 0:3] = -1 * sqrt_info * J_h * C_CS * C_SW * skew(p_W - r_WS); */
+  /* J[0:2, 3:5] = -1 * sqrt_info * J_h * C_CS * -C_SW; */
+
+  /* Setup */
+  real_t C_SC[3 * 3] = {0};
+  real_t C_CS[3 * 3] = {0};
+  real_t C_WS[3 * 3] = {0};
+  real_t C_SW[3 * 3] = {0};
+  real_t C_CW[3 * 3] = {0};
+
+  tf_rot_get(T_SC, C_SC);
+  mat_transpose(C_SC, 3, 3, C_CS);
+  tf_rot_get(T_WS, C_WS);
+  mat_transpose(C_WS, 3, 3, C_SW);
+  dot_3x3_3x3(C_CS, C_SW, C_CW);
+
+  /* Form: C_CS * C_SW * skew(p_W - r_WS) */
+  real_t r_WS[3] = {0};
+  tf_trans_get(T_WS, r_WS);
+
+  real_t p[3] = {0};
+  real_t S[3 * 3] = {0};
+  vec_sub(p_W, r_WS, p, 3);
+  skew(p, S);
+
+  real_t RHS[3 * 3] = {0};
+  dot_3x3_3x3(C_CW, S, RHS);
+
+  /* Form: -C_SW */
+  real_t neg_C_CW[3 * 3] = {0};
+  mat_copy(C_CW, 3, 3, neg_C_CW);
+  mat_scale(neg_C_CW, 3, 3, -1.0);
+
+  /* Form: J_pos = -1 * sqrt_info * J_h * C_CS * C_SW * skew(p_W - r_WS); */
+  real_t J_pos[2 * 3] = {0};
+  dot_2x3_3x3(Jh_weighted, RHS, J_pos);
+
+  /* Form: J_rot = -1 * sqrt_info * J_h * C_CS * -C_SW; */
+  real_t J_rot[2 * 3] = {0};
+  dot_2x3_3x3(Jh_weighted, neg_C_CW, J_rot);
+
+  /* Fill the jacobians */
+  mat_block_set(J, 6, 0, 0, 1, 2, J_pos);
+  mat_block_set(J, 6, 0, 3, 1, 5, J_rot);
+}
+
+static void cam_factor_sensor_camera_jacobian(const real_t Jh_weighted[2 * 3],
+                                              const real_t T_SC[3 * 3],
+                                              const real_t p_C[3],
+                                              real_t J[2 * 6]) {
+  /* J[0:2, 0:3] = -1 * sqrt_info * J_h * C_CS * skew(C_SC * p_C); */
+  /* J[0:2, 3:5] = -1 * sqrt_info * J_h * -C_CS; */
+
+  /* Setup */
+  real_t C_SC[3 * 3] = {0};
+  real_t C_CS[3 * 3] = {0};
+  real_t C_SW[3 * 3] = {0};
+  real_t C_CW[3 * 3] = {0};
+
+  tf_rot_get(T_SC, C_SC);
+  mat_transpose(C_SC, 3, 3, C_CS);
+  dot_3x3_3x3(C_CS, C_SW, C_CW);
+
+  /* Form: C_CS * skew(C_SC * p_C) */
+  real_t p[3] = {0};
+  dot_3x3_3x1(C_SC, p_C, p);
+
+  real_t S[3 * 3] = {0};
+  skew(p, S);
+
+  real_t RHS[3 * 3] = {0};
+  dot_3x3_3x3(C_CS, S, RHS);
+
+  /* Form: -C_CS */
+  real_t neg_C_CS[3 * 3] = {0};
+  mat_copy(C_CS, 3, 3, neg_C_CS);
+  mat_scale(neg_C_CS, 3, 3, -1.0);
+
+  /* Form: J_pos = -1 * sqrt_info * J_h * C_CS * skew(C_SC * p_C); */
+  real_t J_pos[2 * 3] = {0};
+  dot_2x3_3x3(Jh_weighted, RHS, J_pos);
+
+  /* Form: J_rot = -1 * sqrt_info * J_h * -C_CS; */
+  real_t J_rot[2 * 3] = {0};
+  dot_2x3_3x3(Jh_weighted, neg_C_CS, J_rot);
+
+  /* Fill Jacobians */
+  mat_block_set(J, 6, 0, 0, 1, 2, J_pos);
+  mat_block_set(J, 6, 0, 3, 1, 5, J_rot);
+}
+
+static void cam_factor_camera_params_jacobian(const real_t neg_sqrt_info[2 * 2],
+                                              const real_t J_cam_params[2 * 8],
+                                              real_t J[2 * 8]) {
+  /* J = -1 * sqrt_info * J_cam_params; */
+  dot_2x2_2x8(neg_sqrt_info, J_cam_params, J);
+}
+
+static void cam_factor_feature_jacobian(const real_t Jh_weighted[2 * 3],
+                                        const real_t T_WS[4 * 4],
+                                        const real_t T_SC[4 * 4],
+                                        real_t J[2 * 3]) {
+  /* Setup */
+  real_t T_WC[4 * 4] = {0};
+  real_t C_WC[3 * 3] = {0};
+  real_t C_CW[3 * 3] = {0};
+  dot_4x4_4x4(T_WS, T_SC, T_WC);
+  tf_rot_get(T_WC, C_WC);
+  mat_transpose(C_WC, 3, 3, C_CW);
+
+  /* Form: J = -1 * sqrt_info * J_h * C_CW; */
+  dot_2x3_3x3(Jh_weighted, C_CW, J);
+}
+
+/**
+ * Form the weighted residuals of camera `factor`. The sensor pose,
+ * extrinsics, point in the camera frame and square-root information are
+ * returned so the Jacobians can reuse them.
+ */
+static void cam_factor_residuals_eval(cam_factor_t *factor,
+                                      real_t T_WS[4 * 4],
+                                      real_t T_SC[4 * 4],
+                                      real_t p_C[3],
+                                      real_t sqrt_info[2 * 2]) {
+  /* Map params */
+  /* -- Sensor pose */
+  tf(factor->pose->data, T_WS);
+  /* -- Sensor-Camera extrinsics */
+  tf(factor->extrinsics->data, T_SC);
+  /* -- Camera pose */
+  real_t T_WC[4 * 4] = {0};
+  real_t T_CW[4 * 4] = {0};
+  dot_4x4_4x4(T_WS, T_SC, T_WC);
+  tf_inv(T_WC, T_CW);
+  /* -- Feature */
+  tf_point(T_CW, factor->feature->data, p_C);
+
+  /* Calculate residuals */
+  /* -- Project point from world to image plane */
+  real_t z_hat[2];
+  pinhole_radtan4_project(factor->camera->data, p_C, z_hat);
+  /* -- Residual */
+  real_t err[2] = {0};
+  err[0] = factor->z[0] - z_hat[0];
+  err[1] = factor->z[1] - z_hat[1];
+  /* -- Weighted residual */
+  sqrt_info[0] = sqrt(factor->covar[0]);
+  sqrt_info[1] = 0.0;
+  sqrt_info[2] = 0.0;
+  sqrt_info[3] = sqrt(factor->covar[3]);
+  dot_2x2_2x1(sqrt_info, err, factor->r);
+}
+
+/**
+ * Evaluate the residuals of camera `factor` only, the Jacobians are left
+ * untouched. Used where only the cost is needed, e.g. step acceptance.
+ */
+int cam_factor_residuals(cam_factor_t *factor) {
+  assert(factor != NULL);
+  assert(factor->pose);
+  assert(factor->extrinsics);
+  assert(factor->feature);
+  assert(factor->camera);
+
+  real_t T_WS[4 * 4] = {0};
+  real_t T_SC[4 * 4] = {0};
+  real_t p_C[3] = {0};
+  real_t sqrt_info[2 * 2] = {0};
+  cam_factor_residuals_eval(factor, T_WS, T_SC, p_C, sqrt_info);
+
+  return 0;
+}
+
+int cam_factor_eval(cam_factor_t *factor) {
+  assert(factor != NULL);
+  assert(factor->pose);
+  assert(factor->extrinsics);
+  assert(factor->feature);
+  assert(factor->camera);
+  cam_factor_reset(factor);
+
+  /* Calculate residuals */
+  real_t T_WS[4 * 4] = {0};
+  real_t T_SC[4 * 4] = {0};
+  real_t p_C[3] = {0};
+  real_t sqrt_info[2 * 2] = {0};
+  cam_factor_residuals_eval(factor, T_WS, T_SC, p_C, sqrt_info);
+  real_t *p_W = factor->feature->data;
+  real_t *cam_params = factor->camera->data;
+
+  /* Calculate jacobians */
+  /* -- Form: -1 * sqrt_info */
+  real_t neg_sqrt_info[2 * 2] = {0};
+  mat_copy(sqrt_info, 2, 2, neg_sqrt_info);
+  mat_scale(neg_sqrt_info, 2, 2, -1.0);
+  /* -- Form: Jh_weighted = -1 * sqrt_info * J_h */
+  real_t J_h[2 * 3] = {0};
+  real_t Jh_weighted[2 * 3] = {0};
+  pinhole_radtan4_project_jacobian(cam_params, p_C, J_h);
+  dot_2x2_2x3(neg_sqrt_info, J_h, Jh_weighted);
+  /* -- Form: J_cam_params */
+  real_t J_cam_params[2 * 8] = {0};
+  pinhole_radtan4_params_jacobian(cam_params, p_C, J_cam_params);
+  /* -- Fill jacobians */
+  cam_factor_sensor_pose_jacobian(Jh_weighted, T_SC, T_WS, p_W, factor->J0);
+  cam_factor_sensor_camera_jacobian(Jh_weighted, T_SC, p_C, factor->J1);
+  cam_factor_camera_params_jacobian(neg_sqrt_info, J_cam_params, factor->J2);
+  cam_factor_feature_jacobian(Jh_weighted, T_WS, T_SC, factor->J3);
+
+  return 0;
+}
+
+/* CAMERA FACTOR BATCH ------------------------------------------------------ */
+
+/* Number of real_t rows in the batch output and workspace block */
+#define CAM_FACTOR_BATCH_ROWS (2 + 12 + 12 + 16 + 6 + 3 + 3 + 3 + 8 + 6)
+
+/**
+ * Grow the batch to hold at least `capacity` observations, existing
+ * observations are kept while residuals and Jacobians are invalidated.
+ */
+static void cam_factor_batch_reserve(cam_factor_batch_t *batch,
+                                     const int capacity) {
+  if (capacity <= batch->capacity) {
+    return;
+  }
+
+  /* Round up so every row starts on a 32-byte boundary */
+  const int n = (capacity + 7) & ~7;
+  batch->pose_idx = realloc(batch->pose_idx, sizeof(int) * n);
+  batch->extrinsics_idx = realloc(batch->extrinsics_idx, sizeof(int) * n);
+  batch->camera_idx = realloc(batch->camera_idx, sizeof(int) * n);
+  batch->feature_idx = realloc(batch->feature_idx, sizeof(int) * n);
+  for (int k = 0; k < 2; k++) {
+    batch->z[k] = realloc(batch->z[k], sizeof(real_t) * n);
+    batch->sqrt_info[k] = realloc(batch->sqrt_info[k], sizeof(real_t) * n);
+  }
+
+  free(batch->data);
+  const size_t data_size = sizeof(real_t) * n * CAM_FACTOR_BATCH_ROWS;
+  batch->data = aligned_alloc(32, data_size);
+  batch->capacity = n;
+
+  real_t *row = batch->data;
+  for (int k = 0; k < 2; k++, row += n) {
+    batch->r[k] = row;
+  }
+  for (int k = 0; k < 12; k++, row += n) {
+    batch->J0[k] = row;
+  }
+  for (int k = 0; k < 12; k++, row += n) {
+    batch->J1[k] = row;
+  }
+  for (int k = 0; k < 16; k++, row += n) {
+    batch->J2[k] = row;
+  }
+  for (int k = 0; k < 6; k++, row += n) {
+    batch->J3[k] = row;
+  }
+  for (int k = 0; k < 3; k++, row += n) {
+    batch->p_C[k] = row;
+  }
+  for (int k = 0; k < 3; k++, row += n) {
+    batch->p_WS[k] = row;
+  }
+  for (int k = 0; k < 3; k++, row += n) {
+    batch->p_SC[k] = row;
+  }
+  for (int k = 0; k < 8; k++, row += n) {
+    batch->cam[k] = row;
+  }
+  for (int k = 0; k < 6; k++, row += n) {
+    batch->Jh[k] = row;
+  }
+}
+
+/**
+ * Setup camera factor batch with an initial `capacity`.
+ */
+void cam_factor_batch_setup(cam_factor_batch_t *batch, const int capacity) {
+  assert(batch != NULL);
+  memset(batch, 0, sizeof(cam_factor_batch_t));
+  cam_factor_batch_reserve(batch, (capacity > 0) ? capacity : 8);
+}
+
+/**
+ * Free camera factor batch.
+ */
+void cam_factor_batch_free(cam_factor_batch_t *batch) {
+  assert(batch != NULL);
+  free(batch->pose_idx);
+  free(batch->extrinsics_idx);
+  free(batch->camera_idx);
+  free(batch->feature_idx);
+  for (int k = 0; k < 2; k++) {
+    free(batch->z[k]);
+    free(batch->sqrt_info[k]);
+  }
+  free(batch->data);
+  free(batch->tfs);
+  memset(batch, 0, sizeof(cam_factor_batch_t));
+}
+
+/**
+ * Add observation `z` with measurement variance `var` of feature
+ * `features[feature_idx]`, seen by camera `cams[camera_idx]` mounted with
+ * extrinsics `extrinsics[extrinsics_idx]` at sensor pose `poses[pose_idx]`.
+ */
+void cam_factor_batch_add(cam_factor_batch_t *batch,
+                          const int pose_idx,
+                          const int extrinsics_idx,
+                          const int camera_idx,
+                          const int feature_idx,
+                          const real_t z[2],
+                          const real_t var[2]) {
+  assert(batch != NULL);
+  assert(z != NULL);
+  assert(var != NULL);
+
+  if (batch->size == batch->capacity) {
+    cam_factor_batch_reserve(batch, batch->capacity * 2);
+  }
+
+  const int i = batch->size++;
+  batch->pose_idx[i] = pose_idx;
+  batch->extrinsics_idx[i] = extrinsics_idx;
+  batch->camera_idx[i] = camera_idx;
+  batch->feature_idx[i] = feature_idx;
+  batch->z[0][i] = z[0];
+  batch->z[1][i] = z[1];
+  batch->sqrt_info[0][i] = 1.0 / var[0];
+  batch->sqrt_info[1][i] = 1.0 / var[1];
+}
+
+/**
+ * Form rotation transpose `C_T` and translation `r` of transform `params`
+ * (qw, qx, qy, qz, x, y, z) into 12 element table entry `tf`.
+ */
+static void cam_factor_batch_tf(const real_t params[7], real_t tf[12]) {
+  real_t C[3 * 3] = {0};
+  quat2rot(params, C);
+  mat_transpose(C, 3, 3, tf);
+  tf[9] = params[4];
+  tf[10] = params[5];
+  tf[11] = params[6];
+}
+
+/**
+ * Transform the features into the camera frames and gather the camera
+ * parameters of every observation into the batch workspace.
+ */
+static void cam_factor_batch_transform(cam_factor_batch_t *batch,
+                                       const real_t *pose_tfs,
+                                       const real_t *extrinsics_tfs,
+                                       const camera_params_t *cams,
+                                       const feature_t *features) {
+  const int N = batch->size;
+  const int *pose_idx = batch->pose_idx;
+  const int *extrinsics_idx = batch->extrinsics_idx;
+  const int *camera_idx = batch->camera_idx;
+  const int *feature_idx = batch->feature_idx;
+
+  for (int i = 0; i < N; i++) {
+    const real_t *T_SW = &pose_tfs[pose_idx[i] * 12];
+    const real_t *T_CS = &extrinsics_tfs[extrinsics_idx[i] * 12];
+    const real_t *p_W = features[feature_idx[i]].data;
+    const real_t *cam = cams[camera_idx[i]].data;
+
+    /* p_WS = p_W - r_WS, p_S = C_SW * p_WS */
+    const real_t dx = p_W[0] - T_SW[9];
+    const real_t dy = p_W[1] - T_SW[10];
+    const real_t dz = p_W[2] - T_SW[11];
+    const real_t sx = T_SW[0] * dx + T_SW[1] * dy + T_SW[2] * dz;
+    const real_t sy = T_SW[3] * dx + T_SW[4] * dy + T_SW[5] * dz;
+    const real_t sz = T_SW[6] * dx + T_SW[7] * dy + T_SW[8] * dz;
+
+    /* p_SC = p_S - r_SC, p_C = C_CS * p_SC */
+    const real_t ex = sx - T_CS[9];
+    const real_t ey = sy - T_CS[10];
+    const real_t ez = sz - T_CS[11];
+    batch->p_C[0][i] = T_CS[0] * ex + T_CS[1] * ey + T_CS[2] * ez;
+    batch->p_C[1][i] = T_CS[3] * ex + T_CS[4] * ey + T_CS[5] * ez;
+    batch->p_C[2][i] = T_CS[6] * ex + T_CS[7] * ey + T_CS[8] * ez;
+
+    batch->p_WS[0][i] = dx;
+    batch->p_WS[1][i] = dy;
+    batch->p_WS[2][i] = dz;
+    batch->p_SC[0][i] = ex;
+    batch->p_SC[1][i] = ey;
+    batch->p_SC[2][i] = ez;
+    for (int k = 0; k < 8; k++) {
+      batch->cam[k][i] = cam[k];
+    }
+  }
+}
+
+/**
+ * Project the camera frame points `p_C` with Pinhole + Radial-Tangential
+ * parameters `cam`, forming the residuals `r`, the weighted projection
+ * Jacobians `Jh` and the camera parameter Jacobians `J2`. Each argument holds
+ * rows of `N` lanes, `n` elements apart. Every lane is independent so the
+ * loop vectorizes.
+ */
+static void cam_factor_batch_project(const int N,
+                                     const int n,
+                                     const real_t *restrict p_C,
+                                     const real_t *restrict cam,
+                                     const real_t *restrict zx,
+                                     const real_t *restrict zy,
+                                     const real_t *restrict wx,
+                                     const real_t *restrict wy,
+                                     real_t *restrict r,
+                                     real_t *restrict Jh,
+                                     real_t *restrict J2) {
+  /* Rows never overlap, so there are no loop carried dependencies */
+#pragma GCC ivdep
+  for (int i = 0; i < N; i++) {
+    /* Camera parameters */
+    const real_t fx = cam[0 * n + i];
+    const real_t fy = cam[1 * n + i];
+    const real_t cx = cam[2 * n + i];
+    const real_t cy = cam[3 * n + i];
+    const real_t k1 = cam[4 * n + i];
+    const real_t k2 = cam[5 * n + i];
+    const real_t p1 = cam[6 * n + i];
+    const real_t p2 = cam[7 * n + i];
+
+    /* Project */
+    const real_t z_inv = 1.0 / p_C[2 * n + i];
+    const real_t x = p_C[0 * n + i] * z_inv;
+    const real_t y = p_C[1 * n + i] * z_inv;
+
+    /* Distort */
+    const real_t x2 = x * x;
+    const real_t y2 = y * y;
+    const real_t xy = x * y;
+    const real_t r2 = x2 + y2;
+    const real_t r4 = r2 * r2;
+    const real_t radial = 1.0 + k1 * r2 + k2 * r4;
+    const real_t xd = x * radial + 2.0 * p1 * xy + p2 * (r2 + 2.0 * x2);
+    const real_t yd = y * radial + p1 * (r2 + 2.0 * y2) + 2.0 * p2 * xy;
+
+    /* Residual r = sqrt_info * (z - z_hat) */
+    r[0 * n + i] = wx[i] * (zx[i] - (fx * xd + cx));
+    r[1 * n + i] = wy[i] * (zy[i] - (fy * yd + cy));
+
+    /* Distortion point Jacobian */
+    const real_t dr = 2.0 * k1 + 4.0 * k2 * r2;
+    const real_t D0 = radial + 2.0 * p1 * y + 6.0 * p2 * x + x2 * dr;
+    const real_t D1 = 2.0 * p1 * x + 2.0 * p2 * y + xy * dr;
+    const real_t D3 = radial + 6.0 * p1 * y + 2.0 * p2 * x + y2 * dr;
+
+    /* Jh = -sqrt_info * diag(fx, fy) * J_dist_point * J_proj */
+    const real_t sx = -wx[i] * fx * z_inv;
+    const real_t sy = -wy[i] * fy * z_inv;
+    Jh[0 * n + i] = sx * D0;
+    Jh[1 * n + i] = sx * D1;
+    Jh[2 * n + i] = -sx * (D0 * x + D1 * y);
+    Jh[3 * n + i] = sy * D1;
+    Jh[4 * n + i] = sy * D3;
+    Jh[5 * n + i] = -sy * (D1 * x + D3 * y);
+
+    /* J2 = -sqrt_info * [J_proj_params, J_proj_point * J_dist_params] */
+    const real_t nwx = -wx[i];
+    const real_t nwy = -wy[i];
+    J2[0 * n + i] = nwx * xd;
+    J2[1 * n + i] = 0.0;
+    J2[2 * n + i] = nwx;
+    J2[3 * n + i] = 0.0;
+    J2[4 * n + i] = nwx * fx * x * r2;
+    J2[5 * n + i] = nwx * fx * x * r4;
+    J2[6 * n + i] = nwx * fx * 2.0 * xy;
+    J2[7 * n + i] = nwx * fx * (3.0 * x2 + y2);
+
+    J2[8 * n + i] = 0.0;
+    J2[9 * n + i] = nwy * yd;
+    J2[10 * n + i] = 0.0;
+    J2[11 * n + i] = nwy;
+    J2[12 * n + i] = nwy * fy * y * r2;
+    J2[13 * n + i] = nwy * fy * y * r4;
+    J2[14 * n + i] = nwy * fy * (x2 + 3.0 * y2);
+    J2[15 * n + i] = nwy * fy * 2.0 * xy;
+  }
+}
+
+/**
+ * Chain the weighted projection Jacobians `Jh` with the pose, extrinsics and
+ * feature Jacobians of the camera frame point, where `p_WS = p_W - r_WS` and
+ * `p_SC = C_SC * p_C`. The 12 element entries of `T_SW` and `T_CS` hold the
+ * row-major rotation followed by the translation of each pose and extrinsics.
+ * Each row argument holds `N` lanes, `n` elements apart.
+ */
+static void cam_factor_batch_compose(const int N,
+                                     const int n,
+                                     const int *restrict pose_idx,
+                                     const int *restrict extrinsics_idx,
+                                     const real_t *restrict T_SW,
+                                     const real_t *restrict T_CS,
+                                     const real_t *restrict p_WS,
+                                     const real_t *restrict p_SC,
+                                     const real_t *restrict Jh,
+                                     real_t *restrict J0,
+                                     real_t *restrict J1,
+                                     real_t *restrict J3) {
+  for (int row = 0; row < 2; row++) {
+    const real_t *h = &Jh[row * 3 * n];
+    real_t *J0_row = &J0[row * 6 * n];
+    real_t *J1_row = &J1[row * 6 * n];
+    real_t *J3_row = &J3[row * 3 * n];
+
+#pragma GCC ivdep
+    for (int i = 0; i < N; i++) {
+      const int ps = pose_idx[i] * 12;
+      const int es = extrinsics_idx[i] * 12;
+      const real_t h0 = h[0 * n + i];
+      const real_t h1 = h[1 * n + i];
+      const real_t h2 = h[2 * n + i];
+
+      /* B = Jh * C_CS */
+      const real_t b0 =
+          h0 * T_CS[es + 0] + h1 * T_CS[es + 3] + h2 * T_CS[es + 6];
+      const real_t b1 =
+          h0 * T_CS[es + 1] + h1 * T_CS[es + 4] + h2 * T_CS[es + 7];
+      const real_t b2 =
+          h0 * T_CS[es + 2] + h1 * T_CS[es + 5] + h2 * T_CS[es + 8];
+
+      /* A = Jh * C_CS * C_SW */
+      const real_t a0 =
+          b0 * T_SW[ps + 0] + b1 * T_SW[ps + 3] + b2 * T_SW[ps + 6];
+      const real_t a1 =
+          b0 * T_SW[ps + 1] + b1 * T_SW[ps + 4] + b2 * T_SW[ps + 7];
+      const real_t a2 =
+          b0 * T_SW[ps + 2] + b1 * T_SW[ps + 5] + b2 * T_SW[ps + 8];
+
+      /* J0 = [A * skew(p_W - r_WS), -A] */
+      const real_t d0 = p_WS[0 * n + i];
+      const real_t d1 = p_WS[1 * n + i];
+      const real_t d2 = p_WS[2 * n + i];
+      J0_row[0 * n + i] = a1 * d2 - a2 * d1;
+      J0_row[1 * n + i] = a2 * d0 - a0 * d2;
+      J0_row[2 * n + i] = a0 * d1 - a1 * d0;
+      J0_row[3 * n + i] = -a0;
+      J0_row[4 * n + i] = -a1;
+      J0_row[5 * n + i] = -a2;
+
+      /* J1 = [B * skew(C_SC * p_C), -B] */
+      const real_t e0 = p_SC[0 * n + i];
+      const real_t e1 = p_SC[1 * n + i];
+      const real_t e2 = p_SC[2 * n + i];
+      J1_row[0 * n + i] = b1 * e2 - b2 * e1;
+      J1_row[1 * n + i] = b2 * e0 - b0 * e2;
+      J1_row[2 * n + i] = b0 * e1 - b1 * e0;
+      J1_row[3 * n + i] = -b0;
+      J1_row[4 * n + i] = -b1;
+      J1_row[5 * n + i] = -b2;
+
+      /* J3 = A */
+      J3_row[0 * n + i] = a0;
+      J3_row[1 * n + i] = a1;
+      J3_row[2 * n + i] = a2;
+    }
+  }
+}
+
+/**
+ * Evaluate all camera factors in the batch, producing the same residuals and
+ * Jacobians as `cam_factor_eval()`. The pose and extrinsics rotations are
+ * formed once per parameter rather than once per observation, and the
+ * projection runs over contiguous arrays so it can be auto-vectorized.
+ */
+void cam_factor_batch_eval(cam_factor_batch_t *batch,
+                           const pose_t *poses,
+                           const int nb_poses,
+                           const extrinsics_t *extrinsics,
+                           const int nb_extrinsics,
+                           const camera_params_t *cams,
+                           const feature_t *features) {
+  assert(batch != NULL);
+  assert(poses != NULL);
+  assert(extrinsics != NULL);
+  assert(cams != NULL);
+  assert(features != NULL);
+
+  /* Form per parameter rotations and translations */
+  const int tfs_size = (nb_poses + nb_extrinsics) * 12;
+  if (tfs_size > batch->tfs_size) {
+    batch->tfs = realloc(batch->tfs, sizeof(real_t) * tfs_size);
+    batch->tfs_size = tfs_size;
+  }
+  real_t *pose_tfs = batch->tfs;
+  real_t *extrinsics_tfs = batch->tfs + nb_poses * 12;
+  for (int k = 0; k < nb_poses; k++) {
+    cam_factor_batch_tf(poses[k].data, &pose_tfs[k * 12]);
+  }
+  for (int k = 0; k < nb_extrinsics; k++) {
+    cam_factor_batch_tf(extrinsics[k].data, &extrinsics_tfs[k * 12]);
+  }
+
+  /* Evaluate */
+  cam_factor_batch_transform(batch, pose_tfs, extrinsics_tfs, cams, features);
+  cam_factor_batch_project(batch->size,
+                           batch->capacity,
+                           batch->p_C[0],
+                           batch->cam[0],
+                           batch->z[0],
+                           batch->z[1],
+                           batch->sqrt_info[0],
+                           batch->sqrt_info[1],
+                           batch->r[0],
+                           batch->Jh[0],
+                           batch->J2[0]);
+  cam_factor_batch_compose(batch->size,
+                           batch->capacity,
+                           batch->pose_idx,
+                           batch->extrinsics_idx,
+                           pose_tfs,
+                           extrinsics_tfs,
+                           batch->p_WS[0],
+                           batch->p_SC[0],
+                           batch->Jh[0],
+                           batch->J0[0],
+                           batch->J1[0],
+                           batch->J3[0]);
+}
+
+/* IMU FACTOR --------------------------------------------------------------- */
+
+/**
+ * Setup IMU buffer to hold `window_length` seconds of measurements at
+ * `imu_rate` Hz, plus the measurements bracketing the window.
+ */
+void imu_buf_setup(imu_buf_t *imu_buf,
+                   const real_t imu_rate,
+                   const real_t window_length) {
+  assert(imu_buf != NULL);
+  assert(imu_rate >= 0.0 && window_length >= 0.0);
+
+  const int capacity = (int) ceil(imu_rate * window_length) + 2;
+  imu_buf->ts = calloc(capacity, sizeof(timestamp_t));
+  imu_buf->acc = calloc(capacity, sizeof(real_t[3]));
+  imu_buf->gyr = calloc(capacity, sizeof(real_t[3]));
+  imu_buf->capacity = capacity;
+  imu_buf->size = 0;
+  imu_buf->count = 0;
+}
+
+void imu_buf_free(imu_buf_t *imu_buf) {
+  assert(imu_buf != NULL);
+
+  free(imu_buf->ts);
+  free(imu_buf->acc);
+  free(imu_buf->gyr);
+  imu_buf->ts = NULL;
+  imu_buf->acc = NULL;
+  imu_buf->gyr = NULL;
+  imu_buf->capacity = 0;
+  imu_buf->size = 0;
+}
+
+void imu_buf_print(const imu_buf_t *imu_buf) {
+  for (uint64_t n = imu_buf->count - imu_buf->size; n < imu_buf->count; n++) {
+    const int k = n % imu_buf->capacity;
+    const real_t *acc = imu_buf->acc[k];
+    const real_t *gyr = imu_buf->gyr[k];
+
+    printf("ts: %ld ", imu_buf->ts[k]);
+    printf("acc: [%.2f, %.2f, %.2f] ", acc[0], acc[1], acc[2]);
+    printf("gyr: [%.2f, %.2f, %.2f] ", gyr[0], gyr[1], gyr[2]);
+    printf("\n");
+  }
+}
+
+/**
+ * Add IMU measurement to buffer, if the buffer is full the oldest
+ * measurement is overwritten.
+ */
+void imu_buf_add(imu_buf_t *imu_buf,
+                 timestamp_t ts,
+                 real_t acc[3],
+                 real_t gyr[3]) {
+  assert(imu_buf->capacity > 0);
+  const int k = imu_buf->count % imu_buf->capacity;
+  imu_buf->ts[k] = ts;
+  imu_buf->acc[k][0] = acc[0];
+  imu_buf->acc[k][1] = acc[1];
+  imu_buf->acc[k][2] = acc[2];
+  imu_buf->gyr[k][0] = gyr[0];
+  imu_buf->gyr[k][1] = gyr[1];
+  imu_buf->gyr[k][2] = gyr[2];
+  imu_buf->count++;
+  if (imu_buf->size < imu_buf->capacity) {
+    imu_buf->size++;
+  }
+}
+
+/**
+ * Clear IMU buffer. Sample indices keep increasing so existing views become
+ * invalid rather than pointing at newer measurements.
+ */
+void imu_buf_clear(imu_buf_t *imu_buf) {
+  for (uint64_t n = imu_buf->count - imu_buf->size; n < imu_buf->count; n++) {
+    const int k = n % imu_buf->capacity;
+    timestamp_t *ts = &imu_buf->ts[k];
+    real_t *acc = imu_buf->acc[k];
+    real_t *gyr = imu_buf->gyr[k];
+
+    *ts = 0;
+    acc[0] = 0.0;
+    acc[1] = 0.0;
+    acc[2] = 0.0;
+    gyr[0] = 0.0;
+    gyr[1] = 0.0;
+    gyr[2] = 0.0;
+  }
+  imu_buf->size = 0;
+}
+
+/**
+ * Copy the measurements of IMU buffer `from` to `to`, which must have the
+ * capacity to hold them.
+ */
+void imu_buf_copy(const imu_buf_t *from, imu_buf_t *to) {
+  assert(to->capacity >= from->size);
+
+  for (uint64_t n = from->count - from->size; n < from->count; n++) {
+    const int k = n % from->capacity;
+    const int l = n % to->capacity;
+    to->ts[l] = from->ts[k];
+
+    to->acc[l][0] = from->acc[k][0];
+    to->acc[l][1] = from->acc[k][1];
+    to->acc[l][2] = from->acc[k][2];
+
+    to->gyr[l][0] = from->gyr[k][0];
+    to->gyr[l][1] = from->gyr[k][1];
+    to->gyr[l][2] = from->gyr[k][2];
+  }
+  to->size = from->size;
+  to->count = from->count;
+}
+
+/**
+ * @returns Index of the first sample in the buffer with a timestamp greater
+ * than `ts`, or greater or equal to `ts` if `inclusive` is set.
+ */
+static uint64_t imu_buf_bound(const imu_buf_t *imu_buf,
+                              const timestamp_t ts,
+                              const int inclusive) {
+  uint64_t lo = imu_buf->count - imu_buf->size;
+  uint64_t hi = imu_buf->count;
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    const timestamp_t ts_mid = imu_buf->ts[mid % imu_buf->capacity];
+    if (ts_mid < ts || (inclusive == 0 && ts_mid == ts)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/**
+ * Form `view` of the measurements in `imu_buf` covering the time range
+ * `ts_start` to `ts_end`, without copying them. The view includes the last
+ * measurement at or before `ts_start` and the first at or after `ts_end` if
+ * the buffer has them, so the time range can be interpolated.
+ *
+ * @returns
+ * - 0 for success
+ * - -1 if there are less than two measurements in the time range
+ */
+int imu_buf_view(const imu_buf_t *imu_buf,
+                 const timestamp_t ts_start,
+                 const timestamp_t ts_end,
+                 imu_view_t *view) {
+  assert(imu_buf != NULL);
+  assert(view != NULL);
+  assert(ts_start <= ts_end);
+
+  view->buf = imu_buf;
+  view->start = imu_buf_bound(imu_buf, ts_start, 0);
+  view->end = imu_buf_bound(imu_buf, ts_end, 1);
+  view->ts_start = ts_start;
+  view->ts_end = ts_end;
+  if (view->start > imu_buf->count - imu_buf->size) {
+    view->start--;
+  }
+  if (view->end < imu_buf->count) {
+    view->end++;
+  }
+  if (view->end < view->start + 2) {
+    LOG_ERROR("Not enough IMU measurements between [%ld, %ld]!",
+              ts_start,
+              ts_end);
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * @returns Number of measurements in IMU `view`.
+ */
+int imu_view_size(const imu_view_t *view) {
+  return view->end - view->start;
+}
+
+/**
+ * @returns 1 if the measurements of IMU `view` are still in the buffer, else
+ * 0 if they have since been overwritten or cleared.
+ */
+int imu_view_valid(const imu_view_t *view) {
+  const imu_buf_t *buf = view->buf;
+  return view->start >= (buf->count - buf->size) && view->end <= buf->count;
+}
+
+/**
+ * @returns Timestamp of the `k`-th measurement in IMU `view`.
+ */
+timestamp_t imu_view_ts(const imu_view_t *view, const int k) {
+  assert(k >= 0 && k < imu_view_size(view));
+  return view->buf->ts[(view->start + k) % view->buf->capacity];
+}
+
+/**
+ * @returns Accelerometer measurement of the `k`-th measurement in IMU `view`.
+ */
+const real_t *imu_view_acc(const imu_view_t *view, const int k) {
+  assert(k >= 0 && k < imu_view_size(view));
+  return view->buf->acc[(view->start + k) % view->buf->capacity];
+}
+
+/**
+ * @returns Gyroscope measurement of the `k`-th measurement in IMU `view`.
+ */
+const real_t *imu_view_gyr(const imu_view_t *view, const int k) {
+  assert(k >= 0 && k < imu_view_size(view));
+  return view->buf->gyr[(view->start + k) % view->buf->capacity];
+}
+
+/**
+ * Setup IMU factor between sensor poses `pose_i` and `pose_j` with speed and
+ * biases `sb_i` and `sb_j`. The factor views the measurements in the shared
+ * `imu_buf` between the timestamps of `pose_i` and `pose_j` rather than
+ * copying them, so `imu_buf` must outlive the factor and keep those
+ * measurements. They are preintegrated once here about the biases in `sb_i`.
+ *
+ * @returns
+ * - 0 for success
+ * - -1 if there are not enough measurements to preintegrate, or their
+ *   covariance is not positive definite
+ */
+int imu_factor_setup(imu_factor_t *factor,
+                     imu_params_t *imu_params,
+                     const imu_buf_t *imu_buf,
+                     pose_t *pose_i,
+                     speed_biases_t *sb_i,
+                     pose_t *pose_j,
+                     speed_biases_t *sb_j) {
+  assert(factor != NULL);
+  assert(imu_params != NULL);
+  assert(imu_buf != NULL);
+
+  factor->imu_params = imu_params;
+  if (imu_buf_view(imu_buf, pose_i->ts, pose_j->ts, &factor->imu_view)) {
+    LOG_ERROR("IMU factor has no measurements to preintegrate!");
+    return -1;
+  }
+  factor->pose_i = pose_i;
+  factor->sb_i = sb_i;
+  factor->pose_j = pose_j;
+  factor->sb_j = sb_j;
+
+  zeros(factor->r, 15, 1);
+  factor->r_size = 15;
+
+  factor->jacs[0] = factor->J0;
+  factor->jacs[1] = factor->J1;
+  factor->jacs[2] = factor->J2;
+  factor->jacs[3] = factor->J3;
+  factor->nb_params = 4;
+  imu_factor_reset(factor);
+
+  /* Preintegrate about the current bias estimates */
+  vec_copy(sb_i->data + 3, 3, factor->ba);
+  vec_copy(sb_i->data + 6, 3, factor->bg);
+
+  return imu_factor_propagate(factor);
+}
+
+void imu_factor_reset(imu_factor_t *factor) {
+  zeros(factor->r, 15, 1);
+  zeros(factor->J0, 15, 6);
+  zeros(factor->J1, 15, 9);
+  zeros(factor->J2, 15, 6);
+  zeros(factor->J3, 15, 9);
+}
+
+/**
+ * Linearly interpolate the `k`-th and `k + 1`-th measurements of IMU `view`
+ * at `ts`. Outside of the two measurements the nearest one is held, which
+ * extrapolates the first and last measurements of the view.
+ */
+static void imu_view_interp(const imu_view_t *view,
+                            const int k,
+                            const timestamp_t ts,
+                            real_t acc[3],
+                            real_t gyr[3]) {
+  const real_t *acc_k = imu_view_acc(view, k);
+  const real_t *gyr_k = imu_view_gyr(view, k);
+  vec_copy(acc_k, 3, acc);
+  vec_copy(gyr_k, 3, gyr);
+  if (k + 1 >= imu_view_size(view)) {
+    return;
+  }
+
+  const timestamp_t ts_k = imu_view_ts(view, k);
+  const timestamp_t ts_kp1 = imu_view_ts(view, k + 1);
+  if (ts <= ts_k || ts_kp1 <= ts_k) {
+    return;
+  }
+  const real_t alpha = MIN(ts2sec(ts - ts_k) / ts2sec(ts_kp1 - ts_k), 1.0);
+  const real_t *acc_kp1 = imu_view_acc(view, k + 1);
+  const real_t *gyr_kp1 = imu_view_gyr(view, k + 1);
+  for (int i = 0; i < 3; i++) {
+    acc[i] = (1.0 - alpha) * acc_k[i] + alpha * acc_kp1[i];
+    gyr[i] = (1.0 - alpha) * gyr_k[i] + alpha * gyr_kp1[i];
+  }
+}
+
+/**
+ * Preintegrate the IMU measurements about the biases `factor->ba` and
+ * `factor->bg`, forming the relative position `dp`, velocity `dv` and
+ * rotation `dq`, their covariance `covar` and square-root information
+ * `sqrt_info`, and the state transition matrix `F` whose last six columns
+ * are the Jacobians of the preintegrated terms w.r.t. the biases.
+ *
+ * The integration spans exactly the view's `[ts_start, ts_end]`, i.e. the
+ * timestamps of `pose_i` and `pose_j`. The measurements are interpolated at
+ * the ends of the time range, or extrapolated if the buffer does not bracket
+ * it.
+ *
+ * The error state is ordered (dp, dv, dtheta, dba, dbg). This only needs to
+ * be called again if the bias estimates drift far from `ba` and `bg`, smaller
+ * changes are handled by the first-order correction in `imu_factor_eval()`.
+ *
+ * @returns 0 for success or -1 if the covariance is not positive definite
+ */
+int imu_factor_propagate(imu_factor_t *factor) {
+  assert(factor != NULL);
+  const imu_params_t *imu_params = factor->imu_params;
+  const imu_view_t *imu_view = &factor->imu_view;
+  assert(imu_view_valid(imu_view));
+
+  /* Reset preintegrated terms */
+  zeros(factor->dp, 3, 1);
+  zeros(factor->dv, 3, 1);
+  factor->dq[0] = 1.0;
+  factor->dq[1] = 0.0;
+  factor->dq[2] = 0.0;
+  factor->dq[3] = 0.0;
+  eye(factor->F, 15, 15);
+  zeros(factor->covar, 15, 15);
+  factor->Dt = 0.0;
+
+  /* Noise densities */
+  real_t q[12] = {0};
+  for (int i = 0; i < 3; i++) {
+    q[0 + i] = imu_params->n_a[i] * imu_params->n_a[i];
+    q[3 + i] = imu_params->n_g[i] * imu_params->n_g[i];
+    q[6 + i] = imu_params->n_aw[i] * imu_params->n_aw[i];
+    q[9 + i] = imu_params->n_gw[i] * imu_params->n_gw[i];
+  }
+
+  /* Integrate over each interval [ts[k], ts[k + 1]] clipped to the view's */
+  /* time range, the first and last intervals extend to the time range */
+  real_t *A = malloc(sizeof(real_t) * 15 * 15);
+  real_t *A_t = malloc(sizeof(real_t) * 15 * 15);
+  real_t *B = malloc(sizeof(real_t) * 15 * 12);
+  real_t *tmp = malloc(sizeof(real_t) * 15 * 15);
+  real_t *tmp2 = malloc(sizeof(real_t) * 15 * 15);
+  const int nb_samples = imu_view_size(imu_view);
+  for (int k = 0; k < nb_samples; k++) {
+    const timestamp_t ts_k = imu_view_ts(imu_view, k);
+    const timestamp_t t0 =
+        (k == 0) ? imu_view->ts_start : MAX(ts_k, imu_view->ts_start);
+    const timestamp_t t1 =
+        (k == nb_samples - 1)
+            ? imu_view->ts_end
+            : MIN(imu_view_ts(imu_view, k + 1), imu_view->ts_end);
+    if (t1 <= t0) {
+      continue;
+    }
+    const real_t dt = ts2sec(t1 - t0);
+    const real_t dt_sq = dt * dt;
+    real_t acc[3] = {0};
+    real_t gyr[3] = {0};
+    imu_view_interp(imu_view, k, t0, acc, gyr);
+    const real_t a[3] = {acc[0] - factor->ba[0],
+                         acc[1] - factor->ba[1],
+                         acc[2] - factor->ba[2]};
+    const real_t w_dt[3] = {(gyr[0] - factor->bg[0]) * dt,
+                            (gyr[1] - factor->bg[1]) * dt,
+                            (gyr[2] - factor->bg[2]) * dt};
+
+    /* Form: C = C(dq), C * a, C * skew(a) */
+    real_t C[3 * 3] = {0};
+    real_t Ca[3] = {0};
+    real_t S[3 * 3] = {0};
+    real_t CS[3 * 3] = {0};
+    quat2rot(factor->dq, C);
+    dot_3x3_3x1(C, a, Ca);
+    skew(a, S);
+    dot_3x3_3x3(C, S, CS);
+
+    /* Form: dC = Exp(w * dt) */
+    real_t dq_k[4] = {0};
+    real_t dC[3 * 3] = {0};
+    real_t dC_t[3 * 3] = {0};
+    quat_delta(w_dt, dq_k);
+    quat2rot(dq_k, dC);
+    mat_transpose(dC, 3, 3, dC_t);
+
+    /* Error state transition matrix A and noise input matrix B */
+    eye(A, 15, 15);
+    zeros(B, 15, 12);
+    for (int i = 0; i < 3; i++) {
+      A[i * 15 + (3 + i)] = dt;
+      A[(6 + i) * 15 + (12 + i)] = -dt;
+      B[(6 + i) * 12 + (3 + i)] = -dt;
+      B[(9 + i) * 12 + (6 + i)] = dt;
+      B[(12 + i) * 12 + (9 + i)] = dt;
+      for (int j = 0; j < 3; j++) {
+        A[i * 15 + (6 + j)] = -0.5 * CS[i * 3 + j] * dt_sq;
+        A[i * 15 + (9 + j)] = -0.5 * C[i * 3 + j] * dt_sq;
+        A[(3 + i) * 15 + (6 + j)] = -CS[i * 3 + j] * dt;
+        A[(3 + i) * 15 + (9 + j)] = -C[i * 3 + j] * dt;
+        A[(6 + i) * 15 + (6 + j)] = dC_t[i * 3 + j];
+        B[i * 12 + j] = -0.5 * C[i * 3 + j] * dt_sq;
+        B[(3 + i) * 12 + j] = -C[i * 3 + j] * dt;
+      }
+    }
+
+    /* Update covariance: P = A * P * A' + B * (Q / dt) * B' */
+    zeros(tmp, 15, 15);
+    zeros(tmp2, 15, 15);
+    mat_transpose(A, 15, 15, A_t);
+    dot(A, 15, 15, factor->covar, 15, 15, tmp);
+    dot(tmp, 15, 15, A_t, 15, 15, tmp2);
+    for (int i = 0; i < 15; i++) {
+      for (int j = 0; j < 15; j++) {
+        real_t sum = 0.0;
+        for (int n = 0; n < 12; n++) {
+          sum += B[i * 12 + n] * (q[n] / dt) * B[j * 12 + n];
+        }
+        factor->covar[i * 15 + j] = tmp2[i * 15 + j] + sum;
+      }
+    }
+
+    /* Update state transition matrix: F = A * F */
+    zeros(tmp, 15, 15);
+    dot(A, 15, 15, factor->F, 15, 15, tmp);
+    mat_copy(tmp, 15, 15, factor->F);
+
+    /* Update preintegrated relative position, velocity and rotation */
+    for (int i = 0; i < 3; i++) {
+      factor->dp[i] += factor->dv[i] * dt + 0.5 * Ca[i] * dt_sq;
+      factor->dv[i] += Ca[i] * dt;
+    }
+    real_t dq[4] = {0};
+    quat_mul(factor->dq, dq_k, dq);
+    vec_normalize(dq, 4);
+    vec_copy(dq, 4, factor->dq);
+    factor->Dt += dt;
+  }
+  free(A);
+  free(A_t);
+  free(B);
+  free(tmp);
+  free(tmp2);
+
+  /* Square-root information: sqrt_info = inv(L), where covar = L * L' */
+  real_t *L = calloc(15 * 15, sizeof(real_t));
+  if (chol(factor->covar, 15, L) != 0) {
+    LOG_ERROR("IMU factor covariance is not positive definite!");
+    free(L);
+    return -1;
+  }
+  zeros(factor->sqrt_info, 15, 15);
+  for (int j = 0; j < 15; j++) {
+    for (int i = j; i < 15; i++) {
+      real_t sum = (i == j) ? 1.0 : 0.0;
+      for (int k = j; k < i; k++) {
+        sum -= L[i * 15 + k] * factor->sqrt_info[k * 15 + j];
+      }
+      factor->sqrt_info[i * 15 + j] = sum / L[i * 15 + i];
+    }
+  }
+  free(L);
+
+  return 0;
+}
+
+/**
+ * Form the 3x3 matrix `M = w * I + sign * skew(v)` of quaternion `q = (w, v)`,
+ * such that `2 * vec(q * dq(dtheta)) ~= 2 * vec(q) + M * dtheta` for
+ * `sign = 1`, and `2 * vec(dq(dtheta) * q) ~= 2 * vec(q) + M * dtheta` for
+ * `sign = -1`.
+ */
+static void imu_factor_quat_mat(const real_t q[4],
+                                const real_t sign,
+                                real_t M[3 * 3]) {
+  const real_t v[3] = {q[1], q[2], q[3]};
+  skew(v, M);
+  mat_scale(M, 3, 3, sign);
+  M[0] += q[0];
+  M[4] += q[0];
+  M[8] += q[0];
+}
+
+/**
+ * Set 3x3 block `A` in 15 x `n` Jacobian `J` at (`rs`, `cs`), scaled by
+ * `scale`.
+ */
+static void imu_factor_block(real_t *J,
+                             const int n,
+                             const int rs,
+                             const int cs,
+                             const real_t *A,
+                             const real_t scale) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      J[(rs + i) * n + (cs + j)] = scale * A[i * 3 + j];
+    }
+  }
+}
+
+/**
+ * Evaluate IMU factor. The preintegrated terms are corrected to first-order
+ * for the difference between the current biases of `sb_i` and those the
+ * measurements were preintegrated with, so the IMU measurements are not
+ * re-integrated during optimization.
+ *
+ * The residual is `r = sqrt_info * [r_p, r_v, r_theta, r_ba, r_bg]`, the pose
+ * Jacobians are w.r.t. (dtheta, dr) with rotations perturbed on the left, and
+ * the speed and biases Jacobians are w.r.t. (dv, dba, dbg).
+ *
+ * @returns
+ * - 0 for success
+ * - -1 for failure
+ */
+int imu_factor_eval(imu_factor_t *factor) {
+  assert(factor != NULL);
+  assert(factor->imu_params);
+  assert(factor->pose_i && factor->pose_j);
+  assert(factor->sb_i && factor->sb_j);
+  imu_factor_reset(factor);
+
+  /* Map params */
+  /* -- Sensor pose at timestep i and j */
+  const real_t *q_i = factor->pose_i->data;
+  const real_t *r_i = factor->pose_i->data + 4;
+  const real_t *q_j = factor->pose_j->data;
+  const real_t *r_j = factor->pose_j->data + 4;
+  real_t C_i[3 * 3] = {0};
+  real_t C_it[3 * 3] = {0};
+  real_t C_j[3 * 3] = {0};
+  real_t C_jt[3 * 3] = {0};
+  quat2rot(q_i, C_i);
+  quat2rot(q_j, C_j);
+  mat_transpose(C_i, 3, 3, C_it);
+  mat_transpose(C_j, 3, 3, C_jt);
+  /* -- Speed and biases at timestep i and j */
+  const real_t *v_i = factor->sb_i->data;
+  const real_t *ba_i = factor->sb_i->data + 3;
+  const real_t *bg_i = factor->sb_i->data + 6;
+  const real_t *v_j = factor->sb_j->data;
+  const real_t *ba_j = factor->sb_j->data + 3;
+  const real_t *bg_j = factor->sb_j->data + 6;
+
+  /* Bias Jacobians of the preintegrated terms */
+  real_t dp_dba[3 * 3] = {0};
+  real_t dp_dbg[3 * 3] = {0};
+  real_t dv_dba[3 * 3] = {0};
+  real_t dv_dbg[3 * 3] = {0};
+  real_t dq_dbg[3 * 3] = {0};
+  mat_block_get(factor->F, 15, 0, 9, 2, 11, dp_dba);
+  mat_block_get(factor->F, 15, 0, 12, 2, 14, dp_dbg);
+  mat_block_get(factor->F, 15, 3, 9, 5, 11, dv_dba);
+  mat_block_get(factor->F, 15, 3, 12, 5, 14, dv_dbg);
+  mat_block_get(factor->F, 15, 6, 12, 8, 14, dq_dbg);
+
+  /* First-order bias correction of the preintegrated terms */
+  const real_t dba[3] = {ba_i[0] - factor->ba[0],
+                         ba_i[1] - factor->ba[1],
+                         ba_i[2] - factor->ba[2]};
+  const real_t dbg[3] = {bg_i[0] - factor->bg[0],
+                         bg_i[1] - factor->bg[1],
+                         bg_i[2] - factor->bg[2]};
+  real_t alpha[3] = {0};
+  real_t beta[3] = {0};
+  real_t dtheta[3] = {0};
+  vec_copy(factor->dp, 3, alpha);
+  vec_copy(factor->dv, 3, beta);
+  dot(dp_dba, 3, 3, dba, 3, 1, alpha);
+  dot(dp_dbg, 3, 3, dbg, 3, 1, alpha);
+  dot(dv_dba, 3, 3, dba, 3, 1, beta);
+  dot(dv_dbg, 3, 3, dbg, 3, 1, beta);
+  dot(dq_dbg, 3, 3, dbg, 3, 1, dtheta);
+
+  real_t dq_corr[4] = {0};
+  real_t gamma[4] = {0};
+  quat_delta(dtheta, dq_corr);
+  quat_mul(factor->dq, dq_corr, gamma);
+
+  /* Calculate residuals */
+  const real_t Dt = factor->Dt;
+  const real_t g = factor->imu_params->g;
+  /* -- u = r_j - r_i - v_i * Dt + 0.5 * g_W * Dt^2 */
+  /* -- w = v_j - v_i + g_W * Dt */
+  real_t u[3] = {0};
+  real_t w[3] = {0};
+  for (int i = 0; i < 3; i++) {
+    u[i] = r_j[i] - r_i[i] - v_i[i] * Dt;
+    w[i] = v_j[i] - v_i[i];
+  }
+  u[2] += 0.5 * g * Dt * Dt;
+  w[2] += g * Dt;
+  /* -- q_err = inv(gamma) * inv(q_i) * q_j */
+  const real_t gamma_inv[4] = {gamma[0], -gamma[1], -gamma[2], -gamma[3]};
+  const real_t q_i_inv[4] = {q_i[0], -q_i[1], -q_i[2], -q_i[3]};
+  real_t q_ij[4] = {0};
+  real_t q_err[4] = {0};
+  quat_mul(q_i_inv, q_j, q_ij);
+  quat_mul(gamma_inv, q_ij, q_err);
+  /* -- Unweighted residual */
+  real_t err[15] = {0};
+  real_t Cu[3] = {0};
+  real_t Cw[3] = {0};
+  dot_3x3_3x1(C_it, u, Cu);
+  dot_3x3_3x1(C_it, w, Cw);
+  for (int i = 0; i < 3; i++) {
+    err[0 + i] = Cu[i] - alpha[i];
+    err[3 + i] = Cw[i] - beta[i];
+    err[6 + i] = 2.0 * q_err[1 + i];
+    err[9 + i] = ba_j[i] - ba_i[i];
+    err[12 + i] = bg_j[i] - bg_i[i];
+  }
+  /* -- Weighted residual */
+  dot(factor->sqrt_info, 15, 15, err, 15, 1, factor->r);
+
+  /* Calculate jacobians */
+  real_t I3[3 * 3] = {0};
+  eye(I3, 3, 3);
+  real_t J0[15 * 6] = {0};
+  real_t J1[15 * 9] = {0};
+  real_t J2[15 * 6] = {0};
+  real_t J3[15 * 9] = {0};
+  /* -- Rotation residual Jacobians */
+  real_t M_right[3 * 3] = {0};
+  real_t M_left[3 * 3] = {0};
+  real_t dtheta_dq_j[3 * 3] = {0};
+  real_t dtheta_dbg[3 * 3] = {0};
+  real_t Jr[3 * 3] = {0};
+  real_t Jr_dq_dbg[3 * 3] = {0};
+  imu_factor_quat_mat(q_err, 1.0, M_right);
+  imu_factor_quat_mat(q_err, -1.0, M_left);
+  dot_3x3_3x3(M_right, C_jt, dtheta_dq_j);
+  /* -- Jr(dtheta) ~= I - 0.5 * skew(dtheta) */
+  skew(dtheta, Jr);
+  mat_scale(Jr, 3, 3, -0.5);
+  Jr[0] += 1.0;
+  Jr[4] += 1.0;
+  Jr[8] += 1.0;
+  dot_3x3_3x3(Jr, dq_dbg, Jr_dq_dbg);
+  dot_3x3_3x3(M_left, Jr_dq_dbg, dtheta_dbg);
+  /* -- Sensor pose at i Jacobian */
+  real_t Su[3 * 3] = {0};
+  real_t Sw[3 * 3] = {0};
+  real_t C_Su[3 * 3] = {0};
+  real_t C_Sw[3 * 3] = {0};
+  skew(u, Su);
+  skew(w, Sw);
+  dot_3x3_3x3(C_it, Su, C_Su);
+  dot_3x3_3x3(C_it, Sw, C_Sw);
+  imu_factor_block(J0, 6, 0, 0, C_Su, 1.0);
+  imu_factor_block(J0, 6, 0, 3, C_it, -1.0);
+  imu_factor_block(J0, 6, 3, 0, C_Sw, 1.0);
+  imu_factor_block(J0, 6, 6, 0, dtheta_dq_j, -1.0);
+  /* -- Speed and biases at i Jacobian */
+  imu_factor_block(J1, 9, 0, 0, C_it, -Dt);
+  imu_factor_block(J1, 9, 0, 3, dp_dba, -1.0);
+  imu_factor_block(J1, 9, 0, 6, dp_dbg, -1.0);
+  imu_factor_block(J1, 9, 3, 0, C_it, -1.0);
+  imu_factor_block(J1, 9, 3, 3, dv_dba, -1.0);
+  imu_factor_block(J1, 9, 3, 6, dv_dbg, -1.0);
+  imu_factor_block(J1, 9, 6, 6, dtheta_dbg, -1.0);
+  imu_factor_block(J1, 9, 9, 3, I3, -1.0);
+  imu_factor_block(J1, 9, 12, 6, I3, -1.0);
+  /* -- Sensor pose at j Jacobian */
+  imu_factor_block(J2, 6, 0, 3, C_it, 1.0);
+  imu_factor_block(J2, 6, 6, 0, dtheta_dq_j, 1.0);
+  /* -- Speed and biases at j Jacobian */
+  imu_factor_block(J3, 9, 3, 0, C_it, 1.0);
+  imu_factor_block(J3, 9, 9, 3, I3, 1.0);
+  imu_factor_block(J3, 9, 12, 6, I3, 1.0);
+  /* -- Weight jacobians */
+  dot(factor->sqrt_info, 15, 15, J0, 15, 6, factor->J0);
+  dot(factor->sqrt_info, 15, 15, J1, 15, 9, factor->J1);
+  dot(factor->sqrt_info, 15, 15, J2, 15, 6, factor->J2);
+  dot(factor->sqrt_info, 15, 15, J3, 15, 9, factor->J3);
+
+  return 0;
+}
+
+/* BLOCK HESSIAN ------------------------------------------------------------ */
+
+#define BLOCK_HESSIAN_EMPTY UINT64_MAX
+
+static uint64_t block_hessian_key(const int i, const int j) {
+  return ((uint64_t) i << 32) | (uint64_t) j;
+}
+
+static size_t block_hessian_hash(const uint64_t key, const size_t capacity) {
+  /* Fibonacci hashing, capacity is always a power of 2 */
+  return (size_t) ((key * 11400714819323198485llu) >> 32) & (capacity - 1);
+}
+
+static void block_hessian_rehash(block_hessian_t *H, const size_t capacity) {
+  uint64_t *keys = malloc(sizeof(uint64_t) * capacity);
+  size_t *offsets = malloc(sizeof(size_t) * capacity);
+  for (size_t k = 0; k < capacity; k++) {
+    keys[k] = BLOCK_HESSIAN_EMPTY;
+  }
+
+  for (size_t k = 0; k < H->capacity; k++) {
+    if (H->keys[k] == BLOCK_HESSIAN_EMPTY) {
+      continue;
+    }
+    size_t slot = block_hessian_hash(H->keys[k], capacity);
+    while (keys[slot] != BLOCK_HESSIAN_EMPTY) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    keys[slot] = H->keys[k];
+    offsets[slot] = H->offsets[k];
+  }
+
+  free(H->keys);
+  free(H->offsets);
+  H->keys = keys;
+  H->offsets = offsets;
+  H->capacity = capacity;
+}
+
+/**
+ * Setup block-sparse Hessian `H` with `nb_params` parameter blocks of sizes
+ * `param_sizes`. The column index of each parameter block follows the order
+ * in `param_sizes`.
+ */
+void block_hessian_setup(block_hessian_t *H,
+                         const int *param_sizes,
+                         const int nb_params) {
+  assert(H != NULL);
+  assert(param_sizes != NULL || nb_params == 0);
+
+  H->nb_params = nb_params;
+  H->param_sizes = malloc(sizeof(int) * (nb_params + 1));
+  H->param_idxs = malloc(sizeof(int) * (nb_params + 1));
+  H->x_size = 0;
+  for (int i = 0; i < nb_params; i++) {
+    H->param_sizes[i] = param_sizes[i];
+    H->param_idxs[i] = H->x_size;
+    H->x_size += param_sizes[i];
+  }
+
+  H->keys = NULL;
+  H->offsets = NULL;
+  H->capacity = 0;
+  H->nb_blocks = 0;
+  block_hessian_rehash(H, 1024);
+
+  H->data_size = 0;
+  H->data_capacity = 1024 * 36;
+  H->data = malloc(sizeof(real_t) * H->data_capacity);
+}
+
+/**
+ * Free block-sparse Hessian `H`.
+ */
+void block_hessian_free(block_hessian_t *H) {
+  assert(H != NULL);
+  free(H->param_sizes);
+  free(H->param_idxs);
+  free(H->keys);
+  free(H->offsets);
+  free(H->data);
+
+  H->param_sizes = NULL;
+  H->param_idxs = NULL;
+  H->keys = NULL;
+  H->offsets = NULL;
+  H->data = NULL;
+  H->nb_params = 0;
+  H->x_size = 0;
+  H->capacity = 0;
+  H->nb_blocks = 0;
+  H->data_size = 0;
+  H->data_capacity = 0;
+}
+
+/**
+ * Zero the values of the block-sparse Hessian `H` while keeping the sparsity
+ * pattern, so re-evaluation with the same factors does not allocate.
+ */
+void block_hessian_zero(block_hessian_t *H) {
+  assert(H != NULL);
+  memset(H->data, 0, sizeof(real_t) * H->data_size);
+}
+
+/**
+ * Get block `H_ij` from block-sparse Hessian `H`, where `i <= j`.
+ * @returns
+ * - Pointer to the row-major `size_i x size_j` block
+ * - NULL if the block is structurally zero
+ */
+real_t *block_hessian_get(const block_hessian_t *H, const int i, const int j) {
+  assert(H != NULL);
+  assert(i <= j);
+
+  const uint64_t key = block_hessian_key(i, j);
+  size_t slot = block_hessian_hash(key, H->capacity);
+  while (H->keys[slot] != BLOCK_HESSIAN_EMPTY) {
+    if (H->keys[slot] == key) {
+      return &H->data[H->offsets[slot]];
+    }
+    slot = (slot + 1) & (H->capacity - 1);
+  }
+
+  return NULL;
+}
+
+/**
+ * Get block `H_ij` from block-sparse Hessian `H`, where `i <= j`. If the
+ * block does not exist a zero block is inserted.
+ * @returns Pointer to the row-major `size_i x size_j` block
+ */
+real_t *block_hessian_insert(block_hessian_t *H, const int i, const int j) {
+  assert(H != NULL);
+  assert(i <= j);
+  assert(i >= 0 && j < H->nb_params);
+
+  /* Lookup */
+  const uint64_t key = block_hessian_key(i, j);
+  size_t slot = block_hessian_hash(key, H->capacity);
+  while (H->keys[slot] != BLOCK_HESSIAN_EMPTY) {
+    if (H->keys[slot] == key) {
+      return &H->data[H->offsets[slot]];
+    }
+    slot = (slot + 1) & (H->capacity - 1);
+  }
+
+  /* Grow block storage */
+  const size_t block_size = H->param_sizes[i] * H->param_sizes[j];
+  if (H->data_size + block_size > H->data_capacity) {
+    while (H->data_size + block_size > H->data_capacity) {
+      H->data_capacity *= 2;
+    }
+    H->data = realloc(H->data, sizeof(real_t) * H->data_capacity);
+  }
+
+  /* Insert new block, keep load factor below 0.5 */
+  H->keys[slot] = key;
+  H->offsets[slot] = H->data_size;
+  memset(&H->data[H->data_size], 0, sizeof(real_t) * block_size);
+  H->data_size += block_size;
+  H->nb_blocks++;
+
+  real_t *block = &H->data[H->offsets[slot]];
+  if (H->nb_blocks * 2 > H->capacity) {
+    block_hessian_rehash(H, H->capacity * 2);
+  }
+
+  return block;
+}
+
+/**
+ * Accumulate `J_i' * J_j` into the block-sparse Hessian `H`, where `J_i` and
+ * `J_j` are the `r_size x size_i` and `r_size x size_j` Jacobians of a factor
+ * w.r.t. parameter blocks `i` and `j`. If `i > j` the transpose is
+ * accumulated into block `H_ji` instead.
+ */
+void block_hessian_accumulate(block_hessian_t *H,
+                              const int i,
+                              const int j,
+                              const real_t *J_i,
+                              const real_t *J_j,
+                              const int r_size) {
+  assert(H != NULL);
+  assert(J_i != NULL && J_j != NULL);
+
+  const int size_i = H->param_sizes[i];
+  const int size_j = H->param_sizes[j];
+
+  if (i <= j) {
+    /* H_ij += J_i' * J_j */
+    real_t *H_ij = block_hessian_insert(H, i, j);
+    for (int a = 0; a < size_i; a++) {
+      for (int b = 0; b < size_j; b++) {
+        real_t sum = 0.0;
+        for (int k = 0; k < r_size; k++) {
+          sum += J_i[k * size_i + a] * J_j[k * size_j + b];
+        }
+        H_ij[a * size_j + b] += sum;
+      }
+    }
+  } else {
+    /* H_ji += (J_i' * J_j)' = J_j' * J_i */
+    real_t *H_ji = block_hessian_insert(H, j, i);
+    for (int b = 0; b < size_j; b++) {
+      for (int a = 0; a < size_i; a++) {
+        real_t sum = 0.0;
+        for (int k = 0; k < r_size; k++) {
+          sum += J_j[k * size_j + b] * J_i[k * size_i + a];
+        }
+        H_ji[b * size_i + a] += sum;
+      }
+    }
+  }
+}
+
+/**
+ * Add the blocks of `H_src` into `H`, where both share the same parameter
+ * block layout.
+ */
+void block_hessian_merge(block_hessian_t *H, const block_hessian_t *H_src) {
+  assert(H != NULL);
+  assert(H_src != NULL);
+  assert(H->nb_params == H_src->nb_params);
+
+  for (size_t k = 0; k < H_src->capacity; k++) {
+    if (H_src->keys[k] == BLOCK_HESSIAN_EMPTY) {
+      continue;
+    }
+
+    const int i = H_src->keys[k] >> 32;
+    const int j = H_src->keys[k] & 0xFFFFFFFF;
+    const int block_size = H_src->param_sizes[i] * H_src->param_sizes[j];
+    const real_t *src = &H_src->data[H_src->offsets[k]];
+    real_t *dst = block_hessian_insert(H, i, j);
+    for (int n = 0; n < block_size; n++) {
+      dst[n] += src[n];
+    }
+  }
+}
+
+/**
+ * Form the full symmetric dense matrix `H_dense` of size `x_size x x_size`
+ * from the block-sparse Hessian `H`.
+ */
+void block_hessian_dense(const block_hessian_t *H, real_t *H_dense) {
+  assert(H != NULL);
+  assert(H_dense != NULL);
+
+  const int n = H->x_size;
+  zeros(H_dense, n, n);
+
+  for (size_t k = 0; k < H->capacity; k++) {
+    if (H->keys[k] == BLOCK_HESSIAN_EMPTY) {
+      continue;
+    }
+
+    const int i = H->keys[k] >> 32;
+    const int j = H->keys[k] & 0xFFFFFFFF;
+    const int rs = H->param_idxs[i];
+    const int cs = H->param_idxs[j];
+    const int size_i = H->param_sizes[i];
+    const int size_j = H->param_sizes[j];
+    const real_t *H_ij = &H->data[H->offsets[k]];
+
+    for (int a = 0; a < size_i; a++) {
+      for (int b = 0; b < size_j; b++) {
+        H_dense[(rs + a) * n + (cs + b)] = H_ij[a * size_j + b];
+        H_dense[(cs + b) * n + (rs + a)] = H_ij[a * size_j + b];
+      }
+    }
+  }
+}
+
+/* BLOCK CHOLESKY ----------------------------------------------------------- */
+
+static int block_chol_cmp(const void *a, const void *b) {
+  return *(const int *) a - *(const int *) b;
+}
+
+/**
+ * Symbolic analysis of the Hessian `H` for a sparse Cholesky factorization,
+ * where parameter block `order[k]` is eliminated `k`-th, or in the natural
+ * order if `order` is NULL. Only the sparsity pattern of `H` is used, so the
+ * analysis can be reused by `block_chol_factor()` while the pattern of `H`
+ * stays the same.
+ *
+ * @returns 0 for success
+ */
+int block_chol_setup(block_chol_t *chol,
+                     const block_hessian_t *H,
+                     const int *order) {
+  assert(chol != NULL);
+  assert(H != NULL);
+
+  const int N = H->nb_params;
+  const int n = H->x_size;
+  chol->n = n;
+  chol->nb_params = N;
+
+  /* Elimination order and permuted column of each parameter block */
+  int *blk_order = malloc(sizeof(int) * (N + 1));
+  int *iorder = malloc(sizeof(int) * (N + 1));
+  chol->param_pos = malloc(sizeof(int) * (N + 1));
+  chol->perm = malloc(sizeof(int) * (n + 1));
+  int pos = 0;
+  for (int k = 0; k < N; k++) {
+    blk_order[k] = (order) ? order[k] : k;
+    iorder[blk_order[k]] = k;
+
+    const int param = blk_order[k];
+    chol->param_pos[param] = pos;
+    for (int a = 0; a < H->param_sizes[param]; a++) {
+      chol->perm[pos++] = H->param_idxs[param] + a;
+    }
+  }
+
+  /* Lower block adjacency in elimination order */
+  int *adj_ptrs = calloc(N + 1, sizeof(int));
+  int *adj = malloc(sizeof(int) * (H->nb_blocks + 1));
+  for (size_t k = 0; k < H->capacity; k++) {
+    if (H->keys[k] == BLOCK_HESSIAN_EMPTY) {
+      continue;
+    }
+    const int p = iorder[H->keys[k] >> 32];
+    const int q = iorder[H->keys[k] & 0xFFFFFFFF];
+    if (p != q) {
+      adj_ptrs[((p < q) ? p : q) + 1]++;
+    }
+  }
+  for (int c = 0; c < N; c++) {
+    adj_ptrs[c + 1] += adj_ptrs[c];
+  }
+  int *adj_fill = calloc(N + 1, sizeof(int));
+  for (size_t k = 0; k < H->capacity; k++) {
+    if (H->keys[k] == BLOCK_HESSIAN_EMPTY) {
+      continue;
+    }
+    const int p = iorder[H->keys[k] >> 32];
+    const int q = iorder[H->keys[k] & 0xFFFFFFFF];
+    if (p != q) {
+      const int c = (p < q) ? p : q;
+      adj[adj_ptrs[c] + adj_fill[c]++] = (p < q) ? q : p;
+    }
+  }
+
+  /* Block elimination tree and the block pattern of each column of L, the
+   * pattern of column c is its adjacency merged with its children's. */
+  int *parent = malloc(sizeof(int) * (N + 1));
+  int *child_head = malloc(sizeof(int) * (N + 1));
+  int *child_next = malloc(sizeof(int) * (N + 1));
+  int *nb_children = calloc(N + 1, sizeof(int));
+  int *mark = malloc(sizeof(int) * (N + 1));
+  int *pat_ptrs = malloc(sizeof(int) * (N + 1));
+  size_t pat_capacity = H->nb_blocks + N + 1;
+  size_t pat_size = 0;
+  int *pat = malloc(sizeof(int) * pat_capacity);
+  for (int c = 0; c < N; c++) {
+    child_head[c] = -1;
+    mark[c] = -1;
+  }
 
-  /* Calculate delta pose */
-  real_t dpose[4 * 4] = {0};
-  dot(pose_est, 4, 4, pose_meas, 4, 4, dpose);
+  for (int c = 0; c < N; c++) {
+    pat_ptrs[c] = pat_size;
+    mark[c] = c;
+
+    for (int k = adj_ptrs[c]; k < adj_ptrs[c + 1]; k++) {
+      const int row = adj[k];
+      if (mark[row] != c) {
+        mark[row] = c;
+        if (pat_size == pat_capacity) {
+          pat_capacity *= 2;
+          pat = realloc(pat, sizeof(int) * pat_capacity);
+        }
+        pat[pat_size++] = row;
+      }
+    }
+    for (int ch = child_head[c]; ch != -1; ch = child_next[ch]) {
+      for (int k = pat_ptrs[ch]; k < pat_ptrs[ch + 1]; k++) {
+        const int row = pat[k];
+        if (mark[row] != c) {
+          mark[row] = c;
+          if (pat_size == pat_capacity) {
+            pat_capacity *= 2;
+            pat = realloc(pat, sizeof(int) * pat_capacity);
+          }
+          pat[pat_size++] = row;
+        }
+      }
+    }
 
-  /* Calculate pose error */
-  real_t *r = factor->r;
-  const real_t dqw = dpose[0];
-  const real_t dqx = dpose[1];
-  const real_t dqy = dpose[2];
-  const real_t dqz = dpose[3];
-  const real_t drx = dpose[4];
-  const real_t dry = dpose[5];
-  const real_t drz = dpose[6];
-  /* -- dtheta */
-  r[0] = 2.0 * dqx;
-  r[1] = 2.0 * dqy;
-  r[2] = 2.0 * dqz;
-  /* -- dr */
-  r[3] = drx;
-  r[4] = dry;
-  r[5] = drz;
+    const int nb_rows = pat_size - pat_ptrs[c];
+    qsort(&pat[pat_ptrs[c]], nb_rows, sizeof(int), block_chol_cmp);
+    parent[c] = (nb_rows) ? pat[pat_ptrs[c]] : -1;
+    if (parent[c] != -1) {
+      child_next[c] = child_head[parent[c]];
+      child_head[parent[c]] = c;
+      nb_children[parent[c]]++;
+    }
+  }
+  pat_ptrs[N] = pat_size;
+
+  /* Fundamental supernodes, block c joins the supernode of block c - 1 if
+   * it is its only child and their patterns match below c */
+  int *sn_first = malloc(sizeof(int) * (N + 1));
+  int nb_sn = 0;
+  for (int c = 0; c < N; c++) {
+    const int len_prev = (c) ? pat_ptrs[c] - pat_ptrs[c - 1] : 0;
+    const int len = pat_ptrs[c + 1] - pat_ptrs[c];
+    if (c == 0 || parent[c - 1] != c || nb_children[c] != 1
+        || len_prev != len + 1) {
+      sn_first[nb_sn++] = c;
+    }
+  }
+  sn_first[nb_sn] = N;
+
+  /* Scalar row structure and panel offsets of each supernode */
+  chol->nb_supernodes = nb_sn;
+  chol->sn_cols = malloc(sizeof(int) * (nb_sn + 1));
+  chol->sn_row_ptrs = malloc(sizeof(int) * (nb_sn + 1));
+  chol->sn_offsets = malloc(sizeof(size_t) * (nb_sn + 1));
+  chol->col_sn = malloc(sizeof(int) * (n + 1));
+
+  size_t nb_rows_total = 0;
+  for (int s = 0; s < nb_sn; s++) {
+    const int last = sn_first[s + 1] - 1;
+    int nb_rows = 0;
+    for (int b = sn_first[s]; b <= last; b++) {
+      nb_rows += H->param_sizes[blk_order[b]];
+    }
+    for (int k = pat_ptrs[last]; k < pat_ptrs[last + 1]; k++) {
+      nb_rows += H->param_sizes[blk_order[pat[k]]];
+    }
+    nb_rows_total += nb_rows;
+  }
+  chol->sn_rows = malloc(sizeof(int) * (nb_rows_total + 1));
+
+  size_t data_size = 0;
+  size_t work_size = n;
+  int nb_rows_max = 0;
+  int r = 0;
+  for (int s = 0; s < nb_sn; s++) {
+    const int first = sn_first[s];
+    const int last = sn_first[s + 1] - 1;
+    const int c0 = chol->param_pos[blk_order[first]];
+    const int c1 = (last + 1 < N) ? chol->param_pos[blk_order[last + 1]] : n;
+
+    chol->sn_cols[s] = c0;
+    chol->sn_row_ptrs[s] = r;
+    chol->sn_offsets[s] = data_size;
+    for (int c = c0; c < c1; c++) {
+      chol->sn_rows[r++] = c;
+      chol->col_sn[c] = s;
+    }
+    for (int k = pat_ptrs[last]; k < pat_ptrs[last + 1]; k++) {
+      const int param = blk_order[pat[k]];
+      for (int a = 0; a < H->param_sizes[param]; a++) {
+        chol->sn_rows[r++] = chol->param_pos[param] + a;
+      }
+    }
 
-  /* Calculate Jacobians */
-  /* clang-format off */
-  real_t *J = factor->J0;
-  J[0]  = -dqw; J[1]  =  dqz; J[2]  = -dqy; J[3]  =  0.0; J[4]  =  0.0; J[5]  =  0.0;
-  J[6]  = -dqz; J[7]  = -dqw; J[8]  =  dqx; J[9]  =  0.0; J[10] =  0.0; J[11] =  0.0;
-  J[12] =  dqy; J[13] = -dqx; J[14] = -dqw; J[15] =  0.0; J[16] =  0.0; J[17] =  0.0;
-  J[18] =  0.0; J[19] =  0.0; J[20] =  0.0; J[21] = -1.0; J[22] =  0.0; J[23] =  0.0;
-  J[24] =  0.0; J[25] =  0.0; J[26] =  0.0; J[27] =  0.0; J[28] = -1.0; J[29] =  0.0;
-  J[30] =  0.0; J[31] =  0.0; J[32] =  0.0; J[33] =  0.0; J[34] =  0.0; J[35] = -1.0;
-  factor->jacs[0] = J;
-  /* clang-format on */
+    const int nb_rows = r - chol->sn_row_ptrs[s];
+    const size_t nb_off = nb_rows - (c1 - c0);
+    data_size += (size_t) nb_rows * (c1 - c0);
+    nb_rows_max = (nb_rows > nb_rows_max) ? nb_rows : nb_rows_max;
+    work_size = (nb_off * nb_off > work_size) ? nb_off * nb_off : work_size;
+  }
+  chol->sn_cols[nb_sn] = n;
+  chol->sn_row_ptrs[nb_sn] = r;
+  chol->sn_offsets[nb_sn] = data_size;
+
+  /* Numeric storage, the workspace holds the update of a supernode to its
+   * ancestors followed by the packed panels of `chol_update()` */
+  chol->data_size = data_size;
+  chol->data = malloc(sizeof(real_t) * (data_size + 1));
+  work_size += chol_work_size(nb_rows_max);
+  chol->work = malloc(sizeof(real_t) * work_size);
+  chol->map = malloc(sizeof(int) * (n + 1));
+
+  /* Clean up */
+  free(blk_order);
+  free(iorder);
+  free(adj_ptrs);
+  free(adj);
+  free(adj_fill);
+  free(parent);
+  free(child_head);
+  free(child_next);
+  free(nb_children);
+  free(mark);
+  free(pat_ptrs);
+  free(pat);
+  free(sn_first);
 
   return 0;
 }
 
-/* BA FACTOR ---------------------------------------------------------------- */
+/**
+ * Free block Cholesky factorization.
+ */
+void block_chol_free(block_chol_t *chol) {
+  assert(chol != NULL);
+  free(chol->param_pos);
+  free(chol->perm);
+  free(chol->sn_cols);
+  free(chol->sn_row_ptrs);
+  free(chol->sn_rows);
+  free(chol->sn_offsets);
+  free(chol->col_sn);
+  free(chol->data);
+  free(chol->work);
+  free(chol->map);
+}
 
-void ba_factor_setup(ba_factor_t *factor,
-                     pose_t *pose,
-                     feature_t *feature,
-                     camera_params_t *camera,
-                     const real_t var[2]) {
-  factor->pose = pose;
-  factor->feature = feature;
-  factor->camera = camera;
+/**
+ * Add `val` to element (`r`, `c`) of L, where `r >= c`.
+ */
+static void block_chol_add(block_chol_t *chol,
+                           const int r,
+                           const int c,
+                           const real_t val) {
+  const int s = chol->col_sn[c];
+  const int w = chol->sn_cols[s + 1] - chol->sn_cols[s];
+  const int *rows = &chol->sn_rows[chol->sn_row_ptrs[s]];
+  const int nb_rows = chol->sn_row_ptrs[s + 1] - chol->sn_row_ptrs[s];
+
+  /* Binary search for the local row of r */
+  int lo = 0;
+  int hi = nb_rows - 1;
+  while (lo < hi) {
+    const int mid = (lo + hi) / 2;
+    if (rows[mid] < r) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  assert(rows[lo] == r);
 
-  factor->covar[0] = 1.0 / (var[0] * var[0]);
-  factor->covar[1] = 0.0;
-  factor->covar[2] = 0.0;
-  factor->covar[3] = 1.0 / (var[1] * var[1]);
+  real_t *P = &chol->data[chol->sn_offsets[s]];
+  P[lo * w + (c - chol->sn_cols[s])] += val;
+}
 
-  zeros(factor->r, 2, 1);
+/**
+ * Numeric factorization of the Hessian `H` damped by `lambda`, where the
+ * diagonal of `H` is scaled by `(1 + lambda)`. The sparsity pattern of `H`
+ * must match the one passed to `block_chol_setup()`.
+ *
+ * @returns 0 for success, -1 if `H` is not positive definite
+ */
+int block_chol_factor(block_chol_t *chol,
+                      const block_hessian_t *H,
+                      const real_t lambda) {
+  assert(chol != NULL);
+  assert(H != NULL);
+  assert(H->x_size == chol->n);
+
+  /* Scatter the lower triangle of the damped Hessian into the panels */
+  memset(chol->data, 0, sizeof(real_t) * chol->data_size);
+  for (size_t k = 0; k < H->capacity; k++) {
+    if (H->keys[k] == BLOCK_HESSIAN_EMPTY) {
+      continue;
+    }
+    const int i = H->keys[k] >> 32;
+    const int j = H->keys[k] & 0xFFFFFFFF;
+    const int size_i = H->param_sizes[i];
+    const int size_j = H->param_sizes[j];
+    const real_t *H_ij = &H->data[H->offsets[k]];
+
+    for (int a = 0; a < size_i; a++) {
+      for (int b = 0; b < size_j; b++) {
+        real_t val = H_ij[a * size_j + b];
+        int r = chol->param_pos[i] + a;
+        int c = chol->param_pos[j] + b;
+        if (i == j && a < b) {
+          continue;
+        } else if (i == j && a == b) {
+          val += lambda * val;
+        }
+        if (r < c) {
+          const int tmp = r;
+          r = c;
+          c = tmp;
+        }
+        block_chol_add(chol, r, c, val);
+      }
+    }
+  }
 
-  zeros(factor->J0, 2, 6);
-  zeros(factor->J1, 2, 3);
-  factor->jacs[0] = factor->J0;
-  factor->jacs[1] = factor->J1;
-  factor->nb_params = 4;
+  /* Factor the supernodes left to right, each supernode factors its dense
+   * panel and then scatters its update into the ancestor supernodes */
+  for (int s = 0; s < chol->nb_supernodes; s++) {
+    const int w = chol->sn_cols[s + 1] - chol->sn_cols[s];
+    const int *rows = &chol->sn_rows[chol->sn_row_ptrs[s]];
+    const int nb_rows = chol->sn_row_ptrs[s + 1] - chol->sn_row_ptrs[s];
+    const int nb_off = nb_rows - w;
+    real_t *P = &chol->data[chol->sn_offsets[s]];
+    real_t *C = chol->work;
+    real_t *work = &chol->work[(nb_off * nb_off > chol->n)
+                                   ? nb_off * nb_off
+                                   : chol->n];
+
+    /* -- Factor dense panel */
+    if (chol_blocked(P, w, nb_rows, w, work, 0) != 0) {
+      return -1;
+    }
+    if (nb_off == 0) {
+      continue;
+    }
+
+    /* -- Form update C = -L_off * L_off' */
+    memset(C, 0, sizeof(real_t) * nb_off * nb_off);
+    chol_update(&P[w * w], w, nb_off, nb_off, w, NULL, 0, C, nb_off, work);
+
+    /* -- Scatter update into ancestors, one target supernode at a time */
+    int k = 0;
+    while (k < nb_off) {
+      const int t = chol->col_sn[rows[w + k]];
+      const int w_t = chol->sn_cols[t + 1] - chol->sn_cols[t];
+      const int *rows_t = &chol->sn_rows[chol->sn_row_ptrs[t]];
+      const int nb_rows_t = chol->sn_row_ptrs[t + 1] - chol->sn_row_ptrs[t];
+      real_t *P_t = &chol->data[chol->sn_offsets[t]];
+      for (int r = 0; r < nb_rows_t; r++) {
+        chol->map[rows_t[r]] = r;
+      }
+
+      for (; k < nb_off && chol->col_sn[rows[w + k]] == t; k++) {
+        const int c = rows[w + k] - chol->sn_cols[t];
+        for (int r = k; r < nb_off; r++) {
+          P_t[chol->map[rows[w + r]] * w_t + c] += C[r * nb_off + k];
+        }
+      }
+    }
+  }
+
+  return 0;
 }
 
-int ba_factor_eval(ba_factor_t *factor) {
-  assert(factor != NULL);
-  assert(factor->pose);
-  assert(factor->feature);
-  assert(factor->camera);
+/**
+ * Solve `H x = b` with the factorization from `block_chol_factor()`. `x` may
+ * alias `b`.
+ */
+void block_chol_solve(const block_chol_t *chol, const real_t *b, real_t *x) {
+  assert(chol != NULL);
+  assert(b != NULL);
+  assert(x != NULL);
 
-  /* Map params */
-  /* -- Camera pose */
-  real_t T_WC[4 * 4] = {0};
-  tf(factor->pose->data, T_WC);
-  /* -- Feature */
-  real_t *p_W = factor->feature->data;
-  /* -- Camera params */
-  real_t *cam_params = factor->camera->data;
+  /* Permute */
+  real_t *y = chol->work;
+  for (int k = 0; k < chol->n; k++) {
+    y[k] = b[chol->perm[k]];
+  }
 
-  /* Calculate residuals */
-  /* -- Project point from world to image plane */
-  real_t T_CW[4 * 4] = {0};
-  real_t p_C[3] = {0};
-  real_t z_hat[2];
-  tf_inv(T_WC, T_CW);
-  tf_point(T_CW, p_W, p_C);
-  pinhole_radtan4_project(cam_params, p_C, z_hat);
-  /* -- Residual */
-  real_t err[2] = {0};
-  err[0] = factor->z[0] - z_hat[0];
-  err[1] = factor->z[1] - z_hat[1];
-  /* -- Weighted residual */
-  real_t sqrt_info[2 * 2] = {0};
-  sqrt_info[0] = 1.0 / factor->covar[0];
-  sqrt_info[1] = 0.0;
-  sqrt_info[2] = 0.0;
-  sqrt_info[3] = 1.0 / factor->covar[1];
-  dot(sqrt_info, 2, 2, err, 2, 1, factor->r);
+  /* Forward substitution L y = b */
+  for (int s = 0; s < chol->nb_supernodes; s++) {
+    const int c0 = chol->sn_cols[s];
+    const int w = chol->sn_cols[s + 1] - c0;
+    const int *rows = &chol->sn_rows[chol->sn_row_ptrs[s]];
+    const int nb_rows = chol->sn_row_ptrs[s + 1] - chol->sn_row_ptrs[s];
+    const real_t *P = &chol->data[chol->sn_offsets[s]];
+
+    for (int j = 0; j < w; j++) {
+      real_t sum = y[c0 + j];
+      for (int p = 0; p < j; p++) {
+        sum -= P[j * w + p] * y[c0 + p];
+      }
+      y[c0 + j] = sum / P[j * w + j];
+    }
+    for (int r = w; r < nb_rows; r++) {
+      real_t sum = 0.0;
+      for (int p = 0; p < w; p++) {
+        sum += P[r * w + p] * y[c0 + p];
+      }
+      y[rows[r]] -= sum;
+    }
+  }
 
-  /* Calculate jacobians */
-  /* -- Form: -1 * sqrt_info */
-  real_t neg_sqrt_info[2 * 2] = {0};
-  mat_copy(sqrt_info, 2, 2, neg_sqrt_info);
-  mat_scale(neg_sqrt_info, 2, 2, -1.0);
-  /* -- Form: Jh_weighted = -1 * sqrt_info * J_h */
-  real_t J_h[2 * 3] = {0};
-  real_t Jh_weighted[2 * 3] = {0};
-  pinhole_radtan4_project_jacobian(cam_params, p_C, J_h);
-  dot(neg_sqrt_info, 2, 2, J_h, 2, 3, Jh_weighted);
-  /* -- Fill jacobians */
+  /* Backward substitution L' x = y */
+  for (int s = chol->nb_supernodes - 1; s >= 0; s--) {
+    const int c0 = chol->sn_cols[s];
+    const int w = chol->sn_cols[s + 1] - c0;
+    const int *rows = &chol->sn_rows[chol->sn_row_ptrs[s]];
+    const int nb_rows = chol->sn_row_ptrs[s + 1] - chol->sn_row_ptrs[s];
+    const real_t *P = &chol->data[chol->sn_offsets[s]];
+
+    for (int r = w; r < nb_rows; r++) {
+      const real_t y_r = y[rows[r]];
+      for (int p = 0; p < w; p++) {
+        y[c0 + p] -= P[r * w + p] * y_r;
+      }
+    }
+    for (int j = w - 1; j >= 0; j--) {
+      y[c0 + j] /= P[j * w + j];
+      for (int p = 0; p < j; p++) {
+        y[c0 + p] -= P[j * w + p] * y[c0 + j];
+      }
+    }
+  }
+
+  /* Unpermute */
+  for (int k = 0; k < chol->n; k++) {
+    x[chol->perm[k]] = y[k];
+  }
+}
+
+/* SOLVER ------------------------------------------------------------------- */
+
+static int solver_setup_workers(solver_t *solver);
+
+void solver_setup(solver_t *solver) {
+  assert(solver);
+
+  arena_setup(&solver->arena, SOLVER_ARENA_BLOCK_SIZE);
+  solver->imu_buf = calloc(1, sizeof(imu_buf_t));
+  solver_reset(solver);
+
+  memset(&solver->cam_batch, 0, sizeof(cam_factor_batch_t));
+  memset(&solver->H, 0, sizeof(block_hessian_t));
+  memset(solver->H_layout, 0, sizeof(solver->H_layout));
+  memset(&solver->chol, 0, sizeof(block_chol_t));
+  solver->chol_valid = 0;
+  solver->chol_nb_blocks = 0;
+  solver->g = NULL;
+  solver->x = NULL;
+  solver->x_size = 0;
+  solver->r_size = 0;
+
+  solver->nb_threads = 1;
+  solver->deterministic = 1;
+  solver->workers = NULL;
+  solver->nb_workers = 0;
+  pthread_mutex_init(&solver->pool_lock, NULL);
+  pthread_cond_init(&solver->pool_start, NULL);
+  pthread_cond_init(&solver->pool_done, NULL);
+  solver->pool_gen = 0;
+  solver->pool_pending = 0;
+  solver->pool_stop = 0;
+  solver_setup_workers(solver);
+
+  solver->max_iter = 10;
+  solver->lambda = 1e-4;
+  solver->update_factor = 10.0;
+  solver->cost_change_threshold = 1e-10;
+  solver->time_limit = 1.0;
+  solver->verbose = 0;
+  solver->linear_solver = SOLVER_SCHUR;
+}
+
+/**
+ * Setup the solver's IMU buffer to hold a sliding window of `window_length`
+ * seconds of measurements at `imu_rate` Hz. IMU factors can only be added
+ * once the buffer is setup, any measurements it held are discarded.
+ */
+void solver_setup_imu(solver_t *solver,
+                      const real_t imu_rate,
+                      const real_t window_length) {
+  assert(solver);
+
+  imu_buf_free(solver->imu_buf);
+  imu_buf_setup(solver->imu_buf, imu_rate, window_length);
+}
+
+/**
+ * Remove all parameters and factors from the solver, ready for the next
+ * sliding-window iteration. The arena memory is kept for reuse, as are the
+ * IMU buffer and the Hessian sparsity pattern.
+ */
+void solver_reset(solver_t *solver) {
+  assert(solver);
+
+  arena_reset(&solver->arena);
+
+  solver->cam_factors = NULL;
+  solver->nb_cam_factors = 0;
+  solver->max_cam_factors = 0;
+
+  solver->imu_factors = NULL;
+  solver->nb_imu_factors = 0;
+  solver->max_imu_factors = 0;
+
+  solver->poses = NULL;
+  solver->nb_poses = 0;
+  solver->max_poses = 0;
+
+  solver->speed_biases = NULL;
+  solver->nb_speed_biases = 0;
+  solver->max_speed_biases = 0;
+
+  solver->cams = NULL;
+  solver->nb_cams = 0;
+  solver->max_cams = 0;
+
+  solver->extrinsics = NULL;
+  solver->nb_extrinsics = 0;
+  solver->max_extrinsics = 0;
+
+  solver->features = NULL;
+  solver->nb_features = 0;
+  solver->max_features = 0;
+}
+
+/**
+ * Free the Hessian, its cached symbolic factorization, the R.H.S vector and
+ * the thread-local copies of the workers.
+ */
+static void solver_free_hessian(solver_t *solver) {
+  if (solver->chol_valid) {
+    block_chol_free(&solver->chol);
+    solver->chol_valid = 0;
+  }
+  block_hessian_free(&solver->H);
+  free(solver->g);
+  free(solver->x);
+  solver->g = NULL;
+  solver->x = NULL;
+  solver->x_size = 0;
+
+  for (int i = 0; i < solver->nb_workers; i++) {
+    block_hessian_free(&solver->workers[i].H);
+    free(solver->workers[i].g);
+    solver->workers[i].g = NULL;
+  }
+}
+
+/**
+ * Signal the worker threads to exit and join them.
+ */
+static void solver_stop_workers(solver_t *solver) {
+  pthread_mutex_lock(&solver->pool_lock);
+  solver->pool_stop = 1;
+  pthread_cond_broadcast(&solver->pool_start);
+  pthread_mutex_unlock(&solver->pool_lock);
+  for (int i = 0; i < solver->nb_workers; i++) {
+    pthread_join(solver->workers[i].thread, NULL);
+    cam_factor_batch_free(&solver->workers[i].cam_batch);
+  }
+
+  free(solver->workers);
+  solver->workers = NULL;
+  solver->nb_workers = 0;
+  solver->pool_stop = 0;
+}
+
+void solver_free(solver_t *solver) {
+  assert(solver);
+
+  solver_free_hessian(solver);
+  solver_stop_workers(solver);
+  cam_factor_batch_free(&solver->cam_batch);
+  pthread_mutex_destroy(&solver->pool_lock);
+  pthread_cond_destroy(&solver->pool_start);
+  pthread_cond_destroy(&solver->pool_done);
+  solver_reset(solver);
+  arena_free(&solver->arena);
+  imu_buf_free(solver->imu_buf);
+  free(solver->imu_buf);
+  solver->imu_buf = NULL;
+}
+
+void solver_print(solver_t *solver) {
+  printf("solver:\n");
+  printf("r_size: %d\n", solver->r_size);
+  printf("x_size: %d\n", solver->x_size);
+  printf("nb_cam_factors: %d\n", solver->nb_cam_factors);
+  printf("nb_imu_factors: %d\n", solver->nb_imu_factors);
+  printf("nb_poses: %d\n", solver->nb_poses);
+  printf("nb_speed_biases: %d\n", solver->nb_speed_biases);
+}
+
+/**
+ * Grow the solver array `data` of `size` elements of `elem_size` bytes from
+ * the arena if it is at `capacity`, doubling the capacity.
+ *
+ * @returns Pointer to the array, which may have moved
+ */
+static void *solver_grow(solver_t *solver,
+                         void *data,
+                         int *capacity,
+                         const int size,
+                         const size_t elem_size) {
+  if (size < *capacity) {
+    return data;
+  }
+
+  const int old_capacity = *capacity;
+  const int new_capacity = (old_capacity) ? old_capacity * 2
+                                          : SOLVER_MIN_CAPACITY;
+  *capacity = new_capacity;
+  return arena_grow(&solver->arena,
+                    data,
+                    elem_size * old_capacity,
+                    elem_size * new_capacity);
+}
+
+/**
+ * @returns `ptr` moved to `to` if it points into the `nb_bytes` of `from`,
+ * else `ptr` unchanged.
+ */
+static void *solver_rebase_ptr(void *ptr,
+                               const void *from,
+                               void *to,
+                               const size_t nb_bytes) {
+  const uintptr_t p = (uintptr_t) ptr;
+  const uintptr_t start = (uintptr_t) from;
+  if (from == NULL || p < start || p >= start + nb_bytes) {
+    return ptr;
+  }
+  return (char *) to + (p - start);
+}
+
+/**
+ * Point the factors referencing a parameter array that moved from `from` to
+ * `to` at the new array.
+ */
+static void solver_rebase(solver_t *solver,
+                          const void *from,
+                          void *to,
+                          const size_t nb_bytes) {
+  if (from == to) {
+    return;
+  }
+
+  for (int i = 0; i < solver->nb_cam_factors; i++) {
+    cam_factor_t *factor = &solver->cam_factors[i];
+    factor->pose = solver_rebase_ptr(factor->pose, from, to, nb_bytes);
+    factor->extrinsics =
+        solver_rebase_ptr(factor->extrinsics, from, to, nb_bytes);
+    factor->camera = solver_rebase_ptr(factor->camera, from, to, nb_bytes);
+    factor->feature = solver_rebase_ptr(factor->feature, from, to, nb_bytes);
+  }
+
+  for (int i = 0; i < solver->nb_imu_factors; i++) {
+    imu_factor_t *factor = &solver->imu_factors[i];
+    factor->pose_i = solver_rebase_ptr(factor->pose_i, from, to, nb_bytes);
+    factor->pose_j = solver_rebase_ptr(factor->pose_j, from, to, nb_bytes);
+    factor->sb_i = solver_rebase_ptr(factor->sb_i, from, to, nb_bytes);
+    factor->sb_j = solver_rebase_ptr(factor->sb_j, from, to, nb_bytes);
+  }
+}
+
+/**
+ * Add sensor pose to solver.
+ * @returns Pointer to the pose, valid until the next pose is added
+ */
+pose_t *solver_add_pose(solver_t *solver,
+                        const timestamp_t ts,
+                        const real_t data[7]) {
+  assert(solver != NULL);
+
+  pose_t *poses = solver->poses;
+  const int n = solver->nb_poses;
+  solver->poses =
+      solver_grow(solver, poses, &solver->max_poses, n, sizeof(pose_t));
+  solver_rebase(solver, poses, solver->poses, sizeof(pose_t) * n);
+
+  pose_t *pose = &solver->poses[solver->nb_poses++];
+  pose_setup(pose, ts, data);
+  return pose;
+}
 
-  return 0;
+/**
+ * Add speed and biases to solver.
+ * @returns Pointer to the speed and biases, valid until the next one is added
+ */
+speed_biases_t *solver_add_speed_biases(solver_t *solver,
+                                        const timestamp_t ts,
+                                        const real_t data[9]) {
+  assert(solver != NULL);
+
+  speed_biases_t *sbs = solver->speed_biases;
+  const int n = solver->nb_speed_biases;
+  const size_t size = sizeof(speed_biases_t);
+  solver->speed_biases =
+      solver_grow(solver, sbs, &solver->max_speed_biases, n, size);
+  solver_rebase(solver, sbs, solver->speed_biases, size * n);
+
+  speed_biases_t *sb = &solver->speed_biases[solver->nb_speed_biases++];
+  speed_biases_setup(sb, ts, data);
+  return sb;
 }
 
-/* CAMERA FACTOR ------------------------------------------------------------ */
+/**
+ * Add sensor-camera extrinsics to solver.
+ * @returns Pointer to the extrinsics, valid until the next one is added
+ */
+extrinsics_t *solver_add_extrinsics(solver_t *solver, const real_t data[7]) {
+  assert(solver != NULL);
 
-void cam_factor_setup(cam_factor_t *factor,
-                      pose_t *pose,
-                      extrinsics_t *extrinsics,
-                      feature_t *feature,
-                      camera_params_t *camera,
-                      const real_t var[2]) {
-  factor->pose = pose;
-  factor->extrinsics = extrinsics;
-  factor->feature = feature;
-  factor->camera = camera;
+  extrinsics_t *exts = solver->extrinsics;
+  const int n = solver->nb_extrinsics;
+  const size_t size = sizeof(extrinsics_t);
+  solver->extrinsics =
+      solver_grow(solver, exts, &solver->max_extrinsics, n, size);
+  solver_rebase(solver, exts, solver->extrinsics, size * n);
 
-  factor->covar[0] = 1.0 / (var[0] * var[0]);
-  factor->covar[1] = 0.0;
-  factor->covar[2] = 0.0;
-  factor->covar[3] = 1.0 / (var[1] * var[1]);
+  extrinsics_t *extrinsics = &solver->extrinsics[solver->nb_extrinsics++];
+  extrinsics_setup(extrinsics, data);
+  return extrinsics;
+}
 
-  zeros(factor->r, 2, 1);
+/**
+ * Add camera parameters to solver.
+ * @returns Pointer to the camera, valid until the next camera is added
+ */
+camera_params_t *solver_add_camera(solver_t *solver,
+                                   const int cam_idx,
+                                   const int cam_res[2],
+                                   const char *proj_model,
+                                   const char *dist_model,
+                                   const real_t data[8]) {
+  assert(solver != NULL);
 
-  zeros(factor->J0, 2, 6);
-  zeros(factor->J1, 2, 6);
-  zeros(factor->J2, 2, 8);
-  zeros(factor->J3, 2, 3);
-  factor->jacs[0] = factor->J0;
-  factor->jacs[1] = factor->J1;
-  factor->jacs[2] = factor->J2;
-  factor->jacs[3] = factor->J3;
-  factor->nb_params = 4;
+  camera_params_t *cams = solver->cams;
+  const int n = solver->nb_cams;
+  const size_t size = sizeof(camera_params_t);
+  solver->cams = solver_grow(solver, cams, &solver->max_cams, n, size);
+  solver_rebase(solver, cams, solver->cams, size * n);
+
+  camera_params_t *camera = &solver->cams[solver->nb_cams++];
+  camera_params_setup(camera, cam_idx, cam_res, proj_model, dist_model, data);
+  return camera;
 }
 
-void cam_factor_reset(cam_factor_t *factor) {
-  zeros(factor->r, 2, 1);
-  zeros(factor->J0, 2, 6);
-  zeros(factor->J1, 2, 6);
-  zeros(factor->J2, 2, 8);
-  zeros(factor->J3, 2, 3);
+/**
+ * Add feature to solver.
+ * @returns Pointer to the feature, valid until the next feature is added
+ */
+feature_t *solver_add_feature(solver_t *solver, const real_t data[3]) {
+  assert(solver != NULL);
+
+  feature_t *features = solver->features;
+  const int n = solver->nb_features;
+  const size_t size = sizeof(feature_t);
+  solver->features =
+      solver_grow(solver, features, &solver->max_features, n, size);
+  solver_rebase(solver, features, solver->features, size * n);
+
+  feature_t *feature = &solver->features[solver->nb_features++];
+  feature_setup(feature, data);
+  return feature;
 }
 
-static void cam_factor_sensor_pose_jacobian(const real_t Jh_weighted[2 * 3],
-                                            const real_t T_SC[3 * 3],
-                                            const real_t T_WS[3 * 3],
-                                            const real_t p_W[3],
-                                            real_t J[2 * 6]) {
-  /* J[0:2, 0:3] = -1 * sqrt_info * J_h * C_CS * C_SW * skew(p_W - r_WS); */
-  /* J[0:2, 3:5] = -1 * sqrt_info * J_h * C_CS * -C_SW; */
+/**
+ * Add camera factor to solver, the parameters must have been added to the
+ * solver.
+ * @returns Pointer to the factor, valid until the next factor is added
+ */
+cam_factor_t *solver_add_cam_factor(solver_t *solver,
+                                    pose_t *pose,
+                                    extrinsics_t *extrinsics,
+                                    feature_t *feature,
+                                    camera_params_t *camera,
+                                    const real_t var[2]) {
+  assert(solver != NULL);
 
-  /* Setup */
-  real_t C_SC[3 * 3] = {0};
-  real_t C_CS[3 * 3] = {0};
-  real_t C_WS[3 * 3] = {0};
-  real_t C_SW[3 * 3] = {0};
-  real_t C_CW[3 * 3] = {0};
+  cam_factor_t *factors = solver->cam_factors;
+  solver->cam_factors = solver_grow(solver,
+                                    factors,
+                                    &solver->max_cam_factors,
+                                    solver->nb_cam_factors,
+                                    sizeof(cam_factor_t));
+  if (solver->cam_factors != factors) {
+    /* Jacobian pointers refer into the factors themselves */
+    for (int i = 0; i < solver->nb_cam_factors; i++) {
+      cam_factor_t *factor = &solver->cam_factors[i];
+      factor->jacs[0] = factor->J0;
+      factor->jacs[1] = factor->J1;
+      factor->jacs[2] = factor->J2;
+      factor->jacs[3] = factor->J3;
+    }
+  }
 
-  tf_rot_get(T_SC, C_SC);
-  mat_transpose(C_SC, 3, 3, C_CS);
-  tf_rot_get(T_WS, C_WS);
-  mat_transpose(C_WS, 3, 3, C_SW);
-  dot(C_CS, 3, 3, C_SW, 3, 3, C_CW);
+  cam_factor_t *factor = &solver->cam_factors[solver->nb_cam_factors++];
+  cam_factor_setup(factor, pose, extrinsics, feature, camera, var);
+  return factor;
+}
 
-  /* Form: C_CS * C_SW * skew(p_W - r_WS) */
-  real_t r_WS[3] = {0};
-  tf_trans_get(T_WS, r_WS);
+/**
+ * Add IMU factor to solver over the measurements in the solver's IMU buffer
+ * between `pose_i` and `pose_j`, the poses and speed and biases must have
+ * been added to the solver.
+ * @returns Pointer to the factor, valid until the next factor is added, or
+ * NULL if there are not enough IMU measurements between the poses
+ */
+imu_factor_t *solver_add_imu_factor(solver_t *solver,
+                                    imu_params_t *imu_params,
+                                    pose_t *pose_i,
+                                    speed_biases_t *sb_i,
+                                    pose_t *pose_j,
+                                    speed_biases_t *sb_j) {
+  assert(solver != NULL);
 
-  real_t p[3] = {0};
-  real_t S[3 * 3] = {0};
-  vec_sub(p_W, r_WS, p, 3);
-  skew(p, S);
+  imu_factor_t *factors = solver->imu_factors;
+  solver->imu_factors = solver_grow(solver,
+                                    factors,
+                                    &solver->max_imu_factors,
+                                    solver->nb_imu_factors,
+                                    sizeof(imu_factor_t));
+  if (solver->imu_factors != factors) {
+    /* Jacobian pointers refer into the factors themselves */
+    for (int i = 0; i < solver->nb_imu_factors; i++) {
+      imu_factor_t *factor = &solver->imu_factors[i];
+      factor->jacs[0] = factor->J0;
+      factor->jacs[1] = factor->J1;
+      factor->jacs[2] = factor->J2;
+      factor->jacs[3] = factor->J3;
+    }
+  }
 
-  real_t RHS[3 * 3] = {0};
-  dot(C_CW, 3, 3, S, 3, 3, RHS);
+  imu_factor_t *factor = &solver->imu_factors[solver->nb_imu_factors];
+  if (imu_factor_setup(factor,
+                       imu_params,
+                       solver->imu_buf,
+                       pose_i,
+                       sb_i,
+                       pose_j,
+                       sb_j)) {
+    return NULL;
+  }
+  solver->nb_imu_factors++;
+  return factor;
+}
 
-  /* Form: -C_SW */
-  real_t neg_C_CW[3 * 3] = {0};
-  mat_copy(C_CW, 3, 3, neg_C_CW);
-  mat_scale(neg_C_CW, 3, 3, -1.0);
+/**
+ * Parameter block index of the `k`-th pose, speed and biases, extrinsics,
+ * camera or feature. Parameter blocks are ordered as poses, speed and biases,
+ * extrinsics, cameras then features, so that the landmark blocks form the
+ * trailing block-diagonal of H.
+ */
+static int solver_pose_id(const solver_t *solver, const pose_t *pose) {
+  return pose - solver->poses;
+}
 
-  /* Form: J_pos = -1 * sqrt_info * J_h * C_CS * C_SW * skew(p_W - r_WS); */
-  real_t J_pos[2 * 3] = {0};
-  dot(Jh_weighted, 2, 3, RHS, 3, 3, J_pos);
+static int solver_speed_biases_id(const solver_t *solver,
+                                  const speed_biases_t *sb) {
+  return solver->nb_poses + (sb - solver->speed_biases);
+}
 
-  /* Form: J_rot = -1 * sqrt_info * J_h * C_CS * -C_SW; */
-  real_t J_rot[2 * 3] = {0};
-  dot(Jh_weighted, 2, 3, neg_C_CW, 3, 3, J_rot);
+static int solver_extrinsics_id(const solver_t *solver,
+                                const extrinsics_t *extrinsics) {
+  const int offset = solver->nb_poses + solver->nb_speed_biases;
+  return offset + (extrinsics - solver->extrinsics);
+}
 
-  /* Fill the jacobians */
-  mat_block_set(J, 6, 0, 0, 1, 2, J_pos);
-  mat_block_set(J, 6, 0, 3, 1, 5, J_rot);
+static int solver_camera_id(const solver_t *solver,
+                            const camera_params_t *camera) {
+  const int offset =
+      solver->nb_poses + solver->nb_speed_biases + solver->nb_extrinsics;
+  return offset + (camera - solver->cams);
 }
 
-static void cam_factor_sensor_camera_jacobian(const real_t Jh_weighted[2 * 3],
-                                              const real_t T_SC[3 * 3],
-                                              const real_t p_C[3],
-                                              real_t J[2 * 6]) {
-  /* J[0:2, 0:3] = -1 * sqrt_info * J_h * C_CS * skew(C_SC * p_C); */
-  /* J[0:2, 3:5] = -1 * sqrt_info * J_h * -C_CS; */
+/**
+ * @returns Parameter block index of the first feature.
+ */
+static int solver_lmk_id(const solver_t *solver) {
+  return solver->nb_poses + solver->nb_speed_biases + solver->nb_extrinsics
+         + solver->nb_cams;
+}
 
-  /* Setup */
-  real_t C_SC[3 * 3] = {0};
-  real_t C_CS[3 * 3] = {0};
-  real_t C_SW[3 * 3] = {0};
-  real_t C_CW[3 * 3] = {0};
+static int solver_feature_id(const solver_t *solver, const feature_t *feature) {
+  return solver_lmk_id(solver) + (feature - solver->features);
+}
 
-  tf_rot_get(T_SC, C_SC);
-  mat_transpose(C_SC, 3, 3, C_CS);
-  dot(C_CS, 3, 3, C_SW, 3, 3, C_CW);
+/**
+ * Parameter and factor counts the Hessian is setup for. The per-type counts
+ * fix the parameter block layout, the factor counts catch most changes in
+ * connectivity.
+ */
+static void solver_hessian_layout(const solver_t *solver,
+                                  int layout[SOLVER_LAYOUT_SIZE]) {
+  layout[0] = solver->nb_poses;
+  layout[1] = solver->nb_speed_biases;
+  layout[2] = solver->nb_extrinsics;
+  layout[3] = solver->nb_cams;
+  layout[4] = solver->nb_features;
+  layout[5] = solver->nb_cam_factors;
+  layout[6] = solver->nb_imu_factors;
+}
 
-  /* Form: C_CS * skew(C_SC * p_C) */
-  real_t p[3] = {0};
-  dot(C_SC, 3, 3, p_C, 3, 3, p);
+/**
+ * Setup the block-sparse Hessian and R.H.S vector for the current number of
+ * poses, extrinsics, cameras and features, as well as the thread-local H and
+ * g of each worker. If the parameter and factor counts and the number of
+ * threads have not changed since the last evaluation the sparsity patterns
+ * are reused. A factor touching a block missing from a reused pattern still
+ * inserts it, so a change in connectivity the counts do not catch costs an
+ * insert rather than a wrong result.
+ */
+static void solver_setup_hessian(solver_t *solver) {
+  const int nb_params = solver_lmk_id(solver) + solver->nb_features;
+  const int x_size = solver->nb_poses * 6 + solver->nb_speed_biases * 9
+                     + solver->nb_extrinsics * 6 + solver->nb_cams * 8
+                     + solver->nb_features * 3;
+  const int nb_workers = solver->nb_workers;
+  int layout[SOLVER_LAYOUT_SIZE];
+  solver_hessian_layout(solver, layout);
+
+  if (solver->H.data && memcmp(layout, solver->H_layout, sizeof(layout)) == 0) {
+    block_hessian_zero(&solver->H);
+    zeros(solver->g, x_size, 1);
+    for (int i = 0; i < solver->nb_workers; i++) {
+      block_hessian_zero(&solver->workers[i].H);
+      zeros(solver->workers[i].g, x_size, 1);
+    }
+    return;
+  }
 
-  real_t S[3 * 3] = {0};
-  skew(p, S);
+  int *param_sizes = malloc(sizeof(int) * (nb_params + 1));
+  int k = 0;
+  for (int i = 0; i < solver->nb_poses; i++) {
+    param_sizes[k++] = 6;
+  }
+  for (int i = 0; i < solver->nb_speed_biases; i++) {
+    param_sizes[k++] = 9;
+  }
+  for (int i = 0; i < solver->nb_extrinsics; i++) {
+    param_sizes[k++] = 6;
+  }
+  for (int i = 0; i < solver->nb_cams; i++) {
+    param_sizes[k++] = 8;
+  }
+  for (int i = 0; i < solver->nb_features; i++) {
+    param_sizes[k++] = 3;
+  }
 
-  real_t RHS[3 * 3] = {0};
-  dot(C_CS, 3, 3, S, 3, 3, RHS);
+  solver_free_hessian(solver);
+  block_hessian_setup(&solver->H, param_sizes, nb_params);
+  memcpy(solver->H_layout, layout, sizeof(layout));
+  solver->g = vec_malloc(x_size + 1);
+  solver->x = vec_malloc(x_size + 1);
+  solver->x_size = x_size;
 
-  /* Form: -C_CS */
-  real_t neg_C_CS[3 * 3] = {0};
-  mat_copy(C_CS, 3, 3, neg_C_CS);
-  mat_scale(neg_C_CS, 3, 3, -1.0);
+  for (int i = 0; i < nb_workers; i++) {
+    block_hessian_setup(&solver->workers[i].H, param_sizes, nb_params);
+    solver->workers[i].g = vec_malloc(x_size + 1);
+  }
+  free(param_sizes);
+}
 
-  /* Form: J_pos = -1 * sqrt_info * J_h * C_CS * skew(C_SC * p_C); */
-  real_t J_pos[2 * 3] = {0};
-  dot(Jh_weighted, 2, 3, RHS, 3, 3, J_pos);
+/**
+ * Accumulate a factor with residual `r` of size `r_size` and Jacobians `jacs`
+ * w.r.t. the parameter blocks `param_ids` into `H` and `g`, only the blocks
+ * touched by the factor are updated.
+ */
+static void solver_evaluator(block_hessian_t *H,
+                             real_t *g,
+                             const int *param_ids,
+                             const int nb_params,
+                             const real_t *r,
+                             const int r_size,
+                             real_t **jacs) {
+  for (int i = 0; i < nb_params; i++) {
+    const int id_i = param_ids[i];
+    const int idx_i = H->param_idxs[id_i];
+    const int size_i = H->param_sizes[id_i];
+    const real_t *J_i = jacs[i];
 
-  /* Form: J_rot = -1 * sqrt_info * J_h * -C_CS; */
-  real_t J_rot[2 * 3] = {0};
-  dot(Jh_weighted, 2, 3, neg_C_CS, 3, 3, J_rot);
+    /* Fill Hessian H */
+    /* H_ij = J_i' * J_j */
+    /* H_ji = H_ij' */
+    for (int j = i; j < nb_params; j++) {
+      block_hessian_accumulate(H, id_i, param_ids[j], J_i, jacs[j], r_size);
+    }
 
-  /* Fill Jacobians */
-  mat_block_set(J, 6, 0, 0, 1, 2, J_pos);
-  mat_block_set(J, 6, 0, 3, 1, 5, J_rot);
+    /* Fill in the R.H.S of H dx = g */
+    /* g = -J_i' * r */
+    for (int a = 0; a < size_i; a++) {
+      real_t sum = 0.0;
+      for (int k = 0; k < r_size; k++) {
+        sum += J_i[k * size_i + a] * r[k];
+      }
+      g[idx_i + a] -= sum;
+    }
+  }
 }
 
-static void cam_factor_camera_params_jacobian(const real_t neg_sqrt_info[2 * 2],
-                                              const real_t J_cam_params[2 * 8],
-                                              real_t J[2 * 8]) {
-  /* J = -1 * sqrt_info * J_cam_params; */
-  dot(neg_sqrt_info, 2, 2, J_cam_params, 2, 8, J);
+/**
+ * Evaluate camera factors in `[start, end)` into `H` and `g`. The factors are
+ * evaluated together with `cam_factor_batch_eval()` in `batch`, then their
+ * residuals and Jacobians are copied back into the factors and accumulated.
+ * @returns Residual size of the evaluated factors
+ */
+static int solver_eval_cam_factors(solver_t *solver,
+                                   const int start,
+                                   const int end,
+                                   cam_factor_batch_t *batch,
+                                   block_hessian_t *H,
+                                   real_t *g) {
+  if (start == end) {
+    return 0;
+  }
+
+  /* Batch evaluate */
+  cam_factor_batch_reserve(batch, end - start);
+  batch->size = 0;
+  for (int i = start; i < end; i++) {
+    const cam_factor_t *factor = &solver->cam_factors[i];
+    const int k = batch->size++;
+    batch->pose_idx[k] = factor->pose - solver->poses;
+    batch->extrinsics_idx[k] = factor->extrinsics - solver->extrinsics;
+    batch->camera_idx[k] = factor->camera - solver->cams;
+    batch->feature_idx[k] = factor->feature - solver->features;
+    batch->z[0][k] = factor->z[0];
+    batch->z[1][k] = factor->z[1];
+    batch->sqrt_info[0][k] = sqrt(factor->covar[0]);
+    batch->sqrt_info[1][k] = sqrt(factor->covar[3]);
+  }
+  cam_factor_batch_eval(batch,
+                        solver->poses,
+                        solver->nb_poses,
+                        solver->extrinsics,
+                        solver->nb_extrinsics,
+                        solver->cams,
+                        solver->features);
+
+  /* Accumulate */
+  int r_size = 0;
+  for (int i = start; i < end; i++) {
+    cam_factor_t *factor = &solver->cam_factors[i];
+    const int k = i - start;
+    for (int j = 0; j < 2; j++) {
+      factor->r[j] = batch->r[j][k];
+    }
+    for (int j = 0; j < 2 * 6; j++) {
+      factor->J0[j] = batch->J0[j][k];
+      factor->J1[j] = batch->J1[j][k];
+    }
+    for (int j = 0; j < 2 * 8; j++) {
+      factor->J2[j] = batch->J2[j][k];
+    }
+    for (int j = 0; j < 2 * 3; j++) {
+      factor->J3[j] = batch->J3[j][k];
+    }
+
+    const int param_ids[4] = {solver_pose_id(solver, factor->pose),
+                              solver_extrinsics_id(solver, factor->extrinsics),
+                              solver_camera_id(solver, factor->camera),
+                              solver_feature_id(solver, factor->feature)};
+    solver_evaluator(H,
+                     g,
+                     param_ids,
+                     factor->nb_params,
+                     factor->r,
+                     factor->r_size,
+                     factor->jacs);
+    r_size += factor->r_size;
+  }
+
+  return r_size;
 }
 
-static void cam_factor_feature_jacobian(const real_t Jh_weighted[2 * 3],
-                                        const real_t T_WS[4 * 4],
-                                        const real_t T_SC[4 * 4],
-                                        real_t J[2 * 3]) {
-  /* Setup */
-  real_t T_WC[4 * 4] = {0};
-  real_t C_WC[3 * 3] = {0};
-  real_t C_CW[3 * 3] = {0};
-  dot(T_WS, 4, 4, T_SC, 4, 4, T_WC);
-  tf_rot_get(T_WC, C_WC);
-  mat_transpose(C_WC, 3, 3, C_CW);
+/**
+ * Evaluate all IMU factors into `H` and `g`.
+ */
+static int solver_eval_imu_factors(solver_t *solver,
+                                   block_hessian_t *H,
+                                   real_t *g) {
+  int r_size = 0;
+
+  for (int i = 0; i < solver->nb_imu_factors; i++) {
+    imu_factor_t *factor = &solver->imu_factors[i];
+    imu_factor_eval(factor);
+
+    const int param_ids[4] = {solver_pose_id(solver, factor->pose_i),
+                              solver_speed_biases_id(solver, factor->sb_i),
+                              solver_pose_id(solver, factor->pose_j),
+                              solver_speed_biases_id(solver, factor->sb_j)};
+    solver_evaluator(H,
+                     g,
+                     param_ids,
+                     factor->nb_params,
+                     factor->r,
+                     factor->r_size,
+                     factor->jacs);
+    r_size += factor->r_size;
+  }
 
-  /* Form: J = -1 * sqrt_info * J_h * C_CW; */
-  dot(Jh_weighted, 2, 3, C_CW, 3, 3, J);
+  return r_size;
 }
 
-int cam_factor_eval(cam_factor_t *factor) {
-  assert(factor != NULL);
-  assert(factor->pose);
-  assert(factor->extrinsics);
-  assert(factor->feature);
-  assert(factor->camera);
+/**
+ * Reduce worker's thread-local H and g into the solver's H and g.
+ */
+static void solver_worker_reduce(solver_worker_t *worker) {
+  solver_t *solver = worker->solver;
+  block_hessian_merge(&solver->H, &worker->H);
+  for (int i = 0; i < solver->x_size; i++) {
+    solver->g[i] += worker->g[i];
+  }
+  solver->r_size += worker->r_size;
+}
 
-  /* Map params */
-  /* -- Sensor pose */
-  real_t T_WS[4 * 4] = {0};
-  tf(factor->pose->data, T_WS);
-  /* -- Sensor-Camera extrinsics */
-  real_t T_SC[4 * 4] = {0};
-  tf(factor->extrinsics->data, T_SC);
-  /* -- Camera pose */
-  real_t T_WC[4 * 4] = {0};
-  real_t T_CW[4 * 4] = {0};
-  dot(T_WS, 4, 4, T_SC, 4, 4, T_WC);
-  tf_inv(T_WC, T_CW);
-  /* -- Feature */
-  real_t *p_W = factor->feature->data;
-  real_t p_C[3] = {0};
-  tf_point(T_CW, p_W, p_C);
+/**
+ * Worker thread, waits for the solver to signal an evaluation, evaluates its
+ * range of factors and reports back, until the solver stops the pool.
+ */
+static void *solver_worker_loop(void *arg) {
+  solver_worker_t *worker = (solver_worker_t *) arg;
+  solver_t *solver = worker->solver;
+  int gen = 0;
 
-  /* Calculate residuals */
-  /* -- Project point from world to image plane */
-  real_t z_hat[2];
-  real_t *cam_params = factor->camera->data;
-  pinhole_radtan4_project(cam_params, p_C, z_hat);
-  /* -- Residual */
-  real_t err[2] = {0};
-  err[0] = factor->z[0] - z_hat[0];
-  err[1] = factor->z[1] - z_hat[1];
-  /* -- Weighted residual */
-  real_t sqrt_info[2 * 2] = {0};
-  sqrt_info[0] = 1.0 / factor->covar[0];
-  sqrt_info[1] = 0.0;
-  sqrt_info[2] = 0.0;
-  sqrt_info[3] = 1.0 / factor->covar[1];
-  dot(sqrt_info, 2, 2, err, 2, 1, factor->r);
+  pthread_mutex_lock(&solver->pool_lock);
+  while (1) {
+    while (solver->pool_stop == 0 && solver->pool_gen == gen) {
+      pthread_cond_wait(&solver->pool_start, &solver->pool_lock);
+    }
+    if (solver->pool_stop) {
+      break;
+    }
+    gen = solver->pool_gen;
+    pthread_mutex_unlock(&solver->pool_lock);
+
+    worker->r_size = solver_eval_cam_factors(solver,
+                                             worker->start,
+                                             worker->end,
+                                             &worker->cam_batch,
+                                             &worker->H,
+                                             worker->g);
+
+    /* Reduce as soon as finished, order depends on thread scheduling */
+    pthread_mutex_lock(&solver->pool_lock);
+    if (solver->deterministic == 0) {
+      solver_worker_reduce(worker);
+    }
+    solver->pool_pending--;
+    if (solver->pool_pending == 0) {
+      pthread_cond_signal(&solver->pool_done);
+    }
+  }
+  pthread_mutex_unlock(&solver->pool_lock);
+
+  return NULL;
+}
+
+/**
+ * Start a pool of `nb_threads` persistent worker threads if `nb_threads > 1`,
+ * replacing any existing pool of a different size. If a thread fails to
+ * start the pool is stopped and factors are evaluated serially.
+ *
+ * @returns
+ * - 0 for success
+ * - -1 for failure
+ */
+static int solver_setup_workers(solver_t *solver) {
+  const int nb_workers = (solver->nb_threads > 1) ? solver->nb_threads : 0;
+  if (solver->nb_workers == nb_workers) {
+    return 0;
+  }
 
-  /* Calculate jacobians */
-  /* -- Form: -1 * sqrt_info */
-  real_t neg_sqrt_info[2 * 2] = {0};
-  mat_copy(sqrt_info, 2, 2, neg_sqrt_info);
-  mat_scale(neg_sqrt_info, 2, 2, -1.0);
-  /* -- Form: Jh_weighted = -1 * sqrt_info * J_h */
-  real_t J_h[2 * 3] = {0};
-  real_t Jh_weighted[2 * 3] = {0};
-  pinhole_radtan4_project_jacobian(cam_params, p_C, J_h);
-  dot(neg_sqrt_info, 2, 2, J_h, 2, 3, Jh_weighted);
-  /* -- Form: J_cam_params */
-  real_t J_cam_params[2 * 8] = {0};
-  pinhole_radtan4_params_jacobian(cam_params, p_C, J_cam_params);
-  /* -- Fill jacobians */
-  cam_factor_sensor_pose_jacobian(Jh_weighted, T_WS, T_SC, p_W, factor->J0);
-  cam_factor_sensor_camera_jacobian(Jh_weighted, T_SC, p_C, factor->J1);
-  cam_factor_camera_params_jacobian(neg_sqrt_info, J_cam_params, factor->J2);
-  cam_factor_feature_jacobian(Jh_weighted, T_WS, T_SC, factor->J3);
+  /* Worker H and g are sized with the Hessian, force it to be setup again */
+  solver_free_hessian(solver);
+  solver_stop_workers(solver);
+  if (nb_workers == 0) {
+    return 0;
+  }
+
+  solver->workers = calloc(nb_workers, sizeof(solver_worker_t));
+  for (int i = 0; i < nb_workers; i++) {
+    solver_worker_t *worker = &solver->workers[i];
+    worker->solver = solver;
+    if (pthread_create(&worker->thread, NULL, solver_worker_loop, worker)) {
+      LOG_ERROR("Failed to create solver worker thread!");
+      solver_stop_workers(solver);
+      return -1;
+    }
+    solver->nb_workers++;
+  }
 
   return 0;
 }
 
-/* IMU FACTOR --------------------------------------------------------------- */
+/**
+ * Evaluate all factors and form the solver's H and g.
+ *
+ * If `nb_threads > 1` the camera factors are partitioned into contiguous ranges
+ * across a pool of `nb_threads` persistent workers, each accumulating into
+ * thread-local H and g which are reduced into the solver's H and g. The pool
+ * is started by `solver_setup()` and again on the first evaluation after
+ * `nb_threads` changes. With `deterministic` set the reduction happens in
+ * worker order after all workers have finished, so results are reproducible
+ * for a given number of threads, otherwise each worker reduces as soon as it
+ * finishes.
+ *
+ * @returns
+ * - 0 for success
+ * - -1 for failure
+ */
+int solver_eval(solver_t *solver) {
+  assert(solver != NULL);
 
-void imu_buf_setup(imu_buf_t *imu_buf) {
-  for (int k = 0; k < MAX_IMU_BUF_SIZE; k++) {
-    imu_buf->ts[k] = 0.0;
+  const int retval = solver_setup_workers(solver);
+  solver_setup_hessian(solver);
+  solver->r_size = 0;
 
-    imu_buf->acc[k][0] = 0.0;
-    imu_buf->acc[k][1] = 0.0;
-    imu_buf->acc[k][2] = 0.0;
+  /* Evaluate IMU factors, there are few so they are not split over workers */
+  solver->r_size = solver_eval_imu_factors(solver, &solver->H, solver->g);
+
+  /* Evaluate camera factors serially */
+  if (solver->nb_workers == 0) {
+    solver->r_size += solver_eval_cam_factors(solver,
+                                              0,
+                                              solver->nb_cam_factors,
+                                              &solver->cam_batch,
+                                              &solver->H,
+                                              solver->g);
+    return retval;
+  }
 
-    imu_buf->gyr[k][0] = 0.0;
-    imu_buf->gyr[k][1] = 0.0;
-    imu_buf->gyr[k][2] = 0.0;
+  /* Evaluate camera factors in parallel */
+  const int nb_workers = solver->nb_workers;
+  const int nb_factors = solver->nb_cam_factors;
+  pthread_mutex_lock(&solver->pool_lock);
+  for (int i = 0; i < nb_workers; i++) {
+    solver_worker_t *worker = &solver->workers[i];
+    worker->start = (nb_factors * i) / nb_workers;
+    worker->end = (nb_factors * (i + 1)) / nb_workers;
+    worker->r_size = 0;
   }
+  solver->pool_pending = nb_workers;
+  solver->pool_gen++;
+  pthread_cond_broadcast(&solver->pool_start);
+  while (solver->pool_pending > 0) {
+    pthread_cond_wait(&solver->pool_done, &solver->pool_lock);
+  }
+  pthread_mutex_unlock(&solver->pool_lock);
 
-  imu_buf->size = 0;
+  /* Reduce in worker order */
+  if (solver->deterministic) {
+    for (int i = 0; i < nb_workers; i++) {
+      solver_worker_reduce(&solver->workers[i]);
+    }
+  }
+
+  return 0;
 }
 
-void imu_buf_print(const imu_buf_t *imu_buf) {
-  for (int k = 0; k < imu_buf->size; k++) {
-    const real_t *acc = imu_buf->acc[k];
-    const real_t *gyr = imu_buf->gyr[k];
+/**
+ * Sum the cost `0.5 * r' * r` of the residuals currently held by the factors.
+ */
+static real_t solver_residuals_cost(const solver_t *solver) {
+  real_t cost = 0.0;
 
-    printf("ts: %ld ", imu_buf->ts[k]);
-    printf("acc: [%.2f, %.2f, %.2f] ", acc[0], acc[1], acc[2]);
-    printf("gyr: [%.2f, %.2f, %.2f] ", gyr[0], gyr[1], gyr[2]);
-    printf("\n");
+  for (int i = 0; i < solver->nb_cam_factors; i++) {
+    const cam_factor_t *factor = &solver->cam_factors[i];
+    for (int k = 0; k < factor->r_size; k++) {
+      cost += 0.5 * factor->r[k] * factor->r[k];
+    }
   }
-}
 
-void imu_buf_add(imu_buf_t *imu_buf,
-                 timestamp_t ts,
-                 real_t acc[3],
-                 real_t gyr[3]) {
-  int k = imu_buf->size;
-  imu_buf->ts[k] = ts;
-  imu_buf->acc[k][0] = acc[0];
-  imu_buf->acc[k][1] = acc[1];
-  imu_buf->acc[k][2] = acc[2];
-  imu_buf->gyr[k][0] = gyr[0];
-  imu_buf->gyr[k][1] = gyr[1];
-  imu_buf->gyr[k][2] = gyr[2];
-  imu_buf->size++;
-}
+  for (int i = 0; i < solver->nb_imu_factors; i++) {
+    const imu_factor_t *factor = &solver->imu_factors[i];
+    for (int k = 0; k < factor->r_size; k++) {
+      cost += 0.5 * factor->r[k] * factor->r[k];
+    }
+  }
 
-void imu_buf_clear(imu_buf_t *imu_buf) {
-  for (int k = 0; k < imu_buf->size; k++) {
-    timestamp_t *ts = &imu_buf->ts[k];
-    real_t *acc = imu_buf->acc[k];
-    real_t *gyr = imu_buf->gyr[k];
+  return cost;
+}
 
-    *ts = 0;
-    acc[0] = 0.0;
-    acc[1] = 0.0;
-    acc[2] = 0.0;
-    gyr[0] = 0.0;
-    gyr[1] = 0.0;
-    gyr[2] = 0.0;
+/**
+ * Evaluate the cost `0.5 * r' * r` of all factors at the current estimate.
+ * Only the residuals of the camera factors are formed, the few IMU factors
+ * are evaluated in full.
+ */
+static real_t solver_cost(solver_t *solver) {
+  for (int i = 0; i < solver->nb_cam_factors; i++) {
+    cam_factor_residuals(&solver->cam_factors[i]);
   }
-  imu_buf->size = 0;
+  for (int i = 0; i < solver->nb_imu_factors; i++) {
+    imu_factor_eval(&solver->imu_factors[i]);
+  }
+
+  return solver_residuals_cost(solver);
 }
 
-void imu_buf_copy(const imu_buf_t *from, imu_buf_t *to) {
-  to->size = 0;
-  for (int k = 0; k < from->size; k++) {
-    to->ts[k] = from->ts[k];
+/**
+ * Invert 3x3 matrix `A` using its adjugate, results are written to `A_inv`.
+ * @returns
+ * - 0 for success
+ * - -1 if `A` is singular
+ */
+static int solver_inv3x3(const real_t A[3 * 3], real_t A_inv[3 * 3]) {
+  const real_t c0 = A[4] * A[8] - A[5] * A[7];
+  const real_t c1 = A[5] * A[6] - A[3] * A[8];
+  const real_t c2 = A[3] * A[7] - A[4] * A[6];
+  const real_t det = A[0] * c0 + A[1] * c1 + A[2] * c2;
+  if (fabs(det) < 1e-12) {
+    return -1;
+  }
 
-    to->acc[k][0] = from->acc[k][0];
-    to->acc[k][1] = from->acc[k][1];
-    to->acc[k][2] = from->acc[k][2];
+  const real_t inv_det = 1.0 / det;
+  A_inv[0] = c0 * inv_det;
+  A_inv[1] = (A[2] * A[7] - A[1] * A[8]) * inv_det;
+  A_inv[2] = (A[1] * A[5] - A[2] * A[4]) * inv_det;
+  A_inv[3] = c1 * inv_det;
+  A_inv[4] = (A[0] * A[8] - A[2] * A[6]) * inv_det;
+  A_inv[5] = (A[2] * A[3] - A[0] * A[5]) * inv_det;
+  A_inv[6] = c2 * inv_det;
+  A_inv[7] = (A[1] * A[6] - A[0] * A[7]) * inv_det;
+  A_inv[8] = (A[0] * A[4] - A[1] * A[3]) * inv_det;
 
-    to->gyr[k][0] = from->gyr[k][0];
-    to->gyr[k][1] = from->gyr[k][1];
-    to->gyr[k][2] = from->gyr[k][2];
-  }
-  to->size = from->size;
+  return 0;
 }
 
-void imu_factor_setup(imu_factor_t *factor,
-                      imu_params_t *imu_params,
-                      imu_buf_t *imu_buf,
-                      pose_t *pose_i,
-                      speed_biases_t *sb_i,
-                      pose_t *pose_j,
-                      speed_biases_t *sb_j) {
-  factor->imu_params = imu_params;
-  imu_buf_copy(imu_buf, &factor->imu_buf);
-  factor->pose_i = pose_i;
-  factor->sb_i = sb_i;
-  factor->pose_j = pose_j;
-  factor->sb_j = sb_j;
+/**
+ * Solve the damped normal equations `(H + lambda * diag(H)) dx = g` by
+ * eliminating the landmarks with the Schur complement.
+ *
+ * With the state partitioned into poses/extrinsics/cameras `p` and landmarks
+ * `l`, the landmark block `H_ll` is block-diagonal with 3x3 blocks, so
+ *
+ *   S = H_pp - H_pl * H_ll^-1 * H_lp
+ *   b = g_p - H_pl * H_ll^-1 * g_l
+ *
+ * is formed one landmark at a time, the reduced system `S dx_p = b` is solved
+ * and the landmark updates are recovered by back-substitution
+ *
+ *   dx_l = H_ll^-1 * (g_l - H_lp * dx_p)
+ *
+ * The results are written to `dx` of size `x_size`.
+ *
+ * @returns
+ * - 0 for success
+ * - -1 for failure
+ */
+int solver_schur_solve(solver_t *solver, const real_t lambda, real_t *dx) {
+  assert(solver != NULL);
+  assert(dx != NULL);
+
+  const block_hessian_t *H = &solver->H;
+  const real_t *g = solver->g;
+  const int nb_params = H->nb_params;
+  const int lmk_id = solver_lmk_id(solver);
+  const int nb_lmks = nb_params - lmk_id;
+  const int m = (nb_lmks > 0) ? H->param_idxs[lmk_id] : H->x_size;
+  int retval = 0;
 
-  zeros(factor->covar, 15, 15);
-  zeros(factor->r, 15, 1);
-  factor->r_size = 15;
+  /* Form H_pp and group the H_pl blocks by landmark */
+  arena_t *arena = &solver->arena;
+  const arena_mark_t mark = arena_mark(arena);
+  real_t *S = arena_calloc(arena, m * m + 1, sizeof(real_t));
+  real_t *b = arena_alloc(arena, sizeof(real_t) * (m + 1));
+  int *lmk_ptrs = arena_calloc(arena, nb_lmks + 1, sizeof(int));
+  vec_copy(g, m, b);
 
-  factor->jacs[0] = factor->J0;
-  factor->jacs[1] = factor->J1;
-  factor->jacs[2] = factor->J2;
-  factor->jacs[3] = factor->J3;
-  factor->nb_params = 4;
-}
+  for (size_t k = 0; k < H->capacity; k++) {
+    if (H->keys[k] == BLOCK_HESSIAN_EMPTY) {
+      continue;
+    }
 
-void imu_factor_reset(imu_factor_t *factor) {
-  zeros(factor->r, 15, 1);
-  zeros(factor->J0, 2, 6);
-  zeros(factor->J1, 2, 9);
-  zeros(factor->J2, 2, 6);
-  zeros(factor->J3, 2, 9);
-}
+    const int i = H->keys[k] >> 32;
+    const int j = H->keys[k] & 0xFFFFFFFF;
+    if (j < lmk_id) {
+      const int rs = H->param_idxs[i];
+      const int cs = H->param_idxs[j];
+      const int size_i = H->param_sizes[i];
+      const int size_j = H->param_sizes[j];
+      const real_t *H_ij = &H->data[H->offsets[k]];
+      for (int a = 0; a < size_i; a++) {
+        for (int c = 0; c < size_j; c++) {
+          S[(rs + a) * m + (cs + c)] = H_ij[a * size_j + c];
+          S[(cs + c) * m + (rs + a)] = H_ij[a * size_j + c];
+        }
+      }
+    } else if (i < lmk_id) {
+      lmk_ptrs[j - lmk_id + 1]++;
+    }
+  }
+  for (int k = 0; k < m; k++) {
+    S[k * m + k] += lambda * S[k * m + k];
+  }
 
-int imu_factor_eval(imu_factor_t *factor) {
-  assert(factor != NULL);
+  /* -- Compressed landmark to H_pl block lists */
+  for (int l = 0; l < nb_lmks; l++) {
+    lmk_ptrs[l + 1] += lmk_ptrs[l];
+  }
+  const int nb_lmk_blocks = lmk_ptrs[nb_lmks];
+  int *lmk_fill = arena_calloc(arena, nb_lmks + 1, sizeof(int));
+  int *blk_ids = arena_alloc(arena, sizeof(int) * (nb_lmk_blocks + 1));
+  const real_t **blks =
+      arena_alloc(arena, sizeof(real_t *) * (nb_lmk_blocks + 1));
+  for (size_t k = 0; k < H->capacity; k++) {
+    if (H->keys[k] == BLOCK_HESSIAN_EMPTY) {
+      continue;
+    }
+    const int i = H->keys[k] >> 32;
+    const int j = H->keys[k] & 0xFFFFFFFF;
+    if (i < lmk_id && j >= lmk_id) {
+      const int l = j - lmk_id;
+      const int idx = lmk_ptrs[l] + lmk_fill[l]++;
+      blk_ids[idx] = i;
+      blks[idx] = &H->data[H->offsets[k]];
+    }
+  }
 
-  /* factor->jacs[0] */
+  /* Eliminate landmarks one at a time */
+  real_t *H_ll_invs = arena_alloc(arena, sizeof(real_t) * (nb_lmks * 9 + 1));
+  real_t *W =
+      arena_alloc(arena, sizeof(real_t) * (nb_lmk_blocks * 8 * 3 + 1));
+  for (int l = 0; l < nb_lmks; l++) {
+    /* -- Damped H_ll^-1 */
+    real_t H_ll[3 * 3] = {0};
+    const real_t *H_ll_data = block_hessian_get(H, lmk_id + l, lmk_id + l);
+    if (H_ll_data == NULL) {
+      zeros(&H_ll_invs[l * 9], 3, 3);
+      continue;
+    }
+    mat_copy(H_ll_data, 3, 3, H_ll);
+    H_ll[0] += lambda * H_ll[0];
+    H_ll[4] += lambda * H_ll[4];
+    H_ll[8] += lambda * H_ll[8];
+    real_t *H_ll_inv = &H_ll_invs[l * 9];
+    if (solver_inv3x3(H_ll, H_ll_inv) != 0) {
+      zeros(H_ll_inv, 3, 3);
+      continue;
+    }
 
-  return 0;
-}
+    /* -- W_a = H_al * H_ll^-1 */
+    const real_t *g_l = &g[H->param_idxs[lmk_id + l]];
+    for (int a = lmk_ptrs[l]; a < lmk_ptrs[l + 1]; a++) {
+      const int size_a = H->param_sizes[blk_ids[a]];
+      real_t *W_a = &W[(a - lmk_ptrs[l]) * 8 * 3];
+      zeros(W_a, size_a, 3);
+      dot(blks[a], size_a, 3, H_ll_inv, 3, 3, W_a);
+
+      /* b_a -= W_a * g_l */
+      real_t *b_a = &b[H->param_idxs[blk_ids[a]]];
+      for (int r = 0; r < size_a; r++) {
+        b_a[r] -= W_a[r * 3] * g_l[0] + W_a[r * 3 + 1] * g_l[1]
+                  + W_a[r * 3 + 2] * g_l[2];
+      }
 
-/* SOLVER ------------------------------------------------------------------- */
+      /* S_ac -= W_a * H_cl' */
+      for (int c = a; c < lmk_ptrs[l + 1]; c++) {
+        const int size_c = H->param_sizes[blk_ids[c]];
+        const int rs = H->param_idxs[blk_ids[a]];
+        const int cs = H->param_idxs[blk_ids[c]];
+        const real_t *H_cl = blks[c];
+        for (int r = 0; r < size_a; r++) {
+          for (int s = 0; s < size_c; s++) {
+            const real_t v = W_a[r * 3] * H_cl[s * 3]
+                             + W_a[r * 3 + 1] * H_cl[s * 3 + 1]
+                             + W_a[r * 3 + 2] * H_cl[s * 3 + 2];
+            S[(rs + r) * m + (cs + s)] -= v;
+            if (c != a) {
+              S[(cs + s) * m + (rs + r)] -= v;
+            }
+          }
+        }
+      }
+    }
+  }
 
-void solver_setup(solver_t *solver) {
-  assert(solver);
+  /* Solve reduced system S dx_p = b */
+  if (m > 0) {
+    real_t *work = arena_alloc(arena, sizeof(real_t) * chol_work_size(m));
+    if (chol_factor(S, m, work) == 0) {
+      chol_factor_solve(S, m, b, dx);
+    } else {
+      retval = -1;
+    }
+  }
+  for (int k = 0; k < m && retval == 0; k++) {
+    if (isnan(dx[k]) || isinf(dx[k])) {
+      retval = -1;
+      break;
+    }
+  }
 
-  solver->nb_cam_factors = 0;
-  solver->nb_imu_factors = 0;
+  /* Back-substitute landmarks: dx_l = H_ll^-1 * (g_l - H_lp * dx_p) */
+  for (int l = 0; l < nb_lmks; l++) {
+    const int idx_l = H->param_idxs[lmk_id + l];
+    real_t rhs[3] = {g[idx_l], g[idx_l + 1], g[idx_l + 2]};
+    for (int a = lmk_ptrs[l]; a < lmk_ptrs[l + 1]; a++) {
+      const int size_a = H->param_sizes[blk_ids[a]];
+      const real_t *dx_a = &dx[H->param_idxs[blk_ids[a]]];
+      const real_t *H_al = blks[a];
+      for (int r = 0; r < size_a; r++) {
+        rhs[0] -= H_al[r * 3] * dx_a[r];
+        rhs[1] -= H_al[r * 3 + 1] * dx_a[r];
+        rhs[2] -= H_al[r * 3 + 2] * dx_a[r];
+      }
+    }
 
-  solver->nb_poses = 0;
-  solver->nb_cams = 0;
-  solver->nb_extrinsics = 0;
-  solver->nb_features = 0;
+    const real_t *H_ll_inv = &H_ll_invs[l * 9];
+    dx[idx_l + 0] = H_ll_inv[0] * rhs[0] + H_ll_inv[1] * rhs[1]
+                    + H_ll_inv[2] * rhs[2];
+    dx[idx_l + 1] = H_ll_inv[3] * rhs[0] + H_ll_inv[4] * rhs[1]
+                    + H_ll_inv[5] * rhs[2];
+    dx[idx_l + 2] = H_ll_inv[6] * rhs[0] + H_ll_inv[7] * rhs[1]
+                    + H_ll_inv[8] * rhs[2];
+  }
 
-  solver->x_size = 0;
-  solver->r_size = 0;
-}
+  /* Clean up */
+  arena_rewind(arena, mark);
 
-void solver_print(solver_t *solver) {
-  printf("solver:\n");
-  printf("r_size: %d\n", solver->r_size);
-  printf("x_size: %d\n", solver->x_size);
-  printf("nb_cam_factors: %d\n", solver->nb_cam_factors);
-  printf("nb_imu_factors: %d\n", solver->nb_imu_factors);
-  printf("nb_poses: %d\n", solver->nb_poses);
+  return retval;
 }
 
-static void solver_evaluator(solver_t *solver,
-                             int **param_orders,
-                             int *param_sizes,
-                             int nb_params,
-                             real_t *r,
-                             int r_size,
-                             real_t **jacs) {
-  real_t *H = solver->H;
-  int H_size = solver->x_size;
-  real_t *g = solver->g;
+/**
+ * Solve the damped normal equations `(H + lambda * diag(H)) dx = g` with a
+ * supernodal sparse Cholesky factorization of the full Hessian. Landmarks are
+ * eliminated first, so their fill-in stays within the pose blocks they
+ * observe, followed by the remaining parameter blocks in order. The symbolic
+ * analysis is cached in the solver, so across Levenberg-Marquardt iterations
+ * only the numeric factorization is repeated.
+ *
+ * The results are written to `dx` of size `x_size`.
+ *
+ * @returns
+ * - 0 for success
+ * - -1 for failure
+ */
+int solver_sparse_solve(solver_t *solver, const real_t lambda, real_t *dx) {
+  assert(solver != NULL);
+  assert(dx != NULL);
 
-  for (int i = 0; i < nb_params; i++) {
-    int *idx_i = param_orders[i];
-    int size_i = param_sizes[i];
-    const real_t *J_i = jacs[i];
+  const block_hessian_t *H = &solver->H;
+  const int nb_params = H->nb_params;
+  const int lmk_id = solver_lmk_id(solver);
+  if (nb_params == 0) {
+    return 0;
+  }
 
-    real_t J_i_trans[MAX_H_SIZE] = {0};
-    mat_transpose(J_i, r_size, size_i, J_i_trans);
+  /* Symbolic factorization, reused while the pattern of H is unchanged. The
+   * pattern only changes when H is setup again or a block is inserted */
+  block_chol_t *chol = &solver->chol;
+  if (solver->chol_valid == 0 || solver->chol_nb_blocks != H->nb_blocks) {
+    if (solver->chol_valid) {
+      block_chol_free(chol);
+      solver->chol_valid = 0;
+    }
 
-    for (int j = i; j < nb_params; j++) {
-      int *idx_j = param_orders[j];
-      int size_j = param_sizes[i];
-      const real_t *J_j = jacs[j];
-
-      real_t H_ij[MAX_H_SIZE] = {0};
-      dot(J_i_trans, size_i, r_size, J_j, r_size, size_j, H_ij);
-
-      /* Fill Hessian H */
-      /* H_ij = J_i' * J_j */
-      /* H_ji = H_ij' */
-      int stride = H_size;
-      int rs = *idx_i;
-      int cs = *idx_j;
-      int re = rs + size_i;
-      int ce = cs + size_j;
-      if (i == j) {
-        mat_block_set(H, stride, rs, cs, re, ce, H_ij);
-      } else {
-        real_t H_ji[MAX_H_SIZE] = {0};
-        mat_transpose(H_ij, size_i, size_j, H_ji);
-        mat_block_set(H, stride, rs, cs, re, ce, H_ij);
-        mat_block_set(H, stride, cs, rs, ce, re, H_ij);
-      }
+    /* Elimination order */
+    arena_t *arena = &solver->arena;
+    const arena_mark_t mark = arena_mark(arena);
+    int *order = arena_alloc(arena, sizeof(int) * nb_params);
+    int k = 0;
+    for (int i = lmk_id; i < nb_params; i++) {
+      order[k++] = i;
+    }
+    for (int i = 0; i < lmk_id; i++) {
+      order[k++] = i;
+    }
+    block_chol_setup(chol, H, order);
+    arena_rewind(arena, mark);
+    solver->chol_valid = 1;
+    solver->chol_nb_blocks = H->nb_blocks;
+  }
 
-      /* Fill in the R.H.S of H dx = g */
-      /* g = -J_i * r */
-      mat_scale(J_i_trans, H_size, r_size, -1);
-      dot(J_i_trans, H_size, r_size, r, r_size, 1, g);
+  /* Numeric factorization and solve */
+  int retval = block_chol_factor(chol, H, lambda);
+  if (retval == 0) {
+    block_chol_solve(chol, solver->g, dx);
+  }
+  for (int i = 0; i < H->x_size && retval == 0; i++) {
+    if (isnan(dx[i]) || isinf(dx[i])) {
+      retval = -1;
     }
   }
 
-  /* Update parameter order */
-  for (int i = 0; i < nb_params; i++) {
-    param_orders[i] = param_orders[i] + param_sizes[i];
+  return retval;
+}
+
+/**
+ * Update pose-like parameters `data` (qw, qx, qy, qz, rx, ry, rz) with the
+ * 6x1 perturbation `dx` (dtheta, dr), where the rotation is perturbed on the
+ * left to match the factor Jacobians.
+ */
+static void solver_update_pose(real_t data[7], const real_t dx[6]) {
+  const real_t q[4] = {data[0], data[1], data[2], data[3]};
+  real_t dq[4] = {0};
+  real_t q_new[4] = {0};
+  quat_delta(dx, dq);
+  quat_mul(dq, q, q_new);
+  vec_normalize(q_new, 4);
+
+  data[0] = q_new[0];
+  data[1] = q_new[1];
+  data[2] = q_new[2];
+  data[3] = q_new[3];
+  data[4] += dx[3];
+  data[5] += dx[4];
+  data[6] += dx[5];
+}
+
+/**
+ * Update solver state with `dx`, ordered as the parameter blocks of H.
+ */
+static void solver_update(solver_t *solver, const real_t *dx) {
+  const int *idxs = solver->H.param_idxs;
+  int k = 0;
+
+  for (int i = 0; i < solver->nb_poses; i++) {
+    solver_update_pose(solver->poses[i].data, &dx[idxs[k++]]);
+  }
+  for (int i = 0; i < solver->nb_speed_biases; i++) {
+    const real_t *dx_sb = &dx[idxs[k++]];
+    for (int j = 0; j < 9; j++) {
+      solver->speed_biases[i].data[j] += dx_sb[j];
+    }
+  }
+  for (int i = 0; i < solver->nb_extrinsics; i++) {
+    solver_update_pose(solver->extrinsics[i].data, &dx[idxs[k++]]);
+  }
+  for (int i = 0; i < solver->nb_cams; i++) {
+    const real_t *dx_cam = &dx[idxs[k++]];
+    for (int j = 0; j < 8; j++) {
+      solver->cams[i].data[j] += dx_cam[j];
+    }
+  }
+  for (int i = 0; i < solver->nb_features; i++) {
+    const real_t *dx_feature = &dx[idxs[k++]];
+    solver->features[i].data[0] += dx_feature[0];
+    solver->features[i].data[1] += dx_feature[1];
+    solver->features[i].data[2] += dx_feature[2];
   }
 }
 
-int solver_eval(solver_t *solver) {
+/**
+ * Backup of the solver estimates, used to restore the state after a
+ * rejected Levenberg-Marquardt step.
+ */
+typedef struct solver_state_t {
+  pose_t *poses;
+  speed_biases_t *speed_biases;
+  extrinsics_t *extrinsics;
+  camera_params_t *cams;
+  feature_t *features;
+} solver_state_t;
+
+static void solver_state_save(const solver_t *solver, solver_state_t *state) {
+  memcpy(state->poses, solver->poses, sizeof(pose_t) * solver->nb_poses);
+  memcpy(state->speed_biases,
+         solver->speed_biases,
+         sizeof(speed_biases_t) * solver->nb_speed_biases);
+  memcpy(state->extrinsics,
+         solver->extrinsics,
+         sizeof(extrinsics_t) * solver->nb_extrinsics);
+  memcpy(state->cams, solver->cams, sizeof(camera_params_t) * solver->nb_cams);
+  memcpy(state->features,
+         solver->features,
+         sizeof(feature_t) * solver->nb_features);
+}
+
+static void solver_state_restore(solver_t *solver,
+                                 const solver_state_t *state) {
+  memcpy(solver->poses, state->poses, sizeof(pose_t) * solver->nb_poses);
+  memcpy(solver->speed_biases,
+         state->speed_biases,
+         sizeof(speed_biases_t) * solver->nb_speed_biases);
+  memcpy(solver->extrinsics,
+         state->extrinsics,
+         sizeof(extrinsics_t) * solver->nb_extrinsics);
+  memcpy(solver->cams, state->cams, sizeof(camera_params_t) * solver->nb_cams);
+  memcpy(solver->features,
+         state->features,
+         sizeof(feature_t) * solver->nb_features);
+}
+
+/**
+ * Optimize the solver's estimates with Levenberg-Marquardt, where each step
+ * is solved with the landmarks eliminated via the Schur complement, or with
+ * a sparse Cholesky factorization of the full Hessian if `linear_solver` is
+ * `SOLVER_SPARSE_CHOL`.
+ *
+ * @returns
+ * - 0 for success
+ * - -1 if no step was accepted, e.g. the linear solve kept failing
+ */
+int solver_optimize(solver_t *solver) {
   assert(solver != NULL);
+  struct timespec solve_tic = tic();
+  real_t lambda_k = solver->lambda;
 
-  int pose_idx = 0;
-  int lmks_idx = solver->nb_poses * 6;
-  int exts_idx = lmks_idx + solver->nb_features * 3;
-  int cams_idx = exts_idx + solver->nb_extrinsics * 6;
+  /* Setup */
+  arena_t *arena = &solver->arena;
+  const arena_mark_t mark = arena_mark(arena);
+  solver_state_t state;
+  state.poses = arena_alloc(arena, sizeof(pose_t) * solver->nb_poses);
+  state.speed_biases =
+      arena_alloc(arena, sizeof(speed_biases_t) * solver->nb_speed_biases);
+  state.extrinsics =
+      arena_alloc(arena, sizeof(extrinsics_t) * solver->nb_extrinsics);
+  state.cams = arena_alloc(arena, sizeof(camera_params_t) * solver->nb_cams);
+  state.features = arena_alloc(arena, sizeof(feature_t) * solver->nb_features);
+
+  /* Linearize at the initial estimate, cost k from its residuals */
+  solver_eval(solver);
+  real_t cost = solver_residuals_cost(solver);
+  real_t *dx = arena_alloc(arena, sizeof(real_t) * solver->x_size);
+  int nb_accepted = 0;
+  int converged = 0;
+  int rejected = 0;
+
+  for (int iter = 0; iter < solver->max_iter; iter++) {
+    /* Solve for dx */
+    zeros(dx, solver->x_size, 1);
+    const int status = (solver->linear_solver == SOLVER_SPARSE_CHOL)
+                           ? solver_sparse_solve(solver, lambda_k, dx)
+                           : solver_schur_solve(solver, lambda_k, dx);
+
+    real_t cost_delta = 0.0;
+    if (status == 0) {
+      /* Cost k+1, residuals only */
+      solver_state_save(solver, &state);
+      solver_update(solver, dx);
+      const real_t cost_k = solver_cost(solver);
+      cost_delta = cost_k - cost;
+
+      if (solver->verbose) {
+        const real_t solve_time = toc(&solve_tic);
+        printf("iter[%d] ", iter);
+        printf("cost[%.2e] ", cost);
+        printf("cost_k[%.2e] ", cost_k);
+        printf("cost_delta[%.2e] ", cost_delta);
+        printf("lambda[%.2e] ", lambda_k);
+        printf("iter_time[%.4f] ", solve_time / (iter + 1));
+        printf("solve_time[%.4f]  ", solve_time);
+        printf("\n");
+      }
 
-  /* Evaluate camera factors */
-  for (int i = 0; i < solver->nb_cam_factors; i++) {
-    cam_factor_t *factor = &solver->cam_factors[i];
-    cam_factor_eval(factor);
+      /* Determine whether to accept update */
+      if (cost_k < cost) {
+        /* Accept update, relinearize for the next iteration */
+        lambda_k /= solver->update_factor;
+        cost = cost_k;
+        solver_eval(solver);
+        nb_accepted++;
+        rejected = 0;
+      } else {
+        /* Reject update */
+        solver_state_restore(solver, &state);
+        lambda_k *= solver->update_factor;
+        rejected = 1;
+      }
+    } else {
+      /* System not positive definite, increase damping */
+      lambda_k *= solver->update_factor;
+    }
 
-    int *param_orders[4] = {&pose_idx, &exts_idx, &cams_idx, &lmks_idx};
-    int param_sizes[4] = {6, 6, 8, 3};
-    int nb_params = 4;
+    /* Termination criterias */
+    const real_t solve_time = toc(&solve_tic);
+    const real_t iter_time = solve_time / (iter + 1);
+    if (status == 0 && fabs(cost_delta) < solver->cost_change_threshold) {
+      converged = 1;
+      break;
+    } else if ((solve_time + iter_time) > solver->time_limit) {
+      break;
+    }
+  }
 
-    solver_evaluator(solver,
-                     param_orders,
-                     param_sizes,
-                     nb_params,
-                     factor->r,
-                     factor->r_size,
-                     factor->jacs);
+  /* Residuals are from the rejected step, evaluate at the restored state */
+  if (rejected) {
+    solver_cost(solver);
   }
 
-  return 0;
-}
+  if (solver->verbose) {
+    printf("cost: %.2e\t", cost);
+    printf("solver took: %.4fs\n", toc(&solve_tic));
+  }
+
+  /* Clean up */
+  arena_rewind(arena, mark);
 
-/* int solver_optimize(solver_t *solver) { */
-/*   struct timespec solve_tic = tic(); */
-/*   real_t lambda_k = 1e-4; */
-/*  */
-/*   int iter = 0; */
-/*   int max_iter = 10; */
-/*   int verbose = 1; */
-/*  */
-/*   for (iter = 0; iter < max_iter; iter++) { */
-/*     #<{(| Cost k |)}># */
-/*     #<{(| x = solver_get_state(solver); |)}># */
-/*     #<{(| solver_eval(solver, H, g, &marg_size, &remain_size); |)}># */
-/*     #<{(| const matx_t H_diag = (H.diagonal().asDiagonal()); |)}># */
-/*     #<{(| H = H + lambda_k * H_diag; |)}># */
-/*     #<{(| dx = H.ldlt().solve(g); |)}># */
-/*     #<{(| e = solver_residuals(solver); |)}># */
-/*     #<{(| cost = 0.5 * e.transpose() * e; |)}># */
-/*  */
-/*     #<{(| Cost k+1 |)}># */
-/*     #<{(| solver_update(solver, dx); |)}># */
-/*     #<{(| e = solver_residuals(solver); |)}># */
-/*     const real_t cost_k = 0.5 * e.transpose() * e; */
-/*  */
-/*     const real_t cost_delta = cost_k - cost; */
-/*     const real_t solve_time = toc(&solve_tic); */
-/*     const real_t iter_time = (iter == 0) ? 0 : (solve_time / iter); */
-/*  */
-/*     if (verbose) { */
-/*       printf("iter[%d] ", iter); */
-/*       printf("cost[%.2e] ", cost); */
-/*       printf("cost_k[%.2e] ", cost_k); */
-/*       printf("cost_delta[%.2e] ", cost_delta); */
-/*       printf("lambda[%.2e] ", lambda_k); */
-/*       printf("iter_time[%.4f] ", iter_time); */
-/*       printf("solve_time[%.4f]  ", solve_time); */
-/*       printf("\n"); */
-/*  */
-/*       // // Calculate reprojection error */
-/*       // size_t nb_keypoints = e.size() / 2.0; */
-/*       // real_t sse = 0.0; */
-/*       // for (size_t i = 0; i < nb_keypoints; i++) { */
-/*       //   sse += pow(e.segment(i * 2, 2).norm(), 2); */
-/*       // } */
-/*       // const real_t rmse = sqrt(sse / nb_keypoints); */
-/*       // printf("rmse reproj error: %.2f\n", rmse); */
-/*     } */
-/*  */
-/*     #<{(| Determine whether to accept update |)}># */
-/*     if (cost_k < cost) { */
-/*       #<{(| Accept update |)}># */
-/*       lambda_k /= update_factor; */
-/*       cost = cost_k; */
-/*     } else { */
-/*       #<{(| Reject update |)}># */
-/*       #<{(| solver_set_state(solver, x); // Restore state |)}># */
-/*       lambda_k *= update_factor; */
-/*     } */
-/*  */
-/*     #<{(| Termination criterias |)}># */
-/*     if (fabs(cost_delta) < cost_change_threshold) { */
-/*       break; */
-/*     } else if ((solve_time + iter_time) > time_limit) { */
-/*       break; */
-/*     } */
-/*   } */
-/*  */
-/*   #<{(| solve_time = toc(&solve_tic); |)}># */
-/*   #<{(| if (verbose) { |)}># */
-/*   #<{(|   printf("cost: %.2e\t", cost); |)}># */
-/*   #<{(|   printf("solver took: %.4fs\n", solve_time); |)}># */
-/*   #<{(| } |)}># */
-/* } */
+  return (nb_accepted > 0 || converged) ? 0 : -1;
+}
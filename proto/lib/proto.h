@@ -11,11 +11,16 @@
 #include <stdint.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include <time.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <assert.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include <errno.h>
 #include <netdb.h>
@@ -176,15 +181,64 @@ real_t **load_darrays(const char *csv_path, int *nb_arrays);
 int dsv_rows(const char *fp);
 int dsv_cols(const char *fp, const char delim);
 char **dsv_fields(const char *fp, const char delim, int *nb_fields);
-real_t **dsv_data(const char *fp, const char delim, int *nb_rows, int *nb_cols);
-void dsv_free(real_t **data, const int nb_rows);
+real_t *dsv_data(const char *fp,
+                 const char delim,
+                 int *nb_rows,
+                 int *nb_cols);
+void dsv_free(real_t *data);
 
-real_t **csv_data(const char *fp, int *nb_rows, int *nb_cols);
-void csv_free(real_t **data, const int nb_rows);
+real_t *csv_data(const char *fp, int *nb_rows, int *nb_cols);
+void csv_free(real_t *data);
 
 /* real_t *load_matrix(const char *file_path); */
 /* real_t *load_vector(const char *file_path); */
 
+/******************************************************************************
+ * ARENA
+ ******************************************************************************/
+
+#define ARENA_ALIGNMENT 32
+
+/**
+ * Arena memory block, the first `used` of the `size` bytes of `data` are
+ * allocated.
+ */
+typedef struct arena_block_t {
+  struct arena_block_t *next;
+  size_t size;
+  size_t used;
+  char *data;
+} arena_block_t;
+
+/**
+ * Arena allocator. Memory is bump allocated from a list of blocks and is
+ * only ever released all at once. `arena_reset()` keeps the blocks for
+ * reuse, so a workload that repeats stops calling malloc once warmed up.
+ */
+typedef struct arena_t {
+  arena_block_t *head;
+  arena_block_t *curr;
+  size_t block_size;
+} arena_t;
+
+/** Arena position, see `arena_mark()` and `arena_rewind()`. */
+typedef struct arena_mark_t {
+  arena_block_t *block;
+  size_t used;
+} arena_mark_t;
+
+void arena_setup(arena_t *arena, const size_t block_size);
+void arena_free(arena_t *arena);
+void arena_reset(arena_t *arena);
+void *arena_alloc(arena_t *arena, const size_t size);
+void *arena_calloc(arena_t *arena, const size_t nmemb, const size_t size);
+void *arena_grow(arena_t *arena,
+                 void *ptr,
+                 const size_t old_size,
+                 const size_t new_size);
+arena_mark_t arena_mark(const arena_t *arena);
+void arena_rewind(arena_t *arena, const arena_mark_t mark);
+
 /******************************************************************************
  * TIME
  ******************************************************************************/
@@ -196,6 +250,7 @@ struct timespec tic();
 float toc(struct timespec *tic);
 float mtoc(struct timespec *tic);
 timestamp_t time_now();
+real_t ts2sec(const timestamp_t ts);
 
 /******************************************************************************
  * NETWORK
@@ -332,6 +387,22 @@ void vec_scale(real_t *x, const size_t n, const real_t scale);
 real_t vec_norm(const real_t *x, const size_t n);
 void vec_normalize(real_t *x, const size_t n);
 
+#define DOT_AUTO 0
+#define DOT_NAIVE 1
+#define DOT_BUILTIN 2
+#define DOT_CBLAS 3
+
+/* Tiny-matrix fast path and GEMM blocking parameters */
+#define DOT_TINY_MAX 6
+#define DOT_MR 6
+#define DOT_NR 8
+#define DOT_MC 96
+#define DOT_KC 256
+#define DOT_NC 2048
+#define DOT_GEMM_MIN_FLOPS (12 * 12 * 12)
+
+int dot_set_backend(const int backend);
+int dot_get_backend();
 void dot(const real_t *A,
          const size_t A_m,
          const size_t A_n,
@@ -339,6 +410,39 @@ void dot(const real_t *A,
          const size_t B_m,
          const size_t B_n,
          real_t *C);
+
+/**
+ * Define fixed-size matrix multiply `dot_MxK_KxN(A, B, C)`, which sets `C`
+ * to `A * B` where `A` is `M x K` and `B` is `K x N`. Unlike `dot()` the
+ * result overwrites `C`, and the compile-time sizes let the compiler fully
+ * unroll the product and keep it in registers.
+ */
+#define DOT_FIXED(M, K, N)                                                     \
+  static inline void dot_##M##x##K##_##K##x##N(const real_t *restrict A,       \
+                                               const real_t *restrict B,       \
+                                               real_t *restrict C) {           \
+    for (int i = 0; i < M; i++) {                                              \
+      for (int j = 0; j < N; j++) {                                            \
+        real_t sum = 0.0;                                                      \
+        for (int k = 0; k < K; k++) {                                          \
+          sum += A[i * K + k] * B[k * N + j];                                  \
+        }                                                                      \
+        C[i * N + j] = sum;                                                    \
+      }                                                                        \
+    }                                                                          \
+  }
+
+DOT_FIXED(2, 2, 1)
+DOT_FIXED(2, 2, 3)
+DOT_FIXED(2, 2, 4)
+DOT_FIXED(2, 2, 8)
+DOT_FIXED(2, 3, 3)
+DOT_FIXED(2, 3, 6)
+DOT_FIXED(3, 3, 1)
+DOT_FIXED(3, 3, 3)
+DOT_FIXED(4, 4, 1)
+DOT_FIXED(4, 4, 4)
+
 void skew(const real_t x[3], real_t A[3 * 3]);
 void fwdsubs(const real_t *L, const real_t *b, real_t *y, const size_t n);
 void bwdsubs(const real_t *U, const real_t *y, real_t *x, const size_t n);
@@ -370,7 +474,20 @@ int svd(real_t *A, const int m, const int n, real_t *w, real_t *V);
  * CHOL
  ******************************************************************************/
 
-void chol(const real_t *A, const size_t n, real_t *L);
+#define CHOL_NB 64
+
+size_t chol_work_size(const size_t n);
+int chol_factor(real_t *A, const size_t n, real_t *work);
+int ldlt_factor(real_t *A, const size_t n, real_t *work);
+void chol_factor_solve(const real_t *L,
+                       const size_t n,
+                       const real_t *b,
+                       real_t *x);
+void ldlt_factor_solve(const real_t *LD,
+                       const size_t n,
+                       const real_t *b,
+                       real_t *x);
+int chol(const real_t *A, const size_t n, real_t *L);
 void chol_solve(const real_t *A, const real_t *b, real_t *x, const size_t n);
 
 #ifdef USE_LAPACK
@@ -413,13 +530,44 @@ void quat_delta(const real_t dalpha[3], real_t dq[4]);
 
 /* IMAGE ---------------------------------------------------------------------*/
 
+/**
+ * Reference counted pixel buffer, returned to its `pool` once the last image
+ * referencing it is released. The pixels `data` follow the header in the
+ * same allocation.
+ */
+typedef struct image_buf_t {
+  uint8_t *data;
+  size_t size;
+  int ref_count;
+  struct image_pool_t *pool;
+  struct image_buf_t *next;
+} image_buf_t;
+
+/**
+ * Image. `data` points at the first pixel and rows are `stride` bytes apart,
+ * so an image can be a view into a larger image. If `buf` is set the pixels
+ * are shared and released with `image_release()`.
+ */
 typedef struct image_t {
   int width;
   int height;
   int channels;
+  int stride;
   uint8_t *data;
+  image_buf_t *buf;
 } image_t;
 
+/**
+ * Image buffer pool, released buffers are kept on a free list and handed out
+ * again so a steady stream of frames stops allocating once warmed up.
+ */
+typedef struct image_pool_t {
+  pthread_mutex_t lock;
+  image_buf_t *free_list;
+  int nb_bufs;
+  int nb_free;
+} image_pool_t;
+
 void image_setup(image_t *img,
                  const int width,
                  const int height,
@@ -428,6 +576,228 @@ image_t *image_load(const char *file_path);
 void image_print_properties(const image_t *img);
 void image_free(image_t *img);
 
+void image_pool_setup(image_pool_t *pool);
+void image_pool_free(image_pool_t *pool);
+int image_pool_alloc(image_pool_t *pool,
+                     const int width,
+                     const int height,
+                     const int channels,
+                     image_t *img);
+int image_pool_load(image_pool_t *pool, const char *file_path, image_t *img);
+void *image_stbi_malloc(const size_t size);
+void *image_stbi_realloc(void *ptr, const size_t size);
+void image_stbi_free(void *ptr);
+void image_retain(const image_t *img);
+void image_release(image_t *img);
+int image_view(const image_t *src,
+               const int x,
+               const int y,
+               const int width,
+               const int height,
+               image_t *view);
+
+/* Image prefetch slot states */
+#define PREFETCH_FREE 0
+#define PREFETCH_LOADING 1
+#define PREFETCH_READY 2
+#define PREFETCH_FAILED 3
+
+/* Image prefetch status returned by `image_prefetch_next()` */
+#define PREFETCH_OK 0
+#define PREFETCH_END 1
+#define PREFETCH_ERROR -1
+
+/**
+ * Image prefetcher, a pool of `nb_threads` worker threads loads and decodes
+ * up to `nb_ahead` images ahead of the consumer into a ring of `image_t`
+ * slots. Frame `k` is decoded into slot `k % nb_slots`. Frames are decoded
+ * into buffers from `pool`, which are recycled once the consumer releases
+ * them.
+ */
+typedef struct image_prefetch_t {
+  const char **paths;
+  int nb_paths;
+
+  image_pool_t pool;
+  image_t *slots;
+  int *slot_state;
+  int nb_slots;
+
+  int next_load;
+  int next_read;
+  int stop;
+
+  pthread_t *threads;
+  int nb_threads;
+  pthread_mutex_t lock;
+  pthread_cond_t loaded;
+  pthread_cond_t released;
+} image_prefetch_t;
+
+int image_prefetch_setup(image_prefetch_t *pf,
+                         const char **paths,
+                         const int nb_paths,
+                         const int nb_ahead,
+                         const int nb_threads);
+void image_prefetch_free(image_prefetch_t *pf);
+int image_prefetch_next(image_prefetch_t *pf, image_t *img);
+
+/* IMAGE PROCESSING ----------------------------------------------------------*/
+
+/**
+ * Single channel float image, rows are `stride` floats apart.
+ */
+typedef struct imagef_t {
+  int width;
+  int height;
+  int stride;
+  float *data;
+} imagef_t;
+
+#define IMAGE_PYRAMID_MAX_LEVELS 8
+
+/**
+ * Gaussian image pyramid, level 0 is a view of the source image and each
+ * following level is half the size of the previous one.
+ */
+typedef struct image_pyramid_t {
+  image_t levels[IMAGE_PYRAMID_MAX_LEVELS];
+  int nb_levels;
+} image_pyramid_t;
+
+int imagef_malloc(imagef_t *img, const int width, const int height);
+void imagef_free(imagef_t *img);
+void image_gray(const image_t *src, image_t *dst);
+void image_pyrdown(const image_t *src, image_t *dst);
+int image_pyramid_setup(image_pyramid_t *pyr,
+                        const image_t *img,
+                        const int nb_levels);
+void image_pyramid_free(image_pyramid_t *pyr);
+void image_scharr(const image_t *src, imagef_t *gx, imagef_t *gy);
+void image_sobel(const image_t *src, imagef_t *gx, imagef_t *gy);
+void image_box_filter(const image_t *src, const int radius, image_t *dst);
+void imagef_box_filter(const imagef_t *src, const int radius, imagef_t *dst);
+
+/* FAST ----------------------------------------------------------------------*/
+
+typedef struct keypoint_t {
+  real_t x;
+  real_t y;
+  real_t score;
+} keypoint_t;
+
+/**
+ * FAST grid detection worker, detects corners in grid cells `[start, end)`.
+ */
+typedef struct fast_worker_t {
+  pthread_t thread;
+  const image_t *img;
+  int threshold;
+  int grid_rows;
+  int grid_cols;
+  int max_per_cell;
+  int start;
+  int end;
+
+  keypoint_t *kps;
+  int *nb_kps;
+} fast_worker_t;
+
+int fast_detect(const image_t *img,
+                const int threshold,
+                const int max_corners,
+                keypoint_t *kps);
+int fast_grid_detect(const image_t *img,
+                     const int threshold,
+                     const int grid_rows,
+                     const int grid_cols,
+                     const int max_corners,
+                     const int nb_threads,
+                     keypoint_t *kps);
+
+/* KLT -----------------------------------------------------------------------*/
+
+/**
+ * Pyramidal inverse compositional KLT tracker settings.
+ */
+typedef struct klt_t {
+  int patch_size;
+  int max_level;
+  int max_iter;
+  real_t epsilon;
+  real_t min_eigen;
+  int nb_threads;
+} klt_t;
+
+/**
+ * Image pyramid and the Scharr gradients of every level, built once per frame
+ * and shared by all features tracked from or into the frame.
+ */
+typedef struct klt_pyramid_t {
+  image_pyramid_t pyr;
+  imagef_t gx[IMAGE_PYRAMID_MAX_LEVELS];
+  imagef_t gy[IMAGE_PYRAMID_MAX_LEVELS];
+} klt_pyramid_t;
+
+/**
+ * KLT worker, tracks features `[start, end)` with its own patch buffers.
+ */
+typedef struct klt_worker_t {
+  pthread_t thread;
+  const klt_t *klt;
+  const klt_pyramid_t *pyr0;
+  const klt_pyramid_t *pyr1;
+  int start;
+  int end;
+
+  const keypoint_t *kps0;
+  keypoint_t *kps1;
+  uint8_t *status;
+  real_t *err;
+} klt_worker_t;
+
+void klt_setup(klt_t *klt);
+int klt_pyramid_setup(klt_pyramid_t *pyr,
+                      const image_t *img,
+                      const int nb_levels);
+void klt_pyramid_free(klt_pyramid_t *pyr);
+int klt_track(const klt_t *klt,
+              const klt_pyramid_t *pyr0,
+              const klt_pyramid_t *pyr1,
+              const int nb_kps,
+              const keypoint_t *kps0,
+              keypoint_t *kps1,
+              uint8_t *status,
+              real_t *err);
+
+/* RANSAC --------------------------------------------------------------------*/
+
+/**
+ * RANSAC settings, `threshold` is the max Sampson distance of an inlier in
+ * pixels and `confidence` the probability of having drawn an outlier free
+ * sample when the iterations stop.
+ */
+typedef struct ransac_t {
+  real_t threshold;
+  real_t confidence;
+  int max_iter;
+  uint32_t seed;
+} ransac_t;
+
+void ransac_setup(ransac_t *ransac);
+int fundamental_8pt(const keypoint_t *kps0,
+                    const keypoint_t *kps1,
+                    const int *idx,
+                    const int n,
+                    real_t F[3 * 3]);
+int ransac_fundamental(const ransac_t *ransac,
+                       const keypoint_t *kps0,
+                       const keypoint_t *kps1,
+                       const real_t *quality,
+                       const int n,
+                       real_t F[3 * 3],
+                       uint8_t *inliers);
+
 
 /* RADTAN --------------------------------------------------------------------*/
 
@@ -454,7 +824,7 @@ void equi4_params_jacobian(const real_t params[4],
 real_t pinhole_focal(const int image_width, const real_t fov);
 void pinhole_project(const real_t params[4], const real_t p_C[3], real_t x[2]);
 
-void pinhole_point_jacobian(const real_t params[4], real_t J_point[2 * 3]);
+void pinhole_point_jacobian(const real_t params[4], real_t J_point[2 * 2]);
 void pinhole_params_jacobian(const real_t params[4],
                              const real_t x[2],
                              real_t J[2 * 4]);
@@ -623,11 +993,64 @@ void cam_factor_setup(cam_factor_t *factor,
                       camera_params_t *camera,
                       const real_t var[2]);
 void cam_factor_reset(cam_factor_t *factor);
+int cam_factor_residuals(cam_factor_t *factor);
 int cam_factor_eval(cam_factor_t *factor);
 
-/* IMU FACTOR --------------------------------------------------------------- */
+/* CAMERA FACTOR BATCH ------------------------------------------------------ */
+
+/**
+ * Batch of camera factors in structure-of-arrays form. Observation `i`
+ * references its parameters by index, and the k-th row-major element of its
+ * residual or Jacobian is stored at e.g. `J0[k][i]`.
+ */
+typedef struct cam_factor_batch_t {
+  int size;
+  int capacity;
+
+  /* Observations */
+  int *pose_idx;
+  int *extrinsics_idx;
+  int *camera_idx;
+  int *feature_idx;
+  real_t *z[2];
+  real_t *sqrt_info[2];
+
+  /* Residuals and Jacobians */
+  real_t *r[2];
+  real_t *J0[2 * 6]; /* Jacobian w.r.t sensor pose T_WS */
+  real_t *J1[2 * 6]; /* Jacobian w.r.t sensor-camera extrinsics T_SC */
+  real_t *J2[2 * 8]; /* Jacobian w.r.t camera parameters */
+  real_t *J3[2 * 3]; /* Jacobian w.r.t landmark */
+
+  /* Workspace */
+  real_t *p_C[3];
+  real_t *p_WS[3];
+  real_t *p_SC[3];
+  real_t *cam[8];
+  real_t *Jh[2 * 3];
+  real_t *data;
+  real_t *tfs;
+  int tfs_size;
+} cam_factor_batch_t;
+
+void cam_factor_batch_setup(cam_factor_batch_t *batch, const int capacity);
+void cam_factor_batch_free(cam_factor_batch_t *batch);
+void cam_factor_batch_add(cam_factor_batch_t *batch,
+                          const int pose_idx,
+                          const int extrinsics_idx,
+                          const int camera_idx,
+                          const int feature_idx,
+                          const real_t z[2],
+                          const real_t var[2]);
+void cam_factor_batch_eval(cam_factor_batch_t *batch,
+                           const pose_t *poses,
+                           const int nb_poses,
+                           const extrinsics_t *extrinsics,
+                           const int nb_extrinsics,
+                           const camera_params_t *cams,
+                           const feature_t *features);
 
-#define MAX_IMU_BUF_SIZE 10000
+/* IMU FACTOR --------------------------------------------------------------- */
 
 typedef struct imu_params_t {
   uint64_t param_id;
@@ -641,34 +1064,69 @@ typedef struct imu_params_t {
   real_t g;
 } imu_params_t;
 
+/**
+ * IMU ring buffer of `capacity` measurements, sized at setup to hold a
+ * sliding window. Every measurement added is given a monotonically
+ * increasing sample index `n` and stored in slot `n % capacity`, once full
+ * the oldest measurements are overwritten. The buffer holds samples
+ * `[count - size, count)`.
+ */
 typedef struct imu_buf_t {
-  timestamp_t ts[MAX_IMU_BUF_SIZE];
-  real_t acc[MAX_IMU_BUF_SIZE][3];
-  real_t gyr[MAX_IMU_BUF_SIZE][3];
+  timestamp_t *ts;
+  real_t (*acc)[3];
+  real_t (*gyr)[3];
+  int capacity;
   int size;
+  uint64_t count;
 } imu_buf_t;
 
+/**
+ * View of samples `[start, end)` in a shared IMU ring buffer, covering the
+ * time range `[ts_start, ts_end]`. The first and last samples bracket the
+ * time range where the buffer has them.
+ */
+typedef struct imu_view_t {
+  const imu_buf_t *buf;
+  uint64_t start;
+  uint64_t end;
+  timestamp_t ts_start;
+  timestamp_t ts_end;
+} imu_view_t;
+
 typedef struct imu_factor_t {
   imu_params_t *imu_params;
-  imu_buf_t imu_buf;
+  imu_view_t imu_view;
   pose_t *pose_i;
   pose_t *pose_j;
   speed_biases_t *sb_i;
   speed_biases_t *sb_j;
 
+  /* Preintegrated relative motion about biases `ba` and `bg` */
+  real_t Dt;
+  real_t ba[3];
+  real_t bg[3];
+  real_t dp[3];
+  real_t dv[3];
+  real_t dq[4];
+  real_t F[15 * 15]; /* State transition matrix */
+
   real_t covar[15 * 15];
+  real_t sqrt_info[15 * 15];
   real_t r[15];
   int r_size;
 
-  real_t J0[2 * 6];
-  real_t J1[2 * 9];
-  real_t J2[2 * 6];
-  real_t J3[2 * 9];
+  real_t J0[15 * 6]; /* Jacobian w.r.t sensor pose at i */
+  real_t J1[15 * 9]; /* Jacobian w.r.t speed and biases at i */
+  real_t J2[15 * 6]; /* Jacobian w.r.t sensor pose at j */
+  real_t J3[15 * 9]; /* Jacobian w.r.t speed and biases at j */
   real_t *jacs[4];
   int nb_params;
 } imu_factor_t;
 
-void imu_buf_setup(imu_buf_t *imu_buf);
+void imu_buf_setup(imu_buf_t *imu_buf,
+                   const real_t imu_rate,
+                   const real_t window_length);
+void imu_buf_free(imu_buf_t *imu_buf);
 void imu_buf_add(imu_buf_t *imu_buf,
                  timestamp_t ts,
                  real_t acc[3],
@@ -676,58 +1134,241 @@ void imu_buf_add(imu_buf_t *imu_buf,
 void imu_buf_clear(imu_buf_t *imu_buf);
 void imu_buf_copy(const imu_buf_t *from, imu_buf_t *to);
 void imu_buf_print(const imu_buf_t *imu_buf);
-
-void imu_factor_setup(imu_factor_t *factor,
-                      imu_params_t *imu_params,
-                      imu_buf_t *imu_buf,
-                      pose_t *pose_i,
-                      speed_biases_t *sb_i,
-                      pose_t *pose_j,
-                      speed_biases_t *sb_j);
+int imu_buf_view(const imu_buf_t *imu_buf,
+                 const timestamp_t ts_start,
+                 const timestamp_t ts_end,
+                 imu_view_t *view);
+
+int imu_view_size(const imu_view_t *view);
+int imu_view_valid(const imu_view_t *view);
+timestamp_t imu_view_ts(const imu_view_t *view, const int k);
+const real_t *imu_view_acc(const imu_view_t *view, const int k);
+const real_t *imu_view_gyr(const imu_view_t *view, const int k);
+
+int imu_factor_setup(imu_factor_t *factor,
+                     imu_params_t *imu_params,
+                     const imu_buf_t *imu_buf,
+                     pose_t *pose_i,
+                     speed_biases_t *sb_i,
+                     pose_t *pose_j,
+                     speed_biases_t *sb_j);
 void imu_factor_reset(imu_factor_t *factor);
+int imu_factor_propagate(imu_factor_t *factor);
 int imu_factor_eval(imu_factor_t *factor);
 
 /* SLIDING WINDOW ESTIMATOR ------------------------------------------------- */
 
-#define MAX_POSES 1000
-#define MAX_CAMS 4
-#define MAX_FEATURES 1000
-#define MAX_PARAMS MAX_POSES + MAX_CAMS + MAX_CAMS + MAX_FEATURES
-#define MAX_H_SIZE \
-  MAX_POSES * 6 \
-  + MAX_CAMS * 8 \
-  + MAX_CAMS * 6 \
-  + MAX_FEATURES * 3
+#define SOLVER_ARENA_BLOCK_SIZE (1024 * 1024)
+#define SOLVER_MIN_CAPACITY 8
 
+/**
+ * Block-sparse Hessian.
+ *
+ * Only the upper-triangular blocks `H_ij` (i <= j) touched by a factor are
+ * stored. Blocks are keyed by their parameter block index pair `(i, j)` in an
+ * open-addressing hash table and the block values live in one contiguous
+ * `data` pool, so memory grows with the number of factors rather than with
+ * the square of the state size.
+ */
+typedef struct block_hessian_t {
+  int nb_params;
+  int *param_sizes;
+  int *param_idxs;
+  int x_size;
+
+  uint64_t *keys;
+  size_t *offsets;
+  size_t capacity;
+  size_t nb_blocks;
+
+  real_t *data;
+  size_t data_size;
+  size_t data_capacity;
+} block_hessian_t;
+
+void block_hessian_setup(block_hessian_t *H,
+                         const int *param_sizes,
+                         const int nb_params);
+void block_hessian_free(block_hessian_t *H);
+void block_hessian_zero(block_hessian_t *H);
+real_t *block_hessian_get(const block_hessian_t *H, const int i, const int j);
+real_t *block_hessian_insert(block_hessian_t *H, const int i, const int j);
+void block_hessian_accumulate(block_hessian_t *H,
+                              const int i,
+                              const int j,
+                              const real_t *J_i,
+                              const real_t *J_j,
+                              const int r_size);
+void block_hessian_merge(block_hessian_t *H, const block_hessian_t *H_src);
+void block_hessian_dense(const block_hessian_t *H, real_t *H_dense);
+
+/**
+ * Supernodal sparse Cholesky factorization of a block-sparse Hessian.
+ *
+ * Parameter blocks are eliminated in a given order, and consecutive blocks
+ * whose columns in L share the same sparsity pattern are merged into
+ * supernodes. Supernode `s` covers the permuted columns `[sn_cols[s],
+ * sn_cols[s + 1])` of L and stores its rows `sn_rows[sn_row_ptrs[s]]` to
+ * `sn_rows[sn_row_ptrs[s + 1] - 1]` as a dense row-major panel at
+ * `data[sn_offsets[s]]`, so the numeric factorization runs on dense kernels.
+ */
+typedef struct block_chol_t {
+  int n;
+  int nb_params;
+  int *param_pos;
+  int *perm;
+
+  int nb_supernodes;
+  int *sn_cols;
+  int *sn_row_ptrs;
+  int *sn_rows;
+  size_t *sn_offsets;
+  int *col_sn;
+
+  real_t *data;
+  size_t data_size;
+  real_t *work;
+  int *map;
+} block_chol_t;
+
+int block_chol_setup(block_chol_t *chol,
+                     const block_hessian_t *H,
+                     const int *order);
+void block_chol_free(block_chol_t *chol);
+int block_chol_factor(block_chol_t *chol,
+                      const block_hessian_t *H,
+                      const real_t lambda);
+void block_chol_solve(const block_chol_t *chol, const real_t *b, real_t *x);
+
+/**
+ * Solver worker, a persistent thread that evaluates the factors in
+ * `[start, end)` into thread-local H and g which are then reduced into the
+ * solver's H and g. The thread-local H and g are kept across evaluations.
+ */
+typedef struct solver_worker_t {
+  struct solver_t *solver;
+  pthread_t thread;
+  int start;
+  int end;
+
+  cam_factor_batch_t cam_batch;
+  block_hessian_t H;
+  real_t *g;
+  int r_size;
+} solver_worker_t;
+
+/* Linear solvers */
+#define SOLVER_SCHUR 0
+#define SOLVER_SPARSE_CHOL 1
+
+/* Parameter and factor counts that key the reuse of the Hessian pattern */
+#define SOLVER_LAYOUT_SIZE 7
+
+/**
+ * Sliding window solver. Parameters and factors are stored in contiguous
+ * arrays allocated from a per-solve `arena` and grow on demand, so there is
+ * no cap on the problem size. Call `solver_reset()` between sliding-window
+ * iterations to reuse the arena memory without freeing it.
+ */
 typedef struct solver_t {
-  cam_factor_t cam_factors[MAX_FEATURES];
+  arena_t arena;
+
+  cam_factor_t *cam_factors;
   int nb_cam_factors;
+  int max_cam_factors;
+  cam_factor_batch_t cam_batch;
 
-  imu_factor_t imu_factors[MAX_POSES];
+  imu_buf_t *imu_buf;
+  imu_factor_t *imu_factors;
   int nb_imu_factors;
+  int max_imu_factors;
 
-  pose_t poses[MAX_POSES];
+  pose_t *poses;
   int nb_poses;
+  int max_poses;
 
-  camera_params_t cams[MAX_CAMS];
+  speed_biases_t *speed_biases;
+  int nb_speed_biases;
+  int max_speed_biases;
+
+  camera_params_t *cams;
   int nb_cams;
+  int max_cams;
 
-  extrinsics_t extrinsics[MAX_CAMS];
+  extrinsics_t *extrinsics;
   int nb_extrinsics;
+  int max_extrinsics;
 
-  feature_t features[MAX_FEATURES];
+  feature_t *features;
   int nb_features;
-
-  real_t H[MAX_H_SIZE];
-  real_t g[MAX_H_SIZE];
-  real_t x[MAX_H_SIZE];
+  int max_features;
+
+  block_hessian_t H;
+  int H_layout[SOLVER_LAYOUT_SIZE];
+  block_chol_t chol;
+  int chol_valid;
+  size_t chol_nb_blocks;
+  real_t *g;
+  real_t *x;
   int x_size;
   int r_size;
+
+  int nb_threads;
+  int deterministic;
+  solver_worker_t *workers;
+  int nb_workers;
+  pthread_mutex_t pool_lock;
+  pthread_cond_t pool_start;
+  pthread_cond_t pool_done;
+  int pool_gen;
+  int pool_pending;
+  int pool_stop;
+
+  int max_iter;
+  real_t lambda;
+  real_t update_factor;
+  real_t cost_change_threshold;
+  real_t time_limit;
+  int verbose;
+  int linear_solver;
 } solver_t;
 
 void solver_setup(solver_t *solver);
+void solver_setup_imu(solver_t *solver,
+                      const real_t imu_rate,
+                      const real_t window_length);
+void solver_reset(solver_t *solver);
+void solver_free(solver_t *solver);
 void solver_print(solver_t *solver);
+pose_t *solver_add_pose(solver_t *solver,
+                        const timestamp_t ts,
+                        const real_t data[7]);
+speed_biases_t *solver_add_speed_biases(solver_t *solver,
+                                        const timestamp_t ts,
+                                        const real_t data[9]);
+extrinsics_t *solver_add_extrinsics(solver_t *solver, const real_t data[7]);
+camera_params_t *solver_add_camera(solver_t *solver,
+                                   const int cam_idx,
+                                   const int cam_res[2],
+                                   const char *proj_model,
+                                   const char *dist_model,
+                                   const real_t data[8]);
+feature_t *solver_add_feature(solver_t *solver, const real_t data[3]);
+cam_factor_t *solver_add_cam_factor(solver_t *solver,
+                                    pose_t *pose,
+                                    extrinsics_t *extrinsics,
+                                    feature_t *feature,
+                                    camera_params_t *camera,
+                                    const real_t var[2]);
+imu_factor_t *solver_add_imu_factor(solver_t *solver,
+                                    imu_params_t *imu_params,
+                                    pose_t *pose_i,
+                                    speed_biases_t *sb_i,
+                                    pose_t *pose_j,
+                                    speed_biases_t *sb_j);
 int solver_eval(solver_t *solver);
-void solver_optimize(solver_t *solver);
+int solver_schur_solve(solver_t *solver, const real_t lambda, real_t *dx);
+int solver_sparse_solve(solver_t *solver, const real_t lambda, real_t *dx);
+int solver_optimize(solver_t *solver);
 
 #endif // _PROTO_H_
@@ -1,2 +1,9 @@
+#include "proto.h"
+
+/* Route stb_image allocations through the image pool, see image_pool_load() */
+#define STBI_MALLOC(sz) image_stbi_malloc(sz)
+#define STBI_REALLOC(p, newsz) image_stbi_realloc(p, newsz)
+#define STBI_FREE(p) image_stbi_free(p)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
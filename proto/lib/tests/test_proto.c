@@ -129,16 +129,66 @@ int test_dsv_fields() {
 int test_dsv_data() {
   int nb_rows = 0;
   int nb_cols = 0;
-  real_t **data = dsv_data(TEST_CSV, ',', &nb_rows, &nb_cols);
+  real_t *data = dsv_data(TEST_CSV, ',', &nb_rows, &nb_cols);
 
   int index = 0;
   for (int i = 0; i < nb_rows; i++) {
-    for (int j = 0; j < nb_rows; j++) {
-      MU_CHECK(fltcmp(data[i][j], index + 1) == 0);
+    for (int j = 0; j < nb_cols; j++) {
+      MU_CHECK(fltcmp(data[i * nb_cols + j], index + 1) == 0);
       index++;
     }
   }
-  dsv_free(data, nb_rows);
+  dsv_free(data);
+
+  return 0;
+}
+
+int test_dsv_data_format() {
+  /* Comments, spaces, blank lines, CRLF, exponents, special values and no
+   * final newline */
+  const char *fp = "/tmp/test_dsv_data_format.csv";
+  FILE *csv = fopen(fp, "w");
+  fprintf(csv, "# a, b, c\n");
+  fprintf(csv, "1403636579758555392, -0.25, 1.5e-3\r\n");
+  fprintf(csv, "\n");
+  fprintf(csv, "  \t \n");
+  fprintf(csv, " +7 ,  .5e2,nan\n");
+  fprintf(csv, "0.000000001234,-1E+2,12345678901234567890123");
+  fclose(csv);
+
+  int nb_rows = 0;
+  int nb_cols = 0;
+  real_t *data = dsv_data(fp, ',', &nb_rows, &nb_cols);
+  MU_CHECK(data != NULL);
+  MU_CHECK(nb_rows == 3);
+  MU_CHECK(nb_cols == 3);
+  MU_CHECK(fltcmp(data[0], 1403636579758555392.0) == 0);
+  MU_CHECK(fltcmp(data[1], -0.25) == 0);
+  MU_CHECK(fltcmp(data[2], 1.5e-3) == 0);
+  MU_CHECK(fltcmp(data[3], 7.0) == 0);
+  MU_CHECK(fltcmp(data[4], 50.0) == 0);
+  MU_CHECK(isnan(data[5]));
+  MU_CHECK(fltcmp(data[6], 1.234e-9) == 0);
+  MU_CHECK(fltcmp(data[7], -100.0) == 0);
+  MU_CHECK(fltcmp(data[8], 1.2345678901234567e22) == 0);
+  dsv_free(data);
+
+  /* Inconsistent number of columns */
+  csv = fopen(fp, "w");
+  fprintf(csv, "1,2,3\n4,5\n");
+  fclose(csv);
+  MU_CHECK(dsv_data(fp, ',', &nb_rows, &nb_cols) == NULL);
+
+  /* Empty and whitespace only fields */
+  csv = fopen(fp, "w");
+  fprintf(csv, "1,2,3\n4, ,6\n");
+  fclose(csv);
+  MU_CHECK(dsv_data(fp, ',', &nb_rows, &nb_cols) == NULL);
+
+  csv = fopen(fp, "w");
+  fprintf(csv, "1,,3\n");
+  fclose(csv);
+  MU_CHECK(dsv_data(fp, ',', &nb_rows, &nb_cols) == NULL);
 
   return 0;
 }
@@ -146,8 +196,8 @@ int test_dsv_data() {
 int test_dsv_free() {
   int nb_rows = 0;
   int nb_cols = 0;
-  real_t **data = dsv_data(TEST_CSV, ',', &nb_rows, &nb_cols);
-  dsv_free(data, nb_rows);
+  real_t *data = dsv_data(TEST_CSV, ',', &nb_rows, &nb_cols);
+  dsv_free(data);
 
   return 0;
 }
@@ -155,9 +205,72 @@ int test_dsv_free() {
 int test_csv_data() {
   int nb_rows = 0;
   int nb_cols = 0;
-  real_t **data = csv_data(TEST_CSV, &nb_rows, &nb_cols);
-  csv_free(data, nb_rows);
+  real_t *data = csv_data(TEST_CSV, &nb_rows, &nb_cols);
+  csv_free(data);
+
+  return 0;
+}
+
+/******************************************************************************
+ * ARENA
+ ******************************************************************************/
+
+int test_arena_alloc() {
+  arena_t arena;
+  arena_setup(&arena, 1024);
+
+  /* Allocations are aligned and bump allocated from one block */
+  char *a = arena_alloc(&arena, 10);
+  char *b = arena_alloc(&arena, 100);
+  MU_CHECK(((uintptr_t) a % ARENA_ALIGNMENT) == 0);
+  MU_CHECK(((uintptr_t) b % ARENA_ALIGNMENT) == 0);
+  MU_CHECK(b == a + ARENA_ALIGNMENT);
+  MU_CHECK(arena.head == arena.curr);
+
+  /* Allocations larger than a block get their own block */
+  char *c = arena_alloc(&arena, 4096);
+  MU_CHECK(c != NULL);
+  MU_CHECK(arena.curr != arena.head);
+  MU_CHECK(arena.curr->size == 4096);
+  memset(c, 1, 4096);
+
+  /* Rewind releases the allocations made after the mark */
+  arena_mark_t mark = arena_mark(&arena);
+  char *d = arena_alloc(&arena, 512);
+  arena_rewind(&arena, mark);
+  MU_CHECK(arena_alloc(&arena, 512) == d);
+
+  /* Reset reuses the blocks */
+  arena_reset(&arena);
+  MU_CHECK(arena_alloc(&arena, 10) == a);
+
+  arena_free(&arena);
+  MU_CHECK(arena.head == NULL);
+
+  return 0;
+}
+
+int test_arena_grow() {
+  arena_t arena;
+  arena_setup(&arena, 1024);
 
+  /* Last allocation grows in place */
+  int *data = arena_alloc(&arena, sizeof(int) * 4);
+  for (int i = 0; i < 4; i++) {
+    data[i] = i;
+  }
+  int *grown = arena_grow(&arena, data, sizeof(int) * 4, sizeof(int) * 64);
+  MU_CHECK(grown == data);
+
+  /* Otherwise the data is copied to a new allocation */
+  arena_alloc(&arena, 10);
+  grown = arena_grow(&arena, data, sizeof(int) * 64, sizeof(int) * 128);
+  MU_CHECK(grown != data);
+  for (int i = 0; i < 4; i++) {
+    MU_CHECK(grown[i] == i);
+  }
+
+  arena_free(&arena);
   return 0;
 }
 
@@ -585,6 +698,100 @@ int test_dot() {
   return 0;
 }
 
+int test_dot_backends() {
+  /* Tiny fast path sizes, odd sizes and sizes spanning several GEMM blocks */
+  const int sizes[][3] = {{2, 3, 3},
+                          {3, 3, 3},
+                          {3, 3, 1},
+                          {4, 4, 4},
+                          {6, 6, 6},
+                          {2, 3, 6},
+                          {37, 53, 29},
+                          {100, 300, 70},
+                          {130, 270, 150}};
+  const int nb_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  const int backends[4] = {DOT_AUTO, DOT_NAIVE, DOT_BUILTIN, DOT_CBLAS};
+
+  for (int s = 0; s < nb_sizes; s++) {
+    const int m = sizes[s][0];
+    const int k = sizes[s][1];
+    const int n = sizes[s][2];
+    real_t *A = mat_malloc(m, k);
+    real_t *B = mat_malloc(k, n);
+    real_t *C_exp = mat_malloc(m, n);
+    real_t *C = mat_malloc(m, n);
+    for (int i = 0; i < m * k; i++) {
+      A[i] = randf(-1.0, 1.0);
+    }
+    for (int i = 0; i < k * n; i++) {
+      B[i] = randf(-1.0, 1.0);
+    }
+
+    /* Expected C = 1 + A * B, dot() accumulates into C */
+    for (int i = 0; i < m; i++) {
+      for (int j = 0; j < n; j++) {
+        double sum = 1.0;
+        for (int p = 0; p < k; p++) {
+          sum += (double) A[i * k + p] * B[p * n + j];
+        }
+        C_exp[i * n + j] = sum;
+      }
+    }
+
+    for (int b = 0; b < 4; b++) {
+      if (dot_set_backend(backends[b]) != 0) {
+        continue;
+      }
+      ones(C, m, n);
+      dot(A, m, k, B, k, n, C);
+      MU_CHECK(mat_equals(C_exp, C, m, n, 1e-3) == 0);
+    }
+
+    free(A);
+    free(B);
+    free(C_exp);
+    free(C);
+  }
+  dot_set_backend(DOT_AUTO);
+
+  return 0;
+}
+
+int test_dot_fixed() {
+  real_t A[6 * 6] = {0};
+  real_t B[6 * 8] = {0};
+  for (int i = 0; i < 6 * 6; i++) {
+    A[i] = randf(-1.0, 1.0);
+  }
+  for (int i = 0; i < 6 * 8; i++) {
+    B[i] = randf(-1.0, 1.0);
+  }
+
+  /* Fixed-size kernels overwrite C, dot() accumulates into it */
+  real_t C_exp[4 * 8] = {0};
+  real_t C[4 * 8] = {0};
+#define CHECK_DOT_FIXED(M, K, N)                                               \
+  zeros(C_exp, M, N);                                                          \
+  ones(C, M, N);                                                               \
+  dot(A, M, K, B, K, N, C_exp);                                                \
+  dot_##M##x##K##_##K##x##N(A, B, C);                                          \
+  MU_CHECK(mat_equals(C_exp, C, M, N, 1e-6) == 0);
+
+  CHECK_DOT_FIXED(2, 2, 1);
+  CHECK_DOT_FIXED(2, 2, 3);
+  CHECK_DOT_FIXED(2, 2, 4);
+  CHECK_DOT_FIXED(2, 2, 8);
+  CHECK_DOT_FIXED(2, 3, 3);
+  CHECK_DOT_FIXED(2, 3, 6);
+  CHECK_DOT_FIXED(3, 3, 1);
+  CHECK_DOT_FIXED(3, 3, 3);
+  CHECK_DOT_FIXED(4, 4, 1);
+  CHECK_DOT_FIXED(4, 4, 4);
+#undef CHECK_DOT_FIXED
+
+  return 0;
+}
+
 int test_skew() {
   real_t x[3] = {1.0, 2.0, 3.0};
   real_t S[3 * 3] = {0};
@@ -701,7 +908,7 @@ int test_chol() {
 
   struct timespec t = tic();
   real_t L[9] = {0};
-  chol(A, n, L);
+  MU_CHECK(chol(A, n, L) == 0);
   printf("time taken: [%fs]\n", toc(&t));
 
   real_t Lt[9] = {0};
@@ -727,6 +934,26 @@ int test_chol() {
   return 0;
 }
 
+int test_chol_not_pd() {
+  /* clang-format off */
+  const int n = 3;
+  real_t A[9] = {
+    1.0, 2.0, 0.0,
+    2.0, 1.0, 0.0,
+    0.0, 0.0, 1.0
+  };
+  /* clang-format on */
+
+  /* Indefinite matrix fails and L is not left half factored */
+  real_t L[9] = {0};
+  MU_CHECK(chol(A, n, L) == -1);
+  for (int i = 0; i < n * n; i++) {
+    MU_CHECK(isnan(L[i]));
+  }
+
+  return 0;
+}
+
 int test_chol_solve() {
   /* clang-format off */
   const int n = 3;
@@ -751,6 +978,117 @@ int test_chol_solve() {
   return 0;
 }
 
+/**
+ * Form random `n x n` symmetric positive definite matrix `A = R * R' + n I`.
+ */
+static void test_spd_matrix(real_t *A, const int n) {
+  real_t *R = mat_malloc(n, n);
+  real_t *Rt = mat_malloc(n, n);
+  for (int i = 0; i < n * n; i++) {
+    R[i] = randf(-1.0, 1.0);
+  }
+  mat_transpose(R, n, n, Rt);
+  zeros(A, n, n);
+  dot(R, n, n, Rt, n, n, A);
+  for (int i = 0; i < n; i++) {
+    A[i * n + i] += n;
+  }
+  free(R);
+  free(Rt);
+}
+
+int test_chol_factor() {
+  const int n = 150;
+  real_t *A = mat_malloc(n, n);
+  real_t *L = mat_malloc(n, n);
+  real_t *Lt = mat_malloc(n, n);
+  real_t *LLt = mat_malloc(n, n);
+  real_t *work = vec_malloc(chol_work_size(n));
+  test_spd_matrix(A, n);
+
+  /* A = L * L' */
+  mat_copy(A, n, n, L);
+  MU_CHECK(chol_factor(L, n, work) == 0);
+  mat_transpose(L, n, n, Lt);
+  zeros(LLt, n, n);
+  dot(L, n, n, Lt, n, n, LLt);
+  MU_CHECK(mat_equals(A, LLt, n, n, 1e-2) == 0);
+  MU_CHECK(fltcmp(L[1], 0.0) == 0);
+
+  /* Solve A x = b */
+  real_t *x = vec_malloc(n);
+  real_t *b = vec_malloc(n);
+  real_t *Ax = vec_malloc(n);
+  for (int i = 0; i < n; i++) {
+    b[i] = randf(-1.0, 1.0);
+  }
+  chol_factor_solve(L, n, b, x);
+  zeros(Ax, n, 1);
+  dot(A, n, n, x, n, 1, Ax);
+  MU_CHECK(mat_equals(b, Ax, n, 1, 1e-3) == 0);
+
+  /* Not positive definite */
+  mat_copy(A, n, n, L);
+  L[100 * n + 100] = -1.0;
+  MU_CHECK(chol_factor(L, n, work) == -1);
+
+  free(A);
+  free(L);
+  free(Lt);
+  free(LLt);
+  free(work);
+  free(x);
+  free(b);
+  free(Ax);
+
+  return 0;
+}
+
+int test_ldlt_factor() {
+  const int n = 150;
+  real_t *A = mat_malloc(n, n);
+  real_t *LD = mat_malloc(n, n);
+  real_t *work = vec_malloc(chol_work_size(n));
+  test_spd_matrix(A, n);
+
+  /* A = L * D * L' */
+  mat_copy(A, n, n, LD);
+  MU_CHECK(ldlt_factor(LD, n, work) == 0);
+  for (int i = 0; i < n; i += 7) {
+    for (int j = 0; j <= i; j += 5) {
+      real_t a = 0.0;
+      for (int k = 0; k <= j; k++) {
+        const real_t L_ik = (i == k) ? 1.0 : LD[i * n + k];
+        const real_t L_jk = (j == k) ? 1.0 : LD[j * n + k];
+        a += L_ik * LD[k * n + k] * L_jk;
+      }
+      MU_CHECK(fabs(a - A[i * n + j]) < 1e-2);
+    }
+  }
+
+  /* Solve A x = b */
+  real_t *x = vec_malloc(n);
+  real_t *Ax = vec_malloc(n);
+  for (int i = 0; i < n; i++) {
+    x[i] = randf(-1.0, 1.0);
+  }
+  real_t *b = vec_malloc(n);
+  vec_copy(x, n, b);
+  ldlt_factor_solve(LD, n, x, x);
+  zeros(Ax, n, 1);
+  dot(A, n, n, x, n, 1, Ax);
+  MU_CHECK(mat_equals(b, Ax, n, 1, 1e-3) == 0);
+
+  free(A);
+  free(LD);
+  free(work);
+  free(x);
+  free(b);
+  free(Ax);
+
+  return 0;
+}
+
 #ifdef USE_LAPACK
 int test_chol_solve2() {
   /* #<{(| clang-format off |)}># */
@@ -1159,6 +1497,743 @@ int test_image_print_properties() { return 0; }
 
 int test_image_free() { return 0; }
 
+int test_image_pool() {
+  image_pool_t pool;
+  image_pool_setup(&pool);
+
+  /* Released buffers are reused */
+  image_t img0;
+  MU_CHECK(image_pool_alloc(&pool, 640, 480, 1, &img0) == 0);
+  uint8_t *data0 = img0.data;
+  image_release(&img0);
+  MU_CHECK(img0.data == NULL);
+  MU_CHECK(pool.nb_bufs == 1);
+  MU_CHECK(pool.nb_free == 1);
+
+  image_t img1;
+  MU_CHECK(image_pool_alloc(&pool, 320, 240, 1, &img1) == 0);
+  MU_CHECK(img1.data == data0);
+  MU_CHECK(img1.stride == 320);
+  MU_CHECK(pool.nb_bufs == 1);
+  MU_CHECK(pool.nb_free == 0);
+
+  /* Larger image needs a new buffer */
+  image_t img2;
+  MU_CHECK(image_pool_alloc(&pool, 1280, 720, 3, &img2) == 0);
+  MU_CHECK(pool.nb_bufs == 2);
+  image_release(&img1);
+  image_release(&img2);
+  MU_CHECK(pool.nb_free == 2);
+
+  /* Pooled load */
+  const char *path = "test_data/images/flower.jpg";
+  image_t img3;
+  image_t *expected = image_load(path);
+  MU_CHECK(image_pool_load(&pool, path, &img3) == 0);
+  MU_CHECK(img3.width == expected->width);
+  MU_CHECK(img3.height == expected->height);
+  MU_CHECK(img3.channels == expected->channels);
+  const size_t size = img3.width * img3.height * img3.channels;
+  MU_CHECK(memcmp(img3.data, expected->data, size) == 0);
+  image_release(&img3);
+  image_free(expected);
+  MU_CHECK(pool.nb_free == pool.nb_bufs);
+
+  /* Decoding reuses pooled buffers once warmed up */
+  const int nb_bufs = pool.nb_bufs;
+  MU_CHECK(image_pool_load(&pool, path, &img3) == 0);
+  MU_CHECK(pool.nb_bufs == nb_bufs);
+  image_release(&img3);
+  MU_CHECK(pool.nb_free == pool.nb_bufs);
+
+  image_pool_free(&pool);
+
+  return 0;
+}
+
+int test_image_view() {
+  image_pool_t pool;
+  image_pool_setup(&pool);
+
+  image_t img;
+  MU_CHECK(image_pool_alloc(&pool, 8, 6, 2, &img) == 0);
+  for (int i = 0; i < 8 * 6 * 2; i++) {
+    img.data[i] = i;
+  }
+
+  /* View shares pixels and holds a reference */
+  image_t view;
+  MU_CHECK(image_view(&img, 2, 1, 4, 3, &view) == 0);
+  MU_CHECK(view.width == 4);
+  MU_CHECK(view.height == 3);
+  MU_CHECK(view.stride == 16);
+  MU_CHECK(view.buf->ref_count == 2);
+  for (int r = 0; r < view.height; r++) {
+    for (int c = 0; c < view.width * view.channels; c++) {
+      const int expected = (r + 1) * 16 + 2 * 2 + c;
+      MU_CHECK(view.data[r * view.stride + c] == expected);
+    }
+  }
+
+  /* View of a view */
+  image_t subview;
+  MU_CHECK(image_view(&view, 1, 1, 2, 2, &subview) == 0);
+  MU_CHECK(subview.data[0] == 2 * 16 + 3 * 2);
+  MU_CHECK(image_view(&view, 3, 0, 2, 2, &subview) == -1);
+
+  /* Buffer returns to the pool after the last release */
+  image_release(&img);
+  MU_CHECK(pool.nb_free == 0);
+  image_release(&view);
+  MU_CHECK(pool.nb_free == 0);
+  image_release(&subview);
+  MU_CHECK(pool.nb_free == 1);
+
+  image_pool_free(&pool);
+
+  return 0;
+}
+
+int test_image_prefetch() {
+  const char *paths[7] = {"test_data/images/awesomeface.png",
+                          "test_data/images/flower.jpg",
+                          "test_data/images/awesomeface.png",
+                          "test_data/images/does_not_exist.png",
+                          "test_data/images/awesomeface.png",
+                          "test_data/images/flower.jpg",
+                          "test_data/images/awesomeface.png"};
+
+  image_prefetch_t pf;
+  MU_CHECK(image_prefetch_setup(&pf, paths, 7, 3, 2) == 0);
+  image_t prev = {0};
+  for (int k = 0; k < 7; k++) {
+    image_t img;
+    const int status = image_prefetch_next(&pf, &img);
+
+    /* A failed image is reported without ending the stream */
+    if (k == 3) {
+      MU_CHECK(status == PREFETCH_ERROR);
+      MU_CHECK(img.data == NULL);
+      continue;
+    }
+
+    image_t *expected = image_load(paths[k]);
+    MU_CHECK(status == PREFETCH_OK);
+    MU_CHECK(img.buf != NULL);
+    MU_CHECK(img.width == expected->width);
+    MU_CHECK(img.height == expected->height);
+    MU_CHECK(img.channels == expected->channels);
+
+    const size_t size = img.width * img.height * img.channels;
+    MU_CHECK(memcmp(img.data, expected->data, size) == 0);
+    image_free(expected);
+
+    /* The previous frame is kept past the next call */
+    if (prev.buf) {
+      MU_CHECK(prev.data != img.data);
+      image_release(&prev);
+    }
+    prev = img;
+  }
+  image_release(&prev);
+
+  image_t img;
+  MU_CHECK(image_prefetch_next(&pf, &img) == PREFETCH_END);
+  MU_CHECK(img.data == NULL);
+  MU_CHECK(pf.pool.nb_free == pf.pool.nb_bufs);
+  image_prefetch_free(&pf);
+
+  return 0;
+}
+
+/* IMAGE PROCESSING ----------------------------------------------------------*/
+
+static int test_reflect101(int i, const int n) {
+  while (i < 0 || i >= n) {
+    i = (i < 0) ? -i : 2 * n - 2 - i;
+  }
+  return i;
+}
+
+static void test_random_image(image_t *img, const int w, const int h) {
+  image_setup(img, w, h, malloc(w * h));
+  for (int i = 0; i < w * h; i++) {
+    img->data[i] = rand() % 256;
+  }
+}
+
+int test_image_gray() {
+  uint8_t rgb[2 * 3] = {255, 0, 0, 10, 20, 30};
+  uint8_t gray[2] = {0};
+  image_t src = {2, 1, 3, 6, rgb, NULL};
+  image_t dst;
+  image_setup(&dst, 2, 1, gray);
+  image_gray(&src, &dst);
+  MU_CHECK(gray[0] == (77 * 255 + 128) >> 8);
+  MU_CHECK(gray[1] == (77 * 10 + 150 * 20 + 29 * 30 + 128) >> 8);
+
+  return 0;
+}
+
+int test_image_pyrdown() {
+  const int w = 37;
+  const int h = 23;
+  image_t src;
+  test_random_image(&src, w, h);
+
+  const int dst_w = (w + 1) / 2;
+  const int dst_h = (h + 1) / 2;
+  image_t dst;
+  image_setup(&dst, dst_w, dst_h, malloc(dst_w * dst_h));
+  image_pyrdown(&src, &dst);
+
+  /* Compare against direct 5x5 convolution */
+  const int k[5] = {1, 4, 6, 4, 1};
+  for (int y = 0; y < dst.height; y++) {
+    for (int x = 0; x < dst.width; x++) {
+      int sum = 0;
+      for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 5; j++) {
+          const int sy = test_reflect101(2 * y + i - 2, h);
+          const int sx = test_reflect101(2 * x + j - 2, w);
+          sum += k[i] * k[j] * src.data[sy * w + sx];
+        }
+      }
+      MU_CHECK(dst.data[y * dst.stride + x] == (sum + 128) >> 8);
+    }
+  }
+
+  free(src.data);
+  free(dst.data);
+
+  return 0;
+}
+
+int test_image_pyramid() {
+  image_t img;
+  test_random_image(&img, 752, 480);
+
+  image_pyramid_t pyr;
+  MU_CHECK(image_pyramid_setup(&pyr, &img, 4) == 0);
+  MU_CHECK(pyr.nb_levels == 4);
+  MU_CHECK(pyr.levels[0].data == img.data);
+  MU_CHECK(pyr.levels[1].width == 376 && pyr.levels[1].height == 240);
+  MU_CHECK(pyr.levels[2].width == 188 && pyr.levels[2].height == 120);
+  MU_CHECK(pyr.levels[3].width == 94 && pyr.levels[3].height == 60);
+  image_pyramid_free(&pyr);
+  MU_CHECK(image_pyramid_setup(&pyr, &img, IMAGE_PYRAMID_MAX_LEVELS + 1) == -1);
+  free(img.data);
+
+  return 0;
+}
+
+int test_image_scharr() {
+  /* Horizontal ramp with slope 2 */
+  const int w = 16;
+  const int h = 8;
+  image_t img;
+  image_setup(&img, w, h, malloc(w * h));
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      img.data[y * w + x] = 2 * x;
+    }
+  }
+
+  imagef_t gx;
+  imagef_t gy;
+  imagef_malloc(&gx, w, h);
+  imagef_malloc(&gy, w, h);
+
+  image_scharr(&img, &gx, &gy);
+  for (int y = 0; y < h; y++) {
+    for (int x = 1; x < w - 1; x++) {
+      MU_CHECK(fltcmp(gx.data[y * w + x], 2.0 * 2.0 * 16.0) == 0);
+      MU_CHECK(fltcmp(gy.data[y * w + x], 0.0) == 0);
+    }
+    /* Reflect-101 borders zero the gradient at the image edge */
+    MU_CHECK(fltcmp(gx.data[y * w], 0.0) == 0);
+  }
+
+  image_sobel(&img, &gx, &gy);
+  for (int y = 0; y < h; y++) {
+    for (int x = 1; x < w - 1; x++) {
+      MU_CHECK(fltcmp(gx.data[y * w + x], 2.0 * 2.0 * 4.0) == 0);
+      MU_CHECK(fltcmp(gy.data[y * w + x], 0.0) == 0);
+    }
+  }
+
+  free(img.data);
+  imagef_free(&gx);
+  imagef_free(&gy);
+
+  return 0;
+}
+
+int test_image_box_filter() {
+  const int w = 29;
+  const int h = 17;
+  image_t src;
+  test_random_image(&src, w, h);
+
+  imagef_t srcf;
+  imagef_malloc(&srcf, w, h);
+  for (int i = 0; i < w * h; i++) {
+    srcf.data[i] = src.data[i];
+  }
+
+  image_t dst;
+  imagef_t dstf;
+  image_setup(&dst, w, h, malloc(w * h));
+  imagef_malloc(&dstf, w, h);
+
+  for (int r = 0; r <= 3; r++) {
+    image_box_filter(&src, r, &dst);
+    imagef_box_filter(&srcf, r, &dstf);
+
+    /* Compare against direct box sum */
+    const int area = (2 * r + 1) * (2 * r + 1);
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        int sum = 0;
+        for (int i = -r; i <= r; i++) {
+          for (int j = -r; j <= r; j++) {
+            const int sy = test_reflect101(y + i, h);
+            const int sx = test_reflect101(x + j, w);
+            sum += src.data[sy * w + sx];
+          }
+        }
+        MU_CHECK(dst.data[y * w + x] == (sum + area / 2) / area);
+        MU_CHECK(fabs(dstf.data[y * w + x] - (float) sum / area) < 1e-3);
+      }
+    }
+  }
+
+  free(src.data);
+  free(dst.data);
+  imagef_free(&srcf);
+  imagef_free(&dstf);
+
+  return 0;
+}
+
+/* FAST ----------------------------------------------------------------------*/
+
+static image_t *test_gray_image(const char *path) {
+  image_t *rgb = image_load(path);
+  image_t *gray = malloc(sizeof(image_t));
+  image_setup(gray, rgb->width, rgb->height, malloc(rgb->width * rgb->height));
+  image_gray(rgb, gray);
+  image_free(rgb);
+  return gray;
+}
+
+/* Reference FAST-9 score with a direct segment test */
+static int test_fast_score(const image_t *img,
+                           const int x,
+                           const int y,
+                           const int t) {
+  const int circle[16][2] = {{0, -3}, {1, -3}, {2, -2}, {3, -1},
+                             {3, 0}, {3, 1}, {2, 2}, {1, 3},
+                             {0, 3}, {-1, 3}, {-2, 2}, {-3, 1},
+                             {-3, 0}, {-3, -1}, {-2, -2}, {-1, -3}};
+  const int c = img->data[y * img->stride + x];
+  int d[16];
+  for (int k = 0; k < 16; k++) {
+    const int px = x + circle[k][0];
+    const int py = y + circle[k][1];
+    d[k] = img->data[py * img->stride + px] - c;
+  }
+
+  int corner = 0;
+  for (int start = 0; start < 16 && corner == 0; start++) {
+    int nb_bright = 0;
+    int nb_dark = 0;
+    for (int k = 0; k < 9; k++) {
+      nb_bright += d[(start + k) % 16] > t;
+      nb_dark += d[(start + k) % 16] < -t;
+    }
+    corner = (nb_bright == 9 || nb_dark == 9);
+  }
+  if (corner == 0) {
+    return 0;
+  }
+
+  int sum_bright = 0;
+  int sum_dark = 0;
+  for (int k = 0; k < 16; k++) {
+    sum_bright += (d[k] > t) ? d[k] - t : 0;
+    sum_dark += (-d[k] > t) ? -d[k] - t : 0;
+  }
+  return MAX(sum_bright, sum_dark);
+}
+
+int test_fast_detect() {
+  image_t *img = test_gray_image("test_data/images/flower.jpg");
+  const int w = img->width;
+  const int h = img->height;
+  const int t = 20;
+
+  /* Reference scores and non-max suppression */
+  int *scores = calloc(w * h, sizeof(int));
+  for (int y = 3; y < h - 3; y++) {
+    for (int x = 3; x < w - 3; x++) {
+      scores[y * w + x] = test_fast_score(img, x, y, t);
+    }
+  }
+  uint8_t *expected = calloc(w * h, sizeof(uint8_t));
+  int nb_expected = 0;
+  for (int y = 3; y < h - 3; y++) {
+    for (int x = 3; x < w - 3; x++) {
+      const int *p = scores + y * w + x;
+      if (p[0] && p[0] > p[-w - 1] && p[0] > p[-w] && p[0] > p[-w + 1] &&
+          p[0] > p[-1] && p[0] >= p[1] && p[0] >= p[w - 1] &&
+          p[0] >= p[w] && p[0] >= p[w + 1]) {
+        expected[y * w + x] = 1;
+        nb_expected++;
+      }
+    }
+  }
+  MU_CHECK(nb_expected > 0);
+
+  /* Detect all corners */
+  keypoint_t *kps = malloc(sizeof(keypoint_t) * w * h);
+  const int nb_kps = fast_detect(img, t, w * h, kps);
+  MU_CHECK(nb_kps == nb_expected);
+  for (int i = 0; i < nb_kps; i++) {
+    const int x = kps[i].x;
+    const int y = kps[i].y;
+    MU_CHECK(expected[y * w + x]);
+    MU_CHECK(fltcmp(kps[i].score, scores[y * w + x]) == 0);
+    if (i > 0) {
+      MU_CHECK(kps[i - 1].score >= kps[i].score);
+    }
+  }
+
+  /* Strongest corners only */
+  MU_CHECK(fast_detect(img, t, 10, kps) == 10);
+
+  free(scores);
+  free(expected);
+  free(kps);
+  free(img->data);
+  free(img);
+
+  return 0;
+}
+
+int test_fast_grid_detect() {
+  image_t *img = test_gray_image("test_data/images/flower.jpg");
+  const int grid_rows = 4;
+  const int grid_cols = 5;
+  const int max_corners = 200;
+  const int max_per_cell = max_corners / (grid_rows * grid_cols);
+
+  keypoint_t kps0[200];
+  keypoint_t kps1[200];
+  const int nb_kps0 = fast_grid_detect(img, 20, 4, 5, max_corners, 1, kps0);
+  const int nb_kps1 = fast_grid_detect(img, 20, 4, 5, max_corners, 4, kps1);
+  MU_CHECK(nb_kps0 > 0);
+  MU_CHECK(nb_kps0 <= max_corners);
+  MU_CHECK(nb_kps0 == nb_kps1);
+  MU_CHECK(memcmp(kps0, kps1, sizeof(keypoint_t) * nb_kps0) == 0);
+
+  /* Corners are bucketed per cell */
+  int cell_count[20] = {0};
+  for (int i = 0; i < nb_kps0; i++) {
+    const int c = kps0[i].x * grid_cols / img->width;
+    const int r = kps0[i].y * grid_rows / img->height;
+    cell_count[r * grid_cols + c]++;
+  }
+  int nb_cells_used = 0;
+  for (int i = 0; i < 20; i++) {
+    MU_CHECK(cell_count[i] <= max_per_cell);
+    nb_cells_used += (cell_count[i] > 0);
+  }
+  MU_CHECK(nb_cells_used > 1);
+
+  free(img->data);
+  free(img);
+
+  return 0;
+}
+
+/* KLT -----------------------------------------------------------------------*/
+
+/* Shift `src` by (`dx`, `dy`) with bilinear interpolation, clamped borders */
+static image_t *test_shift_image(const image_t *src,
+                                 const real_t dx,
+                                 const real_t dy) {
+  const int w = src->width;
+  const int h = src->height;
+  image_t *dst = malloc(sizeof(image_t));
+  image_setup(dst, w, h, malloc(w * h));
+
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      const real_t sx = x - dx;
+      const real_t sy = y - dy;
+      const int x0 = floor(sx);
+      const int y0 = floor(sy);
+      const real_t a = sx - x0;
+      const real_t b = sy - y0;
+      real_t v = 0.0;
+      for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+          const int px = MIN(MAX(x0 + j, 0), w - 1);
+          const int py = MIN(MAX(y0 + i, 0), h - 1);
+          const real_t wx = (j) ? a : 1.0 - a;
+          const real_t wy = (i) ? b : 1.0 - b;
+          v += wx * wy * src->data[py * src->stride + px];
+        }
+      }
+      dst->data[y * w + x] = v + 0.5;
+    }
+  }
+
+  return dst;
+}
+
+int test_klt_track() {
+  /* Blur before shifting so the resampled image stays close to a shift */
+  image_t *img = test_gray_image("test_data/images/flower.jpg");
+  image_t *img0 = malloc(sizeof(image_t));
+  image_setup(img0, img->width, img->height, malloc(img->width * img->height));
+  image_box_filter(img, 2, img0);
+  image_t *img1 = test_shift_image(img0, 6.3, -4.6);
+
+  klt_pyramid_t pyr0;
+  klt_pyramid_t pyr1;
+  MU_CHECK(klt_pyramid_setup(&pyr0, img0, 4) == 0);
+  MU_CHECK(klt_pyramid_setup(&pyr1, img1, 4) == 0);
+
+  /* Track corners */
+  keypoint_t kps0[200];
+  keypoint_t kps1[200];
+  uint8_t status[200];
+  real_t err[200];
+  const int nb_kps = fast_grid_detect(img0, 20, 4, 5, 200, 1, kps0);
+  MU_CHECK(nb_kps > 0);
+  memcpy(kps1, kps0, sizeof(keypoint_t) * nb_kps);
+
+  klt_t klt;
+  klt_setup(&klt);
+  const int nb_tracked =
+      klt_track(&klt, &pyr0, &pyr1, nb_kps, kps0, kps1, status, err);
+  MU_CHECK(nb_tracked > 0.9 * nb_kps);
+
+  int nb_accurate = 0;
+  for (int i = 0; i < nb_kps; i++) {
+    if (status[i] == 0) {
+      continue;
+    }
+    const real_t ex = kps1[i].x - (kps0[i].x + 6.3);
+    const real_t ey = kps1[i].y - (kps0[i].y - 4.6);
+    nb_accurate += (sqrt(ex * ex + ey * ey) < 0.1);
+    MU_CHECK(err[i] < 5.0);
+  }
+  MU_CHECK(nb_accurate > 0.9 * nb_tracked);
+
+  /* Same result with multiple threads */
+  keypoint_t kps2[200];
+  uint8_t status2[200];
+  real_t err2[200];
+  memcpy(kps2, kps0, sizeof(keypoint_t) * nb_kps);
+  klt.nb_threads = 4;
+  klt_track(&klt, &pyr0, &pyr1, nb_kps, kps0, kps2, status2, err2);
+  MU_CHECK(memcmp(kps1, kps2, sizeof(keypoint_t) * nb_kps) == 0);
+  MU_CHECK(memcmp(status, status2, sizeof(uint8_t) * nb_kps) == 0);
+  MU_CHECK(memcmp(err, err2, sizeof(real_t) * nb_kps) == 0);
+
+  klt_pyramid_free(&pyr0);
+  klt_pyramid_free(&pyr1);
+  free(img->data);
+  free(img);
+  free(img0->data);
+  free(img0);
+  free(img1->data);
+  free(img1);
+
+  return 0;
+}
+
+int test_klt_track_lost() {
+  image_t *img0 = test_gray_image("test_data/images/flower.jpg");
+  image_t *img1 = test_shift_image(img0, 6.3, -4.6);
+
+  klt_pyramid_t pyr0;
+  klt_pyramid_t pyr1;
+  MU_CHECK(klt_pyramid_setup(&pyr0, img0, 4) == 0);
+  MU_CHECK(klt_pyramid_setup(&pyr1, img1, 4) == 0);
+
+  /* Patch outside the image, patch tracked out of the image */
+  keypoint_t kps0[2] = {{1.0, 1.0, 0.0}, {img0->width - 8.0, 100.0, 0.0}};
+  keypoint_t kps1[2] = {{1.0, 1.0, 0.0}, {img0->width + 20.0, 100.0, 0.0}};
+  uint8_t status[2];
+  real_t err[2];
+
+  klt_t klt;
+  klt_setup(&klt);
+  MU_CHECK(klt_track(&klt, &pyr0, &pyr1, 2, kps0, kps1, status, err) == 0);
+  MU_CHECK(status[0] == 0);
+  MU_CHECK(status[1] == 0);
+
+  klt_pyramid_free(&pyr0);
+  klt_pyramid_free(&pyr1);
+  free(img0->data);
+  free(img0);
+  free(img1->data);
+  free(img1);
+
+  return 0;
+}
+
+/* RANSAC --------------------------------------------------------------------*/
+
+/**
+ * Project `n` random points in front of two cameras into keypoints `kps0`
+ * and `kps1`, camera 1 is rotated 5 degrees about y and translated.
+ */
+static void test_two_view(const int n,
+                          const real_t noise,
+                          keypoint_t *kps0,
+                          keypoint_t *kps1) {
+  const real_t fx = 458.0;
+  const real_t fy = 457.0;
+  const real_t cx = 367.0;
+  const real_t cy = 248.0;
+  const real_t yaw = deg2rad(5.0);
+  const real_t R[3 * 3] = {cos(yaw), 0.0, sin(yaw),
+                           0.0, 1.0, 0.0,
+                           -sin(yaw), 0.0, cos(yaw)};
+  const real_t t[3] = {-0.3, 0.05, 0.1};
+
+  for (int i = 0; i < n; i++) {
+    const real_t p0[3] = {randf(-2.0, 2.0), randf(-1.5, 1.5), randf(4.0, 8.0)};
+    real_t p1[3] = {0};
+    dot_3x3_3x1(R, p0, p1);
+    p1[0] += t[0];
+    p1[1] += t[1];
+    p1[2] += t[2];
+
+    kps0[i].x = fx * p0[0] / p0[2] + cx + randf(-noise, noise);
+    kps0[i].y = fy * p0[1] / p0[2] + cy + randf(-noise, noise);
+    kps0[i].score = 0.0;
+    kps1[i].x = fx * p1[0] / p1[2] + cx + randf(-noise, noise);
+    kps1[i].y = fy * p1[1] / p1[2] + cy + randf(-noise, noise);
+    kps1[i].score = 0.0;
+  }
+}
+
+/* Sampson distance of a correspondence to F */
+static real_t test_sampson(const real_t F[3 * 3],
+                           const keypoint_t *kp0,
+                           const keypoint_t *kp1) {
+  const real_t x0[3] = {kp0->x, kp0->y, 1.0};
+  const real_t x1[3] = {kp1->x, kp1->y, 1.0};
+  real_t Fx0[3] = {0};
+  real_t Ftx1[3] = {0};
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      Fx0[i] += F[i * 3 + j] * x0[j];
+      Ftx1[i] += F[j * 3 + i] * x1[j];
+    }
+  }
+  const real_t r = x1[0] * Fx0[0] + x1[1] * Fx0[1] + x1[2] * Fx0[2];
+  const real_t den = Fx0[0] * Fx0[0] + Fx0[1] * Fx0[1] +
+                     Ftx1[0] * Ftx1[0] + Ftx1[1] * Ftx1[1];
+  return sqrt(r * r / den);
+}
+
+int test_fundamental_8pt() {
+  keypoint_t kps0[20];
+  keypoint_t kps1[20];
+  test_two_view(20, 0.0, kps0, kps1);
+
+  /* Minimal and least squares fits */
+  real_t F[3 * 3] = {0};
+  MU_CHECK(fundamental_8pt(kps0, kps1, NULL, 8, F) == 0);
+  for (int i = 0; i < 8; i++) {
+    MU_CHECK(test_sampson(F, &kps0[i], &kps1[i]) < 1e-2);
+  }
+  MU_CHECK(fundamental_8pt(kps0, kps1, NULL, 20, F) == 0);
+  for (int i = 0; i < 20; i++) {
+    MU_CHECK(test_sampson(F, &kps0[i], &kps1[i]) < 1e-2);
+  }
+
+  /* Rank 2 */
+  real_t U[3 * 3] = {0};
+  real_t w[3] = {0};
+  real_t V[3 * 3] = {0};
+  memcpy(U, F, sizeof(real_t) * 9);
+  MU_CHECK(svd(U, 3, 3, w, V) == 0);
+  MU_CHECK(MIN(MIN(w[0], w[1]), w[2]) < 1e-6);
+
+  /* Too few correspondences */
+  MU_CHECK(fundamental_8pt(kps0, kps1, NULL, 7, F) == -1);
+
+  return 0;
+}
+
+/* Check RANSAC separates the inliers, correspondences i % 10 < 3 are
+ * outliers */
+static int test_ransac_inliers(const int n,
+                               const keypoint_t *kps0,
+                               const keypoint_t *kps1,
+                               const real_t *quality) {
+  ransac_t ransac;
+  ransac_setup(&ransac);
+
+  real_t F[3 * 3] = {0};
+  uint8_t *inliers = malloc(sizeof(uint8_t) * n);
+  const int nb_inliers =
+      ransac_fundamental(&ransac, kps0, kps1, quality, n, F, inliers);
+
+  int nb_true_inliers = 0;
+  int nb_false_inliers = 0;
+  for (int i = 0; i < n; i++) {
+    nb_true_inliers += (i % 10 >= 3) && inliers[i];
+    nb_false_inliers += (i % 10 < 3) && inliers[i];
+  }
+  free(inliers);
+
+  MU_CHECK(nb_inliers == nb_true_inliers + nb_false_inliers);
+  MU_CHECK(nb_true_inliers >= 0.95 * n * 0.7);
+  MU_CHECK(nb_false_inliers <= 0.05 * n * 0.3);
+
+  return 0;
+}
+
+int test_ransac_fundamental() {
+  /* 30% outliers */
+  const int n = 200;
+  keypoint_t kps0[200];
+  keypoint_t kps1[200];
+  test_two_view(n, 0.3, kps0, kps1);
+  for (int i = 0; i < n; i++) {
+    if (i % 10 < 3) {
+      kps1[i].x = randf(0.0, 752.0);
+      kps1[i].y = randf(0.0, 480.0);
+    }
+  }
+
+  /* RANSAC, then PROSAC with inliers tracked for longer */
+  real_t ages[200];
+  for (int i = 0; i < n; i++) {
+    ages[i] = (i % 10 < 3) ? randf(0.0, 6.0) : randf(2.0, 10.0);
+  }
+  MU_CHECK(test_ransac_inliers(n, kps0, kps1, NULL) == 0);
+  MU_CHECK(test_ransac_inliers(n, kps0, kps1, ages) == 0);
+
+  /* Too few correspondences */
+  ransac_t ransac;
+  ransac_setup(&ransac);
+  real_t F[3 * 3] = {0};
+  uint8_t inliers[7];
+  MU_CHECK(ransac_fundamental(&ransac, kps0, kps1, NULL, 7, F, inliers) == -1);
+
+  return 0;
+}
+
 /* RADTAN --------------------------------------------------------------------*/
 
 int test_radtan4_distort() { return 0; }
@@ -1447,16 +2522,238 @@ int test_cam_factor_eval() {
   return 0;
 }
 
+static void test_perturb_pose(real_t data[7], const int i, const real_t step) {
+  if (i < 3) {
+    real_t dalpha[3] = {0};
+    dalpha[i] = step;
+    const real_t q[4] = {data[0], data[1], data[2], data[3]};
+    real_t dq[4] = {0};
+    real_t q_new[4] = {0};
+    quat_delta(dalpha, dq);
+    quat_mul(dq, q, q_new);
+    data[0] = q_new[0];
+    data[1] = q_new[1];
+    data[2] = q_new[2];
+    data[3] = q_new[3];
+  } else {
+    data[4 + (i - 3)] += step;
+  }
+}
+
+static void test_cam_factor_fdiff(cam_factor_t *factor,
+                                  real_t *param,
+                                  const int param_size,
+                                  const int is_pose,
+                                  real_t *fdiff) {
+  const real_t step = 1e-2;
+  for (int j = 0; j < param_size; j++) {
+    real_t param_copy[8] = {0};
+    vec_copy(param, (is_pose) ? 7 : param_size, param_copy);
+
+    if (is_pose) {
+      test_perturb_pose(param, j, step);
+    } else {
+      param[j] += step;
+    }
+    cam_factor_eval(factor);
+    const real_t r_fwd[2] = {factor->r[0], factor->r[1]};
+    vec_copy(param_copy, (is_pose) ? 7 : param_size, param);
+
+    if (is_pose) {
+      test_perturb_pose(param, j, -step);
+    } else {
+      param[j] -= step;
+    }
+    cam_factor_eval(factor);
+    const real_t r_bwd[2] = {factor->r[0], factor->r[1]};
+    vec_copy(param_copy, (is_pose) ? 7 : param_size, param);
+
+    fdiff[0 * param_size + j] = (r_fwd[0] - r_bwd[0]) / (2.0 * step);
+    fdiff[1 * param_size + j] = (r_fwd[1] - r_bwd[1]) / (2.0 * step);
+  }
+  cam_factor_eval(factor);
+}
+
+int test_cam_factor_jacobians() {
+  pose_t pose;
+  const real_t pose_data[7] = {0.99, 0.05, -0.1, 0.02, 0.1, 0.2, 0.3};
+  pose_setup(&pose, 0, pose_data);
+  vec_normalize(pose.data, 4);
+
+  extrinsics_t extrinsics;
+  const real_t exts_data[7] = {0.5, -0.5, 0.5, -0.5, 0.01, 0.02, 0.03};
+  extrinsics_setup(&extrinsics, exts_data);
+
+  feature_t feature;
+  const real_t feature_data[3] = {5.0, 0.3, -0.2};
+  feature_setup(&feature, feature_data);
+
+  camera_params_t cam;
+  const int cam_res[2] = {752, 480};
+  const real_t cam_data[8] = {640, 480, 320, 240, 0.01, 0.001, 0.001, 0.001};
+  camera_params_setup(&cam, 0, cam_res, "pinhole", "radtan4", cam_data);
+
+  cam_factor_t factor;
+  const real_t var[2] = {1.0, 1.0};
+  cam_factor_setup(&factor, &pose, &extrinsics, &feature, &cam, var);
+  factor.z[0] = 300.0;
+  factor.z[1] = 250.0;
+  cam_factor_eval(&factor);
+
+  real_t fdiff[2 * 8] = {0};
+  const real_t tol = 1e-1;
+  test_cam_factor_fdiff(&factor, pose.data, 6, 1, fdiff);
+  MU_CHECK(check_jacobian("J0", fdiff, factor.J0, 2, 6, tol, 1) == 0);
+  test_cam_factor_fdiff(&factor, extrinsics.data, 6, 1, fdiff);
+  MU_CHECK(check_jacobian("J1", fdiff, factor.J1, 2, 6, tol, 1) == 0);
+  test_cam_factor_fdiff(&factor, cam.data, 8, 0, fdiff);
+  MU_CHECK(check_jacobian("J2", fdiff, factor.J2, 2, 8, tol, 1) == 0);
+  test_cam_factor_fdiff(&factor, feature.data, 3, 0, fdiff);
+  MU_CHECK(check_jacobian("J3", fdiff, factor.J3, 2, 3, tol, 1) == 0);
+
+  return 0;
+}
+
+int test_cam_factor_residuals() {
+  pose_t pose;
+  const real_t pose_data[7] = {0.99, 0.05, -0.1, 0.02, 0.1, 0.2, 0.3};
+  pose_setup(&pose, 0, pose_data);
+  vec_normalize(pose.data, 4);
+
+  extrinsics_t extrinsics;
+  const real_t exts_data[7] = {0.5, -0.5, 0.5, -0.5, 0.01, 0.02, 0.03};
+  extrinsics_setup(&extrinsics, exts_data);
+
+  feature_t feature;
+  const real_t feature_data[3] = {5.0, 0.3, -0.2};
+  feature_setup(&feature, feature_data);
+
+  camera_params_t cam;
+  const int cam_res[2] = {752, 480};
+  const real_t cam_data[8] = {640, 480, 320, 240, 0.01, 0.001, 0.001, 0.001};
+  camera_params_setup(&cam, 0, cam_res, "pinhole", "radtan4", cam_data);
+
+  cam_factor_t factor;
+  const real_t var[2] = {1.0, 1.0};
+  cam_factor_setup(&factor, &pose, &extrinsics, &feature, &cam, var);
+  factor.z[0] = 300.0;
+  factor.z[1] = 250.0;
+  cam_factor_eval(&factor);
+  const real_t r[2] = {factor.r[0], factor.r[1]};
+  real_t J0[2 * 6] = {0};
+  vec_copy(factor.J0, 2 * 6, J0);
+
+  /* Residuals only must match the full evaluation, Jacobians untouched */
+  feature.data[0] += 0.1;
+  cam_factor_residuals(&factor);
+  MU_CHECK(fabs(factor.r[0] - r[0]) > 1e-6);
+  feature.data[0] -= 0.1;
+  cam_factor_residuals(&factor);
+  MU_CHECK(fltcmp(factor.r[0], r[0]) == 0);
+  MU_CHECK(fltcmp(factor.r[1], r[1]) == 0);
+  MU_CHECK(vec_equals(factor.J0, J0, 2 * 6) == 1);
+
+  return 0;
+}
+
+/**
+ * Check `a` and `b` agree to relative tolerance `tol`, scaled by the larger
+ * magnitude but never below 1 so entries near zero are compared absolutely.
+ */
+static int cam_factor_batch_close(const real_t a,
+                                  const real_t b,
+                                  const real_t tol) {
+  const real_t scale = fmax(1.0, fmax(fabs(a), fabs(b)));
+  return fabs(a - b) <= tol * scale;
+}
+
+int test_cam_factor_batch_eval() {
+  /* Parameters */
+  pose_t poses[2];
+  const real_t pose0[7] = {0.99, 0.05, -0.1, 0.02, 0.1, 0.2, 0.3};
+  const real_t pose1[7] = {0.98, -0.1, 0.05, 0.1, -0.2, 0.1, 0.2};
+  pose_setup(&poses[0], 0, pose0);
+  pose_setup(&poses[1], 1, pose1);
+  vec_normalize(poses[0].data, 4);
+  vec_normalize(poses[1].data, 4);
+
+  extrinsics_t extrinsics;
+  const real_t exts_data[7] = {0.5, -0.5, 0.5, -0.5, 0.01, 0.02, 0.03};
+  extrinsics_setup(&extrinsics, exts_data);
+
+  camera_params_t cam;
+  const int cam_res[2] = {752, 480};
+  const real_t cam_data[8] = {640, 480, 320, 240, 0.01, 0.001, 0.001, 0.001};
+  camera_params_setup(&cam, 0, cam_res, "pinhole", "radtan4", cam_data);
+
+  feature_t features[10];
+  for (int i = 0; i < 10; i++) {
+    const real_t data[3] = {5.0, (i % 5) * 0.2 - 0.4, (i / 5) * 0.3 - 0.15};
+    feature_setup(&features[i], data);
+  }
+
+  /* Scalar and batched camera factors, start small so the batch grows */
+  cam_factor_t factors[20];
+  cam_factor_batch_t batch;
+  cam_factor_batch_setup(&batch, 4);
+  for (int i = 0; i < 20; i++) {
+    const int pose_idx = i % 2;
+    const int feature_idx = i / 2;
+    const real_t var[2] = {1.0 + i * 0.1, 2.0};
+    const real_t z[2] = {300.0 + i, 250.0 - i};
+
+    cam_factor_setup(&factors[i],
+                     &poses[pose_idx],
+                     &extrinsics,
+                     &features[feature_idx],
+                     &cam,
+                     var);
+    factors[i].z[0] = z[0];
+    factors[i].z[1] = z[1];
+    cam_factor_eval(&factors[i]);
+
+    cam_factor_batch_add(&batch, pose_idx, 0, 0, feature_idx, z, var);
+  }
+  MU_CHECK(batch.size == 20);
+  MU_CHECK(batch.capacity >= 20);
+
+  /* Evaluate and compare against the scalar path */
+  cam_factor_batch_eval(&batch, poses, 2, &extrinsics, 1, &cam, features);
+  const real_t tol = 1e-4;
+  for (int i = 0; i < 20; i++) {
+    for (int k = 0; k < 2; k++) {
+      MU_CHECK(cam_factor_batch_close(batch.r[k][i], factors[i].r[k], tol));
+    }
+    for (int k = 0; k < 2 * 6; k++) {
+      MU_CHECK(cam_factor_batch_close(batch.J0[k][i], factors[i].J0[k], tol));
+      MU_CHECK(cam_factor_batch_close(batch.J1[k][i], factors[i].J1[k], tol));
+    }
+    for (int k = 0; k < 2 * 8; k++) {
+      MU_CHECK(cam_factor_batch_close(batch.J2[k][i], factors[i].J2[k], tol));
+    }
+    for (int k = 0; k < 2 * 3; k++) {
+      MU_CHECK(cam_factor_batch_close(batch.J3[k][i], factors[i].J3[k], tol));
+    }
+  }
+  cam_factor_batch_free(&batch);
+
+  return 0;
+}
+
 int test_imu_buf_setup() {
   imu_buf_t imu_buf;
-  imu_buf_setup(&imu_buf);
+  imu_buf_setup(&imu_buf, 100.0, 1.0);
+  MU_CHECK(imu_buf.capacity == 102);
+  MU_CHECK(imu_buf.size == 0);
+  MU_CHECK(imu_buf.count == 0);
+  imu_buf_free(&imu_buf);
 
   return 0;
 }
 
 int test_imu_buf_add() {
   imu_buf_t imu_buf;
-  imu_buf_setup(&imu_buf);
+  imu_buf_setup(&imu_buf, 100.0, 1.0);
 
   timestamp_t ts = 0;
   real_t acc[3] = {1.0, 2.0, 3.0};
@@ -1473,12 +2770,13 @@ int test_imu_buf_add() {
   MU_CHECK(fltcmp(imu_buf.gyr[0][1], 2.0) == 0);
   MU_CHECK(fltcmp(imu_buf.gyr[0][2], 3.0) == 0);
 
+  imu_buf_free(&imu_buf);
   return 0;
 }
 
 int test_imu_buf_clear() {
   imu_buf_t imu_buf;
-  imu_buf_setup(&imu_buf);
+  imu_buf_setup(&imu_buf, 100.0, 1.0);
 
   timestamp_t ts = 0;
   real_t acc[3] = {1.0, 2.0, 3.0};
@@ -1495,12 +2793,13 @@ int test_imu_buf_clear() {
   MU_CHECK(fltcmp(imu_buf.gyr[0][1], 0.0) == 0);
   MU_CHECK(fltcmp(imu_buf.gyr[0][2], 0.0) == 0);
 
+  imu_buf_free(&imu_buf);
   return 0;
 }
 
 int test_imu_buf_copy() {
   imu_buf_t imu_buf;
-  imu_buf_setup(&imu_buf);
+  imu_buf_setup(&imu_buf, 100.0, 1.0);
 
   timestamp_t ts = 0;
   real_t acc[3] = {1.0, 2.0, 3.0};
@@ -1508,7 +2807,7 @@ int test_imu_buf_copy() {
   imu_buf_add(&imu_buf, ts, acc, gyr);
 
   imu_buf_t imu_buf2;
-  imu_buf_setup(&imu_buf2);
+  imu_buf_setup(&imu_buf2, 100.0, 1.0);
   imu_buf_copy(&imu_buf, &imu_buf2);
 
   MU_CHECK(imu_buf2.size == 1);
@@ -1520,12 +2819,14 @@ int test_imu_buf_copy() {
   MU_CHECK(fltcmp(imu_buf2.gyr[0][1], 2.0) == 0);
   MU_CHECK(fltcmp(imu_buf2.gyr[0][2], 3.0) == 0);
 
+  imu_buf_free(&imu_buf);
+  imu_buf_free(&imu_buf2);
   return 0;
 }
 
 int test_imu_buf_print() {
   imu_buf_t imu_buf;
-  imu_buf_setup(&imu_buf);
+  imu_buf_setup(&imu_buf, 100.0, 1.0);
 
   timestamp_t ts = 0;
   real_t acc[3] = {1.0, 2.0, 3.0};
@@ -1533,19 +2834,934 @@ int test_imu_buf_print() {
   imu_buf_add(&imu_buf, ts, acc, gyr);
 
   imu_buf_print(&imu_buf);
+  imu_buf_free(&imu_buf);
   return 0;
 }
 
+int test_imu_buf_view() {
+  imu_buf_t *imu_buf = malloc(sizeof(imu_buf_t));
+  imu_buf_setup(imu_buf, 1000.0, 1.0);
+  const int capacity = imu_buf->capacity;
+
+  /* Fill buffer past capacity so it wraps around */
+  const int nb_samples = capacity + 100;
+  for (int k = 0; k < nb_samples; k++) {
+    real_t acc[3] = {k, 0.0, 0.0};
+    real_t gyr[3] = {0.0, k, 0.0};
+    imu_buf_add(imu_buf, k * 10, acc, gyr);
+  }
+  MU_CHECK(imu_buf->size == capacity);
+  MU_CHECK(imu_buf->count == (uint64_t) nb_samples);
+
+  /* View spanning the wrap around point */
+  const int k0 = capacity - 10;
+  const int k1 = capacity + 20;
+  imu_view_t view;
+  MU_CHECK(imu_buf_view(imu_buf, k0 * 10, k1 * 10, &view) == 0);
+  MU_CHECK(imu_view_valid(&view));
+  MU_CHECK(imu_view_size(&view) == k1 - k0 + 1);
+  for (int k = 0; k < imu_view_size(&view); k++) {
+    MU_CHECK(imu_view_ts(&view, k) == (k0 + k) * 10);
+    MU_CHECK(fltcmp(imu_view_acc(&view, k)[0], k0 + k) == 0);
+    MU_CHECK(fltcmp(imu_view_gyr(&view, k)[1], k0 + k) == 0);
+  }
+
+  /* Timestamps between samples are bracketed by the view */
+  MU_CHECK(imu_buf_view(imu_buf, k0 * 10 + 5, k1 * 10 - 5, &view) == 0);
+  MU_CHECK(imu_view_size(&view) == k1 - k0 + 1);
+  MU_CHECK(imu_view_ts(&view, 0) == k0 * 10);
+  MU_CHECK(imu_view_ts(&view, k1 - k0) == k1 * 10);
+
+  /* Overwritten or out of range measurements */
+  MU_CHECK(imu_buf_view(imu_buf, 0, 50, &view) == -1);
+  MU_CHECK(imu_buf_view(imu_buf, nb_samples * 10, nb_samples * 10 + 50, &view) == -1);
+
+  /* Views become invalid once their measurements are overwritten */
+  MU_CHECK(imu_buf_view(imu_buf, k0 * 10, k1 * 10, &view) == 0);
+  for (int k = nb_samples; k < nb_samples + capacity; k++) {
+    real_t acc[3] = {0};
+    real_t gyr[3] = {0};
+    imu_buf_add(imu_buf, k * 10, acc, gyr);
+  }
+  MU_CHECK(imu_view_valid(&view) == 0);
+
+  /* And once the buffer is cleared */
+  MU_CHECK(imu_buf_view(imu_buf, nb_samples * 10, nb_samples * 10 + 50, &view) == 0);
+  imu_buf_clear(imu_buf);
+  MU_CHECK(imu_view_valid(&view) == 0);
+
+  imu_buf_free(imu_buf);
+  free(imu_buf);
+  return 0;
+}
+
+static void test_imu_params(imu_params_t *imu_params) {
+  imu_params->imu_idx = 0;
+  imu_params->rate = 200.0;
+  for (int i = 0; i < 3; i++) {
+    imu_params->n_a[i] = 0.1;
+    imu_params->n_g[i] = 0.1;
+    imu_params->n_aw[i] = 0.1;
+    imu_params->n_gw[i] = 0.1;
+  }
+  imu_params->g = 9.81;
+}
+
+/**
+ * Simulate 1 second of IMU measurements at 200Hz with constant body angular
+ * velocity and constant world acceleration, and the sensor poses and speed
+ * and biases at the start and end.
+ */
+static void test_imu_sim(imu_buf_t *imu_buf,
+                         pose_t *pose_i,
+                         speed_biases_t *sb_i,
+                         pose_t *pose_j,
+                         speed_biases_t *sb_j) {
+  const real_t w_B[3] = {0.1, -0.2, 0.3};
+  const real_t a_W[3] = {0.5, -0.3, 0.2};
+  const real_t g_W[3] = {0.0, 0.0, 9.81};
+  const real_t q0[4] = {0.99, 0.05, -0.1, 0.02};
+  const real_t r0[3] = {1.0, 2.0, 3.0};
+  const real_t v0[3] = {0.1, 0.2, 0.3};
+
+  real_t q_WS0[4] = {0};
+  vec_copy(q0, 4, q_WS0);
+  vec_normalize(q_WS0, 4);
+
+  const int nb_measurements = 201;
+  const timestamp_t dt = 5000000;
+  imu_buf_setup(imu_buf, 200.0, 1.0);
+  real_t q_WS[4] = {0};
+  real_t r_WS[3] = {0};
+  real_t v_WS[3] = {0};
+  for (int k = 0; k < nb_measurements; k++) {
+    const timestamp_t ts = k * dt;
+    const real_t t = ts2sec(ts);
+
+    /* Sensor state at time t */
+    const real_t dalpha[3] = {w_B[0] * t, w_B[1] * t, w_B[2] * t};
+    real_t dq[4] = {0};
+    quat_delta(dalpha, dq);
+    quat_mul(q_WS0, dq, q_WS);
+    for (int i = 0; i < 3; i++) {
+      r_WS[i] = r0[i] + v0[i] * t + 0.5 * a_W[i] * t * t;
+      v_WS[i] = v0[i] + a_W[i] * t;
+    }
+
+    /* IMU measurement: a_m = C_SW * (a_W + g_W), w_m = w_B */
+    real_t C_WS[3 * 3] = {0};
+    real_t C_SW[3 * 3] = {0};
+    quat2rot(q_WS, C_WS);
+    mat_transpose(C_WS, 3, 3, C_SW);
+    const real_t a[3] = {a_W[0] + g_W[0], a_W[1] + g_W[1], a_W[2] + g_W[2]};
+    real_t acc[3] = {0};
+    real_t gyr[3] = {w_B[0], w_B[1], w_B[2]};
+    dot(C_SW, 3, 3, a, 3, 1, acc);
+    imu_buf_add(imu_buf, ts, acc, gyr);
+
+    /* Sensor pose and speed and biases at start and end */
+    if (k == 0 || k == nb_measurements - 1) {
+      const real_t pose[7] = {
+          q_WS[0], q_WS[1], q_WS[2], q_WS[3], r_WS[0], r_WS[1], r_WS[2]};
+      const real_t sb[9] = {v_WS[0], v_WS[1], v_WS[2], 0, 0, 0, 0, 0, 0};
+      pose_setup((k == 0) ? pose_i : pose_j, ts, pose);
+      speed_biases_setup((k == 0) ? sb_i : sb_j, ts, sb);
+    }
+  }
+}
+
+static void test_imu_factor_fdiff(imu_factor_t *factor,
+                                  real_t *param,
+                                  const int param_size,
+                                  const int is_pose,
+                                  real_t *fdiff) {
+  const real_t step = 1e-2;
+  for (int j = 0; j < param_size; j++) {
+    real_t param_copy[9] = {0};
+    vec_copy(param, (is_pose) ? 7 : param_size, param_copy);
+
+    if (is_pose) {
+      test_perturb_pose(param, j, step);
+    } else {
+      param[j] += step;
+    }
+    imu_factor_eval(factor);
+    real_t r_fwd[15] = {0};
+    vec_copy(factor->r, 15, r_fwd);
+    vec_copy(param_copy, (is_pose) ? 7 : param_size, param);
+
+    if (is_pose) {
+      test_perturb_pose(param, j, -step);
+    } else {
+      param[j] -= step;
+    }
+    imu_factor_eval(factor);
+    real_t r_bwd[15] = {0};
+    vec_copy(factor->r, 15, r_bwd);
+    vec_copy(param_copy, (is_pose) ? 7 : param_size, param);
+
+    for (int i = 0; i < 15; i++) {
+      fdiff[i * param_size + j] = (r_fwd[i] - r_bwd[i]) / (2.0 * step);
+    }
+  }
+  imu_factor_eval(factor);
+}
+
+int test_imu_factor_setup() {
+  imu_params_t imu_params;
+  test_imu_params(&imu_params);
+
+  imu_buf_t *imu_buf = malloc(sizeof(imu_buf_t));
+  pose_t pose_i, pose_j;
+  speed_biases_t sb_i, sb_j;
+  test_imu_sim(imu_buf, &pose_i, &sb_i, &pose_j, &sb_j);
+
+  imu_factor_t *factor = malloc(sizeof(imu_factor_t));
+  MU_CHECK(imu_factor_setup(factor,
+                            &imu_params,
+                            imu_buf,
+                            &pose_i,
+                            &sb_i,
+                            &pose_j,
+                            &sb_j) == 0);
+  MU_CHECK(factor->r_size == 15);
+  MU_CHECK(factor->nb_params == 4);
+  MU_CHECK(fltcmp(factor->Dt, 1.0) == 0);
+
+  /* Preintegrated rotation is the relative rotation between pose i and j */
+  const real_t q_i_inv[4] = {
+      pose_i.data[0], -pose_i.data[1], -pose_i.data[2], -pose_i.data[3]};
+  real_t q_ij[4] = {0};
+  quat_mul(q_i_inv, pose_j.data, q_ij);
+  for (int i = 0; i < 4; i++) {
+    MU_CHECK(fabs(q_ij[i] - factor->dq[i]) < 1e-3);
+  }
+
+  /* Covariance is symmetric with positive diagonal */
+  for (int i = 0; i < 15; i++) {
+    MU_CHECK(factor->covar[i * 15 + i] > 0.0);
+    for (int j = 0; j < 15; j++) {
+      const real_t P_ij = factor->covar[i * 15 + j];
+      const real_t P_ji = factor->covar[j * 15 + i];
+      MU_CHECK(fabs(P_ij - P_ji) < 1e-6);
+    }
+  }
+
+  /* Pose timestamps between samples are interpolated */
+  pose_i.ts += 2500000;
+  pose_j.ts -= 2500000;
+  MU_CHECK(imu_factor_setup(factor,
+                            &imu_params,
+                            imu_buf,
+                            &pose_i,
+                            &sb_i,
+                            &pose_j,
+                            &sb_j) == 0);
+  MU_CHECK(fabs(factor->Dt - 0.995) < 1e-6);
+
+  /* And extrapolated past the last sample */
+  pose_j.ts += 5000000;
+  MU_CHECK(imu_factor_setup(factor,
+                            &imu_params,
+                            imu_buf,
+                            &pose_i,
+                            &sb_i,
+                            &pose_j,
+                            &sb_j) == 0);
+  MU_CHECK(fabs(factor->Dt - 1.0) < 1e-6);
+
+  /* No measurements between the poses */
+  pose_i.ts = 2000000000;
+  pose_j.ts = 3000000000;
+  MU_CHECK(imu_factor_setup(factor,
+                            &imu_params,
+                            imu_buf,
+                            &pose_i,
+                            &sb_i,
+                            &pose_j,
+                            &sb_j) == -1);
+
+  imu_buf_free(imu_buf);
+  free(imu_buf);
+  free(factor);
+  return 0;
+}
+
+int test_imu_factor_eval() {
+  imu_params_t imu_params;
+  test_imu_params(&imu_params);
+
+  imu_buf_t *imu_buf = malloc(sizeof(imu_buf_t));
+  pose_t pose_i, pose_j;
+  speed_biases_t sb_i, sb_j;
+  test_imu_sim(imu_buf, &pose_i, &sb_i, &pose_j, &sb_j);
+
+  imu_factor_t *factor = malloc(sizeof(imu_factor_t));
+  imu_factor_setup(factor,
+                   &imu_params,
+                   imu_buf,
+                   &pose_i,
+                   &sb_i,
+                   &pose_j,
+                   &sb_j);
+
+  /* Residual at the true states is small */
+  imu_factor_eval(factor);
+  MU_CHECK(vec_norm(factor->r, 15) < 1e-1);
+
+  /* Check jacobians away from the linearization point */
+  sb_i.data[3] += 0.01;
+  sb_i.data[8] -= 0.01;
+  sb_j.data[0] += 0.1;
+  pose_j.data[4] += 0.1;
+  imu_factor_eval(factor);
+
+  real_t fdiff[15 * 9] = {0};
+  const real_t tol = 1e-1;
+  test_imu_factor_fdiff(factor, pose_i.data, 6, 1, fdiff);
+  MU_CHECK(check_jacobian("J0", fdiff, factor->J0, 15, 6, tol, 1) == 0);
+  test_imu_factor_fdiff(factor, sb_i.data, 9, 0, fdiff);
+  MU_CHECK(check_jacobian("J1", fdiff, factor->J1, 15, 9, tol, 1) == 0);
+  test_imu_factor_fdiff(factor, pose_j.data, 6, 1, fdiff);
+  MU_CHECK(check_jacobian("J2", fdiff, factor->J2, 15, 6, tol, 1) == 0);
+  test_imu_factor_fdiff(factor, sb_j.data, 9, 0, fdiff);
+  MU_CHECK(check_jacobian("J3", fdiff, factor->J3, 15, 9, tol, 1) == 0);
+
+  /* First-order bias correction agrees with re-integrating */
+  real_t r_corrected[15] = {0};
+  vec_copy(factor->r, 15, r_corrected);
+  vec_copy(sb_i.data + 3, 3, factor->ba);
+  vec_copy(sb_i.data + 6, 3, factor->bg);
+  imu_factor_propagate(factor);
+  imu_factor_eval(factor);
+  for (int i = 0; i < 15; i++) {
+    MU_CHECK(fabs(r_corrected[i] - factor->r[i]) < 1e-2);
+  }
+
+  imu_buf_free(imu_buf);
+  free(imu_buf);
+  free(factor);
+  return 0;
+}
+
+int test_block_hessian_setup() {
+  const int param_sizes[3] = {6, 8, 3};
+  block_hessian_t H;
+  block_hessian_setup(&H, param_sizes, 3);
+
+  MU_CHECK(H.nb_params == 3);
+  MU_CHECK(H.x_size == 17);
+  MU_CHECK(H.param_idxs[0] == 0);
+  MU_CHECK(H.param_idxs[1] == 6);
+  MU_CHECK(H.param_idxs[2] == 14);
+  MU_CHECK(H.nb_blocks == 0);
+  MU_CHECK(block_hessian_get(&H, 0, 1) == NULL);
+
+  block_hessian_free(&H);
+  return 0;
+}
+
+int test_block_hessian_accumulate() {
+  const int param_sizes[3] = {2, 3, 1};
+  block_hessian_t H;
+  block_hessian_setup(&H, param_sizes, 3);
+
+  /* Factor connecting parameter blocks 2 and 0 (in that order) */
+  const real_t J_a[2 * 1] = {1.0, 2.0};
+  const real_t J_b[2 * 2] = {1.0, 2.0, 3.0, 4.0};
+  const int ids[2] = {2, 0};
+  const real_t *jacs[2] = {J_a, J_b};
+  for (int i = 0; i < 2; i++) {
+    for (int j = i; j < 2; j++) {
+      block_hessian_accumulate(&H, ids[i], ids[j], jacs[i], jacs[j], 2);
+    }
+  }
+  MU_CHECK(H.nb_blocks == 3);
+  MU_CHECK(block_hessian_get(&H, 1, 1) == NULL);
+
+  /* Form J = [J_b, 0, J_a] and check H == J' * J */
+  /* clang-format off */
+  const real_t J[2 * 6] = {1.0, 2.0, 0.0, 0.0, 0.0, 1.0,
+                           3.0, 4.0, 0.0, 0.0, 0.0, 2.0};
+  /* clang-format on */
+  real_t Jt[6 * 2] = {0};
+  real_t JtJ[6 * 6] = {0};
+  mat_transpose(J, 2, 6, Jt);
+  dot(Jt, 6, 2, J, 2, 6, JtJ);
+
+  real_t H_dense[6 * 6] = {0};
+  block_hessian_dense(&H, H_dense);
+  MU_CHECK(mat_equals(JtJ, H_dense, 6, 6, 1e-8) == 0);
+
+  block_hessian_free(&H);
+  return 0;
+}
+
+/**
+ * Random block-sparse SPD Hessian with a chain of factors between
+ * consecutive blocks, sparse random couplings and a dense factor over the
+ * last blocks.
+ */
+static void setup_test_block_hessian(block_hessian_t *H) {
+  const int nb_params = 30;
+  int param_sizes[30] = {0};
+  for (int i = 0; i < nb_params; i++) {
+    param_sizes[i] = (i % 3 == 0) ? 6 : 3;
+  }
+  block_hessian_setup(H, param_sizes, nb_params);
+
+  real_t J_i[9 * 6] = {0};
+  real_t J_j[9 * 6] = {0};
+  for (int f = 0; f < 2 * nb_params; f++) {
+    const int i = (f < nb_params) ? f : rand() % nb_params;
+    const int j = (f < nb_params) ? (f + 1) % nb_params : rand() % nb_params;
+    for (int k = 0; k < 9 * 6; k++) {
+      J_i[k] = randf(-1.0, 1.0);
+      J_j[k] = randf(-1.0, 1.0);
+    }
+    block_hessian_accumulate(H, i, i, J_i, J_i, 9);
+    block_hessian_accumulate(H, i, j, J_i, J_j, 9);
+    block_hessian_accumulate(H, j, j, J_j, J_j, 9);
+  }
+  for (int i = nb_params - 16; i < nb_params; i++) {
+    for (int j = i; j < nb_params; j++) {
+      for (int k = 0; k < 9 * 6; k++) {
+        J_i[k] = randf(-1.0, 1.0);
+        J_j[k] = randf(-1.0, 1.0);
+      }
+      block_hessian_accumulate(H, i, j, J_i, J_j, 9);
+    }
+  }
+  for (int i = 0; i < nb_params; i++) {
+    real_t *H_ii = block_hessian_insert(H, i, i);
+    for (int a = 0; a < param_sizes[i]; a++) {
+      H_ii[a * param_sizes[i] + a] += 100.0;
+    }
+  }
+}
+
+int test_block_chol() {
+  block_hessian_t H;
+  setup_test_block_hessian(&H);
+
+  /* Dense solve */
+  const int n = H.x_size;
+  const real_t lambda = 1e-2;
+  real_t *H_dense = malloc(sizeof(real_t) * n * n);
+  real_t *b = vec_malloc(n);
+  real_t *x_dense = vec_malloc(n);
+  block_hessian_dense(&H, H_dense);
+  for (int i = 0; i < n; i++) {
+    H_dense[i * n + i] += lambda * H_dense[i * n + i];
+    b[i] = randf(-1.0, 1.0);
+  }
+  chol_solve(H_dense, b, x_dense, n);
+
+  /* Sparse solve in natural and reversed elimination order */
+  int order[30] = {0};
+  for (int k = 0; k < H.nb_params; k++) {
+    order[k] = H.nb_params - 1 - k;
+  }
+  const int *orders[2] = {NULL, order};
+  for (int k = 0; k < 2; k++) {
+    block_chol_t chol;
+    MU_CHECK(block_chol_setup(&chol, &H, orders[k]) == 0);
+    MU_CHECK(chol.nb_supernodes < H.nb_params);
+    MU_CHECK(block_chol_factor(&chol, &H, lambda) == 0);
+
+    real_t *x = vec_malloc(n);
+    block_chol_solve(&chol, b, x);
+    MU_CHECK(mat_equals(x, x_dense, n, 1, 1e-4) == 0);
+
+    free(x);
+    block_chol_free(&chol);
+  }
+
+  free(H_dense);
+  free(b);
+  free(x_dense);
+  block_hessian_free(&H);
+  return 0;
+}
+
+static void setup_test_solver(solver_t *solver) {
+  solver_setup(solver);
+
+  /* Camera */
+  const int cam_res[2] = {752, 480};
+  const real_t cam_data[8] = {640, 480, 320, 240, 0.0, 0.0, 0.0, 0.0};
+  solver_add_camera(solver, 0, cam_res, "pinhole", "radtan4", cam_data);
+
+  /* Sensor-camera extrinsics */
+  const real_t ext_data[7] = {0.5, -0.5, 0.5, -0.5, 0.0, 0.0, 0.0};
+  solver_add_extrinsics(solver, ext_data);
+
+  /* Sensor poses */
+  for (int k = 0; k < 3; k++) {
+    const real_t data[7] = {1.0, 0.0, 0.0, 0.0, 0.0, k * 0.1, 0.0};
+    solver_add_pose(solver, k, data);
+  }
+
+  /* Features and observations */
+  for (int i = 0; i < 10; i++) {
+    const real_t data[3] = {5.0, (i % 5) * 0.2 - 0.4, (i / 5) * 0.3 - 0.15};
+    feature_t *feature = solver_add_feature(solver, data);
+
+    for (int k = 0; k < solver->nb_poses; k++) {
+      const real_t var[2] = {10.0, 10.0};
+      cam_factor_t *factor = solver_add_cam_factor(solver,
+                                                   &solver->poses[k],
+                                                   &solver->extrinsics[0],
+                                                   feature,
+                                                   &solver->cams[0],
+                                                   var);
+      factor->z[0] = 320.0 + i;
+      factor->z[1] = 240.0 - i;
+    }
+  }
+}
+
 int test_solver_setup() {
-  solver_t solver;
-  solver_setup(&solver);
+  solver_t *solver = malloc(sizeof(solver_t));
+  solver_setup(solver);
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_reset() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  solver_setup(solver);
+
+  /* Grow well past the initial capacity */
+  const int cam_res[2] = {752, 480};
+  const real_t cam_data[8] = {640, 480, 320, 240, 0.0, 0.0, 0.0, 0.0};
+  const real_t ext_data[7] = {1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  const real_t var[2] = {1.0, 1.0};
+  camera_params_t *cam =
+      solver_add_camera(solver, 0, cam_res, "pinhole", "radtan4", cam_data);
+  extrinsics_t *exts = solver_add_extrinsics(solver, ext_data);
+
+  for (int round = 0; round < 2; round++) {
+    for (int k = 0; k < 100; k++) {
+      const real_t pose_data[7] = {1.0, 0.0, 0.0, 0.0, k, 0.0, 0.0};
+      const real_t p_data[3] = {k, 0.0, 5.0};
+      pose_t *pose = solver_add_pose(solver, k, pose_data);
+      feature_t *feature = solver_add_feature(solver, p_data);
+      solver_add_cam_factor(solver, pose, exts, feature, cam, var);
+    }
+    MU_CHECK(solver->nb_poses == 100);
+    MU_CHECK(solver->max_poses >= 100);
+
+    /* Factors still reference the parameters after they moved */
+    for (int k = 0; k < solver->nb_cam_factors; k++) {
+      const cam_factor_t *factor = &solver->cam_factors[k];
+      MU_CHECK(factor->pose == &solver->poses[k]);
+      MU_CHECK(factor->feature == &solver->features[k]);
+      MU_CHECK(factor->camera == &solver->cams[0]);
+      MU_CHECK(factor->extrinsics == &solver->extrinsics[0]);
+      MU_CHECK(factor->jacs[0] == factor->J0);
+      MU_CHECK(factor->jacs[3] == factor->J3);
+    }
+
+    /* Reset keeps the arena memory for the next window */
+    arena_block_t *head = solver->arena.head;
+    solver_reset(solver);
+    MU_CHECK(solver->nb_poses == 0);
+    MU_CHECK(solver->nb_cam_factors == 0);
+    MU_CHECK(solver->arena.head == head);
+    cam = solver_add_camera(solver, 0, cam_res, "pinhole", "radtan4", cam_data);
+    exts = solver_add_extrinsics(solver, ext_data);
+  }
+
+  solver_free(solver);
+  free(solver);
   return 0;
 }
 
 int test_solver_print() {
-  solver_t solver;
-  solver_setup(&solver);
-  solver_print(&solver);
+  solver_t *solver = malloc(sizeof(solver_t));
+  solver_setup(solver);
+  solver_print(solver);
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_eval() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  setup_test_solver(solver);
+  solver_eval(solver);
+
+  const int x_size = solver->x_size;
+  MU_CHECK(x_size == 3 * 6 + 6 + 8 + 10 * 3);
+  MU_CHECK(solver->r_size == solver->nb_cam_factors * 2);
+
+  /* Only pose, extrinsics, camera and feature blocks touched by a factor */
+  const int nb_params = solver->H.nb_params;
+  MU_CHECK(block_hessian_get(&solver->H, nb_params - 2, nb_params - 1) == NULL);
+  MU_CHECK(block_hessian_get(&solver->H, 0, 1) == NULL);
+  MU_CHECK(block_hessian_get(&solver->H, 0, 3) != NULL);
+
+  /* Form dense J and r and check H == J' * J, g == -J' * r */
+  const int r_size = solver->r_size;
+  real_t *J = calloc(r_size * x_size, sizeof(real_t));
+  real_t *r = calloc(r_size, sizeof(real_t));
+  for (int k = 0; k < solver->nb_cam_factors; k++) {
+    const cam_factor_t *factor = &solver->cam_factors[k];
+    const int ids[4] = {factor->pose - solver->poses,
+                        3 + (factor->extrinsics - solver->extrinsics),
+                        4 + (factor->camera - solver->cams),
+                        5 + (factor->feature - solver->features)};
+    for (int p = 0; p < 4; p++) {
+      const int cs = solver->H.param_idxs[ids[p]];
+      const int size = solver->H.param_sizes[ids[p]];
+      for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < size; j++) {
+          J[(k * 2 + i) * x_size + cs + j] = factor->jacs[p][i * size + j];
+        }
+      }
+    }
+    r[k * 2 + 0] = factor->r[0];
+    r[k * 2 + 1] = factor->r[1];
+  }
+
+  real_t *Jt = calloc(x_size * r_size, sizeof(real_t));
+  real_t *JtJ = calloc(x_size * x_size, sizeof(real_t));
+  real_t *Jtr = calloc(x_size, sizeof(real_t));
+  mat_transpose(J, r_size, x_size, Jt);
+  dot(Jt, x_size, r_size, J, r_size, x_size, JtJ);
+  dot(Jt, x_size, r_size, r, r_size, 1, Jtr);
+  vec_scale(Jtr, x_size, -1.0);
+
+  real_t *H_dense = calloc(x_size * x_size, sizeof(real_t));
+  block_hessian_dense(&solver->H, H_dense);
+  MU_CHECK(mat_equals(JtJ, H_dense, x_size, x_size, 1e-1) == 0);
+  MU_CHECK(mat_equals(Jtr, solver->g, x_size, 1, 1e-1) == 0);
+
+  /* Re-evaluating reuses the sparsity pattern */
+  const size_t nb_blocks = solver->H.nb_blocks;
+  solver_eval(solver);
+  MU_CHECK(solver->H.nb_blocks == nb_blocks);
+  block_hessian_dense(&solver->H, H_dense);
+  MU_CHECK(mat_equals(JtJ, H_dense, x_size, x_size, 1e-1) == 0);
+
+  free(J);
+  free(r);
+  free(Jt);
+  free(JtJ);
+  free(Jtr);
+  free(H_dense);
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_eval_layout() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  solver_setup(solver);
+
+  /* 5 poses and 3 features */
+  const real_t pose_data[7] = {1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  const real_t p_data[3] = {0.0, 0.0, 5.0};
+  for (int k = 0; k < 5; k++) {
+    solver_add_pose(solver, k, pose_data);
+  }
+  for (int i = 0; i < 3; i++) {
+    solver_add_feature(solver, p_data);
+  }
+  solver_eval(solver);
+  MU_CHECK(solver->H.nb_params == 8);
+  MU_CHECK(solver->H.x_size == 39);
+  MU_CHECK(solver->H.param_sizes[0] == 6);
+
+  /* 3 cameras and 5 features, same number of blocks and columns */
+  solver_reset(solver);
+  const int cam_res[2] = {752, 480};
+  const real_t cam_data[8] = {640, 480, 320, 240, 0.0, 0.0, 0.0, 0.0};
+  for (int i = 0; i < 3; i++) {
+    solver_add_camera(solver, i, cam_res, "pinhole", "radtan4", cam_data);
+  }
+  for (int i = 0; i < 5; i++) {
+    solver_add_feature(solver, p_data);
+  }
+  solver_eval(solver);
+  MU_CHECK(solver->H.nb_params == 8);
+  MU_CHECK(solver->H.x_size == 39);
+  MU_CHECK(solver->H.param_sizes[0] == 8);
+  MU_CHECK(solver->H.param_sizes[3] == 3);
+  MU_CHECK(solver->H.param_idxs[3] == 24);
+
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_eval_parallel() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  setup_test_solver(solver);
+
+  /* Serial evaluation */
+  solver_eval(solver);
+  const int x_size = solver->x_size;
+  const int r_size = solver->r_size;
+  real_t *H_serial = calloc(x_size * x_size, sizeof(real_t));
+  real_t *g_serial = calloc(x_size, sizeof(real_t));
+  block_hessian_dense(&solver->H, H_serial);
+  vec_copy(solver->g, x_size, g_serial);
+
+  /* Parallel evaluation with deterministic reduction */
+  real_t *H_0 = calloc(x_size * x_size, sizeof(real_t));
+  real_t *H_1 = calloc(x_size * x_size, sizeof(real_t));
+  solver->nb_threads = 4;
+  solver->deterministic = 1;
+  solver_eval(solver);
+  MU_CHECK(solver->nb_workers == 4);
+  MU_CHECK(solver->r_size == r_size);
+  block_hessian_dense(&solver->H, H_0);
+  MU_CHECK(mat_equals(H_serial, H_0, x_size, x_size, 1e-1) == 0);
+  MU_CHECK(mat_equals(g_serial, solver->g, x_size, 1, 1e-1) == 0);
+
+  /* The worker pool and their H persist across evaluations */
+  const pthread_t thread = solver->workers[0].thread;
+  const real_t *H_data = solver->workers[0].H.data;
+  solver_eval(solver);
+  MU_CHECK(pthread_equal(thread, solver->workers[0].thread));
+  MU_CHECK(H_data == solver->workers[0].H.data);
+  block_hessian_dense(&solver->H, H_1);
+  MU_CHECK(memcmp(H_0, H_1, sizeof(real_t) * x_size * x_size) == 0);
+
+  /* Parallel evaluation with reduction in completion order */
+  solver->deterministic = 0;
+  solver_eval(solver);
+  MU_CHECK(solver->r_size == r_size);
+  block_hessian_dense(&solver->H, H_1);
+  MU_CHECK(mat_equals(H_serial, H_1, x_size, x_size, 1e-1) == 0);
+  MU_CHECK(mat_equals(g_serial, solver->g, x_size, 1, 1e-1) == 0);
+
+  free(H_serial);
+  free(g_serial);
+  free(H_0);
+  free(H_1);
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_schur_solve() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  setup_test_solver(solver);
+  solver_eval(solver);
+
+  /* Schur complement solve */
+  const int x_size = solver->x_size;
+  const real_t lambda = 1e-2;
+  real_t *dx = vec_malloc(x_size);
+  MU_CHECK(solver_schur_solve(solver, lambda, dx) == 0);
+
+  /* Dense solve */
+  real_t *H = calloc(x_size * x_size, sizeof(real_t));
+  real_t *dx_dense = vec_malloc(x_size);
+  block_hessian_dense(&solver->H, H);
+  for (int i = 0; i < x_size; i++) {
+    H[i * x_size + i] += lambda * H[i * x_size + i];
+  }
+  chol_solve(H, solver->g, dx_dense, x_size);
+
+  /* Compare relative to the size of the update */
+  real_t *diff = vec_malloc(x_size);
+  vec_sub(dx, dx_dense, diff, x_size);
+  MU_CHECK(vec_norm(diff, x_size) < 1e-2 * vec_norm(dx_dense, x_size));
+
+  free(dx);
+  free(H);
+  free(dx_dense);
+  free(diff);
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_sparse_solve() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  setup_test_solver(solver);
+  solver_eval(solver);
+
+  /* Sparse Cholesky and Schur complement solves */
+  const int x_size = solver->x_size;
+  const real_t lambda = 1e-2;
+  real_t *dx = vec_malloc(x_size);
+  real_t *dx_schur = vec_malloc(x_size);
+  MU_CHECK(solver_sparse_solve(solver, lambda, dx) == 0);
+  MU_CHECK(solver_schur_solve(solver, lambda, dx_schur) == 0);
+
+  /* Compare relative to the size of the update */
+  real_t *diff = vec_malloc(x_size);
+  vec_sub(dx, dx_schur, diff, x_size);
+  MU_CHECK(vec_norm(diff, x_size) < 1e-2 * vec_norm(dx_schur, x_size));
+
+  /* Re-evaluating keeps the symbolic factorization, only the numbers change */
+  const int *sn_cols = solver->chol.sn_cols;
+  solver->features[0].data[0] += 0.1;
+  solver_eval(solver);
+  MU_CHECK(solver_sparse_solve(solver, 10.0 * lambda, dx) == 0);
+  MU_CHECK(solver_schur_solve(solver, 10.0 * lambda, dx_schur) == 0);
+  MU_CHECK(solver->chol_valid);
+  MU_CHECK(solver->chol.sn_cols == sn_cols);
+  vec_sub(dx, dx_schur, diff, x_size);
+  MU_CHECK(vec_norm(diff, x_size) < 1e-2 * vec_norm(dx_schur, x_size));
+
+  free(dx);
+  free(dx_schur);
+  free(diff);
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_optimize() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  setup_test_solver(solver);
+
+  /* Simulate measurements from the ground truth state */
+  for (int k = 0; k < solver->nb_cam_factors; k++) {
+    cam_factor_t *factor = &solver->cam_factors[k];
+    factor->z[0] = 0.0;
+    factor->z[1] = 0.0;
+    cam_factor_eval(factor);
+    factor->z[0] = -factor->r[0] * sqrt(1.0 / factor->covar[0]);
+    factor->z[1] = -factor->r[1] * sqrt(1.0 / factor->covar[3]);
+  }
+
+  /* Perturb features */
+  for (int i = 0; i < solver->nb_features; i++) {
+    solver->features[i].data[0] += 0.1;
+    solver->features[i].data[1] -= 0.05;
+    solver->features[i].data[2] += 0.05;
+  }
+
+  /* No iterations means no accepted step */
+  solver->max_iter = 0;
+  MU_CHECK(solver_optimize(solver) == -1);
+
+  /* Optimize */
+  solver->max_iter = 20;
+  solver->verbose = 1;
+  solver->time_limit = 10.0;
+  solver_eval(solver);
+  real_t cost_init = 0.0;
+  for (int k = 0; k < solver->nb_cam_factors; k++) {
+    const real_t *r = solver->cam_factors[k].r;
+    cost_init += 0.5 * (r[0] * r[0] + r[1] * r[1]);
+  }
+  MU_CHECK(solver_optimize(solver) == 0);
+
+  real_t cost = 0.0;
+  solver_eval(solver);
+  for (int k = 0; k < solver->nb_cam_factors; k++) {
+    const real_t *r = solver->cam_factors[k].r;
+    cost += 0.5 * (r[0] * r[0] + r[1] * r[1]);
+  }
+  MU_CHECK(cost < 1e-3 * cost_init);
+
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_optimize_reject() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  setup_test_solver(solver);
+
+  /* Inconsistent measurements, the first step overshoots and is rejected */
+  for (int k = 0; k < solver->nb_cam_factors; k++) {
+    cam_factor_t *factor = &solver->cam_factors[k];
+    factor->z[0] = 320.0 + 10.0 * ((k * 7) % 11);
+    factor->z[1] = 240.0 - 10.0 * ((k * 5) % 13);
+  }
+  real_t features[10 * 3] = {0};
+  for (int i = 0; i < solver->nb_features; i++) {
+    vec_copy(solver->features[i].data, 3, &features[i * 3]);
+  }
+  solver->max_iter = 1;
+  MU_CHECK(solver_optimize(solver) == -1);
+
+  /* Estimates are restored and the residuals match them */
+  for (int i = 0; i < solver->nb_features; i++) {
+    MU_CHECK(vec_equals(solver->features[i].data, &features[i * 3], 3));
+  }
+  for (int k = 0; k < solver->nb_cam_factors; k++) {
+    cam_factor_t *factor = &solver->cam_factors[k];
+    const real_t r[2] = {factor->r[0], factor->r[1]};
+    cam_factor_residuals(factor);
+    MU_CHECK(fltcmp(r[0], factor->r[0]) == 0);
+    MU_CHECK(fltcmp(r[1], factor->r[1]) == 0);
+  }
+
+  solver_free(solver);
+  free(solver);
+  return 0;
+}
+
+int test_solver_imu() {
+  solver_t *solver = malloc(sizeof(solver_t));
+  solver_setup(solver);
+  solver_setup_imu(solver, 200.0, 1.0);
+
+  /* Simulate IMU measurements into the solver's IMU buffer */
+  imu_params_t imu_params;
+  test_imu_params(&imu_params);
+  imu_buf_t *imu_buf = malloc(sizeof(imu_buf_t));
+  pose_t pose_i, pose_j;
+  speed_biases_t sb_i, sb_j;
+  test_imu_sim(imu_buf, &pose_i, &sb_i, &pose_j, &sb_j);
+  imu_buf_copy(imu_buf, solver->imu_buf);
+
+  /* Add the states with pose j and speed and biases j perturbed */
+  pose_t *pi = solver_add_pose(solver, pose_i.ts, pose_i.data);
+  speed_biases_t *sbi = solver_add_speed_biases(solver, sb_i.ts, sb_i.data);
+  pose_j.data[4] += 0.1;
+  sb_j.data[0] -= 0.1;
+  pose_t *pj = solver_add_pose(solver, pose_j.ts, pose_j.data);
+  speed_biases_t *sbj = solver_add_speed_biases(solver, sb_j.ts, sb_j.data);
+  MU_CHECK(solver_add_imu_factor(solver, &imu_params, pi, sbi, pj, sbj));
+  MU_CHECK(solver->nb_imu_factors == 1);
+
+  /* IMU factor without measurements between the poses is rejected */
+  const real_t pose_data[7] = {1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  pose_t *pk = solver_add_pose(solver, 2000000000, pose_data);
+  MU_CHECK(solver_add_imu_factor(solver, &imu_params, pj, sbj, pk, sbj) == 0);
+  MU_CHECK(solver->nb_imu_factors == 1);
+  solver->nb_poses--; /* Drop the unconnected pose k */
+
+  /* Speed and biases are parameter blocks after the poses */
+  solver_eval(solver);
+  MU_CHECK(solver->x_size == 2 * 6 + 2 * 9);
+  MU_CHECK(solver->r_size == 15);
+  MU_CHECK(solver->H.param_sizes[2] == 9);
+  MU_CHECK(block_hessian_get(&solver->H, 0, 3) != NULL);
+
+  /* Optimize */
+  const real_t *r = solver->imu_factors[0].r;
+  const real_t cost_init = 0.5 * vec_norm(r, 15) * vec_norm(r, 15);
+  solver->max_iter = 20;
+  MU_CHECK(solver_optimize(solver) == 0);
+  solver_eval(solver);
+  const real_t cost = 0.5 * vec_norm(r, 15) * vec_norm(r, 15);
+  MU_CHECK(cost < 1e-3 * cost_init);
+
+  /* IMU factors still reference the speed and biases after they moved */
+  const real_t sb_data[9] = {0};
+  for (int k = 0; k < SOLVER_MIN_CAPACITY; k++) {
+    solver_add_speed_biases(solver, 0, sb_data);
+  }
+  MU_CHECK(solver->imu_factors[0].sb_i == &solver->speed_biases[0]);
+  MU_CHECK(solver->imu_factors[0].sb_j == &solver->speed_biases[1]);
+
+  imu_buf_free(imu_buf);
+  free(imu_buf);
+  solver_free(solver);
+  free(solver);
   return 0;
 }
 
@@ -1569,8 +3785,13 @@ void test_suite() {
   MU_ADD_TEST(test_dsv_cols);
   MU_ADD_TEST(test_dsv_fields);
   MU_ADD_TEST(test_dsv_data);
+  MU_ADD_TEST(test_dsv_data_format);
   MU_ADD_TEST(test_dsv_free);
 
+  /* ARENA */
+  MU_ADD_TEST(test_arena_alloc);
+  MU_ADD_TEST(test_arena_grow);
+
   /* TIME */
   MU_ADD_TEST(test_tic);
   MU_ADD_TEST(test_toc);
@@ -1614,6 +3835,8 @@ void test_suite() {
   MU_ADD_TEST(test_vec_add);
   MU_ADD_TEST(test_vec_sub);
   MU_ADD_TEST(test_dot);
+  MU_ADD_TEST(test_dot_backends);
+  MU_ADD_TEST(test_dot_fixed);
   MU_ADD_TEST(test_skew);
   MU_ADD_TEST(test_check_jacobian);
 
@@ -1622,7 +3845,10 @@ void test_suite() {
 
   /* CHOL */
   MU_ADD_TEST(test_chol);
+  MU_ADD_TEST(test_chol_not_pd);
   MU_ADD_TEST(test_chol_solve);
+  MU_ADD_TEST(test_chol_factor);
+  MU_ADD_TEST(test_ldlt_factor);
 #ifdef USE_LAPACK
   MU_ADD_TEST(test_chol_solve2);
 #endif
@@ -1649,6 +3875,20 @@ void test_suite() {
   MU_ADD_TEST(test_image_load);
   MU_ADD_TEST(test_image_print_properties);
   MU_ADD_TEST(test_image_free);
+  MU_ADD_TEST(test_image_pool);
+  MU_ADD_TEST(test_image_view);
+  MU_ADD_TEST(test_image_prefetch);
+  MU_ADD_TEST(test_image_gray);
+  MU_ADD_TEST(test_image_pyrdown);
+  MU_ADD_TEST(test_image_pyramid);
+  MU_ADD_TEST(test_image_scharr);
+  MU_ADD_TEST(test_image_box_filter);
+  MU_ADD_TEST(test_fast_detect);
+  MU_ADD_TEST(test_fast_grid_detect);
+  MU_ADD_TEST(test_klt_track);
+  MU_ADD_TEST(test_klt_track_lost);
+  MU_ADD_TEST(test_fundamental_8pt);
+  MU_ADD_TEST(test_ransac_fundamental);
   /* -- RADTAN */
   MU_ADD_TEST(test_radtan4_distort);
   MU_ADD_TEST(test_radtan4_point_jacobian);
@@ -1686,19 +3926,33 @@ void test_suite() {
   /* -- Camera factor */
   MU_ADD_TEST(test_cam_factor_setup);
   MU_ADD_TEST(test_cam_factor_eval);
+  MU_ADD_TEST(test_cam_factor_jacobians);
+  MU_ADD_TEST(test_cam_factor_residuals);
+  MU_ADD_TEST(test_cam_factor_batch_eval);
   /* -- IMU factor */
   MU_ADD_TEST(test_imu_buf_setup);
   MU_ADD_TEST(test_imu_buf_add);
   MU_ADD_TEST(test_imu_buf_clear);
   MU_ADD_TEST(test_imu_buf_copy);
   MU_ADD_TEST(test_imu_buf_print);
-  /* MU_ADD_TEST(test_imu_factor_setup); */
-  /* MU_ADD_TEST(test_imu_factor_eval); */
+  MU_ADD_TEST(test_imu_buf_view);
+  MU_ADD_TEST(test_imu_factor_setup);
+  MU_ADD_TEST(test_imu_factor_eval);
   /* -- Sliding window estimator */
+  MU_ADD_TEST(test_block_hessian_setup);
+  MU_ADD_TEST(test_block_hessian_accumulate);
+  MU_ADD_TEST(test_block_chol);
   MU_ADD_TEST(test_solver_setup);
+  MU_ADD_TEST(test_solver_reset);
   MU_ADD_TEST(test_solver_print);
-  /* MU_ADD_TEST(test_solver_eval); */
-  /* MU_ADD_TEST(test_solver_solve); */
+  MU_ADD_TEST(test_solver_eval);
+  MU_ADD_TEST(test_solver_eval_layout);
+  MU_ADD_TEST(test_solver_eval_parallel);
+  MU_ADD_TEST(test_solver_schur_solve);
+  MU_ADD_TEST(test_solver_sparse_solve);
+  MU_ADD_TEST(test_solver_optimize);
+  MU_ADD_TEST(test_solver_optimize_reject);
+  MU_ADD_TEST(test_solver_imu);
 }
 
 MU_RUN_TESTS(test_suite)